@@ -0,0 +1,555 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+// Benchmark scenarios, each run with a freshly initialized engine.
+// Frames are warmed up, then a fixed number of frame times is sampled.
+// Results are written as JSON, one scenario object per line, and can be
+// compared against an earlier result file with --baseline; the run fails
+// if p95 frame time or startup time of a scenario regresses past the
+// threshold. Without a display it runs under Xvfb, see README.md.
+// Culling scenarios run on the CPU only, a sample is one cull of all
+// objects instead of a frame.
+//
+// bench [--scenario=<name>|all] [--frames=N] [--warmup=N] [--objects=N]
+//       [--cull_objects=N] [--output=<file>] [--baseline=<file>]
+//       [--threshold=<percent>] [--<config key>=<value> ...]
+
+#include "Engine.h"
+#include "FrustumCuller.h"
+#include "Renderer.h"
+#include "Window.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    std::string scenario    = "all";
+    uint32_t frames         = 500;
+    uint32_t warmup         = 100;
+    uint32_t objects        = 1000;
+    uint32_t cullObjects    = 100000;
+    std::string output      = "bench_results.json";
+    std::string baseline;
+    double threshold        = 10.0;
+    // passed on to the engine config
+    std::vector<std::string> configArgs;
+};
+
+struct Scenario
+{
+    std::string name;
+    std::vector<std::string> configArgs;
+    // window switches between its size and a smaller one
+    // every this many frames, 0 = never
+    uint32_t resizeInterval = 0;
+    // frustum culling on the CPU instead of frames
+    bool culling = false;
+    core::FrustumCuller::Kernel cullKernel = core::FrustumCuller::Kernel::Scalar;
+};
+
+struct Result
+{
+    std::string name;
+    uint32_t frames     = 0;
+    double startupMs    = 0.0;
+    double meanMs       = 0.0;
+    double p50Ms        = 0.0;
+    double p95Ms        = 0.0;
+    double p99Ms        = 0.0;
+    double maxMs        = 0.0;
+    // culling scenarios only
+    double objectsPerMs = 0.0;
+};
+
+double elapsedMs(const Clock::time_point begin, const Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+// nearest rank on sorted samples
+double percentile(const std::vector<double>& sorted, const double fraction)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    const size_t rank = (size_t)std::ceil(fraction * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+// whole string, as Config parses its values
+uint32_t parseUint(const std::string& key, const std::string& value)
+{
+    errno = 0;
+    char* p_end = nullptr;
+    const unsigned long long parsed = strtoull(value.c_str(), &p_end, 10);
+    if (value.empty() || !isdigit((unsigned char)value[0]) || *p_end != '\0'
+        || errno == ERANGE || parsed > UINT32_MAX)
+    {
+        throw std::runtime_error("Invalid value for " + key + ": " + value);
+    }
+    return (uint32_t)parsed;
+}
+
+double parseDouble(const std::string& key, const std::string& value)
+{
+    errno = 0;
+    char* p_end = nullptr;
+    const double parsed = strtod(value.c_str(), &p_end);
+    if (value.empty() || *p_end != '\0' || errno == ERANGE || !std::isfinite(parsed) || parsed < 0.0)
+    {
+        throw std::runtime_error("Invalid value for " + key + ": " + value);
+    }
+    return parsed;
+}
+
+Options parseOptions(const int argc, const char* const argv[])
+{
+    Options options;
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        const std::string arg = argv[idx];
+        const size_t separator = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || separator == std::string::npos)
+        {
+            throw std::runtime_error("Invalid argument, expected --key=value: " + arg);
+        }
+        const std::string key = arg.substr(2, separator - 2);
+        const std::string value = arg.substr(separator + 1);
+
+        if (key == "scenario")          { options.scenario = value; }
+        else if (key == "frames")       { options.frames = std::max(parseUint(key, value), 1u); }
+        else if (key == "warmup")       { options.warmup = parseUint(key, value); }
+        else if (key == "objects")      { options.objects = std::max(parseUint(key, value), 1u); }
+        else if (key == "cull_objects") { options.cullObjects = std::max(parseUint(key, value), 1u); }
+        else if (key == "output")       { options.output = value; }
+        else if (key == "baseline")     { options.baseline = value; }
+        else if (key == "threshold")    { options.threshold = parseDouble(key, value); }
+        else                            { options.configArgs.push_back(arg); }
+    }
+    return options;
+}
+
+std::vector<Scenario> createScenarios(const uint32_t objects)
+{
+    const std::string count = std::to_string(objects);
+
+    std::vector<Scenario> scenarios;
+    scenarios.push_back({ "triangle", {}, 0 });
+    scenarios.push_back({ "instanced", { "--instance_count=" + count }, 0 });
+    scenarios.push_back({ "draws", { "--draw_count=" + count }, 0 });
+    scenarios.push_back({ "pipelines", { "--draw_count=" + count, "--pipeline_count=64" }, 0 });
+    scenarios.push_back({ "resize", {}, 10 });
+    scenarios.push_back({ "readback", { "--readback=true" }, 0 });
+
+    typedef core::FrustumCuller::Kernel Kernel;
+    for (const Kernel kernel : { Kernel::Scalar, Kernel::Sse, Kernel::Avx2 })
+    {
+        if (core::FrustumCuller::isSupported(kernel))
+        {
+            const std::string name = std::string("culling_") + core::FrustumCuller::getKernelName(kernel);
+            scenarios.push_back({ name, {}, 0, true, kernel });
+        }
+    }
+    return scenarios;
+}
+
+void setStatistics(std::vector<double>& samples, Result& result)
+{
+    std::sort(samples.begin(), samples.end());
+    double totalMs = 0.0;
+    for (const double sample : samples)
+    {
+        totalMs += sample;
+    }
+    result.frames = (uint32_t)samples.size();
+    result.meanMs = totalMs / samples.size();
+    result.p50Ms = percentile(samples, 0.50);
+    result.p95Ms = percentile(samples, 0.95);
+    result.p99Ms = percentile(samples, 0.99);
+    result.maxMs = samples.back();
+}
+
+// column-major, Vulkan clip space: 90 degree vertical fov, 16:9,
+// near 1, far 100, camera at the origin turned by yaw radians
+void getViewProjection(const float yaw, float viewProjection[16])
+{
+    const float aspect = 16.0f / 9.0f;
+    const float nearZ = 1.0f;
+    const float farZ = 100.0f;
+    const float projection[16] =
+    {
+        1.0f / aspect, 0.0f, 0.0f, 0.0f,
+        0.0f, -1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, farZ / (nearZ - farZ), -1.0f,
+        0.0f, 0.0f, nearZ * farZ / (nearZ - farZ), 0.0f,
+    };
+    // inverse of the camera rotation about y
+    const float s = std::sin(yaw);
+    const float c = std::cos(yaw);
+    const float view[16] =
+    {
+        c, 0.0f, s, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        -s, 0.0f, c, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+
+    for (uint32_t col = 0; col < 4; ++col)
+    {
+        for (uint32_t row = 0; row < 4; ++row)
+        {
+            float sum = 0.0f;
+            for (uint32_t k = 0; k < 4; ++k)
+            {
+                sum += projection[k * 4 + row] * view[col * 4 + k];
+            }
+            viewProjection[col * 4 + row] = sum;
+        }
+    }
+}
+
+Result runCullingScenario(const Scenario& scenario, const Options& options)
+{
+    Result result;
+    result.name = scenario.name;
+
+    // same objects for every kernel, spread around the camera
+    core::FrustumCuller culler(0);
+    culler.setKernel(scenario.cullKernel);
+    culler.reserve(options.cullObjects);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    for (uint32_t idx = 0; idx < options.cullObjects; ++idx)
+    {
+        core::FrustumCuller::Bounds bounds;
+        const float halfExtent = size(random);
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            bounds.center[axis] = position(random);
+            bounds.aabbMin[axis] = bounds.center[axis] - halfExtent;
+            bounds.aabbMax[axis] = bounds.center[axis] + halfExtent;
+        }
+        bounds.radius = halfExtent * std::sqrt(3.0f);
+        culler.add(bounds);
+    }
+
+    std::vector<core::FrustumCuller::ObjectId> visible;
+    std::vector<double> samples;
+    samples.reserve(options.frames);
+    uint64_t visibleTotal = 0;
+    for (uint32_t iteration = 0; iteration < options.warmup + options.frames; ++iteration)
+    {
+        float viewProjection[16];
+        getViewProjection(0.01f * iteration, viewProjection);
+        const core::FrustumCuller::Frustum frustum = core::FrustumCuller::Frustum::fromMatrix(viewProjection);
+
+        const Clock::time_point cullBegin = Clock::now();
+        culler.cull(frustum, visible);
+        const Clock::time_point cullEnd = Clock::now();
+        if (iteration >= options.warmup)
+        {
+            samples.push_back(elapsedMs(cullBegin, cullEnd));
+            visibleTotal += visible.size();
+        }
+    }
+
+    setStatistics(samples, result);
+    result.objectsPerMs = (result.meanMs > 0.0) ? (options.cullObjects / result.meanMs) : 0.0;
+    std::cout << "scenario " << result.name << ": " << options.cullObjects << " objects, "
+        << visibleTotal / samples.size() << " visible on average" << std::endl;
+    return result;
+}
+
+Result runScenario(const Scenario& scenario, const Options& options)
+{
+    // quiet and unthrottled, user and scenario arguments override these
+    std::vector<std::string> args =
+    {
+        "bench",
+        "--present_mode=immediate",
+        "--frame_rate_limit=0",
+        "--print_device_properties=false",
+        "--print_startup_timing=false",
+        "--print_frame_latency=false",
+    };
+    args.insert(args.end(), options.configArgs.begin(), options.configArgs.end());
+    args.insert(args.end(), scenario.configArgs.begin(), scenario.configArgs.end());
+
+    std::vector<const char*> argv;
+    for (const std::string& arg : args)
+    {
+        argv.push_back(arg.c_str());
+    }
+
+    Result result;
+    result.name = scenario.name;
+
+    core::Engine engine;
+    const Clock::time_point initBegin = Clock::now();
+    engine.init((int)argv.size(), argv.data());
+    result.startupMs = elapsedMs(initBegin, Clock::now());
+
+    engine.start();
+
+    // skipped frames are retried, but don't loop forever on a broken surface
+    const uint32_t maxAttempts = 10 * (options.warmup + options.frames);
+    uint32_t attempts = 0;
+    uint32_t presented = 0;
+    for (; presented < options.warmup && attempts < maxAttempts; ++attempts)
+    {
+        if (engine.runFrame())
+        {
+            ++presented;
+        }
+    }
+
+    // a real size change, so the swapchain, frame graphs and
+    // per resolution pipelines are all rebuilt
+    core::Window& window = engine.getWindow();
+    const uint32_t width = window.getWidth();
+    const uint32_t height = window.getHeight();
+    bool shrunk = false;
+
+    std::vector<double> samples;
+    samples.reserve(options.frames);
+    Clock::time_point frameBegin = Clock::now();
+    for (; samples.size() < options.frames && attempts < maxAttempts; ++attempts)
+    {
+        if (scenario.resizeInterval > 0 && (attempts % scenario.resizeInterval) == 0)
+        {
+            shrunk = !shrunk;
+            window.setSize(shrunk ? width * 3 / 4 : width, shrunk ? height * 3 / 4 : height);
+        }
+        if (engine.runFrame())
+        {
+            const Clock::time_point frameEnd = Clock::now();
+            samples.push_back(elapsedMs(frameBegin, frameEnd));
+            frameBegin = frameEnd;
+        }
+    }
+
+    engine.stop();
+
+    if (samples.empty())
+    {
+        throw std::runtime_error("No frames presented in scenario " + scenario.name);
+    }
+
+    setStatistics(samples, result);
+    return result;
+}
+
+void writeResults(std::ostream& out, const std::vector<Result>& results, const Options& options)
+{
+    // one scenario per line, readBaseline() depends on it
+    out << "{" << std::endl;
+    out << "\"frames\": " << options.frames << ", \"warmup\": " << options.warmup
+        << ", \"objects\": " << options.objects
+        << ", \"cull_objects\": " << options.cullObjects << "," << std::endl;
+    out << "\"scenarios\": [" << std::endl;
+    for (size_t idx = 0; idx < results.size(); ++idx)
+    {
+        const Result& result = results[idx];
+        out << "{\"name\": \"" << result.name << "\""
+            << ", \"frames\": " << result.frames
+            << ", \"startup_ms\": " << result.startupMs
+            << ", \"mean_ms\": " << result.meanMs
+            << ", \"p50_ms\": " << result.p50Ms
+            << ", \"p95_ms\": " << result.p95Ms
+            << ", \"p99_ms\": " << result.p99Ms
+            << ", \"max_ms\": " << result.maxMs;
+        if (result.objectsPerMs > 0.0)
+        {
+            out << ", \"objects_per_ms\": " << result.objectsPerMs;
+        }
+        out << "}" << ((idx + 1 < results.size()) ? "," : "") << std::endl;
+    }
+    out << "]" << std::endl;
+    out << "}" << std::endl;
+}
+
+bool findNumber(const std::string& line, const std::string& key, double& value)
+{
+    const std::string pattern = "\"" + key + "\": ";
+    const size_t pos = line.find(pattern);
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    value = std::strtod(line.c_str() + pos + pattern.size(), nullptr);
+    return true;
+}
+
+std::map<std::string, Result> readBaseline(const std::string& fileName)
+{
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open baseline: " + fileName);
+    }
+
+    std::map<std::string, Result> baseline;
+    const std::string namePattern = "{\"name\": \"";
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const size_t namePos = line.find(namePattern);
+        if (namePos == std::string::npos)
+        {
+            continue;
+        }
+        const size_t nameBegin = namePos + namePattern.size();
+        const size_t nameEnd = line.find('"', nameBegin);
+        if (nameEnd == std::string::npos)
+        {
+            continue;
+        }
+
+        Result result;
+        result.name = line.substr(nameBegin, nameEnd - nameBegin);
+        if (findNumber(line, "startup_ms", result.startupMs)
+            && findNumber(line, "p95_ms", result.p95Ms))
+        {
+            baseline[result.name] = result;
+        }
+    }
+    return baseline;
+}
+
+// returns the number of regressions
+uint32_t compareBaseline(const std::vector<Result>& results,
+    const std::map<std::string, Result>& baseline, const double threshold)
+{
+    const double limit = 1.0 + threshold / 100.0;
+    uint32_t regressions = 0;
+
+    const auto check = [&](const std::string& name, const char* const metric,
+        const double value, const double baseValue)
+    {
+        const bool regressed = value > baseValue * limit;
+        std::cout << (regressed ? "REGRESSION " : "ok         ") << name << " " << metric
+            << ": " << value << " ms, baseline " << baseValue << " ms" << std::endl;
+        if (regressed)
+        {
+            ++regressions;
+        }
+    };
+
+    for (const Result& result : results)
+    {
+        const auto iter = baseline.find(result.name);
+        if (iter == baseline.end())
+        {
+            std::cout << "no baseline for " << result.name << std::endl;
+            continue;
+        }
+        check(result.name, "p95", result.p95Ms, iter->second.p95Ms);
+        check(result.name, "startup", result.startupMs, iter->second.startupMs);
+    }
+    return regressions;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const Options options = parseOptions(argc, argv);
+
+        // read first, the output may overwrite it
+        std::map<std::string, Result> baseline;
+        if (!options.baseline.empty())
+        {
+            baseline = readBaseline(options.baseline);
+        }
+
+        std::vector<Scenario> scenarios = createScenarios(options.objects);
+        if (options.scenario != "all")
+        {
+            scenarios.erase(std::remove_if(scenarios.begin(), scenarios.end(),
+                [&options](const Scenario& scenario) { return scenario.name != options.scenario; }),
+                scenarios.end());
+            if (scenarios.empty())
+            {
+                throw std::runtime_error("Unknown scenario: " + options.scenario);
+            }
+        }
+
+        std::vector<Result> results;
+        for (const Scenario& scenario : scenarios)
+        {
+            if (scenario.culling)
+            {
+                results.push_back(runCullingScenario(scenario, options));
+                const Result& result = results.back();
+                std::cout << "scenario " << result.name
+                    << ": mean " << result.meanMs
+                    << " ms, p95 " << result.p95Ms
+                    << " ms, " << result.objectsPerMs << " objects/ms" << std::endl;
+                continue;
+            }
+
+            results.push_back(runScenario(scenario, options));
+            const Result& result = results.back();
+            std::cout << "scenario " << result.name
+                << ": startup " << result.startupMs
+                << " ms, mean " << result.meanMs
+                << " ms, p95 " << result.p95Ms
+                << " ms, p99 " << result.p99Ms
+                << " ms, frames " << result.frames << std::endl;
+        }
+
+        std::ofstream file(options.output);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open output: " + options.output);
+        }
+        writeResults(file, results, options);
+        std::cout << "results written to " << options.output << std::endl;
+
+        if (!options.baseline.empty())
+        {
+            const uint32_t regressions = compareBaseline(results, baseline, options.threshold);
+            if (regressions > 0)
+            {
+                std::cerr << regressions << " regression(s) past "
+                    << options.threshold << "%" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    catch (const std::runtime_error& err)
+    {
+        std::cerr << err.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,3 @@
+#!/bin/sh
+glslangValidator -V shaders/triangle.vert -o shaders/triangle.vert.spv
+glslangValidator -V shaders/triangle.frag -o shaders/triangle.frag.spv
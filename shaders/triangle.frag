@@ -1,11 +1,42 @@
 #version 430 core
 
+// specialization constants, set per pipeline variant
+
+// size of the bindless texture array
+layout(constant_id = 0) const uint c_textureCount = 1;
+// swapchain extent, the gradient spans the rendered part of it
+layout(constant_id = 1) const float c_resolutionX = 1600.0;
+layout(constant_id = 2) const float c_resolutionY = 900.0;
+// without a texture the sampling is compiled out
+layout(constant_id = 3) const bool c_textured = true;
+
+layout(set = 0, binding = 0) uniform sampler2D u_textures[c_textureCount];
+
+layout(push_constant) uniform PushConstants
+{
+    layout(offset = 4) float minLod;
+    uint textureIndex;
+    float renderScaleX;
+    float renderScaleY;
+} pc;
+
+layout(location = 0) in vec2 in_uv;
+
 layout(location = 0) out vec4 out_color;
 
 void main(void)
 {
+    // dynamic resolution renders into the top left part of the target
+    const vec2 size = vec2(c_resolutionX * pc.renderScaleX, c_resolutionY * pc.renderScaleY);
     out_color = vec4(
-        float(gl_FragCoord.x)/1600.0f,
-        float(gl_FragCoord.y)/900.0f, 
-        float(gl_FragCoord.x)/1600.0f, 1.0);
+        float(gl_FragCoord.x) / size.x,
+        float(gl_FragCoord.y) / size.y,
+        float(gl_FragCoord.x) / size.x, 1.0);
+
+    if (c_textured)
+    {
+        // finer mips than minLod are not streamed in yet
+        const float lod = max(textureQueryLod(u_textures[pc.textureIndex], in_uv).y, pc.minLod);
+        out_color *= textureLod(u_textures[pc.textureIndex], in_uv, lod);
+    }
 }
@@ -1,14 +1,32 @@
 #version 430 core
 
+// specialization constant, set per pipeline variant:
+// instances are laid out in a grid of this many rows and columns
+layout(constant_id = 0) const uint c_gridSize = 1;
+
+layout(push_constant) uniform PushConstants
+{
+    float angle;
+} pc;
+
+// MeshBatcher::PackedVertex, the normal at location 1 is not used
+layout(location = 0) in vec3 in_position;
+layout(location = 2) in vec2 in_uv;
+
+layout(location = 0) out vec2 out_uv;
+
 void main(void)
 {
-    const vec2 vertices[] =
-    {
-        vec2(-0.5, 0.0),
-        vec2( 0.0, 1.0),
-        vec2( 0.5, 0.0)
-    };
-    
-    const vec2 vert = vertices[gl_VertexIndex % 3];
-    gl_Position = vec4(vert, 0.5, 1.0);
+    const vec2 vert = in_position.xy;
+    const float s = sin(pc.angle);
+    const float c = cos(pc.angle);
+    const vec2 pos = vec2(c * vert.x - s * vert.y, s * vert.x + c * vert.y);
+
+    // centre of the instance's cell, the origin with a single instance
+    const uint instanceIndex = uint(gl_InstanceIndex);
+    const vec2 cell = vec2(instanceIndex % c_gridSize, instanceIndex / c_gridSize);
+    const vec2 offset = (cell * 2.0 + 1.0) / float(c_gridSize) - 1.0;
+
+    gl_Position = vec4(pos / float(c_gridSize) + offset, 0.5, 1.0);
+    out_uv = in_uv;
 }
@@ -0,0 +1,444 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "BindlessTable.h"
+
+#include "DeletionQueue.h"
+#include "ErrorHandling.h"
+
+#include <assert.h>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// frames in flight are limited by the swapchain image count
+static const uint32_t s_maxSetCopies = 8;
+static const VkDeviceSize s_defaultBufferSize = 256;
+
+BindlessTable::BindlessTable(VkDevice device,
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    const Limits& limits)
+    : m_device(device),
+    m_limits(limits)
+{
+    assert(device);
+    assert(limits.textureCount > 0 && limits.bufferCount > 0);
+
+    m_textures.resize(m_limits.textureCount);
+    m_buffers.resize(m_limits.bufferCount);
+    // lowest indices are handed out first
+    for (uint32_t idx = m_limits.textureCount; idx > 0; --idx)
+    {
+        m_freeTextures.push_back(idx - 1);
+    }
+    for (uint32_t idx = m_limits.bufferCount; idx > 0; --idx)
+    {
+        m_freeBuffers.push_back(idx - 1);
+    }
+
+    const VkDescriptorSetLayoutBinding bindings[] =
+    {
+        {
+            0,                                          // binding
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+            m_limits.textureCount,                      // descriptorCount
+            VK_SHADER_STAGE_FRAGMENT_BIT,               // stageFlags
+            nullptr                                     // pImmutableSamplers
+        },
+        {
+            1,                                                          // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,                          // descriptorType
+            m_limits.bufferCount,                                       // descriptorCount
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,  // stageFlags
+            nullptr                                                     // pImmutableSamplers
+        }
+    };
+
+    // slots that are not used by pending frames can be written at any time,
+    // and slots that are never written don't need to be valid
+    constexpr VkDescriptorBindingFlags bindingFlag =
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+        | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+        | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    const VkDescriptorBindingFlags bindingFlags[] = { bindingFlag, bindingFlag };
+
+    const VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,  // sType
+        nullptr,                                                            // pNext
+        2,                                                                  // bindingCount
+        bindingFlags                                                        // pBindingFlags
+    };
+
+    const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,    // sType
+        m_limits.updateAfterBind ? &bindingFlagsCreateInfo : nullptr,   // pNext
+        m_limits.updateAfterBind
+            ? (VkDescriptorSetLayoutCreateFlags)VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT
+            : 0,                                                // flags
+        2,                                                      // bindingCount
+        bindings                                                // pBindings
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkCreateDescriptorSetLayout(
+        m_device,                       // device
+        &descriptorSetLayoutCreateInfo, // pCreateInfo
+        nullptr,                        // pAllocator
+        &m_setLayout));                 // pSetLayout
+
+    const uint32_t setCount = m_limits.updateAfterBind ? 1 : s_maxSetCopies;
+    const VkDescriptorPoolSize descriptorPoolSizes[] =
+    {
+        {
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // type
+            setCount * m_limits.textureCount            // descriptorCount
+        },
+        {
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // type
+            setCount * m_limits.bufferCount             // descriptorCount
+        }
+    };
+
+    const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,  // sType
+        nullptr,                                        // pNext
+        m_limits.updateAfterBind
+            ? (VkDescriptorPoolCreateFlags)VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT
+            : 0,                                        // flags
+        setCount,                                       // maxSets
+        2,                                              // poolSizeCount
+        descriptorPoolSizes                             // pPoolSizes
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkCreateDescriptorPool(
+        m_device,                   // device
+        &descriptorPoolCreateInfo,  // pCreateInfo
+        nullptr,                    // pAllocator
+        &m_descriptorPool));        // pDescriptorPool
+
+    if (m_limits.updateAfterBind)
+    {
+        SetCopy copy;
+        allocateSet(copy.set);
+        copy.version = m_version;
+        m_sets.push_back(copy);
+    }
+    else
+    {
+        createDefaultBuffer(memoryProperties);
+    }
+}
+
+BindlessTable::~BindlessTable()
+{
+    // frees the sets too
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+    vkDestroyBuffer(m_device, m_defaultBuffer, nullptr);
+    vkFreeMemory(m_device, m_defaultBufferMemory, nullptr);
+}
+
+void BindlessTable::createDefaultBuffer(const VkPhysicalDeviceMemoryProperties& memoryProperties)
+{
+    // contents are never read by anything meaningful, it only has to exist
+    const VkBufferCreateInfo bufferCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,   // sType
+        nullptr,                                // pNext
+        0,                                      // flags
+        s_defaultBufferSize,                    // size
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,     // usage
+        VK_SHARING_MODE_EXCLUSIVE,              // sharingMode
+        0,                                      // queueFamilyIndexCount
+        nullptr                                 // pQueueFamilyIndices
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkCreateBuffer(
+        m_device,           // device
+        &bufferCreateInfo,  // pCreateInfo
+        nullptr,            // pAllocator
+        &m_defaultBuffer)); // pBuffer
+
+    VkMemoryRequirements memoryRequirements = {};
+    vkGetBufferMemoryRequirements(
+        m_device,               // device
+        m_defaultBuffer,        // buffer
+        &memoryRequirements);   // pMemoryRequirements
+
+    uint32_t memoryTypeIndex = ~0u;
+    for (uint32_t idx = 0; idx < memoryProperties.memoryTypeCount; ++idx)
+    {
+        if (memoryRequirements.memoryTypeBits & (1u << idx))
+        {
+            memoryTypeIndex = idx;
+            break;
+        }
+    }
+    if (memoryTypeIndex == ~0u)
+    {
+        throw std::runtime_error("No memory type for the default bindless buffer");
+    }
+
+    const VkMemoryAllocateInfo memoryAllocateInfo =
+    {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, // sType
+        nullptr,                                // pNext
+        memoryRequirements.size,                // allocationSize
+        memoryTypeIndex                         // memoryTypeIndex
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkAllocateMemory(
+        m_device,                   // device
+        &memoryAllocateInfo,        // pAllocateInfo
+        nullptr,                    // pAllocator
+        &m_defaultBufferMemory));   // pMemory
+
+    CHECK_VK_RESULT_SUCCESS(vkBindBufferMemory(
+        m_device,               // device
+        m_defaultBuffer,        // buffer
+        m_defaultBufferMemory,  // memory
+        0));                    // memoryOffset
+}
+
+VkDescriptorSetLayout BindlessTable::getSetLayout() const
+{
+    return m_setLayout;
+}
+
+const BindlessTable::Limits& BindlessTable::getLimits() const
+{
+    return m_limits;
+}
+
+bool BindlessTable::isCompatible(const std::vector<VkDescriptorSetLayoutBinding>& bindings) const
+{
+    for (const VkDescriptorSetLayoutBinding& binding : bindings)
+    {
+        // arrays sized by specialization constants reflect their default size
+        const bool textures = (binding.binding == 0)
+            && (binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+            && (binding.descriptorCount <= m_limits.textureCount)
+            && !(binding.stageFlags & ~VK_SHADER_STAGE_FRAGMENT_BIT);
+        const bool buffers = (binding.binding == 1)
+            && (binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+            && (binding.descriptorCount <= m_limits.bufferCount)
+            && !(binding.stageFlags & ~(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT));
+        if (!textures && !buffers)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BindlessTable::setDefaultTexture(VkImageView imageView, VkSampler sampler)
+{
+    m_defaultTexture.sampler = sampler;
+    m_defaultTexture.imageView = imageView;
+    m_defaultTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    ++m_version;
+}
+
+void BindlessTable::allocateSet(VkDescriptorSet& set)
+{
+    const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo =
+    {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, // sType
+        nullptr,                                        // pNext
+        m_descriptorPool,                               // descriptorPool
+        1,                                              // descriptorSetCount
+        &m_setLayout                                    // pSetLayouts
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkAllocateDescriptorSets(
+        m_device,                       // device
+        &descriptorSetAllocateInfo,     // pAllocateInfo
+        &set));                         // pDescriptorSets
+}
+
+void BindlessTable::writeTextures(VkDescriptorSet set, const uint32_t first, const uint32_t count)
+{
+    std::vector<VkDescriptorImageInfo> imageInfos(m_textures.begin() + first,
+        m_textures.begin() + first + count);
+    for (VkDescriptorImageInfo& imageInfo : imageInfos)
+    {
+        if (!imageInfo.imageView)
+        {
+            imageInfo = m_defaultTexture;
+        }
+    }
+
+    const VkWriteDescriptorSet writeDescriptorSet =
+    {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,     // sType
+        nullptr,                                    // pNext
+        set,                                        // dstSet
+        0,                                          // dstBinding
+        first,                                      // dstArrayElement
+        count,                                      // descriptorCount
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+        imageInfos.data(),                          // pImageInfo
+        nullptr,                                    // pBufferInfo
+        nullptr                                     // pTexelBufferView
+    };
+
+    vkUpdateDescriptorSets(
+        m_device,               // device
+        1,                      // descriptorWriteCount
+        &writeDescriptorSet,    // pDescriptorWrites
+        0,                      // descriptorCopyCount
+        nullptr);               // pDescriptorCopies
+}
+
+void BindlessTable::writeBuffers(VkDescriptorSet set, const uint32_t first, const uint32_t count)
+{
+    std::vector<VkDescriptorBufferInfo> bufferInfos(m_buffers.begin() + first,
+        m_buffers.begin() + first + count);
+    for (VkDescriptorBufferInfo& bufferInfo : bufferInfos)
+    {
+        if (!bufferInfo.buffer)
+        {
+            bufferInfo = { m_defaultBuffer, 0, VK_WHOLE_SIZE };
+        }
+    }
+
+    const VkWriteDescriptorSet writeDescriptorSet =
+    {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, // sType
+        nullptr,                                // pNext
+        set,                                    // dstSet
+        1,                                      // dstBinding
+        first,                                  // dstArrayElement
+        count,                                  // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,      // descriptorType
+        nullptr,                                // pImageInfo
+        bufferInfos.data(),                     // pBufferInfo
+        nullptr                                 // pTexelBufferView
+    };
+
+    vkUpdateDescriptorSets(
+        m_device,               // device
+        1,                      // descriptorWriteCount
+        &writeDescriptorSet,    // pDescriptorWrites
+        0,                      // descriptorCopyCount
+        nullptr);               // pDescriptorCopies
+}
+
+uint32_t BindlessTable::addTexture(VkImageView imageView, VkSampler sampler)
+{
+    assert(imageView && sampler);
+    if (m_freeTextures.empty())
+    {
+        return c_invalidIndex;
+    }
+    const uint32_t index = m_freeTextures.back();
+    m_freeTextures.pop_back();
+
+    m_textures[index] = { sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    ++m_version;
+
+    if (m_limits.updateAfterBind)
+    {
+        // the slot is not used by any pending frame
+        writeTextures(m_sets[0].set, index, 1);
+    }
+    return index;
+}
+
+uint32_t BindlessTable::addBuffer(VkBuffer buffer)
+{
+    assert(buffer);
+    if (m_freeBuffers.empty())
+    {
+        return c_invalidIndex;
+    }
+    const uint32_t index = m_freeBuffers.back();
+    m_freeBuffers.pop_back();
+
+    m_buffers[index] = { buffer, 0, VK_WHOLE_SIZE };
+    ++m_version;
+
+    if (m_limits.updateAfterBind)
+    {
+        writeBuffers(m_sets[0].set, index, 1);
+    }
+    return index;
+}
+
+void BindlessTable::removeTexture(const uint32_t index, DeletionQueue& deletionQueue)
+{
+    assert(index < m_textures.size() && m_textures[index].imageView);
+    deletionQueue.destroy([this, index]()
+    {
+        m_textures[index] = VkDescriptorImageInfo();
+        m_freeTextures.push_back(index);
+        ++m_version;
+    });
+}
+
+void BindlessTable::removeBuffer(const uint32_t index, DeletionQueue& deletionQueue)
+{
+    assert(index < m_buffers.size() && m_buffers[index].buffer);
+    deletionQueue.destroy([this, index]()
+    {
+        m_buffers[index] = VkDescriptorBufferInfo();
+        m_freeBuffers.push_back(index);
+        ++m_version;
+    });
+}
+
+VkDescriptorSet BindlessTable::acquireSet(const DeletionQueue& deletionQueue)
+{
+    if (m_limits.updateAfterBind)
+    {
+        return m_sets[0].set;
+    }
+
+    assert(m_defaultTexture.imageView);
+
+    // a copy no pending frame uses, or the one already bound this frame
+    const uint64_t recordingFrame = deletionQueue.getRecordingFrame();
+    const uint64_t completedFrame = deletionQueue.getCompletedFrame();
+    SetCopy* p_copy = nullptr;
+    for (SetCopy& copy : m_sets)
+    {
+        if (copy.frame == recordingFrame)
+        {
+            return copy.set;
+        }
+        if (!p_copy && copy.frame <= completedFrame)
+        {
+            p_copy = &copy;
+        }
+    }
+
+    if (!p_copy)
+    {
+        if (m_sets.size() == s_maxSetCopies)
+        {
+            throw std::runtime_error("Too many frames in flight for the bindless table");
+        }
+        m_sets.push_back(SetCopy());
+        p_copy = &m_sets.back();
+        allocateSet(p_copy->set);
+    }
+
+    if (p_copy->version != m_version)
+    {
+        writeTextures(p_copy->set, 0, m_limits.textureCount);
+        writeBuffers(p_copy->set, 0, m_limits.bufferCount);
+        p_copy->version = m_version;
+    }
+    p_copy->frame = recordingFrame;
+
+    return p_copy->set;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,111 @@
+#ifndef CORE_BINDLESS_TABLE_H
+#define CORE_BINDLESS_TABLE_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+class DeletionQueue;
+
+// All textures and buffers the shaders can read, as two descriptor arrays
+// in one set that is bound once per frame. Draws pick their resources with
+// array indices passed in push constants, so there is no per draw binding.
+//
+// With descriptor indexing the set is update-after-bind and partially
+// bound: slots are written once when added, while earlier frames are still
+// in flight. Without it, a copy of the set is kept per frame in flight,
+// every slot is valid (empty ones point to the default texture and buffer)
+// and a copy is rewritten before it is bound if slots have changed since.
+//
+// binding 0: combined image samplers, binding 1: storage buffers
+class BindlessTable
+{
+public:
+    static const uint32_t c_invalidIndex = ~0u;
+
+    struct Limits
+    {
+        uint32_t textureCount   = 0;
+        uint32_t bufferCount    = 0;
+        // descriptor indexing with update-after-bind and partially bound
+        bool updateAfterBind    = false;
+    };
+
+    BindlessTable(VkDevice device,
+        const VkPhysicalDeviceMemoryProperties& memoryProperties,
+        const Limits& limits);
+    // the device must be idle
+    ~BindlessTable();
+
+    BindlessTable(const BindlessTable&) = delete;
+    BindlessTable& operator=(const BindlessTable&) = delete;
+
+    VkDescriptorSetLayout getSetLayout() const;
+    const Limits& getLimits() const;
+    // true if the layout covers the set 0 bindings a shader declares
+    bool isCompatible(const std::vector<VkDescriptorSetLayoutBinding>& bindings) const;
+
+    // written to empty texture slots, must be set before the first
+    // acquireSet() without descriptor indexing, nullptr clears it
+    void setDefaultTexture(VkImageView imageView, VkSampler sampler);
+
+    // returns c_invalidIndex if the table is full
+    uint32_t addTexture(VkImageView imageView, VkSampler sampler);
+    uint32_t addBuffer(VkBuffer buffer);
+    // the slot is reused once the frames recorded so far are done
+    void removeTexture(const uint32_t index, DeletionQueue& deletionQueue);
+    void removeBuffer(const uint32_t index, DeletionQueue& deletionQueue);
+
+    // set to bind for the frame being recorded
+    VkDescriptorSet acquireSet(const DeletionQueue& deletionQueue);
+
+private:
+    struct SetCopy
+    {
+        VkDescriptorSet set = nullptr;
+        // last frame that bound it, 0 = never
+        uint64_t frame      = 0;
+        uint64_t version    = 0;
+    };
+
+    void createDefaultBuffer(const VkPhysicalDeviceMemoryProperties& memoryProperties);
+    void allocateSet(VkDescriptorSet& set);
+    void writeTextures(VkDescriptorSet set, const uint32_t first, const uint32_t count);
+    void writeBuffers(VkDescriptorSet set, const uint32_t first, const uint32_t count);
+
+    VkDevice m_device = nullptr;
+    const Limits m_limits;
+
+    VkDescriptorSetLayout m_setLayout   = nullptr;
+    VkDescriptorPool m_descriptorPool   = nullptr;
+
+    // current contents of the slots
+    std::vector<VkDescriptorImageInfo> m_textures;
+    std::vector<VkDescriptorBufferInfo> m_buffers;
+    std::vector<uint32_t> m_freeTextures;
+    std::vector<uint32_t> m_freeBuffers;
+
+    VkDescriptorImageInfo m_defaultTexture = {};
+    VkBuffer m_defaultBuffer            = nullptr;
+    VkDeviceMemory m_defaultBufferMemory= nullptr;
+
+    // one copy with update-after-bind, grows to the frames in flight without
+    std::vector<SetCopy> m_sets;
+    // bumped on every slot change
+    uint64_t m_version = 1;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_BINDLESS_TABLE_H
@@ -0,0 +1,371 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "Config.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+static const char* const s_defaultConfigFile = "triangle.cfg";
+static const char* const s_envPrefix = "CORE_";
+
+static std::string trim(const std::string& str)
+{
+    const size_t first = str.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+    {
+        return std::string();
+    }
+    const size_t last = str.find_last_not_of(" \t\r\n");
+    return str.substr(first, last - first + 1);
+}
+
+static std::string toLower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(),
+        [](unsigned char c) { return (char)tolower(c); });
+    return str;
+}
+
+static std::string toUpper(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(),
+        [](unsigned char c) { return (char)toupper(c); });
+    return str;
+}
+
+static std::runtime_error invalidValue(const char* const key, const std::string& value)
+{
+    return std::runtime_error("Invalid config value \"" + value + "\" for " + key);
+}
+
+static const struct
+{
+    const char* name;
+    VkPresentModeKHR mode;
+} s_presentModes[] =
+{
+    { "default",        VK_PRESENT_MODE_MAX_ENUM_KHR },
+    { "immediate",      VK_PRESENT_MODE_IMMEDIATE_KHR },
+    { "mailbox",        VK_PRESENT_MODE_MAILBOX_KHR },
+    { "fifo",           VK_PRESENT_MODE_FIFO_KHR },
+    { "fifo_relaxed",   VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+Config::Config()
+{
+    addString("application_name",   applicationName);
+    addString("engine_name",        engineName);
+    addVersion("application_version", applicationVersion);
+    addVersion("engine_version",    engineVersion);
+    addVersion("api_version",       apiVersion);
+
+    addUint("window_width",         windowWidth);
+    addUint("window_height",        windowHeight);
+
+    addUint("buffering_count",      bufferingCount);
+    addPresentMode("present_mode",  presentMode);
+    addUint("max_frames_ahead",     maxFramesAhead);
+    addUint("frame_rate_limit",     frameRateLimit);
+
+    addBool("bindless",             bindless);
+    addBool("timeline_semaphore",   timelineSemaphore);
+
+    addUint("msaa_samples",         msaaSamples);
+
+    addBool("dynamic_resolution",   dynamicResolution);
+    addUint("gpu_time_budget_us",   gpuTimeBudgetUs);
+    addUint("min_resolution_scale", minResolutionScale);
+
+    addUint("simulation_tick_rate", simulationTickRate);
+    addUint("worker_thread_count",  workerThreadCount);
+    addUint("memory_budget_watermark", memoryBudgetWatermark);
+
+    addString("gpu",                gpuPreference);
+
+    addString("vertex_shader",      vertexShader);
+    addString("fragment_shader",    fragmentShader);
+    addString("cache_path",         cachePath);
+
+    addString("texture",            texture);
+    addUint("texture_upload_budget_kb", textureUploadBudgetKb);
+    addUint("texture_staging_kb",   textureStagingKb);
+
+    addUint("draw_count",           drawCount);
+    addUint("instance_count",       instanceCount);
+    addUint("pipeline_count",       pipelineCount);
+    addBool("readback",             readback);
+
+    addBool("gpu_statistics",       gpuStatistics);
+
+    addBool("print_config",         printConfig);
+    addBool("print_device_properties", printDeviceProperties);
+    addBool("print_startup_timing", printStartupTiming);
+    addBool("print_render_graph",   printRenderGraph);
+    addBool("print_draw_statistics", printDrawStatistics);
+    addBool("print_memory_budget",  printMemoryBudget);
+    addBool("print_frame_latency",  printFrameLatency);
+
+    addString("profile_trace",      profileTrace);
+}
+
+void Config::load(const int argc, const char* const argv[])
+{
+    // command line is parsed first to find the config file,
+    // but applied last so it overrides everything else
+    std::string configFile = s_defaultConfigFile;
+    std::vector<std::pair<std::string, std::string>> arguments;
+
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        std::string arg = argv[idx];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            throw std::runtime_error("Invalid argument: " + arg);
+        }
+        arg = arg.substr(2);
+
+        std::string key;
+        std::string value;
+        const size_t separator = arg.find('=');
+        if (separator != std::string::npos)
+        {
+            key = arg.substr(0, separator);
+            value = arg.substr(separator + 1);
+        }
+        else if (idx + 1 < argc)
+        {
+            key = arg;
+            value = argv[++idx];
+        }
+        else
+        {
+            throw std::runtime_error("Missing value for argument: " + arg);
+        }
+
+        std::replace(key.begin(), key.end(), '-', '_');
+        if (key == "config")
+        {
+            configFile = value;
+        }
+        else
+        {
+            arguments.emplace_back(key, value);
+        }
+    }
+
+    loadFile(configFile);
+
+    for (const auto& ref : m_entries)
+    {
+        const std::string envName = s_envPrefix + toUpper(ref.first);
+        const char* const envValue = getenv(envName.c_str());
+        if (envValue)
+        {
+            ref.second.setter(envValue);
+        }
+    }
+
+    for (const auto& ref : arguments)
+    {
+        set(ref.first, ref.second);
+    }
+
+    if (printConfig)
+    {
+        print();
+    }
+}
+
+void Config::loadFile(const std::string& fileName)
+{
+    std::ifstream file(fileName);
+    if (!file.is_open())
+    {
+        // optional, defaults are used
+        return;
+    }
+
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+        line = trim(line);
+        if (line.empty())
+        {
+            continue;
+        }
+
+        const size_t separator = line.find('=');
+        if (separator == std::string::npos)
+        {
+            throw std::runtime_error(fileName + "(" + std::to_string(lineNumber)
+                + "): expected key = value");
+        }
+        set(trim(line.substr(0, separator)), trim(line.substr(separator + 1)));
+    }
+}
+
+void Config::set(const std::string& key, const std::string& value)
+{
+    const auto iter = m_entries.find(toLower(key));
+    if (iter == m_entries.end())
+    {
+        throw std::runtime_error("Unknown config key: " + key);
+    }
+    iter->second.setter(value);
+}
+
+void Config::print() const
+{
+    for (const auto& ref : m_entries)
+    {
+        std::cout << ref.first << " = " << ref.second.getter() << std::endl;
+    }
+}
+
+void Config::addString(const char* const key, std::string& value)
+{
+    m_entries[key] =
+    {
+        [&value](const std::string& str) { value = str; },
+        [&value]() { return value; }
+    };
+}
+
+void Config::addUint(const char* const key, uint32_t& value)
+{
+    m_entries[key] =
+    {
+        [key, &value](const std::string& str)
+        {
+            errno = 0;
+            char* end = nullptr;
+            const unsigned long parsed = strtoul(str.c_str(), &end, 10);
+            if (str.empty() || *end != '\0' || str[0] == '-'
+                || errno == ERANGE || parsed > UINT32_MAX)
+            {
+                throw invalidValue(key, str);
+            }
+            value = (uint32_t)parsed;
+        },
+        [&value]() { return std::to_string(value); }
+    };
+}
+
+void Config::addBool(const char* const key, bool& value)
+{
+    m_entries[key] =
+    {
+        [key, &value](const std::string& str)
+        {
+            const std::string lower = toLower(str);
+            if (lower == "1" || lower == "true" || lower == "on" || lower == "yes")
+            {
+                value = true;
+            }
+            else if (lower == "0" || lower == "false" || lower == "off" || lower == "no")
+            {
+                value = false;
+            }
+            else
+            {
+                throw invalidValue(key, str);
+            }
+        },
+        [&value]() { return std::string(value ? "true" : "false"); }
+    };
+}
+
+void Config::addVersion(const char* const key, uint32_t& value)
+{
+    // major.minor.patch, minor and patch are optional
+    m_entries[key] =
+    {
+        [key, &value](const std::string& str)
+        {
+            uint32_t parts[3] = { 0, 0, 0 };
+            std::istringstream stream(str);
+            std::string part;
+            uint32_t count = 0;
+            while (std::getline(stream, part, '.'))
+            {
+                if (count == 3 || part.empty()
+                    || !std::all_of(part.begin(), part.end(), ::isdigit))
+                {
+                    throw invalidValue(key, str);
+                }
+                parts[count++] = (uint32_t)std::stoul(part);
+            }
+            if (count == 0)
+            {
+                throw invalidValue(key, str);
+            }
+            value = VK_MAKE_VERSION(parts[0], parts[1], parts[2]);
+        },
+        [&value]()
+        {
+            return std::to_string(VK_VERSION_MAJOR(value)) + "."
+                + std::to_string(VK_VERSION_MINOR(value)) + "."
+                + std::to_string(VK_VERSION_PATCH(value));
+        }
+    };
+}
+
+void Config::addPresentMode(const char* const key, VkPresentModeKHR& value)
+{
+    m_entries[key] =
+    {
+        [key, &value](const std::string& str)
+        {
+            const std::string lower = toLower(str);
+            for (const auto& ref : s_presentModes)
+            {
+                if (lower == ref.name)
+                {
+                    value = ref.mode;
+                    return;
+                }
+            }
+            throw invalidValue(key, str);
+        },
+        [&value]()
+        {
+            for (const auto& ref : s_presentModes)
+            {
+                if (value == ref.mode)
+                {
+                    return std::string(ref.name);
+                }
+            }
+            return std::to_string(value);
+        }
+    };
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,150 @@
+#ifndef CORE_CONFIG_H
+#define CORE_CONFIG_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Runtime settings. Defaults below are overridden in order by
+// the config file ("key = value" lines, '#' comments),
+// environment variables (CORE_<KEY>, e.g. CORE_WINDOW_WIDTH=1280)
+// and command line arguments (--key=value or --key value).
+// The file is triangle.cfg unless given with --config=<file>.
+class Config
+{
+public:
+    Config();
+    ~Config() = default;
+
+    Config(const Config&) = delete;
+    Config& operator=(const Config&) = delete;
+
+    // throws std::runtime_error for unknown keys and invalid values
+    void load(const int argc, const char* const argv[]);
+    void loadFile(const std::string& fileName);
+    void set(const std::string& key, const std::string& value);
+
+    void print() const;
+
+    std::string applicationName     = "ApplicationName";
+    std::string engineName          = "Core";
+    uint32_t applicationVersion     = VK_MAKE_VERSION(1, 0, 0);
+    uint32_t engineVersion          = VK_MAKE_VERSION(1, 0, 0);
+    // minimum for the device
+    uint32_t apiVersion             = VK_API_VERSION_1_0;
+
+    uint32_t windowWidth            = 1600;
+    uint32_t windowHeight           = 900;
+
+    // swapchain images to ask for
+    uint32_t bufferingCount         = 3;
+    // VK_PRESENT_MODE_MAX_ENUM_KHR = first supported
+    VkPresentModeKHR presentMode    = VK_PRESENT_MODE_MAX_ENUM_KHR;
+    // frames the cpu may queue ahead of the gpu, 0 = no limit
+    uint32_t maxFramesAhead         = 1;
+    // 0 = no limit
+    uint32_t frameRateLimit         = 0;
+
+    // update-after-bind descriptor arrays if the device has
+    // descriptor indexing, a small table copied per frame if not
+    bool bindless                   = true;
+    // queue completion tracked with a timeline semaphore
+    // if the device has them, with fences if not
+    bool timelineSemaphore          = true;
+
+    // 1, 2, 4 or 8, limited by what the device supports
+    uint32_t msaaSamples            = 1;
+
+    // render at a scale that keeps gpu time within the budget
+    // and upscale to the swapchain image
+    bool dynamicResolution          = false;
+    uint32_t gpuTimeBudgetUs        = 14000;
+    // percent of the swapchain size per axis
+    uint32_t minResolutionScale     = 50;
+
+    uint32_t simulationTickRate     = 60;
+    // 0 = hardware concurrency
+    uint32_t workerThreadCount      = 0;
+
+    // percent of the heap budget, least recently used streamed
+    // textures are evicted past it
+    uint32_t memoryBudgetWatermark  = 90;
+
+    // physical device selection:
+    // empty = best score, "discrete"/"integrated"/"cpu" = prefer type,
+    // number = device index, anything else = device name substring
+    std::string gpuPreference;
+
+    std::string vertexShader        = "shaders/triangle.vert.spv";
+    std::string fragmentShader      = "shaders/triangle.frag.spv";
+    std::string cachePath           = "cache";
+
+    // KTX2 file streamed in after startup, empty = none
+    std::string texture;
+    // staged and uploaded per frame
+    uint32_t textureUploadBudgetKb  = 2048;
+    // staging ring, every mip level must fit in it
+    uint32_t textureStagingKb       = 16384;
+
+    // synthetic load, e.g. for benchmarks:
+    // triangle draws per frame, instances per draw,
+    // identical pipelines the draws cycle through
+    uint32_t drawCount              = 1;
+    uint32_t instanceCount          = 1;
+    uint32_t pipelineCount          = 1;
+    // copy every frame back to host memory
+    bool readback                   = false;
+
+    // pipeline statistics queries per render graph pass,
+    // printed with the frame latency stats
+    bool gpuStatistics              = false;
+
+    bool printConfig                = false;
+    bool printDeviceProperties      = true;
+    bool printStartupTiming         = true;
+    bool printRenderGraph           = false;
+    // binds issued and skipped by the draw list, with the frame latency stats
+    bool printDrawStatistics        = false;
+    // heap usage, budget and our allocations, with the frame latency stats
+    bool printMemoryBudget          = false;
+    bool printFrameLatency          = true;
+
+    // Chrome trace of the profiler zones written here at exit, empty = none,
+    // needs a build with CORE_PROFILER
+    std::string profileTrace;
+
+private:
+    typedef std::function<void(const std::string&)> Setter;
+    typedef std::function<std::string()> Getter;
+
+    struct Entry
+    {
+        Setter setter;
+        Getter getter;
+    };
+
+    void addString(const char* const key, std::string& value);
+    void addUint(const char* const key, uint32_t& value);
+    void addBool(const char* const key, bool& value);
+    void addVersion(const char* const key, uint32_t& value);
+    void addPresentMode(const char* const key, VkPresentModeKHR& value);
+
+    std::map<std::string, Entry> m_entries;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_CONFIG_H
@@ -0,0 +1,166 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "DeletionQueue.h"
+
+#include <algorithm>
+#include <assert.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+template <typename T>
+static T toHandle(const uint64_t value)
+{
+    T handle;
+    std::memcpy(&handle, &value, sizeof(handle));
+    return handle;
+}
+
+DeletionQueue::DeletionQueue(VkDevice device)
+    : m_device(device)
+{
+    assert(device);
+}
+
+DeletionQueue::~DeletionQueue()
+{
+    // owner flushes after the device is idle
+    assert(m_entries.empty());
+}
+
+uint64_t DeletionQueue::getRecordingFrame() const
+{
+    return m_recordingFrame;
+}
+
+void DeletionQueue::endFrame()
+{
+    ++m_recordingFrame;
+}
+
+void DeletionQueue::markCompleted(const uint64_t frame)
+{
+    assert(frame < m_recordingFrame);
+    m_completedFrame = std::max(m_completedFrame, frame);
+}
+
+uint64_t DeletionQueue::getCompletedFrame() const
+{
+    return m_completedFrame;
+}
+
+void DeletionQueue::destroy(VkBuffer buffer)                { push(Type::Buffer, buffer); }
+void DeletionQueue::destroy(VkImage image)                  { push(Type::Image, image); }
+void DeletionQueue::destroy(VkImageView imageView)          { push(Type::ImageView, imageView); }
+void DeletionQueue::destroy(VkFramebuffer framebuffer)      { push(Type::Framebuffer, framebuffer); }
+void DeletionQueue::destroy(VkPipeline pipeline)            { push(Type::Pipeline, pipeline); }
+void DeletionQueue::destroy(VkPipelineLayout pipelineLayout){ push(Type::PipelineLayout, pipelineLayout); }
+void DeletionQueue::destroy(VkShaderModule shaderModule)    { push(Type::ShaderModule, shaderModule); }
+void DeletionQueue::destroy(VkSampler sampler)              { push(Type::Sampler, sampler); }
+void DeletionQueue::destroy(VkDeviceMemory memory)          { push(Type::DeviceMemory, memory); }
+void DeletionQueue::destroy(VkQueryPool queryPool)          { push(Type::QueryPool, queryPool); }
+void DeletionQueue::destroy(VkFence fence)                  { push(Type::Fence, fence); }
+void DeletionQueue::destroy(VkSwapchainKHR swapchain)       { push(Type::Swapchain, swapchain); }
+
+void DeletionQueue::destroy(VkCommandPool commandPool, VkCommandBuffer commandBuffer)
+{
+    if (!commandBuffer)
+    {
+        return;
+    }
+    Entry entry;
+    entry.frame = m_recordingFrame;
+    entry.type = Type::CommandBuffer;
+    entry.commandPool = commandPool;
+    entry.commandBuffer = commandBuffer;
+    m_entries.push_back(std::move(entry));
+}
+
+void DeletionQueue::destroy(std::function<void()> func)
+{
+    Entry entry;
+    entry.frame = m_recordingFrame;
+    entry.type = Type::Function;
+    entry.func = std::move(func);
+    m_entries.push_back(std::move(entry));
+}
+
+void DeletionQueue::collect()
+{
+    while (!m_entries.empty() && m_entries.front().frame <= m_completedFrame)
+    {
+        release(m_entries.front());
+        m_entries.pop_front();
+    }
+}
+
+void DeletionQueue::flush()
+{
+    for (Entry& entry : m_entries)
+    {
+        release(entry);
+    }
+    m_entries.clear();
+    m_completedFrame = m_recordingFrame - 1;
+}
+
+size_t DeletionQueue::getPendingCount() const
+{
+    return m_entries.size();
+}
+
+void DeletionQueue::release(Entry& entry)
+{
+    switch (entry.type)
+    {
+    case Type::Buffer:
+        vkDestroyBuffer(m_device, toHandle<VkBuffer>(entry.handle), nullptr);
+        break;
+    case Type::Image:
+        vkDestroyImage(m_device, toHandle<VkImage>(entry.handle), nullptr);
+        break;
+    case Type::ImageView:
+        vkDestroyImageView(m_device, toHandle<VkImageView>(entry.handle), nullptr);
+        break;
+    case Type::Framebuffer:
+        vkDestroyFramebuffer(m_device, toHandle<VkFramebuffer>(entry.handle), nullptr);
+        break;
+    case Type::Pipeline:
+        vkDestroyPipeline(m_device, toHandle<VkPipeline>(entry.handle), nullptr);
+        break;
+    case Type::PipelineLayout:
+        vkDestroyPipelineLayout(m_device, toHandle<VkPipelineLayout>(entry.handle), nullptr);
+        break;
+    case Type::ShaderModule:
+        vkDestroyShaderModule(m_device, toHandle<VkShaderModule>(entry.handle), nullptr);
+        break;
+    case Type::Sampler:
+        vkDestroySampler(m_device, toHandle<VkSampler>(entry.handle), nullptr);
+        break;
+    case Type::DeviceMemory:
+        vkFreeMemory(m_device, toHandle<VkDeviceMemory>(entry.handle), nullptr);
+        break;
+    case Type::QueryPool:
+        vkDestroyQueryPool(m_device, toHandle<VkQueryPool>(entry.handle), nullptr);
+        break;
+    case Type::Fence:
+        vkDestroyFence(m_device, toHandle<VkFence>(entry.handle), nullptr);
+        break;
+    case Type::Swapchain:
+        vkDestroySwapchainKHR(m_device, toHandle<VkSwapchainKHR>(entry.handle), nullptr);
+        break;
+    case Type::CommandBuffer:
+        vkFreeCommandBuffers(m_device, entry.commandPool, 1, &entry.commandBuffer);
+        break;
+    case Type::Function:
+        entry.func();
+        break;
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,126 @@
+#ifndef CORE_DELETION_QUEUE_H
+#define CORE_DELETION_QUEUE_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Destroys vulkan objects once the gpu is done with them, without
+// waiting for the device to go idle. Every submitted frame has a value,
+// the queue timeline value of its submit, objects released while a
+// frame is recorded are tagged with it and destroyed by collect() after
+// the timeline has reached it. Completion of a frame means every earlier
+// frame has completed too.
+class DeletionQueue
+{
+public:
+    explicit DeletionQueue(VkDevice device);
+    ~DeletionQueue();
+
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    // value of the frame being recorded, starts from 1
+    uint64_t getRecordingFrame() const;
+    // call after the frame is submitted
+    void endFrame();
+    // the queue timeline has reached frame
+    void markCompleted(const uint64_t frame);
+    // latest frame known to be done on the gpu, 0 = none
+    uint64_t getCompletedFrame() const;
+
+    // released objects, nullptr handles are ignored
+    void destroy(VkBuffer buffer);
+    void destroy(VkImage image);
+    void destroy(VkImageView imageView);
+    void destroy(VkFramebuffer framebuffer);
+    void destroy(VkPipeline pipeline);
+    void destroy(VkPipelineLayout pipelineLayout);
+    void destroy(VkShaderModule shaderModule);
+    void destroy(VkSampler sampler);
+    void destroy(VkDeviceMemory memory);
+    void destroy(VkQueryPool queryPool);
+    void destroy(VkFence fence);
+    void destroy(VkSwapchainKHR swapchain);
+    void destroy(VkCommandPool commandPool, VkCommandBuffer commandBuffer);
+    // anything else, e.g. objects owning several handles
+    void destroy(std::function<void()> func);
+
+    // destroys everything whose frame has completed
+    void collect();
+    // destroys everything, the device must be idle
+    void flush();
+
+    size_t getPendingCount() const;
+
+private:
+    enum class Type
+    {
+        Buffer,
+        Image,
+        ImageView,
+        Framebuffer,
+        Pipeline,
+        PipelineLayout,
+        ShaderModule,
+        Sampler,
+        DeviceMemory,
+        QueryPool,
+        Fence,
+        Swapchain,
+        CommandBuffer,
+        Function,
+    };
+
+    struct Entry
+    {
+        uint64_t frame  = 0;
+        Type type       = Type::Function;
+        // non-dispatchable handles are 64-bit on all platforms
+        uint64_t handle = 0;
+        VkCommandPool commandPool = nullptr;
+        VkCommandBuffer commandBuffer = nullptr;
+        std::function<void()> func;
+    };
+
+    template <typename T>
+    void push(const Type type, const T handle)
+    {
+        if (!handle)
+        {
+            return;
+        }
+        Entry entry;
+        entry.frame = m_recordingFrame;
+        entry.type = type;
+        std::memcpy(&entry.handle, &handle, sizeof(handle));
+        m_entries.push_back(std::move(entry));
+    }
+
+    void release(Entry& entry);
+
+    VkDevice m_device = nullptr;
+
+    uint64_t m_recordingFrame = 1;
+    uint64_t m_completedFrame = 0;
+
+    // in frame order, entries are only added for the recording frame
+    std::deque<Entry> m_entries;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_DELETION_QUEUE_H
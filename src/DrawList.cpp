@@ -0,0 +1,344 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "DrawList.h"
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <cstring>
+#include <thread>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+static const size_t s_minItemsPerThread = 1 << 14;
+
+typedef std::array<size_t, 256> Histogram;
+
+uint64_t DrawList::makeKey(const uint32_t pass, const uint32_t pipeline,
+    const uint32_t material, const float depth, const uint32_t mesh)
+{
+    const float clampedDepth = std::min(std::max(depth, 0.0f), 1.0f);
+    const uint64_t quantizedDepth = (uint64_t)(clampedDepth * 65535.0f + 0.5f);
+
+    return ((uint64_t)(pass & 0xf) << 60)
+        | ((uint64_t)(pipeline & 0xfff) << 48)
+        | ((uint64_t)(material & 0xffff) << 32)
+        | (quantizedDepth << 16)
+        | (uint64_t)(mesh & 0xffff);
+}
+
+DrawList::DrawList(const uint32_t threadCount)
+    : m_threadCount(std::max((threadCount > 0) ? threadCount : std::thread::hardware_concurrency(), 1u))
+{
+}
+
+void DrawList::clear()
+{
+    m_draws.clear();
+    m_items.clear();
+    m_sorted = true;
+}
+
+uint32_t DrawList::add(const uint64_t key, const Draw& draw)
+{
+    assert(draw.pipeline && draw.layout && draw.indexBuffer);
+
+    const uint32_t drawIndex = (uint32_t)m_draws.size();
+    m_items.push_back({ key, drawIndex });
+    m_draws.push_back(draw);
+    m_sorted = false;
+    return drawIndex;
+}
+
+void DrawList::sortRange(Item* const p_items, Item* const p_scratch, const size_t count,
+    const uint32_t firstByte, const uint32_t byteCount)
+{
+    // least significant byte first, stable, so each pass keeps the order of the previous
+    Item* p_src = p_items;
+    Item* p_dst = p_scratch;
+    for (uint32_t byte = firstByte; byte < firstByte + byteCount; ++byte)
+    {
+        const uint32_t shift = 8 * byte;
+
+        Histogram histogram = {};
+        for (size_t idx = 0; idx < count; ++idx)
+        {
+            ++histogram[(p_src[idx].key >> shift) & 0xff];
+        }
+        // all keys share this byte, e.g. unused depth or a single pass
+        if (std::find(histogram.begin(), histogram.end(), count) != histogram.end())
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t& bucket : histogram)
+        {
+            const size_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+        for (size_t idx = 0; idx < count; ++idx)
+        {
+            p_dst[histogram[(p_src[idx].key >> shift) & 0xff]++] = p_src[idx];
+        }
+        std::swap(p_src, p_dst);
+    }
+
+    if (p_src != p_items)
+    {
+        std::copy(p_src, p_src + count, p_items);
+    }
+}
+
+void DrawList::sort()
+{
+    const size_t count = m_items.size();
+    m_scratch.resize(count);
+
+    const uint32_t threadCount = (uint32_t)std::min((size_t)m_threadCount, count / s_minItemsPerThread);
+    if (count < TaskGraph::c_parallelThreshold || threadCount <= 1)
+    {
+        sortRange(m_items.data(), m_scratch.data(), count, 0, 8);
+        m_sorted = true;
+        return;
+    }
+
+    // the top byte partitions the items in parallel, then the
+    // buckets are sorted on the remaining bytes independently
+    const size_t chunkSize = (count + threadCount - 1) / threadCount;
+    std::vector<Histogram> histograms(threadCount);
+    TaskGraph::parallelFor(threadCount, [&](const uint32_t thread)
+    {
+        Histogram& histogram = histograms[thread];
+        histogram.fill(0);
+        const size_t end = std::min(count, (thread + 1) * chunkSize);
+        for (size_t idx = thread * chunkSize; idx < end; ++idx)
+        {
+            ++histogram[m_items[idx].key >> 56];
+        }
+    });
+
+    // bucket major, then thread, so the scatter is stable
+    std::vector<Histogram> offsets(threadCount);
+    std::array<size_t, 257> bucketBegin = {};
+    size_t offset = 0;
+    for (uint32_t bucket = 0; bucket < 256; ++bucket)
+    {
+        bucketBegin[bucket] = offset;
+        for (uint32_t thread = 0; thread < threadCount; ++thread)
+        {
+            offsets[thread][bucket] = offset;
+            offset += histograms[thread][bucket];
+        }
+    }
+    bucketBegin[256] = offset;
+
+    TaskGraph::parallelFor(threadCount, [&](const uint32_t thread)
+    {
+        Histogram& bucketOffsets = offsets[thread];
+        const size_t end = std::min(count, (thread + 1) * chunkSize);
+        for (size_t idx = thread * chunkSize; idx < end; ++idx)
+        {
+            m_scratch[bucketOffsets[m_items[idx].key >> 56]++] = m_items[idx];
+        }
+    });
+
+    // largest buckets first, each to the least loaded thread
+    std::vector<uint32_t> buckets;
+    for (uint32_t bucket = 0; bucket < 256; ++bucket)
+    {
+        if (bucketBegin[bucket + 1] > bucketBegin[bucket])
+        {
+            buckets.push_back(bucket);
+        }
+    }
+    std::sort(buckets.begin(), buckets.end(), [&bucketBegin](const uint32_t lhs, const uint32_t rhs)
+    {
+        return (bucketBegin[lhs + 1] - bucketBegin[lhs]) > (bucketBegin[rhs + 1] - bucketBegin[rhs]);
+    });
+    std::vector<std::vector<uint32_t>> threadBuckets(threadCount);
+    std::vector<size_t> threadLoads(threadCount, 0);
+    for (const uint32_t bucket : buckets)
+    {
+        const size_t thread = std::min_element(threadLoads.begin(), threadLoads.end()) - threadLoads.begin();
+        threadBuckets[thread].push_back(bucket);
+        threadLoads[thread] += bucketBegin[bucket + 1] - bucketBegin[bucket];
+    }
+
+    // sorted in the scratch, which then becomes the item list
+    TaskGraph::parallelFor(threadCount, [&](const uint32_t thread)
+    {
+        for (const uint32_t bucket : threadBuckets[thread])
+        {
+            const size_t begin = bucketBegin[bucket];
+            sortRange(&m_scratch[begin], &m_items[begin], bucketBegin[bucket + 1] - begin, 0, 7);
+        }
+    });
+    m_items.swap(m_scratch);
+    m_sorted = true;
+}
+
+void DrawList::record(VkCommandBuffer cmdBuffer, const uint32_t hookDraw, const DrawHook& drawHook)
+{
+    if (!m_sorted)
+    {
+        sort();
+    }
+
+    VkPipeline pipeline         = nullptr;
+    VkPipelineLayout layout     = nullptr;
+    VkDescriptorSet set         = nullptr;
+    VkBuffer vertexBuffer       = nullptr;
+    VkBuffer indexBuffer        = nullptr;
+    const GfxResources::PushConstants* p_pushConstants = nullptr;
+
+    for (const Item& item : m_items)
+    {
+        const Draw& draw = m_draws[item.draw];
+
+        if (draw.pipeline != pipeline)
+        {
+            vkCmdBindPipeline(
+                cmdBuffer,                          // commandBuffer
+                VK_PIPELINE_BIND_POINT_GRAPHICS,    // pipelineBindPoint
+                draw.pipeline);                     // pipeline
+            pipeline = draw.pipeline;
+            ++m_counters.pipelineBinds;
+        }
+        else
+        {
+            ++m_counters.pipelineSkips;
+        }
+
+        // bound sets and push constants stay valid across
+        // pipelines only if the layouts are compatible
+        if (draw.layout != layout)
+        {
+            layout = draw.layout;
+            set = nullptr;
+            p_pushConstants = nullptr;
+        }
+
+        if (draw.descriptorSet != set)
+        {
+            vkCmdBindDescriptorSets(
+                cmdBuffer,                          // commandBuffer
+                VK_PIPELINE_BIND_POINT_GRAPHICS,    // pipelineBindPoint
+                draw.layout,                        // layout
+                0,                                  // firstSet
+                1,                                  // descriptorSetCount
+                &draw.descriptorSet,                // pDescriptorSets
+                0,                                  // dynamicOffsetCount
+                nullptr);                           // pDynamicOffsets
+            set = draw.descriptorSet;
+            ++m_counters.descriptorBinds;
+        }
+        else
+        {
+            ++m_counters.descriptorSkips;
+        }
+
+        if (draw.vertexBuffer != vertexBuffer || draw.indexBuffer != indexBuffer)
+        {
+            if (draw.vertexBuffer)
+            {
+                const VkDeviceSize offset = 0;
+                vkCmdBindVertexBuffers(
+                    cmdBuffer,              // commandBuffer
+                    0,                      // firstBinding
+                    1,                      // bindingCount
+                    &draw.vertexBuffer,     // pBuffers
+                    &offset);               // pOffsets
+            }
+            vkCmdBindIndexBuffer(
+                cmdBuffer,              // commandBuffer
+                draw.indexBuffer,       // buffer
+                0,                      // offset
+                VK_INDEX_TYPE_UINT32);  // indexType
+            vertexBuffer = draw.vertexBuffer;
+            indexBuffer = draw.indexBuffer;
+            ++m_counters.bufferBinds;
+        }
+        else
+        {
+            ++m_counters.bufferSkips;
+        }
+
+        if (!p_pushConstants
+            || memcmp(p_pushConstants, &draw.pushConstants, sizeof(GfxResources::PushConstants)) != 0)
+        {
+            vkCmdPushConstants(
+                cmdBuffer,                                                  // commandBuffer
+                draw.layout,                                                // layout
+                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,  // stageFlags
+                0,                                                          // offset
+                sizeof(GfxResources::PushConstants),                        // size
+                &draw.pushConstants);                                       // pValues
+            p_pushConstants = &draw.pushConstants;
+            ++m_counters.pushConstants;
+        }
+        else
+        {
+            ++m_counters.pushConstantSkips;
+        }
+
+        const bool hooked = (item.draw == hookDraw && drawHook);
+        if (hooked)
+        {
+            drawHook(cmdBuffer, true);
+        }
+
+        vkCmdDrawIndexed(
+            cmdBuffer,              // commandBuffer
+            draw.indexCount,        // indexCount
+            draw.instanceCount,     // instanceCount
+            draw.firstIndex,        // firstIndex
+            0,                      // vertexOffset
+            draw.firstInstance);    // firstInstance
+        ++m_counters.draws;
+
+        if (hooked)
+        {
+            drawHook(cmdBuffer, false);
+        }
+    }
+    ++m_counters.frames;
+}
+
+const DrawList::Counters& DrawList::getCounters() const
+{
+    return m_counters;
+}
+
+void DrawList::print(std::ostream& out)
+{
+    if (m_counters.frames == 0)
+    {
+        return;
+    }
+
+    const uint64_t frames = m_counters.frames;
+    out << "draw list per frame: draws " << m_counters.draws / frames
+        << ", pipeline binds " << m_counters.pipelineBinds / frames
+        << " (" << m_counters.pipelineSkips / frames << " skipped)"
+        << ", descriptor binds " << m_counters.descriptorBinds / frames
+        << " (" << m_counters.descriptorSkips / frames << " skipped)"
+        << ", buffer binds " << m_counters.bufferBinds / frames
+        << " (" << m_counters.bufferSkips / frames << " skipped)"
+        << ", push constants " << m_counters.pushConstants / frames
+        << " (" << m_counters.pushConstantSkips / frames << " skipped)"
+        << ", frames " << frames << std::endl;
+    m_counters = Counters();
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,116 @@
+#ifndef CORE_DRAW_LIST_H
+#define CORE_DRAW_LIST_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "GfxResources.h"
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Draws of a frame, each with a 64-bit sort key. Keys are radix sorted,
+// then the draws are recorded in key order and state is only bound
+// when it differs from what the previous draw left bound. Pipelines with
+// the same layout keep the bound descriptor set and push constants.
+// Counters of binds issued and skipped are kept until printed.
+class DrawList
+{
+public:
+    struct Draw
+    {
+        VkPipeline pipeline             = nullptr;
+        VkPipelineLayout layout         = nullptr;
+        // set 0
+        VkDescriptorSet descriptorSet   = nullptr;
+        VkBuffer vertexBuffer           = nullptr;
+        VkBuffer indexBuffer            = nullptr;
+        GfxResources::PushConstants pushConstants;
+
+        uint32_t indexCount     = 0;
+        uint32_t instanceCount  = 1;
+        uint32_t firstIndex     = 0;
+        uint32_t firstInstance  = 0;
+    };
+
+    struct Counters
+    {
+        uint64_t frames             = 0;
+        uint64_t draws              = 0;
+        uint64_t pipelineBinds      = 0;
+        uint64_t pipelineSkips      = 0;
+        uint64_t descriptorBinds    = 0;
+        uint64_t descriptorSkips    = 0;
+        uint64_t bufferBinds        = 0;
+        uint64_t bufferSkips        = 0;
+        uint64_t pushConstants      = 0;
+        uint64_t pushConstantSkips  = 0;
+    };
+
+    // called before and after the given draw is recorded,
+    // inside the render pass, e.g. for queries
+    typedef std::function<void(VkCommandBuffer cmdBuffer, const bool begin)> DrawHook;
+
+    // key bits, most significant first: pass 4, pipeline 12, material 16,
+    // depth 16, mesh 16. Depth is in [0, 1], nearer sorts first, so
+    // opaque draws go front to back within a pipeline and material.
+    static uint64_t makeKey(const uint32_t pass, const uint32_t pipeline,
+        const uint32_t material, const float depth, const uint32_t mesh);
+
+    // large lists are sorted on up to threadCount threads,
+    // 0 = hardware concurrency
+    explicit DrawList(const uint32_t threadCount);
+    ~DrawList() = default;
+
+    DrawList(const DrawList&) = delete;
+    DrawList& operator=(const DrawList&) = delete;
+
+    void clear();
+    // returns the index of the draw, in the order added
+    uint32_t add(const uint64_t key, const Draw& draw);
+
+    void sort();
+    // draws in sorted order, sorts first if needed, inside a render pass
+    // with viewport and scissor set, once per frame for the counters.
+    // drawHook, if set, is called around the draw with index hookDraw
+    void record(VkCommandBuffer cmdBuffer,
+        const uint32_t hookDraw = ~0u, const DrawHook& drawHook = DrawHook());
+
+    const Counters& getCounters() const;
+    // per frame averages since the last call, then clears the counters
+    void print(std::ostream& out);
+
+private:
+    struct Item
+    {
+        uint64_t key;
+        uint32_t draw;
+    };
+
+    static void sortRange(Item* const p_items, Item* const p_scratch, const size_t count,
+        const uint32_t firstByte, const uint32_t byteCount);
+
+    const uint32_t m_threadCount = 1;
+
+    std::vector<Draw> m_draws;
+    std::vector<Item> m_items;
+    std::vector<Item> m_scratch;
+    bool m_sorted = true;
+
+    Counters m_counters;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_DRAW_LIST_H
@@ -0,0 +1,74 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// aim a bit below the budget so that spikes do not go over it
+static const double s_targetFraction = 0.9;
+// relative error ignored around the target
+static const double s_deadBand = 0.05;
+// fraction of the correction applied per frame
+static const float s_smoothing = 0.1f;
+
+DynamicResolution::DynamicResolution(
+    const double gpuTimeBudgetMs, const float minScale, const float maxScale)
+    : m_budgetMs(gpuTimeBudgetMs),
+    m_minScale(minScale),
+    m_maxScale(maxScale),
+    m_scale(maxScale)
+{
+    assert(gpuTimeBudgetMs > 0.0);
+    assert(minScale > 0.0f && minScale <= maxScale && maxScale <= 1.0f);
+}
+
+float DynamicResolution::update(const double gpuTimeMs)
+{
+    m_gpuTimeMs = gpuTimeMs;
+    if (gpuTimeMs <= 0.0)
+    {
+        return m_scale;
+    }
+
+    const double target = m_budgetMs * s_targetFraction;
+    const double ratio = target / gpuTimeMs;
+    if (std::abs(ratio - 1.0) < s_deadBand)
+    {
+        return m_scale;
+    }
+
+    const float wanted = std::min(std::max(
+        m_scale * (float)std::sqrt(ratio), m_minScale), m_maxScale);
+    m_scale += (wanted - m_scale) * s_smoothing;
+
+    return m_scale;
+}
+
+uint32_t DynamicResolution::getScaledSize(const uint32_t fullSize) const
+{
+    const uint32_t size = (uint32_t)std::ceil(fullSize * m_scale);
+    const uint32_t aligned = (size + s_sizeGranularity - 1) / s_sizeGranularity * s_sizeGranularity;
+    return std::max(std::min(aligned, fullSize), 1u);
+}
+
+float DynamicResolution::getScale() const
+{
+    return m_scale;
+}
+
+double DynamicResolution::getGpuTimeMs() const
+{
+    return m_gpuTimeMs;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,52 @@
+#ifndef CORE_DYNAMIC_RESOLUTION_H
+#define CORE_DYNAMIC_RESOLUTION_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Picks the render resolution scale from measured gpu frame time.
+// Gpu time is assumed to follow the rendered pixel count, so the scale
+// moves towards sqrt(budget / time) of the current one. Smoothing and a
+// dead band around the budget keep the size from oscillating.
+class DynamicResolution
+{
+public:
+    // scales are per axis, in range (0, 1]
+    DynamicResolution(const double gpuTimeBudgetMs, const float minScale, const float maxScale = 1.0f);
+    ~DynamicResolution() = default;
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // feed the gpu time of a finished frame, returns the new scale
+    float update(const double gpuTimeMs);
+
+    // scaled size, rounded up to s_sizeGranularity and clamped to full size
+    uint32_t getScaledSize(const uint32_t fullSize) const;
+
+    float getScale() const;
+    double getGpuTimeMs() const;
+
+private:
+    static const uint32_t s_sizeGranularity = 8;
+
+    const double m_budgetMs;
+    const float m_minScale;
+    const float m_maxScale;
+
+    float m_scale = 1.0f;
+    double m_gpuTimeMs = 0.0;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_DYNAMIC_RESOLUTION_H
@@ -3,11 +3,17 @@
 
 #include "Engine.h"
 
+#include "Config.h"
+#include "ErrorHandling.h"
+#include "FrameLatency.h"
 #include "GfxResources.h"
+#include "Profiler.h"
 #include "Renderer.h"
+#include "Simulation.h"
 #include "Window.h"
-#include "Utils.h"
 
+#include <fstream>
+#include <iostream>
 #include <memory>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -25,27 +31,139 @@ Engine::~Engine()
 
 }
 
-void Engine::init()
+void Engine::init(const int argc, const char* const argv[])
 {
-    GlobalVariables& gv = GlobalVariables::getInstance();
-    gv.applicationName = "Vulkan Triangle";
-    gv.engineName = "Dummy Engine";
+    m_config = std::unique_ptr<Config>(new Config());
+    m_config->applicationName = "Vulkan Triangle";
+    m_config->engineName = "Dummy Engine";
+    m_config->load(argc, argv);
+
+    CORE_PROFILE_THREAD("main");
 
     m_window = std::unique_ptr<Window>(new Window(
-        gv.windowWidth, gv.windowHeight, gv.applicationName));
+        m_config->windowWidth, m_config->windowHeight, m_config->applicationName));
+
+    createGraphics();
+
+    m_simulation = std::unique_ptr<Simulation>(new Simulation(m_config->simulationTickRate));
+    m_frameLatency = std::unique_ptr<FrameLatency>(new FrameLatency(
+        m_config->frameRateLimit, m_config->printFrameLatency));
+    // renderer is recreated after a device loss, look it up on every report
+    m_frameLatency->setReportFunc([this](std::ostream& out)
+    {
+        m_renderer->printStatistics(out);
+    });
+}
 
-    m_gfxResources = std::unique_ptr<GfxResources>(new GfxResources(m_window.get()));
+void Engine::createGraphics()
+{
+    // renderer references the resources, release it first
+    m_renderer.reset();
+    m_gfxResources.reset();
+
+    m_gfxResources = std::unique_ptr<GfxResources>(new GfxResources(
+        m_window.get(), m_config.get()));
     m_renderer = std::unique_ptr<Renderer>(new Renderer(
-        m_gfxResources.get(), m_window.get()));
+        m_gfxResources.get(), m_window.get(), m_config.get()));
 }
 
 void Engine::run()
 {
-    while (!m_window->shouldClose())
+    start();
+
+    {
+        CORE_PROFILE_ZONE("Engine::run");
+        while (!m_window->shouldClose())
+        {
+            runFrame();
+        }
+    }
+
+    stop();
+}
+
+void Engine::start()
+{
+    // simulation runs with a fixed timestep in its own thread,
+    // this thread handles input and renders the latest snapshot
+    m_simulation->start();
+}
+
+bool Engine::runFrame()
+{
+    CORE_PROFILE_ZONE("Engine::runFrame");
+
+    try
     {
+        // wait just in time before sampling input
+        m_renderer->waitForFramesInFlight(m_config->maxFramesAhead);
+        m_frameLatency->waitForFrameStart();
+
         m_window->update();
-        m_renderer->render();
+        m_frameLatency->markInputSampled();
+
+        WindowEvent event;
+        while (m_window->pollEvent(event))
+        {
+            if (event.type == WindowEvent::Type::Resize)
+            {
+                m_renderer->onResize();
+            }
+        }
+
+        if (m_renderer->render(m_simulation->sample()))
+        {
+            m_frameLatency->markPresented();
+            return true;
+        }
     }
+    catch (const DeviceLostError& err)
+    {
+        std::cerr << err.what() << std::endl;
+        std::cerr << "device lost, recreating graphics resources" << std::endl;
+        createGraphics();
+    }
+    return false;
+}
+
+void Engine::stop()
+{
+    // joins the simulation thread, the trace reads its zones unsynchronized
+    m_simulation->stop();
+
+    if (!m_config->profileTrace.empty())
+    {
+        writeProfileTrace();
+    }
+}
+
+void Engine::writeProfileTrace()
+{
+    if (!Profiler::c_enabled)
+    {
+        std::cerr << "profile_trace is set, but profiler zones are not built in, "
+            << "configure with -DCORE_PROFILER=ON" << std::endl;
+        return;
+    }
+
+    std::ofstream file(m_config->profileTrace);
+    if (!file)
+    {
+        std::cerr << "Failed to open profile trace: " << m_config->profileTrace << std::endl;
+        return;
+    }
+    Profiler::writeChromeTrace(file);
+    std::cout << "profile trace written to " << m_config->profileTrace << std::endl;
+}
+
+Renderer& Engine::getRenderer()
+{
+    return *m_renderer;
+}
+
+Window& Engine::getWindow()
+{
+    return *m_window;
 }
 
 } // namespace
@@ -11,8 +11,11 @@
 namespace core
 {
 
+class Config;
+class FrameLatency;
 class GfxResources;
 class Renderer;
+class Simulation;
 class Window;
 
 class Engine
@@ -24,13 +27,30 @@ public:
     Engine(const Engine&) = delete;
     Engine& operator=(const Engine&) = delete;
 
-    void init();
+    void init(const int argc, const char* const argv[]);
+    // start(), runFrame() until the window closes and stop()
     void run();
 
+    // for driving the loop from outside, e.g. benchmarks
+    void start();
+    // returns true if a frame was presented
+    bool runFrame();
+    // writes the profile trace if one is configured
+    void stop();
+
+    Renderer& getRenderer();
+    Window& getWindow();
+
 private:
+    void createGraphics();
+    void writeProfileTrace();
+
+    std::unique_ptr<Config> m_config;
     std::unique_ptr<GfxResources> m_gfxResources;
+    std::unique_ptr<FrameLatency> m_frameLatency;
 
     std::unique_ptr<Renderer> m_renderer;
+    std::unique_ptr<Simulation> m_simulation;
     std::unique_ptr<Window> m_window;
 };
 
@@ -0,0 +1,121 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "ErrorHandling.h"
+
+#include <iostream>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+static VkResultHandler s_handlers[(size_t)VkResultCategory::Count];
+
+static std::string formatVkError(const VkResult result, const VkCallSite& callSite)
+{
+    return std::string(callSite.file) + "(" + std::to_string(callSite.line) + "): "
+        + getVkResultString(result) + " from " + callSite.call;
+}
+
+static bool defaultVkResultHandler(const VkResult result, const VkCallSite& callSite)
+{
+    switch (getVkResultCategory(result))
+    {
+    case VkResultCategory::NotReady:    return false;
+    case VkResultCategory::Suboptimal:  return true;
+    case VkResultCategory::DeviceLost:  throw DeviceLostError(result, callSite);
+    default:                            throw VkError(result, callSite);
+    }
+}
+
+VkError::VkError(const VkResult result, const VkCallSite& callSite)
+    : std::runtime_error(formatVkError(result, callSite)),
+    result(result),
+    callSite(callSite)
+{
+}
+
+void setVkResultHandler(const VkResultCategory category, VkResultHandler handler)
+{
+    s_handlers[(size_t)category] = std::move(handler);
+}
+
+VkResultCategory getVkResultCategory(const VkResult result)
+{
+    switch (result)
+    {
+    case VK_NOT_READY:
+    case VK_TIMEOUT:                        return VkResultCategory::NotReady;
+    case VK_SUBOPTIMAL_KHR:                 return VkResultCategory::Suboptimal;
+    case VK_ERROR_OUT_OF_DATE_KHR:          return VkResultCategory::OutOfDate;
+    case VK_ERROR_SURFACE_LOST_KHR:         return VkResultCategory::SurfaceLost;
+    case VK_ERROR_DEVICE_LOST:              return VkResultCategory::DeviceLost;
+    case VK_ERROR_OUT_OF_HOST_MEMORY:
+    case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+    case VK_ERROR_OUT_OF_POOL_MEMORY:
+    case VK_ERROR_FRAGMENTED_POOL:          return VkResultCategory::OutOfMemory;
+    default:                                return VkResultCategory::Other;
+    }
+}
+
+const char* getVkResultString(const VkResult result)
+{
+    switch (result)
+    {
+    case VK_SUCCESS:                        return "VK_SUCCESS";
+    case VK_NOT_READY:                      return "VK_NOT_READY";
+    case VK_TIMEOUT:                        return "VK_TIMEOUT";
+    case VK_EVENT_SET:                      return "VK_EVENT_SET";
+    case VK_EVENT_RESET:                    return "VK_EVENT_RESET";
+    case VK_INCOMPLETE:                     return "VK_INCOMPLETE";
+    case VK_ERROR_OUT_OF_HOST_MEMORY:       return "VK_ERROR_OUT_OF_HOST_MEMORY";
+    case VK_ERROR_OUT_OF_DEVICE_MEMORY:     return "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+    case VK_ERROR_INITIALIZATION_FAILED:    return "VK_ERROR_INITIALIZATION_FAILED";
+    case VK_ERROR_DEVICE_LOST:              return "VK_ERROR_DEVICE_LOST";
+    case VK_ERROR_MEMORY_MAP_FAILED:        return "VK_ERROR_MEMORY_MAP_FAILED";
+    case VK_ERROR_LAYER_NOT_PRESENT:        return "VK_ERROR_LAYER_NOT_PRESENT";
+    case VK_ERROR_EXTENSION_NOT_PRESENT:    return "VK_ERROR_EXTENSION_NOT_PRESENT";
+    case VK_ERROR_FEATURE_NOT_PRESENT:      return "VK_ERROR_FEATURE_NOT_PRESENT";
+    case VK_ERROR_INCOMPATIBLE_DRIVER:      return "VK_ERROR_INCOMPATIBLE_DRIVER";
+    case VK_ERROR_TOO_MANY_OBJECTS:         return "VK_ERROR_TOO_MANY_OBJECTS";
+    case VK_ERROR_FORMAT_NOT_SUPPORTED:     return "VK_ERROR_FORMAT_NOT_SUPPORTED";
+    case VK_ERROR_FRAGMENTED_POOL:          return "VK_ERROR_FRAGMENTED_POOL";
+    case VK_ERROR_OUT_OF_POOL_MEMORY:       return "VK_ERROR_OUT_OF_POOL_MEMORY";
+    case VK_ERROR_SURFACE_LOST_KHR:         return "VK_ERROR_SURFACE_LOST_KHR";
+    case VK_ERROR_NATIVE_WINDOW_IN_USE_KHR: return "VK_ERROR_NATIVE_WINDOW_IN_USE_KHR";
+    case VK_SUBOPTIMAL_KHR:                 return "VK_SUBOPTIMAL_KHR";
+    case VK_ERROR_OUT_OF_DATE_KHR:          return "VK_ERROR_OUT_OF_DATE_KHR";
+    default:                                return "unknown VkResult";
+    }
+}
+
+bool handleVkResult(const VkResult result,
+    const char* const call, const char* const file, const int line)
+{
+    // non-error status codes which callers treat as success
+    if (result == VK_INCOMPLETE || result == VK_EVENT_SET || result == VK_EVENT_RESET)
+    {
+        return true;
+    }
+
+    VkCallSite callSite;
+    callSite.call = call;
+    callSite.file = file;
+    callSite.line = line;
+
+    if (result < 0)
+    {
+        std::cerr << formatVkError(result, callSite) << std::endl;
+    }
+
+    const VkResultHandler& handler = s_handlers[(size_t)getVkResultCategory(result)];
+    return handler ? handler(result, callSite) : defaultVkResultHandler(result, callSite);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,99 @@
+#ifndef CORE_ERROR_HANDLING_H
+#define CORE_ERROR_HANDLING_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CORE_LIKELY(x)      __builtin_expect(!!(x), 1)
+#define CORE_UNLIKELY(x)    __builtin_expect(!!(x), 0)
+#define CORE_COLD           __attribute__((noinline, cold))
+#else
+#define CORE_LIKELY(x)      (x)
+#define CORE_UNLIKELY(x)    (x)
+#define CORE_COLD           __declspec(noinline)
+#endif
+
+namespace core
+{
+
+// Where a failing Vulkan call was made
+struct VkCallSite
+{
+    const char* call    = nullptr;
+    const char* file    = nullptr;
+    int line            = 0;
+};
+
+// Results are routed to a handler per category
+enum class VkResultCategory
+{
+    NotReady = 0,   // VK_NOT_READY, VK_TIMEOUT
+    Suboptimal,     // VK_SUBOPTIMAL_KHR
+    OutOfDate,      // VK_ERROR_OUT_OF_DATE_KHR
+    SurfaceLost,    // VK_ERROR_SURFACE_LOST_KHR
+    DeviceLost,     // VK_ERROR_DEVICE_LOST
+    OutOfMemory,    // host, device and pool memory
+    Other,
+    Count
+};
+
+class VkError : public std::runtime_error
+{
+public:
+    VkError(const VkResult result, const VkCallSite& callSite);
+
+    const VkResult result;
+    const VkCallSite callSite;
+};
+
+class DeviceLostError : public VkError
+{
+public:
+    DeviceLostError(const VkResult result, const VkCallSite& callSite)
+        : VkError(result, callSite) {}
+};
+
+// Returns true if the caller may continue as if the call succeeded
+typedef std::function<bool(VkResult, const VkCallSite&)> VkResultHandler;
+
+// nullptr restores the default handler:
+// NotReady returns false, Suboptimal returns true,
+// DeviceLost throws DeviceLostError and others throw VkError
+void setVkResultHandler(const VkResultCategory category, VkResultHandler handler);
+
+VkResultCategory getVkResultCategory(const VkResult result);
+const char* getVkResultString(const VkResult result);
+
+// Cold path, kept out of line so the success check stays a single branch
+CORE_COLD bool handleVkResult(const VkResult result,
+    const char* const call, const char* const file, const int line);
+
+inline bool checkVkResult(const VkResult result,
+    const char* const call, const char* const file, const int line)
+{
+    if (CORE_LIKELY(result == VK_SUCCESS))
+    {
+        return true;
+    }
+    return handleVkResult(result, call, file, line);
+}
+
+} // namespace
+
+// Helper for checking the returned result from Vulkan functions,
+// evaluates to false if the caller should skip the current operation
+#define CHECK_VK_RESULT_SUCCESS(check_vk_func) \
+    ::core::checkVkResult((check_vk_func), #check_vk_func, __FILE__, __LINE__)
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_ERROR_HANDLING_H
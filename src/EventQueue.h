@@ -0,0 +1,74 @@
+#ifndef CORE_EVENT_QUEUE_H
+#define CORE_EVENT_QUEUE_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Fixed capacity FIFO, storage is allocated up front.
+// Single threaded, push fails when the queue is full.
+template<typename T, uint32_t Capacity>
+class EventQueue
+{
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be power of two");
+
+    EventQueue() = default;
+    ~EventQueue() = default;
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    bool push(const T& value)
+    {
+        if (m_tail - m_head == Capacity)
+        {
+            m_droppedCount++;
+            return false;
+        }
+        m_items[m_tail & (Capacity - 1)] = value;
+        m_tail++;
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        if (m_head == m_tail)
+        {
+            return false;
+        }
+        value = m_items[m_head & (Capacity - 1)];
+        m_head++;
+        return true;
+    }
+
+    uint32_t size() const
+    {
+        return m_tail - m_head;
+    }
+
+    // events lost because the queue was full
+    uint32_t getDroppedCount() const
+    {
+        return m_droppedCount;
+    }
+
+private:
+    T m_items[Capacity];
+
+    uint32_t m_head = 0;
+    uint32_t m_tail = 0;
+    uint32_t m_droppedCount = 0;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_EVENT_QUEUE_H
@@ -0,0 +1,102 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "FrameLatency.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+static const std::chrono::seconds s_reportInterval(1);
+
+FrameLatency::FrameLatency(const uint32_t frameRateLimit, const bool printStats)
+    : m_frameInterval((frameRateLimit > 0)
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(1000000000 / frameRateLimit))
+        : Clock::duration::zero()),
+    m_printStats(printStats)
+{
+    m_nextFrameStart = Clock::now();
+    m_inputSampleTime = m_nextFrameStart;
+    m_reportStartTime = m_nextFrameStart;
+}
+
+void FrameLatency::waitForFrameStart()
+{
+    if (m_frameInterval == Clock::duration::zero())
+    {
+        return;
+    }
+
+    const Clock::time_point now = Clock::now();
+    if (now < m_nextFrameStart)
+    {
+        std::this_thread::sleep_until(m_nextFrameStart);
+        m_nextFrameStart += m_frameInterval;
+    }
+    else
+    {
+        // missed the slot, don't try to catch up
+        m_nextFrameStart = now + m_frameInterval;
+    }
+}
+
+void FrameLatency::markInputSampled()
+{
+    m_inputSampleTime = Clock::now();
+}
+
+void FrameLatency::markPresented()
+{
+    const Clock::time_point now = Clock::now();
+    const double latencyMs =
+        std::chrono::duration<double, std::milli>(now - m_inputSampleTime).count();
+
+    m_stats.frameCount++;
+    m_stats.lastMs = latencyMs;
+    m_stats.maxMs = std::max(m_stats.maxMs, latencyMs);
+    m_totalMs += latencyMs;
+    m_stats.averageMs = m_totalMs / m_stats.frameCount;
+
+    if (now - m_reportStartTime >= s_reportInterval)
+    {
+        report();
+        m_reportStartTime = now;
+    }
+}
+
+const FrameLatency::Stats& FrameLatency::getStats() const
+{
+    return m_stats;
+}
+
+void FrameLatency::setReportFunc(ReportFunc func)
+{
+    m_reportFunc = func;
+}
+
+void FrameLatency::report()
+{
+    if (m_printStats)
+    {
+        std::cout << "input to present: avg " << m_stats.averageMs
+            << " ms, max " << m_stats.maxMs
+            << " ms, frames " << m_stats.frameCount << std::endl;
+    }
+    if (m_reportFunc)
+    {
+        m_reportFunc(std::cout);
+    }
+
+    m_stats = Stats();
+    m_totalMs = 0.0;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
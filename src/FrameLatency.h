@@ -0,0 +1,75 @@
+#ifndef CORE_FRAME_LATENCY_H
+#define CORE_FRAME_LATENCY_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Paces the main loop and measures input sample to present latency.
+// The caller waits for the GPU (see Renderer::waitForFramesInFlight())
+// and then calls waitForFrameStart() right before sampling input, so the
+// input is as fresh as possible when the frame is recorded.
+class FrameLatency
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Stats
+    {
+        uint32_t frameCount = 0;
+        double averageMs    = 0.0;
+        double maxMs        = 0.0;
+        double lastMs       = 0.0;
+    };
+
+    // writes more stats of the reporting period after the latency
+    typedef std::function<void(std::ostream&)> ReportFunc;
+
+    FrameLatency(const uint32_t frameRateLimit, const bool printStats);
+    ~FrameLatency() = default;
+
+    FrameLatency(const FrameLatency&) = delete;
+    FrameLatency& operator=(const FrameLatency&) = delete;
+
+    // sleeps until the next frame slot if frame rate is limited
+    void waitForFrameStart();
+
+    void markInputSampled();
+    void markPresented();
+
+    // stats of the current reporting period
+    const Stats& getStats() const;
+
+    // called every reporting period, also when latency is not printed
+    void setReportFunc(ReportFunc func);
+
+private:
+    void report();
+
+    const Clock::duration m_frameInterval;
+    const bool m_printStats = false;
+
+    Clock::time_point m_nextFrameStart;
+    Clock::time_point m_inputSampleTime;
+    Clock::time_point m_reportStartTime;
+
+    Stats m_stats;
+    double m_totalMs = 0.0;
+
+    ReportFunc m_reportFunc;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_FRAME_LATENCY_H
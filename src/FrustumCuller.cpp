@@ -0,0 +1,500 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "FrustumCuller.h"
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <thread>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define CORE_CULL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// SSE2 is part of the x64 baseline, 32-bit builds need it enabled
+#if defined(CORE_CULL_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CORE_CULL_SSE 1
+#endif
+
+// the AVX2 kernel is built without AVX2 enabled for the whole program
+// and only called if the cpu supports it
+#if defined(CORE_CULL_SSE)
+#define CORE_CULL_AVX2 1
+#if defined(_MSC_VER)
+#define CORE_TARGET_AVX2
+#else
+#define CORE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// objects per chunk, a multiple of the widest kernel
+static const uint32_t s_chunkSize = 1 << 14;
+
+struct CullArrays
+{
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* radius;
+    const float* minX;
+    const float* minY;
+    const float* minZ;
+    const float* maxX;
+    const float* maxY;
+    const float* maxZ;
+};
+
+// corner of the AABB furthest along the plane normal, if it is
+// behind the plane the whole box is
+struct CornerArrays
+{
+    const float* x;
+    const float* y;
+    const float* z;
+};
+
+static void getCorners(const CullArrays& arrays, const FrustumCuller::Frustum& frustum,
+    CornerArrays corners[6])
+{
+    for (uint32_t idx = 0; idx < 6; ++idx)
+    {
+        const FrustumCuller::Plane& plane = frustum.planes[idx];
+        corners[idx].x = (plane.nx >= 0.0f) ? arrays.maxX : arrays.minX;
+        corners[idx].y = (plane.ny >= 0.0f) ? arrays.maxY : arrays.minY;
+        corners[idx].z = (plane.nz >= 0.0f) ? arrays.maxZ : arrays.minZ;
+    }
+}
+
+static inline uint32_t countTrailingZeros(const uint32_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, value);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(value);
+#endif
+}
+
+// writes visible ids of [begin, end) to p_visible, returns the count
+static uint32_t cullScalar(const CullArrays& arrays, const FrustumCuller::Frustum& frustum,
+    const uint32_t begin, const uint32_t end, FrustumCuller::ObjectId* const p_visible)
+{
+    CornerArrays corners[6];
+    getCorners(arrays, frustum, corners);
+
+    uint32_t count = 0;
+    for (uint32_t idx = begin; idx < end; ++idx)
+    {
+        bool visible = true;
+        for (uint32_t planeIdx = 0; planeIdx < 6; ++planeIdx)
+        {
+            const FrustumCuller::Plane& plane = frustum.planes[planeIdx];
+            const float dist = plane.nx * arrays.centerX[idx] + plane.ny * arrays.centerY[idx]
+                + plane.nz * arrays.centerZ[idx] + plane.d;
+            visible = visible && (dist >= -arrays.radius[idx]);
+        }
+        for (uint32_t planeIdx = 0; planeIdx < 6 && visible; ++planeIdx)
+        {
+            const FrustumCuller::Plane& plane = frustum.planes[planeIdx];
+            const CornerArrays& corner = corners[planeIdx];
+            const float dist = plane.nx * corner.x[idx] + plane.ny * corner.y[idx]
+                + plane.nz * corner.z[idx] + plane.d;
+            visible = (dist >= 0.0f);
+        }
+
+        // branchless append
+        p_visible[count] = idx;
+        count += visible ? 1 : 0;
+    }
+    return count;
+}
+
+#if defined(CORE_CULL_SSE)
+static uint32_t cullSse(const CullArrays& arrays, const FrustumCuller::Frustum& frustum,
+    const uint32_t begin, const uint32_t end, FrustumCuller::ObjectId* const p_visible)
+{
+    CornerArrays corners[6];
+    getCorners(arrays, frustum, corners);
+
+    __m128 planes[6][4];
+    for (uint32_t planeIdx = 0; planeIdx < 6; ++planeIdx)
+    {
+        const FrustumCuller::Plane& plane = frustum.planes[planeIdx];
+        planes[planeIdx][0] = _mm_set1_ps(plane.nx);
+        planes[planeIdx][1] = _mm_set1_ps(plane.ny);
+        planes[planeIdx][2] = _mm_set1_ps(plane.nz);
+        planes[planeIdx][3] = _mm_set1_ps(plane.d);
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    uint32_t count = 0;
+    uint32_t idx = begin;
+    for (; idx + 4 <= end; idx += 4)
+    {
+        const __m128 centerX = _mm_loadu_ps(arrays.centerX + idx);
+        const __m128 centerY = _mm_loadu_ps(arrays.centerY + idx);
+        const __m128 centerZ = _mm_loadu_ps(arrays.centerZ + idx);
+        const __m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(arrays.radius + idx));
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (uint32_t planeIdx = 0; planeIdx < 6; ++planeIdx)
+        {
+            const __m128* const plane = planes[planeIdx];
+            __m128 dist = _mm_add_ps(_mm_mul_ps(plane[0], centerX), plane[3]);
+            dist = _mm_add_ps(dist, _mm_mul_ps(plane[1], centerY));
+            dist = _mm_add_ps(dist, _mm_mul_ps(plane[2], centerZ));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+        }
+        if (_mm_movemask_ps(inside) == 0)
+        {
+            continue;
+        }
+
+        for (uint32_t planeIdx = 0; planeIdx < 6; ++planeIdx)
+        {
+            const __m128* const plane = planes[planeIdx];
+            const CornerArrays& corner = corners[planeIdx];
+            __m128 dist = _mm_add_ps(_mm_mul_ps(plane[0], _mm_loadu_ps(corner.x + idx)), plane[3]);
+            dist = _mm_add_ps(dist, _mm_mul_ps(plane[1], _mm_loadu_ps(corner.y + idx)));
+            dist = _mm_add_ps(dist, _mm_mul_ps(plane[2], _mm_loadu_ps(corner.z + idx)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, zero));
+        }
+
+        uint32_t mask = (uint32_t)_mm_movemask_ps(inside);
+        while (mask != 0)
+        {
+            p_visible[count++] = idx + countTrailingZeros(mask);
+            mask &= mask - 1;
+        }
+    }
+
+    return count + cullScalar(arrays, frustum, idx, end, p_visible + count);
+}
+#endif
+
+#if defined(CORE_CULL_AVX2)
+CORE_TARGET_AVX2
+static uint32_t cullAvx2(const CullArrays& arrays, const FrustumCuller::Frustum& frustum,
+    const uint32_t begin, const uint32_t end, FrustumCuller::ObjectId* const p_visible)
+{
+    CornerArrays corners[6];
+    getCorners(arrays, frustum, corners);
+
+    __m256 planes[6][4];
+    for (uint32_t planeIdx = 0; planeIdx < 6; ++planeIdx)
+    {
+        const FrustumCuller::Plane& plane = frustum.planes[planeIdx];
+        planes[planeIdx][0] = _mm256_set1_ps(plane.nx);
+        planes[planeIdx][1] = _mm256_set1_ps(plane.ny);
+        planes[planeIdx][2] = _mm256_set1_ps(plane.nz);
+        planes[planeIdx][3] = _mm256_set1_ps(plane.d);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+
+    uint32_t count = 0;
+    uint32_t idx = begin;
+    for (; idx + 8 <= end; idx += 8)
+    {
+        const __m256 centerX = _mm256_loadu_ps(arrays.centerX + idx);
+        const __m256 centerY = _mm256_loadu_ps(arrays.centerY + idx);
+        const __m256 centerZ = _mm256_loadu_ps(arrays.centerZ + idx);
+        const __m256 negRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(arrays.radius + idx));
+
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for (uint32_t planeIdx = 0; planeIdx < 6; ++planeIdx)
+        {
+            const __m256* const plane = planes[planeIdx];
+            __m256 dist = _mm256_add_ps(_mm256_mul_ps(plane[0], centerX), plane[3]);
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(plane[1], centerY));
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(plane[2], centerZ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negRadius, _CMP_GE_OQ));
+        }
+        if (_mm256_movemask_ps(inside) == 0)
+        {
+            continue;
+        }
+
+        for (uint32_t planeIdx = 0; planeIdx < 6; ++planeIdx)
+        {
+            const __m256* const plane = planes[planeIdx];
+            const CornerArrays& corner = corners[planeIdx];
+            __m256 dist = _mm256_add_ps(_mm256_mul_ps(plane[0], _mm256_loadu_ps(corner.x + idx)), plane[3]);
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(plane[1], _mm256_loadu_ps(corner.y + idx)));
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(plane[2], _mm256_loadu_ps(corner.z + idx)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, zero, _CMP_GE_OQ));
+        }
+
+        uint32_t mask = (uint32_t)_mm256_movemask_ps(inside);
+        while (mask != 0)
+        {
+            p_visible[count++] = idx + countTrailingZeros(mask);
+            mask &= mask - 1;
+        }
+    }
+
+    return count + cullScalar(arrays, frustum, idx, end, p_visible + count);
+}
+
+static bool isAvx2Supported()
+{
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    // the os must save the ymm registers too
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+FrustumCuller::Frustum FrustumCuller::Frustum::fromMatrix(const float viewProjection[16])
+{
+    float rows[4][4];
+    for (uint32_t r = 0; r < 4; ++r)
+    {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            rows[r][c] = viewProjection[c * 4 + r];
+        }
+    }
+    const float zeroRow[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    Frustum frustum;
+    // a + sign * b, normalized
+    const auto setPlane = [&frustum](const uint32_t idx, const float a[4], const float sign, const float b[4])
+    {
+        float plane[4];
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            plane[c] = a[c] + sign * b[c];
+        }
+        const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        const float invLength = (length > 0.0f) ? (1.0f / length) : 0.0f;
+        frustum.planes[idx].nx = plane[0] * invLength;
+        frustum.planes[idx].ny = plane[1] * invLength;
+        frustum.planes[idx].nz = plane[2] * invLength;
+        frustum.planes[idx].d  = plane[3] * invLength;
+    };
+
+    // Gribb-Hartmann, near is row 2 alone as clip z is in [0, w]
+    setPlane(0, rows[3],  1.0f, rows[0]);
+    setPlane(1, rows[3], -1.0f, rows[0]);
+    setPlane(2, rows[3],  1.0f, rows[1]);
+    setPlane(3, rows[3], -1.0f, rows[1]);
+    setPlane(4, zeroRow,  1.0f, rows[2]);
+    setPlane(5, rows[3], -1.0f, rows[2]);
+    return frustum;
+}
+
+FrustumCuller::Kernel FrustumCuller::getBestKernel()
+{
+    if (isSupported(Kernel::Avx2))
+    {
+        return Kernel::Avx2;
+    }
+    if (isSupported(Kernel::Sse))
+    {
+        return Kernel::Sse;
+    }
+    return Kernel::Scalar;
+}
+
+bool FrustumCuller::isSupported(const Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::Scalar:
+        return true;
+#if defined(CORE_CULL_SSE)
+    case Kernel::Sse:
+        return true;
+#endif
+#if defined(CORE_CULL_AVX2)
+    case Kernel::Avx2:
+    {
+        static const bool s_supported = isAvx2Supported();
+        return s_supported;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* FrustumCuller::getKernelName(const Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::Scalar:    return "scalar";
+    case Kernel::Sse:       return "sse";
+    case Kernel::Avx2:      return "avx2";
+    }
+    return "unknown";
+}
+
+FrustumCuller::FrustumCuller(const uint32_t threadCount)
+    : m_threadCount(std::max((threadCount > 0) ? threadCount : std::thread::hardware_concurrency(), 1u)),
+    m_kernel(getBestKernel())
+{
+}
+
+void FrustumCuller::clear()
+{
+    m_bounds = Soa();
+    m_objectCount = 0;
+}
+
+void FrustumCuller::reserve(const uint32_t count)
+{
+    for (std::vector<float>* p_array : { &m_bounds.centerX, &m_bounds.centerY, &m_bounds.centerZ,
+        &m_bounds.radius, &m_bounds.minX, &m_bounds.minY, &m_bounds.minZ,
+        &m_bounds.maxX, &m_bounds.maxY, &m_bounds.maxZ })
+    {
+        p_array->reserve(count);
+    }
+}
+
+FrustumCuller::ObjectId FrustumCuller::add(const Bounds& bounds)
+{
+    const ObjectId id = m_objectCount++;
+    m_bounds.centerX.push_back(bounds.center[0]);
+    m_bounds.centerY.push_back(bounds.center[1]);
+    m_bounds.centerZ.push_back(bounds.center[2]);
+    m_bounds.radius.push_back(bounds.radius);
+    m_bounds.minX.push_back(bounds.aabbMin[0]);
+    m_bounds.minY.push_back(bounds.aabbMin[1]);
+    m_bounds.minZ.push_back(bounds.aabbMin[2]);
+    m_bounds.maxX.push_back(bounds.aabbMax[0]);
+    m_bounds.maxY.push_back(bounds.aabbMax[1]);
+    m_bounds.maxZ.push_back(bounds.aabbMax[2]);
+    return id;
+}
+
+void FrustumCuller::set(const ObjectId id, const Bounds& bounds)
+{
+    assert(id < m_objectCount);
+    m_bounds.centerX[id] = bounds.center[0];
+    m_bounds.centerY[id] = bounds.center[1];
+    m_bounds.centerZ[id] = bounds.center[2];
+    m_bounds.radius[id] = bounds.radius;
+    m_bounds.minX[id] = bounds.aabbMin[0];
+    m_bounds.minY[id] = bounds.aabbMin[1];
+    m_bounds.minZ[id] = bounds.aabbMin[2];
+    m_bounds.maxX[id] = bounds.aabbMax[0];
+    m_bounds.maxY[id] = bounds.aabbMax[1];
+    m_bounds.maxZ[id] = bounds.aabbMax[2];
+}
+
+uint32_t FrustumCuller::getObjectCount() const
+{
+    return m_objectCount;
+}
+
+void FrustumCuller::setKernel(const Kernel kernel)
+{
+    m_kernel = isSupported(kernel) ? kernel : getBestKernel();
+}
+
+FrustumCuller::Kernel FrustumCuller::getKernel() const
+{
+    return m_kernel;
+}
+
+void FrustumCuller::cull(const Frustum& frustum, std::vector<ObjectId>& visible)
+{
+    visible.clear();
+    if (m_objectCount == 0)
+    {
+        return;
+    }
+
+    const CullArrays arrays =
+    {
+        m_bounds.centerX.data(), m_bounds.centerY.data(), m_bounds.centerZ.data(),
+        m_bounds.radius.data(),
+        m_bounds.minX.data(), m_bounds.minY.data(), m_bounds.minZ.data(),
+        m_bounds.maxX.data(), m_bounds.maxY.data(), m_bounds.maxZ.data(),
+    };
+
+    typedef uint32_t (*CullFunc)(const CullArrays&, const Frustum&,
+        const uint32_t, const uint32_t, ObjectId* const);
+    CullFunc cullFunc = cullScalar;
+#if defined(CORE_CULL_SSE)
+    if (m_kernel == Kernel::Sse)
+    {
+        cullFunc = cullSse;
+    }
+#endif
+#if defined(CORE_CULL_AVX2)
+    if (m_kernel == Kernel::Avx2)
+    {
+        cullFunc = cullAvx2;
+    }
+#endif
+
+    if (m_objectCount < TaskGraph::c_parallelThreshold || m_threadCount == 1)
+    {
+        visible.resize(m_objectCount);
+        visible.resize(cullFunc(arrays, frustum, 0, m_objectCount, visible.data()));
+        return;
+    }
+
+    // chunks round robin over the threads, each writes its own list
+    const uint32_t chunkCount = (m_objectCount + s_chunkSize - 1) / s_chunkSize;
+    const uint32_t threadCount = std::min(m_threadCount, chunkCount);
+    m_chunkVisible.resize(std::max((uint32_t)m_chunkVisible.size(), chunkCount));
+
+    TaskGraph::parallelFor(threadCount, [&](const uint32_t thread)
+    {
+        for (uint32_t chunk = thread; chunk < chunkCount; chunk += threadCount)
+        {
+            const uint32_t begin = chunk * s_chunkSize;
+            const uint32_t end = std::min(begin + s_chunkSize, m_objectCount);
+            std::vector<ObjectId>& chunkVisible = m_chunkVisible[chunk];
+            chunkVisible.resize(end - begin);
+            chunkVisible.resize(cullFunc(arrays, frustum, begin, end, chunkVisible.data()));
+        }
+    });
+
+    size_t visibleCount = 0;
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        visibleCount += m_chunkVisible[chunk].size();
+    }
+    visible.reserve(visibleCount);
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        visible.insert(visible.end(), m_chunkVisible[chunk].begin(), m_chunkVisible[chunk].end());
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,116 @@
+#ifndef CORE_FRUSTUM_CULLER_H
+#define CORE_FRUSTUM_CULLER_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Visibility of many objects against the six planes of a view frustum.
+// Bounds are kept as structure of arrays, a bounding sphere and an AABB
+// per object, so a kernel tests 8 (AVX2), 4 (SSE) or 1 (scalar) objects
+// per instruction. The sphere test runs first, the AABB test only on
+// what the sphere test kept. Large sets are culled in chunks on several
+// threads. The result is a compact list of visible object indices in
+// ascending order, for building the frame's draws.
+class FrustumCuller
+{
+public:
+    typedef uint32_t ObjectId;
+
+    enum class Kernel : uint32_t
+    {
+        Scalar,
+        Sse,
+        Avx2,
+    };
+
+    // inside: nx * x + ny * y + nz * z + d >= 0
+    struct Plane
+    {
+        float nx = 0.0f;
+        float ny = 0.0f;
+        float nz = 0.0f;
+        float d  = 0.0f;
+    };
+
+    struct Frustum
+    {
+        // left, right, bottom, top, near, far
+        Plane planes[6];
+
+        // from a column-major view projection matrix with
+        // Vulkan clip space, depth in [0, 1], planes normalized
+        static Frustum fromMatrix(const float viewProjection[16]);
+    };
+
+    struct Bounds
+    {
+        float center[3]     = { 0.0f, 0.0f, 0.0f };
+        float radius        = 0.0f;
+        float aabbMin[3]    = { 0.0f, 0.0f, 0.0f };
+        float aabbMax[3]    = { 0.0f, 0.0f, 0.0f };
+    };
+
+    // best kernel the cpu supports
+    static Kernel getBestKernel();
+    static bool isSupported(const Kernel kernel);
+    static const char* getKernelName(const Kernel kernel);
+
+    // large sets are culled on up to threadCount threads,
+    // 0 = hardware concurrency
+    explicit FrustumCuller(const uint32_t threadCount);
+    ~FrustumCuller() = default;
+
+    FrustumCuller(const FrustumCuller&) = delete;
+    FrustumCuller& operator=(const FrustumCuller&) = delete;
+
+    void clear();
+    void reserve(const uint32_t count);
+    ObjectId add(const Bounds& bounds);
+    void set(const ObjectId id, const Bounds& bounds);
+    uint32_t getObjectCount() const;
+
+    // defaults to getBestKernel(), unsupported kernels are not used
+    void setKernel(const Kernel kernel);
+    Kernel getKernel() const;
+
+    // visible receives the ids of objects inside or intersecting the frustum
+    void cull(const Frustum& frustum, std::vector<ObjectId>& visible);
+
+private:
+    struct Soa
+    {
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> radius;
+        std::vector<float> minX;
+        std::vector<float> minY;
+        std::vector<float> minZ;
+        std::vector<float> maxX;
+        std::vector<float> maxY;
+        std::vector<float> maxZ;
+    };
+
+    const uint32_t m_threadCount = 1;
+    Kernel m_kernel = Kernel::Scalar;
+
+    Soa m_bounds;
+    uint32_t m_objectCount = 0;
+
+    // per chunk output, concatenated in chunk order
+    std::vector<std::vector<ObjectId>> m_chunkVisible;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_FRUSTUM_CULLER_H
@@ -0,0 +1,58 @@
+#ifndef CORE_GFX_HANDLES_H
+#define CORE_GFX_HANDLES_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "HandlePool.h"
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Pools of gpu resources owned by GfxResources. Column enums name the
+// per-resource arrays, e.g. pool.get<ImagePool::View>(handle).
+
+struct BufferTag;
+struct ImageTag;
+struct PipelineTag;
+struct SamplerTag;
+
+typedef Handle<BufferTag> BufferHandle;
+typedef Handle<ImageTag> ImageHandle;
+typedef Handle<PipelineTag> PipelineHandle;
+typedef Handle<SamplerTag> SamplerHandle;
+
+struct BufferPool : HandlePool<BufferTag,
+    VkBuffer, VkDeviceMemory, VkDeviceSize, VkBufferUsageFlags>
+{
+    enum Column { Buffer, Memory, Size, Usage };
+};
+
+// memory is nullptr for images owned by someone else, like the swapchain
+struct ImagePool : HandlePool<ImageTag,
+    VkImage, VkImageView, VkDeviceMemory, VkFormat, VkExtent2D>
+{
+    enum Column { Image, View, Memory, Format, Extent };
+};
+
+struct PipelinePool : HandlePool<PipelineTag,
+    VkPipeline, VkPipelineLayout, VkPipelineBindPoint>
+{
+    enum Column { Pipeline, Layout, BindPoint };
+};
+
+struct SamplerPool : HandlePool<SamplerTag,
+    VkSampler>
+{
+    enum Column { Sampler };
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_GFX_HANDLES_H
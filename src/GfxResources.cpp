@@ -3,21 +3,40 @@
 
 #include "GfxResources.h"
 
-#include "Utils.h"
+#include "BindlessTable.h"
+#include "Config.h"
+#include "MeshBatcher.h"
+#include "Profiler.h"
+#include "QueueTimeline.h"
+#include "RenderPassBuilder.h"
+#include "TaskGraph.h"
 #include "Window.h"
 
 #include <assert.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 #include <vulkan/vulkan.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
-#define DEF_PRINT_DEVICE_PROPERTIES 1
-
 #ifdef _DEBUG
 #define DEF_USE_DEBUG_VALIDATION 1
 #endif
@@ -47,48 +66,319 @@ PFN_vkDestroyDebugReportCallbackEXT	fvkDestroyDebugReportCallbackEXT = nullptr;
 
 #endif
 
+// returns empty if the file can't be read
+static std::vector<char> readFile(const std::string& fileName)
+{
+    std::vector<char> data;
+
+    std::ifstream file(fileName, std::ios::ate | std::ios::binary);
+    if (file.is_open())
+    {
+        const size_t fileSize = file.tellg();
+        data.resize(fileSize);
+        file.seekg(0);
+        file.read(data.data(), fileSize);
+    }
+
+    return data;
+}
+
+static void writeFile(const std::string& fileName, const std::vector<char>& data)
+{
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        // the cache directory probably does not exist yet
+        const size_t separator = fileName.find_last_of("/\\");
+        if (separator != std::string::npos)
+        {
+            const std::string path = fileName.substr(0, separator);
+#ifdef _WIN32
+            _mkdir(path.c_str());
+#else
+            mkdir(path.c_str(), 0755);
+#endif
+        }
+        file.open(fileName, std::ios::binary | std::ios::trunc);
+    }
+
+    if (file.is_open())
+    {
+        file.write(data.data(), data.size());
+    }
+}
+
 static VkShaderModule createShaderModule(
     VkDevice device,
-    const char* const shaderFile)
+    const std::vector<char>& binaryShader)
 {
     assert(device);
     VkShaderModule shaderModule = nullptr;
 
-    std::ifstream file(shaderFile, std::ios::ate | std::ios::binary);
-    assert(file.is_open() && "Shader file not found! Correct working dir, shaders compiled?");
+    assert(!binaryShader.empty() && "Shader file not found! Correct working dir, shaders compiled?");
+    if (binaryShader.empty())
+    {
+        throw std::runtime_error("Shader file not found! Correct working dir, shaders compiled?");
+    }
 
-    if (file.is_open())
+    const VkShaderModuleCreateInfo shaderModuleCreateInfo =
     {
-        const size_t fileSize = file.tellg();
-        std::vector<char> binaryShader(fileSize);
-        file.seekg(0);
-        file.read(binaryShader.data(), fileSize);
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,// sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        binaryShader.size(),                        // codeSize
+        (const uint32_t*)(binaryShader.data())      // pCode
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkCreateShaderModule(
+        device,                 // device
+        &shaderModuleCreateInfo,// pCreateInfo
+        nullptr,                // pAllocator
+        &shaderModule));        // pShaderModule
 
-        const VkShaderModuleCreateInfo shaderModuleCreateInfo =
+    return shaderModule;
+}
+
+struct PhysicalDeviceCandidate
+{
+    VkPhysicalDevice physicalDevice = nullptr;
+    VkPhysicalDeviceProperties properties;
+    uint32_t queueFamilyIndex   = ~0u;
+    VkDeviceSize deviceLocalSize= 0;
+    bool suitable               = false;
+    int64_t score               = 0;
+};
+
+static bool hasDeviceExtension(
+    VkPhysicalDevice physicalDevice,
+    const char* const extensionName)
+{
+    uint32_t extensionCount = 0;
+    CHECK_VK_RESULT_SUCCESS(vkEnumerateDeviceExtensionProperties(
+        physicalDevice,     // physicalDevice
+        nullptr,            // pLayerName
+        &extensionCount,    // pPropertyCount
+        nullptr));          // pProperties
+
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    CHECK_VK_RESULT_SUCCESS(vkEnumerateDeviceExtensionProperties(
+        physicalDevice,     // physicalDevice
+        nullptr,            // pLayerName
+        &extensionCount,    // pPropertyCount
+        extensions.data()));// pProperties
+
+    for (const auto& ref : extensions)
+    {
+        if (strcmp(ref.extensionName, extensionName) == 0)
         {
-            VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,// sType
-            nullptr,                                    // pNext
-            0,                                          // flags
-            binaryShader.size(),                        // codeSize
-            (uint32_t*)(binaryShader.data())            // pCode
-        };
+            return true;
+        }
+    }
+    return false;
+}
 
-        CHECK_VK_RESULT_SUCCESS(vkCreateShaderModule(
-            device,                 // device
-            &shaderModuleCreateInfo,// pCreateInfo
-            nullptr,                // pAllocator
-            &shaderModule));        // pShaderModule
+static bool hasDeviceFeatures(
+    VkPhysicalDevice physicalDevice,
+    const VkPhysicalDeviceFeatures& requiredFeatures)
+{
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+    // the struct is just a list of VkBool32
+    const VkBool32* const supported = (const VkBool32*)&features;
+    const VkBool32* const required = (const VkBool32*)&requiredFeatures;
+    const size_t count = sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32);
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        if (required[idx] && !supported[idx])
+        {
+            return false;
+        }
     }
+    return true;
+}
 
-    return shaderModule;
+static int64_t getDeviceTypeScore(const VkPhysicalDeviceType deviceType)
+{
+    switch (deviceType)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:      return 10000;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:    return 1000;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:       return 500;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:               return 100;
+    default:                                        return 0;
+    }
+}
+
+static VkBool32 hasPresentationSupport(
+    VkPhysicalDevice physicalDevice,
+    const uint32_t queueFamilyIndex,
+    const Window* const p_window)
+{
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+    (void)p_window;
+    return vkGetPhysicalDeviceWin32PresentationSupportKHR(
+        physicalDevice,         // physicalDevice
+        queueFamilyIndex);      // queueFamilyIndex
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    return vkGetPhysicalDeviceXcbPresentationSupportKHR(
+        physicalDevice,             // physicalDevice
+        queueFamilyIndex,           // queueFamilyIndex
+        p_window->getConnection(),  // connection
+        p_window->getVisualId());   // visual_id
+#endif
+}
+
+static PhysicalDeviceCandidate scorePhysicalDevice(
+    VkPhysicalDevice physicalDevice,
+    const Window* const p_window,
+    const VkPhysicalDeviceFeatures& requiredFeatures,
+    const uint32_t requiredApiVersion)
+{
+    PhysicalDeviceCandidate candidate;
+    candidate.physicalDevice = physicalDevice;
+    vkGetPhysicalDeviceProperties(physicalDevice, &candidate.properties);
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for (uint32_t idx = 0; idx < memoryProperties.memoryHeapCount; ++idx)
+    {
+        if (memoryProperties.memoryHeaps[idx].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            candidate.deviceLocalSize += memoryProperties.memoryHeaps[idx].size;
+        }
+    }
+
+    uint32_t queueFamilyPropertyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physicalDevice,                 // physicalDevice
+        &queueFamilyPropertyCount,      // pQueueFamilyPropertyCount
+        nullptr);                       // pQueueFamilyProperties
+
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyPropertyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physicalDevice,                 // physicalDevice
+        &queueFamilyPropertyCount,      // pQueueFamilyPropertyCount
+        queueFamilyProperties.data());  // pQueueFamilyProperties
+
+    for (uint32_t idx = 0; idx < queueFamilyProperties.size(); ++idx)
+    {
+        // first graphics queue which can present
+        if ((queueFamilyProperties[idx].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            && hasPresentationSupport(physicalDevice, idx, p_window))
+        {
+            candidate.queueFamilyIndex = idx;
+            break;
+        }
+    }
+
+    candidate.suitable = (candidate.queueFamilyIndex != ~0u)
+        && (candidate.properties.apiVersion >= requiredApiVersion)
+        && hasDeviceExtension(physicalDevice, VK_KHR_SWAPCHAIN_EXTENSION_NAME)
+        && hasDeviceFeatures(physicalDevice, requiredFeatures);
+
+    if (candidate.suitable)
+    {
+        // device type dominates, then prefer more local memory (1 point / 16 MiB)
+        candidate.score = getDeviceTypeScore(candidate.properties.deviceType)
+            + int64_t(candidate.deviceLocalSize >> 24);
+    }
+
+    return candidate;
+}
+
+// returns index of the selected candidate
+static size_t selectPhysicalDevice(
+    const std::vector<PhysicalDeviceCandidate>& candidates,
+    const std::string& preference)
+{
+    std::string lowerPreference = preference;
+    std::transform(lowerPreference.begin(), lowerPreference.end(),
+        lowerPreference.begin(), [](unsigned char c) { return (char)tolower(c); });
+
+    // an index must name an enumerated device, a typo is a config error
+    const bool indexPreference = !lowerPreference.empty()
+        && std::all_of(lowerPreference.begin(), lowerPreference.end(),
+            [](unsigned char c) { return isdigit(c) != 0; });
+    size_t preferredIndex = candidates.size();
+    if (indexPreference)
+    {
+        errno = 0;
+        char* p_end = nullptr;
+        const unsigned long parsed = strtoul(lowerPreference.c_str(), &p_end, 10);
+        if (errno == ERANGE || *p_end != '\0' || parsed >= candidates.size())
+        {
+            throw std::runtime_error("GPU preference \"" + preference + "\" is not a device index, "
+                + std::to_string(candidates.size()) + " physical devices found");
+        }
+        preferredIndex = (size_t)parsed;
+    }
+
+    const auto matches = [&lowerPreference, indexPreference, preferredIndex](
+        const PhysicalDeviceCandidate& candidate, const size_t idx)
+    {
+        if (lowerPreference.empty())
+        {
+            return true;
+        }
+        if (indexPreference)
+        {
+            return idx == preferredIndex;
+        }
+        if (lowerPreference == "discrete")
+        {
+            return candidate.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+        }
+        if (lowerPreference == "integrated")
+        {
+            return candidate.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+        }
+        if (lowerPreference == "cpu")
+        {
+            return candidate.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+        }
+
+        std::string name = candidate.properties.deviceName;
+        std::transform(name.begin(), name.end(), name.begin(),
+            [](unsigned char c) { return (char)tolower(c); });
+        return name.find(lowerPreference) != std::string::npos;
+    };
+
+    size_t selected = candidates.size();
+    for (int pass = 0; pass < 2 && selected == candidates.size(); ++pass)
+    {
+        // second pass ignores the preference if nothing matched
+        for (size_t idx = 0; idx < candidates.size(); ++idx)
+        {
+            const PhysicalDeviceCandidate& candidate = candidates[idx];
+            if (!candidate.suitable || (pass == 0 && !matches(candidate, idx)))
+            {
+                continue;
+            }
+            if (selected == candidates.size() || candidate.score > candidates[selected].score)
+            {
+                selected = idx;
+            }
+        }
+
+        if (pass == 0 && selected == candidates.size())
+        {
+            std::cerr << "no suitable physical device matches preference \""
+                << preference << "\"" << std::endl;
+        }
+    }
+
+    return selected;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-GfxResources::GfxResources(Window* const p_window)
-    : mp_window(p_window)
+GfxResources::GfxResources(Window* const p_window, const Config* const p_config)
+    : mp_window(p_window),
+    mp_config(p_config)
 {
     assert(p_window);
+    assert(p_config);
 
     create();
 }
@@ -102,22 +392,26 @@ void GfxResources::destroy()
 {
     vkDeviceWaitIdle(m_device);
 
+    savePipelineCache();
+    vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+
     vkDestroyShaderModule(m_device, m_shader.vert, nullptr);
     vkDestroyShaderModule(m_device, m_shader.frag, nullptr);
 
-    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
-    vkDestroyPipeline(m_device,	m_graphicsPipeline,	nullptr);
-
-    for (uint32_t idx = 0; idx < m_bufferedFrameResource.bufferCount; ++idx)
+    destroySwapchainResources();
+    destroyCommandBuffers();
+    if (m_deletionQueue)
     {
-        vkDestroyImageView(m_device, m_bufferedFrameResource.imageViews[idx], nullptr);
-        vkDestroyFramebuffer(m_device, m_bufferedFrameResource.framebuffers[idx], nullptr);
-        vkDestroyFence(m_device, m_bufferedFrameResource.commandBufferFences[idx], nullptr);
+        releaseAll();
+        m_graphicsPipelines.clear();
+        m_deletionQueue->flush();
+        m_deletionQueue.reset();
     }
-
-    vkFreeCommandBuffers(m_device, m_commandPool,
-        (uint32_t)(m_bufferedFrameResource.commandBuffers.size()),
-        m_bufferedFrameResource.commandBuffers.data()); // not really needed due to vkDestroyCommandPool
+    // after the flush, released slots call back into the table
+    m_bindlessTable.reset();
+    m_layoutCache.reset();
+    m_memoryBudget.reset();
+    m_queueTimeline.reset();
     vkDestroyCommandPool(m_device, m_commandPool, nullptr);
 
     vkDestroySemaphore(m_device, m_bufferedFrameResource.swapchainImageSemaphore, nullptr);
@@ -136,39 +430,269 @@ void GfxResources::destroy()
     vkDestroyInstance(m_instance, nullptr);
 }
 
-void GfxResources::create()
+// frames in flight may still use these, they go through the deletion queue
+
+void GfxResources::destroySwapchainResources()
+{
+    for (const ImageHandle image : m_bufferedFrameResource.images)
+    {
+        releaseImage(image);
+    }
+    m_bufferedFrameResource.images.clear();
+}
+
+void GfxResources::releaseBuffer(const BufferHandle handle)
+{
+    m_memoryBudget->onFree(m_bufferPool.get<BufferPool::Memory>(handle));
+    m_deletionQueue->destroy(m_bufferPool.get<BufferPool::Buffer>(handle));
+    m_deletionQueue->destroy(m_bufferPool.get<BufferPool::Memory>(handle));
+    m_bufferPool.destroy(handle);
+}
+
+void GfxResources::releaseImage(const ImageHandle handle)
+{
+    m_deletionQueue->destroy(m_imagePool.get<ImagePool::View>(handle));
+    // image is only ours if we allocated its memory
+    VkDeviceMemory memory = m_imagePool.get<ImagePool::Memory>(handle);
+    if (memory)
+    {
+        m_memoryBudget->onFree(memory);
+        m_deletionQueue->destroy(m_imagePool.get<ImagePool::Image>(handle));
+        m_deletionQueue->destroy(memory);
+    }
+    m_imagePool.destroy(handle);
+}
+
+void GfxResources::releasePipeline(const PipelineHandle handle)
+{
+    // layouts may be shared, they are owned separately
+    m_deletionQueue->destroy(m_pipelinePool.get<PipelinePool::Pipeline>(handle));
+    m_pipelinePool.destroy(handle);
+}
+
+void GfxResources::releaseSampler(const SamplerHandle handle)
+{
+    m_deletionQueue->destroy(m_samplerPool.get<SamplerPool::Sampler>(handle));
+    m_samplerPool.destroy(handle);
+}
+
+void GfxResources::releaseAll()
+{
+    // releasing swaps the last one into place, so sweep from the back
+    while (m_bufferPool.size() > 0)
+    {
+        releaseBuffer(m_bufferPool.getHandle(m_bufferPool.size() - 1));
+    }
+    while (m_imagePool.size() > 0)
+    {
+        releaseImage(m_imagePool.getHandle(m_imagePool.size() - 1));
+    }
+    while (m_pipelinePool.size() > 0)
+    {
+        releasePipeline(m_pipelinePool.getHandle(m_pipelinePool.size() - 1));
+    }
+    while (m_samplerPool.size() > 0)
+    {
+        releaseSampler(m_samplerPool.getHandle(m_samplerPool.size() - 1));
+    }
+}
+
+void GfxResources::destroyCommandBuffers()
+{
+    m_deletionQueue->destroy(m_bufferedFrameResource.timestampQueryPool);
+    m_bufferedFrameResource.timestampQueryPool = nullptr;
+
+    for (VkCommandBuffer commandBuffer : m_bufferedFrameResource.commandBuffers)
+    {
+        m_deletionQueue->destroy(m_commandPool, commandBuffer);
+    }
+    m_bufferedFrameResource.commandBuffers.clear();
+}
+
+void GfxResources::recreateSwapchain()
 {
-    createInstance();
-    createPhysicalDevice();
-    createSurface();
+    // no device wait, the old resources are released
+    // when the frames using them have completed
+    destroySwapchainResources();
+    destroyCommandBuffers();
+
+    // the old swapchain is retired inside createSwapchain()
     createSwapchain();
-    createRenderPass();
-    createFramebuffer();
-    createGraphicsPipeline();
-    createQueueAndPool();
-    createSemaphores();
+    createCommandBuffers();
+
+    // variants for other sizes would pile up over resizes, frames in
+    // flight may still use them. Their replacements are created here
+    // instead of stalling the first frame that records with them
+    std::vector<ShaderVariantKey> resizedKeys;
+    for (auto iter = m_graphicsPipelines.begin(); iter != m_graphicsPipelines.end();)
+    {
+        if (iter->first.resolution.width != m_swapchainExtent.width
+            || iter->first.resolution.height != m_swapchainExtent.height)
+        {
+            resizedKeys.push_back(iter->first);
+            resizedKeys.back().resolution = m_swapchainExtent;
+            releasePipeline(iter->second);
+            iter = m_graphicsPipelines.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+    for (const ShaderVariantKey& key : resizedKeys)
+    {
+        getGraphicsPipeline(key);
+    }
+
+    m_bufferedFrameResource.bufferIndex = 0;
+}
+
+void GfxResources::create()
+{
+    CORE_PROFILE_ZONE("GfxResources::create");
+
+    // file loading runs in parallel with instance and device creation,
+    // pipeline creation in parallel with the swapchain
+    TaskGraph graph;
+
+    const auto loadVert = graph.addTask("loadVertexShader",
+        [this]() { m_shaderCode.vert = readFile(mp_config->vertexShader); });
+    const auto loadFrag = graph.addTask("loadFragmentShader",
+        [this]() { m_shaderCode.frag = readFile(mp_config->fragmentShader); });
+    const auto loadCache = graph.addTask("loadPipelineCacheFile",
+        [this]() { m_pipelineCacheData = readFile(getPipelineCacheFileName()); });
+
+    const auto instance = graph.addTask("createInstance",
+        [this]() { createInstance(); });
+    const auto physicalDevice = graph.addTask("createPhysicalDevice",
+        [this]() { createPhysicalDevice(); }, { instance });
+    const auto surface = graph.addTask("createSurface",
+        [this]() { createSurface(); }, { physicalDevice });
+    const auto renderPass = graph.addTask("createRenderPass",
+        [this]() { createRenderPass(); }, { surface });
+
+    const auto swapchain = graph.addTask("createSwapchain",
+        [this]() { createSwapchain(); }, { surface });
+
+    const auto pipelineCache = graph.addTask("createPipelineCache",
+        [this]() { createPipelineCache(); }, { physicalDevice, loadCache });
+    const auto bindlessTable = graph.addTask("createBindlessTable",
+        [this]() { createBindlessTable(); }, { physicalDevice });
+    const auto reflectVert = graph.addTask("reflectVertexShader",
+        [this]() { reflectShader(mp_config->vertexShader, m_shaderCode.vert, m_reflection.vert); },
+        { loadVert });
+    const auto reflectFrag = graph.addTask("reflectFragmentShader",
+        [this]() { reflectShader(mp_config->fragmentShader, m_shaderCode.frag, m_reflection.frag); },
+        { loadFrag });
+    graph.addTask("createGraphicsPipeline",
+        [this]() { createGraphicsPipeline(); },
+        { renderPass, pipelineCache, bindlessTable, reflectVert, reflectFrag });
+
+    const auto queueAndPool = graph.addTask("createQueueAndPool",
+        [this]() { createQueueAndPool(); }, { physicalDevice });
+    graph.addTask("createCommandBuffers",
+        [this]() { createCommandBuffers(); }, { queueAndPool, swapchain });
+    graph.addTask("createSemaphores",
+        [this]() { createSemaphores(); }, { physicalDevice });
+
+    graph.run(mp_config->workerThreadCount);
+
+    if (mp_config->printStartupTiming)
+    {
+        graph.printReport(std::cout);
+    }
+}
+
+std::string GfxResources::getPipelineCacheFileName() const
+{
+    return mp_config->cachePath + "/pipeline.cache";
+}
+
+void GfxResources::createPipelineCache()
+{
+    CORE_PROFILE_ZONE("GfxResources::createPipelineCache");
+
+    // the driver validates the header and ignores data
+    // from another device or driver version
+    const VkPipelineCacheCreateInfo pipelineCacheCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,   // sType
+        nullptr,                                        // pNext
+        0,                                              // flags
+        m_pipelineCacheData.size(),                     // initialDataSize
+        m_pipelineCacheData.data()                      // pInitialData
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkCreatePipelineCache(
+        m_device,                   // device
+        &pipelineCacheCreateInfo,   // pCreateInfo
+        nullptr,                    // pAllocator
+        &m_pipelineCache));         // pPipelineCache
+
+    m_pipelineCacheData.clear();
+    m_pipelineCacheData.shrink_to_fit();
+}
+
+void GfxResources::savePipelineCache()
+{
+    if (!m_pipelineCache)
+    {
+        return;
+    }
+
+    size_t dataSize = 0;
+    CHECK_VK_RESULT_SUCCESS(vkGetPipelineCacheData(
+        m_device,           // device
+        m_pipelineCache,    // pipelineCache
+        &dataSize,          // pDataSize
+        nullptr));          // pData
+
+    std::vector<char> data(dataSize);
+    CHECK_VK_RESULT_SUCCESS(vkGetPipelineCacheData(
+        m_device,           // device
+        m_pipelineCache,    // pipelineCache
+        &dataSize,          // pDataSize
+        data.data()));      // pData
+
+    writeFile(getPipelineCacheFileName(), data);
 }
 
 void GfxResources::createInstance()
 {
-    const GlobalVariables& gv = GlobalVariables::getInstance();
+    CORE_PROFILE_ZONE("GfxResources::createInstance");
+
+    // config api version is the minimum for the device, the instance asks
+    // for up to 1.2 if the loader has it so newer features can be queried
+    uint32_t loaderApiVersion = VK_API_VERSION_1_0;
+    const PFN_vkEnumerateInstanceVersion fvkEnumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)
+        vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    if (fvkEnumerateInstanceVersion)
+    {
+        CHECK_VK_RESULT_SUCCESS(fvkEnumerateInstanceVersion(&loaderApiVersion));
+    }
+    m_instanceApiVersion = std::max(mp_config->apiVersion,
+        std::min(loaderApiVersion, (uint32_t)VK_API_VERSION_1_2));
 
     const VkApplicationInfo applicationInfo =
     {
-        VK_STRUCTURE_TYPE_APPLICATION_INFO, // sType
-        nullptr,                            // pNext
-        gv.applicationName.c_str(),         // pApplicationName
-        gv.applicationVersion,              // applicationVersion
-        gv.engineName.c_str(),              // pEngineName
-        gv.engineVersion,                   // engineVersion
-        gv.apiVersion,                      // apiVersion
+        VK_STRUCTURE_TYPE_APPLICATION_INFO,     // sType
+        nullptr,                                // pNext
+        mp_config->applicationName.c_str(),     // pApplicationName
+        mp_config->applicationVersion,          // applicationVersion
+        mp_config->engineName.c_str(),          // pEngineName
+        mp_config->engineVersion,               // engineVersion
+        m_instanceApiVersion,                   // apiVersion
     };
 
     std::vector<const char*> extensions;
     std::vector<const char*> layers;
 
     extensions.emplace_back(VK_KHR_SURFACE_EXTENSION_NAME);
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
     extensions.emplace_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    extensions.emplace_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+#endif
 #if (DEF_USE_DEBUG_VALIDATION == 1)
     extensions.emplace_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
     // this is the most important thing
@@ -220,16 +744,108 @@ void GfxResources::createInstance()
 
 void GfxResources::createPhysicalDevice()
 {
-    uint32_t physicalDeviceCount = 1; // let's try to get one
+    CORE_PROFILE_ZONE("GfxResources::createPhysicalDevice");
+
+    // resource arrays are indexed with push constants
+    VkPhysicalDeviceFeatures requiredDeviceFeatures = {};
+    requiredDeviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    requiredDeviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+
+    uint32_t physicalDeviceCount = 0;
     CHECK_VK_RESULT_SUCCESS(vkEnumeratePhysicalDevices(
         m_instance,             // instance
         &physicalDeviceCount,   // pPhysicalDeviceCount
-        &m_physicalDevice));    // pPhysicalDevices
+        nullptr));              // pPhysicalDevices
+
+    std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
+    CHECK_VK_RESULT_SUCCESS(vkEnumeratePhysicalDevices(
+        m_instance,                 // instance
+        &physicalDeviceCount,       // pPhysicalDeviceCount
+        physicalDevices.data()));   // pPhysicalDevices
 
-#if (DEF_PRINT_DEVICE_PROPERTIES == 1)
+    std::vector<PhysicalDeviceCandidate> candidates;
+    for (VkPhysicalDevice physicalDevice : physicalDevices)
     {
-        VkPhysicalDeviceProperties physicalDeviceProperties;
-        vkGetPhysicalDeviceProperties(m_physicalDevice, &physicalDeviceProperties);
+        candidates.push_back(scorePhysicalDevice(
+            physicalDevice, mp_window, requiredDeviceFeatures, mp_config->apiVersion));
+    }
+
+    const size_t selected = selectPhysicalDevice(candidates, mp_config->gpuPreference);
+
+    for (size_t idx = 0; idx < candidates.size(); ++idx)
+    {
+        const PhysicalDeviceCandidate& candidate = candidates[idx];
+        std::cout << ((idx == selected) ? "* " : "  ")
+            << "gpu " << idx << ": " << candidate.properties.deviceName
+            << ", type " << candidate.properties.deviceType
+            << ", local memory " << (candidate.deviceLocalSize >> 20) << " MiB, "
+            << (candidate.suitable ? "score " + std::to_string(candidate.score) : std::string("not suitable"))
+            << std::endl;
+    }
+
+    if (selected == candidates.size())
+    {
+        throw std::runtime_error("No suitable physical device found");
+    }
+
+    m_physicalDevice = candidates[selected].physicalDevice;
+    m_queueFamilyIndex = candidates[selected].queueFamilyIndex;
+
+    vkGetPhysicalDeviceMemoryProperties(
+        m_physicalDevice,       // physicalDevice
+        &m_memoryProperties);   // pMemoryProperties
+
+    {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        m_timestampValidBits = queueFamilies[m_queueFamilyIndex].timestampValidBits;
+        m_timestampPeriod = candidates[selected].properties.limits.timestampPeriod;
+    }
+
+    // highest supported sample count up to the configured one,
+    // the depth attachment has as many samples as color
+    {
+        const VkSampleCountFlags supportedCounts =
+            candidates[selected].properties.limits.framebufferColorSampleCounts
+            & candidates[selected].properties.limits.framebufferDepthSampleCounts;
+        m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
+        for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > 1; count >>= 1)
+        {
+            if (count <= mp_config->msaaSamples && (supportedCounts & count))
+            {
+                m_sampleCount = (VkSampleCountFlagBits)count;
+                break;
+            }
+        }
+        if (m_sampleCount != mp_config->msaaSamples)
+        {
+            std::cout << "msaa " << mp_config->msaaSamples << "x not supported, using "
+                << m_sampleCount << "x" << std::endl;
+        }
+    }
+
+    // optional query features
+    {
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
+        m_pipelineStatistics = mp_config->gpuStatistics && supportedFeatures.pipelineStatisticsQuery;
+        if (mp_config->gpuStatistics && !m_pipelineStatistics)
+        {
+            std::cout << "pipeline statistics queries not supported" << std::endl;
+        }
+        m_occlusionQueryPrecise = (supportedFeatures.occlusionQueryPrecise == VK_TRUE);
+
+        requiredDeviceFeatures.pipelineStatisticsQuery = m_pipelineStatistics ? VK_TRUE : VK_FALSE;
+        requiredDeviceFeatures.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise;
+    }
+
+    if (mp_config->printDeviceProperties)
+    {
+        const VkPhysicalDeviceProperties& physicalDeviceProperties = candidates[selected].properties;
 
         const uint32_t version = physicalDeviceProperties.apiVersion;
         const uint32_t drVersion = physicalDeviceProperties.driverVersion;
@@ -242,43 +858,136 @@ void GfxResources::createPhysicalDevice()
         std::cout << "deviceType:        " << physicalDeviceProperties.deviceType << std::endl;
         std::cout << "deviceName:        " << physicalDeviceProperties.deviceName << std::endl;
     }
-#endif
-
-    // not used atm
-    //VkPhysicalDeviceFeatures physicalDeviceFeatures;
-    //vkGetPhysicalDeviceFeatures(
-    //    m_physicalDevice,           // physicalDevice
-    //    &physicalDeviceFeatures);   // pFeatures
-    //VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
-    //vkGetPhysicalDeviceMemoryProperties(
-    //    m_physicalDevice,                   // physicalDevice
-    //    &physicalDeviceMemoryProperties);   // pMemoryProperties
 
-    uint32_t queueFamilyPropertyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(
-        m_physicalDevice,               // physicalDevice
-        &queueFamilyPropertyCount,      // pQueueFamilyPropertyCount
-        nullptr);                       // pQueueFamilyProperties
+    std::vector<const char*> extensions;
+    extensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
-    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyPropertyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(
-        m_physicalDevice,               // physicalDevice
-        &queueFamilyPropertyCount,      // pQueueFamilyPropertyCount
-        queueFamilyProperties.data());  // pQueueFamilyProperties
+    // heap budget and usage of the process, needs memory properties 2
+    const bool memoryBudgetExtension = m_instanceApiVersion >= VK_API_VERSION_1_1
+        && candidates[selected].properties.apiVersion >= VK_API_VERSION_1_1
+        && hasDeviceExtension(m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+        && vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceMemoryProperties2") != nullptr;
+    if (memoryBudgetExtension)
+    {
+        extensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
-    for (uint32_t idx = 0; idx < queueFamilyProperties.size(); ++idx)
+    // bindless resources need descriptor indexing, core in 1.2
+    // and an extension before, otherwise a small table is used
+    VkPhysicalDeviceDescriptorIndexingFeatures enabledIndexingFeatures = {};
+    enabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
     {
-        // just get the first with graphics queue
-        if (queueFamilyProperties[idx].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        const VkPhysicalDeviceLimits& limits = candidates[selected].properties.limits;
+        m_bindlessLimits.textureCount = std::min({ 64u,
+            limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages,
+            limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+        m_bindlessLimits.bufferCount = std::min({ 8u,
+            limits.maxPerStageDescriptorStorageBuffers, limits.maxDescriptorSetStorageBuffers });
+        m_bindlessLimits.updateAfterBind = false;
+
+        const uint32_t deviceApiVersion = candidates[selected].properties.apiVersion;
+        const bool hasIndexingExtension =
+            hasDeviceExtension(m_physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        const PFN_vkGetPhysicalDeviceFeatures2 fvkGetPhysicalDeviceFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)
+            vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceFeatures2");
+        const PFN_vkGetPhysicalDeviceProperties2 fvkGetPhysicalDeviceProperties2 = (PFN_vkGetPhysicalDeviceProperties2)
+            vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceProperties2");
+
+        if (mp_config->bindless
+            && m_instanceApiVersion >= VK_API_VERSION_1_1 && deviceApiVersion >= VK_API_VERSION_1_1
+            && (deviceApiVersion >= VK_API_VERSION_1_2 || hasIndexingExtension)
+            && fvkGetPhysicalDeviceFeatures2 && fvkGetPhysicalDeviceProperties2)
         {
-            m_queueFamilyIndex = idx;
-            break;
+            VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+            indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+            VkPhysicalDeviceFeatures2 features = {};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &indexingFeatures;
+            fvkGetPhysicalDeviceFeatures2(m_physicalDevice, &features);
+
+            VkPhysicalDeviceDescriptorIndexingProperties indexingProperties = {};
+            indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+            VkPhysicalDeviceProperties2 properties = {};
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties.pNext = &indexingProperties;
+            fvkGetPhysicalDeviceProperties2(m_physicalDevice, &properties);
+
+            if (indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+                && indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+                && indexingFeatures.descriptorBindingUpdateUnusedWhilePending
+                && indexingFeatures.descriptorBindingPartiallyBound)
+            {
+                enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+                enabledIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+                enabledIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+                enabledIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+                if (deviceApiVersion < VK_API_VERSION_1_2)
+                {
+                    extensions.emplace_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+                }
+
+                // both arrays are visible to the fragment shader
+                m_bindlessLimits.textureCount = std::min({ 4096u,
+                    indexingProperties.maxPerStageUpdateAfterBindResources / 2,
+                    indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                    indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                    indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                    indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+                m_bindlessLimits.bufferCount = std::min({ 1024u,
+                    indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                    indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                    indexingProperties.maxPerStageUpdateAfterBindResources / 2 });
+                m_bindlessLimits.updateAfterBind = true;
+            }
         }
+
+        std::cout << "bindless table: " << m_bindlessLimits.textureCount << " textures, "
+            << m_bindlessLimits.bufferCount << " buffers, "
+            << (m_bindlessLimits.updateAfterBind ? "update after bind" : "copy per frame")
+            << std::endl;
     }
-    assert(m_queueFamilyIndex != ~0u);
 
-    // we don't need anything fancy
-    VkPhysicalDeviceFeatures requiredDeviceFeatures = {};
+    // submits signal a timeline semaphore, core in 1.2 and
+    // an extension before, otherwise each signals a fence
+    VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimelineFeatures = {};
+    enabledTimelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    enabledTimelineFeatures.pNext = m_bindlessLimits.updateAfterBind ? &enabledIndexingFeatures : nullptr;
+    bool timelineSemaphore = false;
+    const bool timelineCore = m_instanceApiVersion >= VK_API_VERSION_1_2
+        && candidates[selected].properties.apiVersion >= VK_API_VERSION_1_2;
+    {
+        const bool hasTimelineExtension =
+            hasDeviceExtension(m_physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        const PFN_vkGetPhysicalDeviceFeatures2 fvkGetPhysicalDeviceFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)
+            vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceFeatures2");
+
+        if (mp_config->timelineSemaphore
+            && m_instanceApiVersion >= VK_API_VERSION_1_1
+            && candidates[selected].properties.apiVersion >= VK_API_VERSION_1_1
+            && (timelineCore || hasTimelineExtension)
+            && fvkGetPhysicalDeviceFeatures2)
+        {
+            VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+            timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+            VkPhysicalDeviceFeatures2 features = {};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &timelineFeatures;
+            fvkGetPhysicalDeviceFeatures2(m_physicalDevice, &features);
+
+            if (timelineFeatures.timelineSemaphore)
+            {
+                enabledTimelineFeatures.timelineSemaphore = VK_TRUE;
+                timelineSemaphore = true;
+                if (!timelineCore)
+                {
+                    extensions.emplace_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+                }
+            }
+        }
+
+        std::cout << "queue completion: "
+            << (timelineSemaphore ? "timeline semaphore" : "fences") << std::endl;
+    }
 
     constexpr float queuePriorities[] = { 0.0f };
     const VkDeviceQueueCreateInfo deviceQueueCreateInfo =
@@ -291,13 +1000,10 @@ void GfxResources::createPhysicalDevice()
         queuePriorities                             // pQueuePriorities
     };
 
-    std::vector<const char*> extensions;
-    extensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
-
     const VkDeviceCreateInfo deviceCreateInfo =
     {
         VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,   // sType
-        nullptr,                                // pNext
+        timelineSemaphore ? &enabledTimelineFeatures : enabledTimelineFeatures.pNext,   // pNext
         0,                                      // flags
         1,                                      // queueCreateInfoCount
         &deviceQueueCreateInfo,                 // pQueueCreateInfos
@@ -313,15 +1019,21 @@ void GfxResources::createPhysicalDevice()
         &deviceCreateInfo,  // pCreateInfo
         nullptr,            // pAllocator
         &m_device));        // pDevice
+
+    m_queueTimeline = std::unique_ptr<QueueTimeline>(
+        new QueueTimeline(m_device, timelineSemaphore, timelineCore));
+    m_deletionQueue = std::unique_ptr<DeletionQueue>(new DeletionQueue(m_device));
+    m_memoryBudget = std::unique_ptr<MemoryBudget>(new MemoryBudget(m_instance, m_physicalDevice,
+        m_memoryProperties, memoryBudgetExtension, mp_config->memoryBudgetWatermark));
 }
 
 void GfxResources::createSurface()
 {
-    const VkBool32 hasPresentationSupport = vkGetPhysicalDeviceWin32PresentationSupportKHR(
-        m_physicalDevice,       // physicalDevice
-        m_queueFamilyIndex);    // queueFamilyIndex
-    assert(hasPresentationSupport);
+    CORE_PROFILE_ZONE("GfxResources::createSurface");
+
+    assert(hasPresentationSupport(m_physicalDevice, m_queueFamilyIndex, mp_window));
 
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
     const VkWin32SurfaceCreateInfoKHR surfaceCreateInfo =
     {
         //VK_STRUCTURE_TYPE_DISPLAY_SURFACE_CREATE_INFO_KHR,
@@ -337,15 +1049,22 @@ void GfxResources::createSurface()
         &surfaceCreateInfo, // pCreateInfo
         nullptr,            // pAllocator
         &m_surface));       // pSurface
-}
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    const VkXcbSurfaceCreateInfoKHR surfaceCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR,  // sType
+        nullptr,                                        // pNext
+        0,                                              // flags
+        mp_window->getConnection(),                     // connection
+        mp_window->getXcbWindow()                       // window
+    };
 
-void GfxResources::createSwapchain()
-{
-    VkSurfaceCapabilitiesKHR surfaceCapabilities;
-    CHECK_VK_RESULT_SUCCESS(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
-        m_physicalDevice,       // physicalDevice
-        m_surface,              // surface
-        &surfaceCapabilities)); // pSurfaceCapabilities
+    CHECK_VK_RESULT_SUCCESS(vkCreateXcbSurfaceKHR(
+        m_instance,         // instance
+        &surfaceCreateInfo, // pCreateInfo
+        nullptr,            // pAllocator
+        &m_surface));       // pSurface
+#endif
 
     uint32_t surfaceFormatCount = 0;
     CHECK_VK_RESULT_SUCCESS(vkGetPhysicalDeviceSurfaceFormatsKHR(
@@ -362,9 +1081,70 @@ void GfxResources::createSwapchain()
         surfaceFormats.data()));// pSurfaceFormats
     assert(surfaceFormats.size() > 0);
 
-    // take the first format and color space
+    // take the first format and color space,
+    // picked here so the render pass does not need to wait for the swapchain
     m_swapChainImageformat = surfaceFormats[0].format;
-    const VkColorSpaceKHR colorSpace = surfaceFormats[0].colorSpace;
+    m_swapChainColorSpace = surfaceFormats[0].colorSpace;
+
+    // dynamic resolution needs gpu timestamps to drive the scale
+    // and blits between the offscreen target and the swapchain image
+    m_dynamicResolution = mp_config->dynamicResolution;
+    if (m_dynamicResolution)
+    {
+        VkSurfaceCapabilitiesKHR surfaceCapabilities;
+        CHECK_VK_RESULT_SUCCESS(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+            m_physicalDevice,       // physicalDevice
+            m_surface,              // surface
+            &surfaceCapabilities)); // pSurfaceCapabilities
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(
+            m_physicalDevice,       // physicalDevice
+            m_swapChainImageformat, // format
+            &formatProperties);     // pFormatProperties
+
+        constexpr VkFormatFeatureFlags requiredFeatures =
+            VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+            | VK_FORMAT_FEATURE_BLIT_SRC_BIT
+            | VK_FORMAT_FEATURE_BLIT_DST_BIT
+            | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+        if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures
+            || !(surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+            || m_timestampValidBits == 0)
+        {
+            std::cout << "dynamic resolution not supported, rendering at full resolution" << std::endl;
+            m_dynamicResolution = false;
+        }
+    }
+
+    // frames are copied out of the swapchain images
+    m_readback = mp_config->readback;
+    if (m_readback)
+    {
+        VkSurfaceCapabilitiesKHR surfaceCapabilities;
+        CHECK_VK_RESULT_SUCCESS(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+            m_physicalDevice,       // physicalDevice
+            m_surface,              // surface
+            &surfaceCapabilities)); // pSurfaceCapabilities
+
+        if (!(surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+        {
+            std::cout << "readback not supported by the surface" << std::endl;
+            m_readback = false;
+        }
+    }
+}
+
+void GfxResources::createSwapchain()
+{
+    CORE_PROFILE_ZONE("GfxResources::createSwapchain");
+
+    VkSurfaceCapabilitiesKHR surfaceCapabilities;
+    CHECK_VK_RESULT_SUCCESS(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+        m_physicalDevice,       // physicalDevice
+        m_surface,              // surface
+        &surfaceCapabilities)); // pSurfaceCapabilities
 
     uint32_t presentModeCount = 0;
     CHECK_VK_RESULT_SUCCESS(vkGetPhysicalDeviceSurfacePresentModesKHR(
@@ -381,8 +1161,30 @@ void GfxResources::createSwapchain()
         presentModes.data()));  // pPresentModes
     assert(presentModes.size() > 0);
 
-    // take the first present mode
-    const VkPresentModeKHR presentMode = presentModes[0];
+    // take the configured present mode if supported, otherwise the first one
+    VkPresentModeKHR presentMode = presentModes[0];
+    if (std::find(presentModes.begin(), presentModes.end(), mp_config->presentMode)
+        != presentModes.end())
+    {
+        presentMode = mp_config->presentMode;
+    }
+
+    // surface size decides the extent, unless it lets the swapchain decide
+    VkExtent2D extent = surfaceCapabilities.currentExtent;
+    if (extent.width == ~0u)
+    {
+        extent.width = std::min(std::max(mp_window->getWidth(),
+            surfaceCapabilities.minImageExtent.width), surfaceCapabilities.maxImageExtent.width);
+        extent.height = std::min(std::max(mp_window->getHeight(),
+            surfaceCapabilities.minImageExtent.height), surfaceCapabilities.maxImageExtent.height);
+    }
+    m_swapchainExtent = extent;
+
+    uint32_t minImageCount = std::max(mp_config->bufferingCount, surfaceCapabilities.minImageCount);
+    if (surfaceCapabilities.maxImageCount > 0)
+    {
+        minImageCount = std::min(minImageCount, surfaceCapabilities.maxImageCount);
+    }
 
     {
         VkBool32 surfaceSupported = VK_FALSE;
@@ -394,18 +1196,24 @@ void GfxResources::createSwapchain()
         assert(surfaceSupported == VK_TRUE);
     }
 
+    // with dynamic resolution the image is only a blit destination
+    const VkImageUsageFlags swapchainImageUsage = (m_dynamicResolution
+        ? VK_IMAGE_USAGE_TRANSFER_DST_BIT
+        : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
+        | (m_readback ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+
     const VkSwapchainCreateInfoKHR swapchainCreateInfo =
     {
         VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,            // sType
         nullptr,                                                // pNext
         0,                                                      // flags
         m_surface,                                              // surface
-        c_bufferingCount,                                       // minImageCount
+        minImageCount,                                          // minImageCount
         m_swapChainImageformat,                                 // imageFormat
-        colorSpace,                                             // imageColorSpace
-        VkExtent2D{ mp_window->getWidth(), mp_window->getHeight() },    // imageExtent
+        m_swapChainColorSpace,                                  // imageColorSpace
+        m_swapchainExtent,                                      // imageExtent
         1,                                                      // imageArrayLayers
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,                    // imageUsage
+        swapchainImageUsage,                                    // imageUsage
         VK_SHARING_MODE_EXCLUSIVE,                              // imageSharingMode
         1,                                                      // queueFamilyIndexCount
         &m_queueFamilyIndex,                                    // pQueueFamilyIndices
@@ -413,27 +1221,30 @@ void GfxResources::createSwapchain()
         VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,                      // compositeAlpha
         presentMode,                                            // presentMode
         VK_TRUE,                                                // clipped
-        nullptr,                                                // oldSwapchain
+        m_swapchain,                                            // oldSwapchain
     };
 
+    VkSwapchainKHR oldSwapchain = m_swapchain;
     CHECK_VK_RESULT_SUCCESS(vkCreateSwapchainKHR(
         m_device,               // device
         &swapchainCreateInfo,   // pCreateInfo
         nullptr,                // pAllocator
         &m_swapchain));         // pSwapchain
 
+    m_deletionQueue->destroy(oldSwapchain);
+
     CHECK_VK_RESULT_SUCCESS(vkGetSwapchainImagesKHR(
         m_device,                               // device
         m_swapchain,                            // swapchain
         &m_bufferedFrameResource.bufferCount,   // pSwapchainImageCount
         nullptr));                              // pSwapchainImages
 
-    m_bufferedFrameResource.images.resize(m_bufferedFrameResource.bufferCount);
+    std::vector<VkImage> images(m_bufferedFrameResource.bufferCount);
     CHECK_VK_RESULT_SUCCESS(vkGetSwapchainImagesKHR(
         m_device,                               // device
         m_swapchain,                            // swapchain
         &m_bufferedFrameResource.bufferCount,   // pSwapchainImageCount
-        m_bufferedFrameResource.images.data()));// pSwapchainImages
+        images.data()));                        // pSwapchainImages
 
     constexpr VkImageSubresourceRange imageSubresourceRange =
     {
@@ -451,121 +1262,221 @@ void GfxResources::createSwapchain()
         VK_COMPONENT_SWIZZLE_IDENTITY,  // a
     };
 
-    m_bufferedFrameResource.imageViews.resize(m_bufferedFrameResource.bufferCount);
-    for (uint32_t idx = 0; idx < m_bufferedFrameResource.imageViews.size(); ++idx)
+    m_bufferedFrameResource.images.clear();
+    for (VkImage image : images)
     {
         const VkImageViewCreateInfo imageViewCreateInfo =
         {
             VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,   // sType
             nullptr,                                    // pNext
             0,                                          // flags
-            m_bufferedFrameResource.images[idx],        // image
+            image,                                      // image
             VK_IMAGE_VIEW_TYPE_2D,                      // viewType
             m_swapChainImageformat,                     // format
             componentMapping,                           // components
             imageSubresourceRange                       // subresourceRange;
         };
+        VkImageView imageView = nullptr;
         CHECK_VK_RESULT_SUCCESS(vkCreateImageView(
-            m_device,                                   // device
-            &imageViewCreateInfo,                       // pCreateInfo
-            nullptr,                                    // pAllocator
-            &m_bufferedFrameResource.imageViews[idx])); // pView
+            m_device,               // device
+            &imageViewCreateInfo,   // pCreateInfo
+            nullptr,                // pAllocator
+            &imageView));           // pView
+
+        // owned by the swapchain, so no memory
+        m_bufferedFrameResource.images.push_back(m_imagePool.create(
+            image, imageView, nullptr, m_swapChainImageformat, m_swapchainExtent));
     }
 
-    // framebuffers are done later for imageviews
+    // framebuffers are done by the render graph for imageviews
 
 }
 
 void GfxResources::createRenderPass()
 {
-    const VkAttachmentDescription attachments[] =
-    {
-        {
-            0,                                  // flags
-            m_swapChainImageformat,             // format
-            VK_SAMPLE_COUNT_1_BIT,              // samples
-            VK_ATTACHMENT_LOAD_OP_CLEAR,        // loadOp
-            VK_ATTACHMENT_STORE_OP_STORE,       // storeOp
-            VK_ATTACHMENT_LOAD_OP_DONT_CARE,    // stencilLoadOp
-            VK_ATTACHMENT_STORE_OP_DONT_CARE,   // stencilStoreOp
-            VK_IMAGE_LAYOUT_UNDEFINED,          // initialLayout
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR     // finalLayout
-        }
-    };
+    CORE_PROFILE_ZONE("GfxResources::createRenderPass");
 
-    constexpr VkAttachmentReference attachmentReferences[] =
+    // the render graph transitions the attachments around the pass.
+    // Depth and, with msaa, the multisampled color are only used within
+    // the subpass, so they are never loaded or stored
+    const bool multisampled = (m_sampleCount != VK_SAMPLE_COUNT_1_BIT);
+
+    RenderPassBuilder builder;
+    const RenderPassBuilder::SubpassId subpass = builder.addSubpass();
+
+    RenderPassBuilder::AttachmentDesc colorDesc;
+    colorDesc.format = m_swapChainImageformat;
+    colorDesc.samples = m_sampleCount;
+    colorDesc.clear = true;
+    colorDesc.storeContents = !multisampled;
+    const RenderPassBuilder::AttachmentId color = builder.addAttachment(colorDesc);
+
+    RenderPassBuilder::AttachmentId resolve = RenderPassBuilder::c_noAttachment;
+    if (multisampled)
     {
-        {
-            0,                                          // attachment
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL    // layout
-        }
-    };
+        RenderPassBuilder::AttachmentDesc resolveDesc;
+        resolveDesc.format = m_swapChainImageformat;
+        resolveDesc.storeContents = true;
+        resolve = builder.addAttachment(resolveDesc);
+    }
+    builder.addColor(subpass, color, resolve);
+
+    RenderPassBuilder::AttachmentDesc depthDesc;
+    depthDesc.format = RenderPassBuilder::findDepthFormat(m_physicalDevice, false);
+    depthDesc.samples = m_sampleCount;
+    depthDesc.clear = true;
+    const RenderPassBuilder::AttachmentId depth = builder.addAttachment(depthDesc);
+    builder.setDepth(subpass, depth, true);
+
+    m_renderPass = builder.build(m_device);
+
+    m_mainPassAttachments.count = builder.getAttachmentCount();
+    m_mainPassAttachments.depthFormat = depthDesc.format;
+    m_mainPassAttachments.msaaColorUsage = multisampled ? builder.getImageUsage(color) : 0;
+    m_mainPassAttachments.depthUsage = builder.getImageUsage(depth);
+}
 
-    constexpr VkSubpassDescription subpassDescription =
+void GfxResources::reflectShader(const std::string& fileName, const std::vector<char>& code,
+    ShaderReflection& reflection)
+{
+    if (code.empty())
     {
-        0,                              // flags
-        VK_PIPELINE_BIND_POINT_GRAPHICS,// pipelineBindPoint
-        0,                              // inputAttachmentCount
-        nullptr,                        // pInputAttachments
-        1,                              // colorAttachmentCount
-        &attachmentReferences[0],       // pColorAttachments
-        nullptr,                        // pResolveAttachments
-        nullptr,                        // pDepthStencilAttachment
-        0,                              // preserveAttachmentCount
-        nullptr                         // pPreserveAttachments
-    };
+        // createShaderModule() reports it
+        return;
+    }
 
-    const VkRenderPassCreateInfo createInfo =
+    // next to the pipeline cache, stale when the code hash differs
+    const size_t separator = fileName.find_last_of("/\\");
+    const std::string cacheFileName = mp_config->cachePath + "/"
+        + fileName.substr((separator == std::string::npos) ? 0 : separator + 1) + ".reflection";
+    const uint64_t codeHash = ShaderReflection::hashCode(code);
+    if (ShaderReflection::deserialize(readFile(cacheFileName), codeHash, reflection))
     {
-        VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,  // sType
-        nullptr,                                    // pNext
-        0,                                          // flags
-        1,                                          // attachmentCount
-        &attachments[0],                            // pAttachments
-        1,                                          // subpassCount
-        &subpassDescription,                        // pSubpasses
-        0,                                          // dependencyCount
-        nullptr,                                    // pDependencies
-    };
+        return;
+    }
 
-    CHECK_VK_RESULT_SUCCESS(vkCreateRenderPass(
-        m_device,           // device
-        &createInfo,        // pCreateInfo
-        nullptr,            // pAllocator
-        &m_renderPass));    // pRenderPass
+    const std::string error = ShaderReflection::parse(code, reflection);
+    if (!error.empty())
+    {
+        throw std::runtime_error("Shader reflection failed for " + fileName + ": " + error);
+    }
+    writeFile(cacheFileName, reflection.serialize(codeHash));
 }
 
-void GfxResources::createFramebuffer()
+void GfxResources::createGraphicsPipeline()
 {
-    // create framebuffers for swapchain image views
-    m_bufferedFrameResource.framebuffers.resize(m_bufferedFrameResource.bufferCount);
-    for (uint32_t idx = 0; idx < m_bufferedFrameResource.framebuffers.size(); ++idx)
+    CORE_PROFILE_ZONE("GfxResources::createGraphicsPipeline");
+
+    m_shader.vert = createShaderModule(m_device, m_shaderCode.vert);
+    m_shader.frag = createShaderModule(m_device, m_shaderCode.frag);
+    m_shaderCode = ShaderCode();
+
+    m_layoutCache = std::unique_ptr<LayoutCache>(new LayoutCache(m_device));
+
+    const PipelineInterface pipelineInterface =
+        PipelineInterface::merge({ &m_reflection.vert, &m_reflection.frag });
+
+    // set 0 is the bindless table, the rest are generated
+    std::vector<VkDescriptorSetLayout> setLayouts(std::max(pipelineInterface.sets.size(), (size_t)1));
+    for (size_t idx = 0; idx < setLayouts.size(); ++idx)
     {
-        const VkFramebufferCreateInfo framebufferCreateInfo =
+        const std::vector<VkDescriptorSetLayoutBinding> bindings = (idx < pipelineInterface.sets.size())
+            ? pipelineInterface.sets[idx] : std::vector<VkDescriptorSetLayoutBinding>();
+        if (idx == 0)
         {
-            VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
-            nullptr,                                    // pNext
-            0,                                          // flags
-            m_renderPass,                               // renderPass
-            1,                                          // attachmentCount
-            &m_bufferedFrameResource.imageViews[idx],   // pAttachments
-            mp_window->getWidth(),                      // width
-            mp_window->getHeight(),                     // height
-            1,                                          // layers
-        };
+            if (!m_bindlessTable->isCompatible(bindings))
+            {
+                throw std::runtime_error("Shader set 0 bindings don't match the bindless table");
+            }
+            setLayouts[idx] = m_bindlessTable->getSetLayout();
+        }
+        else
+        {
+            setLayouts[idx] = m_layoutCache->getSetLayout(bindings);
+        }
+    }
 
-        CHECK_VK_RESULT_SUCCESS(vkCreateFramebuffer(
-            m_device,                                       // device
-            &framebufferCreateInfo,                         // pCreateInfo
-            nullptr,                                        // pAllocator
-            &m_bufferedFrameResource.framebuffers[idx]));   // pFramebuffer
+    // the renderer pushes all of PushConstants to both stages in one call,
+    // so the range covers that even if a stage declares less
+    const VkPushConstantRange& reflectedRange = pipelineInterface.pushConstantRange;
+    if (reflectedRange.offset + reflectedRange.size > sizeof(PushConstants))
+    {
+        throw std::runtime_error("Shader push constant blocks don't fit GfxResources::PushConstants");
     }
+    const VkPushConstantRange pushConstantRange =
+    {
+        reflectedRange.stageFlags
+            | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,    // stageFlags
+        0,                                                                  // offset
+        sizeof(PushConstants)                                               // size
+    };
+
+    m_pipelineLayout = m_layoutCache->getPipelineLayout(setLayouts, { pushConstantRange });
+
+    // the variant the first frame asks for, the window size
+    // is the likely first swapchain extent
+    ShaderVariantKey key;
+    key.resolution = { mp_window->getWidth(), mp_window->getHeight() };
+    key.gridSize = ShaderVariantKey::getGridSize(mp_config->instanceCount);
+    key.textured = !mp_config->texture.empty();
+    getGraphicsPipeline(key);
 }
 
-void GfxResources::createGraphicsPipeline()
+PipelineHandle GfxResources::createGraphicsPipelineVariant(const ShaderVariantKey& key)
 {
-    m_shader.vert = createShaderModule(m_device, c_vertexShader);
-    m_shader.frag = createShaderModule(m_device, c_fragmentShader);
+    CORE_PROFILE_ZONE("GfxResources::createGraphicsPipelineVariant");
+
+    // constant ids and layouts match triangle.vert and triangle.frag
+    struct VertexConstants
+    {
+        uint32_t gridSize;
+    };
+    struct FragmentConstants
+    {
+        uint32_t textureCount;
+        float resolutionX;
+        float resolutionY;
+        VkBool32 textured;
+    };
+
+    const VertexConstants vertexConstants =
+    {
+        std::max(key.gridSize, 1u),     // gridSize
+    };
+    const FragmentConstants fragmentConstants =
+    {
+        m_bindlessTable->getLimits().textureCount,      // textureCount
+        (float)std::max(key.resolution.width, 1u),      // resolutionX
+        (float)std::max(key.resolution.height, 1u),     // resolutionY
+        key.textured ? VK_TRUE : VK_FALSE,              // textured
+    };
+
+    const VkSpecializationMapEntry vertexMapEntries[] =
+    {
+        { 0, offsetof(VertexConstants, gridSize), sizeof(uint32_t) },
+    };
+    const VkSpecializationMapEntry fragmentMapEntries[] =
+    {
+        { 0, offsetof(FragmentConstants, textureCount), sizeof(uint32_t) },
+        { 1, offsetof(FragmentConstants, resolutionX), sizeof(float) },
+        { 2, offsetof(FragmentConstants, resolutionY), sizeof(float) },
+        { 3, offsetof(FragmentConstants, textured), sizeof(VkBool32) },
+    };
+
+    const VkSpecializationInfo vertexSpecializationInfo =
+    {
+        1,                          // mapEntryCount
+        vertexMapEntries,           // pMapEntries
+        sizeof(vertexConstants),    // dataSize
+        &vertexConstants            // pData
+    };
+    const VkSpecializationInfo fragmentSpecializationInfo =
+    {
+        4,                          // mapEntryCount
+        fragmentMapEntries,         // pMapEntries
+        sizeof(fragmentConstants),  // dataSize
+        &fragmentConstants          // pData
+    };
 
     const VkPipelineShaderStageCreateInfo shaderStageCreateInfo[] =
     {
@@ -576,7 +1487,7 @@ void GfxResources::createGraphicsPipeline()
             VK_SHADER_STAGE_VERTEX_BIT,                             // stage
             m_shader.vert,                                          // module
             "main",                                                 // pName
-            nullptr                                                 // pSpecializationInfo
+            &vertexSpecializationInfo                               // pSpecializationInfo
         },
         {
             VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,    // sType
@@ -585,19 +1496,24 @@ void GfxResources::createGraphicsPipeline()
             VK_SHADER_STAGE_FRAGMENT_BIT,                           // stage
             m_shader.frag,                                          // module
             "main",                                                 // pName
-            nullptr                                                 // pSpecializationInfo
+            &fragmentSpecializationInfo                             // pSpecializationInfo
         }
     };
 
-    constexpr VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo =
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+    PipelineInterface::getVertexInput(m_reflection.vert, MeshBatcher::getVertexAttributes(),
+        { (uint32_t)sizeof(MeshBatcher::PackedVertex) }, vertexBindings, vertexAttributes);
+
+    const VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo =
     {
         VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,  // sType
         nullptr,                                                    // pNext
         0,                                                          // flags
-        0,                                                          // vertexBindingDescriptionCount
-        nullptr,                                                    // pVertexBindingDescriptions
-        0,                                                          // vertexAttributeDescriptionCount
-        nullptr                                                     // pVertexAttributeDescriptions
+        (uint32_t)vertexBindings.size(),                            // vertexBindingDescriptionCount
+        vertexBindings.data(),                                      // pVertexBindingDescriptions
+        (uint32_t)vertexAttributes.size(),                          // vertexAttributeDescriptionCount
+        vertexAttributes.data()                                     // pVertexAttributeDescriptions
     };
 
     constexpr VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo =
@@ -609,34 +1525,31 @@ void GfxResources::createGraphicsPipeline()
         VK_FALSE                                                        // primitiveRestartEnable
     };
 
-    const uint32_t width = mp_window->getWidth();
-    const uint32_t height = mp_window->getHeight();
-
-    const VkViewport viewport =
+    // viewport and scissor are dynamic so the pipeline survives resizes
+    constexpr VkPipelineViewportStateCreateInfo viewportStateCreateInfo =
     {
-        0.0f,           // x
-        0.0f,           // y
-        (float)width,   // width
-        (float)height,  // height
-        0.0f,           // minDepth
-        1.0f,           // maxDepth
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,  // sType
+        nullptr,                                                // pNext
+        0,                                                      // flags
+        1,                                                      // viewportCount
+        nullptr,                                                // pViewports
+        1,                                                      // scissorCount
+        nullptr                                                 // pScissors
     };
 
-    const VkRect2D scissor =
+    constexpr VkDynamicState dynamicStates[] =
     {
-        { 0, 0 },           // offset
-        { width, height }   // extent
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
     };
 
-    const VkPipelineViewportStateCreateInfo viewportStateCreateInfo =
+    const VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo =
     {
-        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,  // sType
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,   // sType
         nullptr,                                                // pNext
         0,                                                      // flags
-        1,                                                      // viewportCount
-        &viewport,                                              // pViewports
-        1,                                                      // scissorCount
-        &scissor                                                // pScissors
+        2,                                                      // dynamicStateCount
+        dynamicStates                                           // pDynamicStates
     };
 
     constexpr VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo =
@@ -669,7 +1582,7 @@ void GfxResources::createGraphicsPipeline()
             | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,  // colorWriteMask
     };
 
-    constexpr VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo =
+    const VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo =
     {
         VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,   // sType
         nullptr,                                                    // pNext
@@ -681,12 +1594,12 @@ void GfxResources::createGraphicsPipeline()
         { 0.0f, 0.0f, 0.0f, 0.0f }                                  // blendConstants[4]
     };
 
-    constexpr VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo =
+    const VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo =
     {
         VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,   // sType
         nullptr,                                                    // pNext
         0,                                                          // flags
-        VK_SAMPLE_COUNT_1_BIT,                                      // rasterizationSamples
+        m_sampleCount,                                              // rasterizationSamples
         VK_FALSE,                                                   // sampleShadingEnable
         1.0f,                                                       // minSampleShading
         nullptr,                                                    // pSampleMask
@@ -694,23 +1607,23 @@ void GfxResources::createGraphicsPipeline()
         VK_FALSE,                                                   // alphaToOneEnable
     };
 
-    constexpr VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+    // nearer or equal passes, later draws of the same depth win
+    const VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo =
     {
-        VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,  // sType
-        nullptr,                                        // pNext
-        0,                                              // flags
-        0,                                              // setLayoutCount
-        nullptr,                                        // pSetLayouts
-        0,                                              // pushConstantRangeCount
-        nullptr                                         // pPushConstantRanges
+        VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO, // sType
+        nullptr,                                                    // pNext
+        0,                                                          // flags
+        VK_TRUE,                                                    // depthTestEnable
+        VK_TRUE,                                                    // depthWriteEnable
+        VK_COMPARE_OP_LESS_OR_EQUAL,                                // depthCompareOp
+        VK_FALSE,                                                   // depthBoundsTestEnable
+        VK_FALSE,                                                   // stencilTestEnable
+        {},                                                         // front
+        {},                                                         // back
+        0.0f,                                                       // minDepthBounds
+        1.0f                                                        // maxDepthBounds
     };
 
-    CHECK_VK_RESULT_SUCCESS(vkCreatePipelineLayout(
-        m_device,                       // device
-        &pipelineLayoutCreateInfo,      // pCreateInfo
-        nullptr,                        // pAllocator,
-        &m_pipelineLayout));            // pPipelineLayout
-
     const VkGraphicsPipelineCreateInfo pipelineCreateInfo =
     {
         VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,    // sType
@@ -724,9 +1637,9 @@ void GfxResources::createGraphicsPipeline()
         &viewportStateCreateInfo,       // pViewportState
         &rasterizationStateCreateInfo,  // pRasterizationState
         &multisampleStateCreateInfo,    // pMultisampleState
-        nullptr,                        // pDepthStencilState
+        &depthStencilStateCreateInfo,   // pDepthStencilState
         &colorBlendStateCreateInfo,     // pColorBlendState
-        nullptr,                        // pDynamicState
+        &dynamicStateCreateInfo,        // pDynamicState
         m_pipelineLayout,               // layout
         m_renderPass,                   // renderPass
         0,                              // subpass
@@ -734,17 +1647,31 @@ void GfxResources::createGraphicsPipeline()
         0                               // basePipelineIndex
     };
 
+    VkPipeline graphicsPipeline = nullptr;
     CHECK_VK_RESULT_SUCCESS(vkCreateGraphicsPipelines(
         m_device,               // device
-        nullptr,                // pipelineCache
+        m_pipelineCache,        // pipelineCache
         1,                      // createInfoCount
         &pipelineCreateInfo,    // pCreateInfos
         nullptr,                // pAllocator
-        &m_graphicsPipeline));  // pPipelines
+        &graphicsPipeline));    // pPipelines
+
+    return m_pipelinePool.create(
+        graphicsPipeline, m_pipelineLayout, VK_PIPELINE_BIND_POINT_GRAPHICS);
+}
+
+void GfxResources::createBindlessTable()
+{
+    CORE_PROFILE_ZONE("GfxResources::createBindlessTable");
+
+    m_bindlessTable = std::unique_ptr<BindlessTable>(new BindlessTable(
+        m_device, m_memoryProperties, m_bindlessLimits));
 }
 
 void GfxResources::createQueueAndPool()
 {
+    CORE_PROFILE_ZONE("GfxResources::createQueueAndPool");
+
     vkGetDeviceQueue(
         m_device,           // device
         m_queueFamilyIndex, // queueFamilyIndex
@@ -766,10 +1693,14 @@ void GfxResources::createQueueAndPool()
         nullptr,                // pAllocator
         &m_commandPool));       // pCommandPool
     assert(m_commandPool);
+}
+
+void GfxResources::createCommandBuffers()
+{
+    CORE_PROFILE_ZONE("GfxResources::createCommandBuffers");
 
-    // create command buffers and their fences
+    // completion is tracked by the queue timeline
     m_bufferedFrameResource.commandBuffers.resize(m_bufferedFrameResource.bufferCount);
-    m_bufferedFrameResource.commandBufferFences.resize(m_bufferedFrameResource.bufferCount);
 
     const VkCommandBufferAllocateInfo commandBufferAllocateInfo =
     {
@@ -785,26 +1716,30 @@ void GfxResources::createQueueAndPool()
         &commandBufferAllocateInfo,                     // pAllocateInfo
         m_bufferedFrameResource.commandBuffers.data()));// pCommandBuffers
 
-    // set as signaled, so we pass the vkWaitForFences() the first time
-    constexpr VkFenceCreateInfo fenceCreateInfo =
+    if (m_timestampValidBits > 0)
     {
-        VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,    // sType
-        nullptr,                                // pNext
-        VK_FENCE_CREATE_SIGNALED_BIT            // flags
-    };
+        const VkQueryPoolCreateInfo queryPoolCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,   // sType
+            nullptr,                                    // pNext
+            0,                                          // flags
+            VK_QUERY_TYPE_TIMESTAMP,                    // queryType
+            2 * m_bufferedFrameResource.bufferCount,    // queryCount
+            0                                           // pipelineStatistics
+        };
 
-    for (uint32_t idx = 0; idx < m_bufferedFrameResource.bufferCount; ++idx)
-    {
-        CHECK_VK_RESULT_SUCCESS(vkCreateFence(
+        CHECK_VK_RESULT_SUCCESS(vkCreateQueryPool(
             m_device,                                           // device
-            &fenceCreateInfo,                                   // pCreateInfo
+            &queryPoolCreateInfo,                               // pCreateInfo
             nullptr,                                            // pAllocator
-            &m_bufferedFrameResource.commandBufferFences[idx]));// pFence
+            &m_bufferedFrameResource.timestampQueryPool));      // pQueryPool
     }
 }
 
 void GfxResources::createSemaphores()
 {
+    CORE_PROFILE_ZONE("GfxResources::createSemaphores");
+
     constexpr VkSemaphoreCreateInfo semaphoreCreateInfo =
     {
         VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,    // sType
@@ -835,6 +1770,11 @@ VkDevice GfxResources::getDevice()
     return m_device;
 }
 
+VkPhysicalDevice GfxResources::getPhysicalDevice()
+{
+    return m_physicalDevice;
+}
+
 VkSwapchainKHR GfxResources::getSwapchain()
 {
     return m_swapchain;
@@ -845,9 +1785,70 @@ VkRenderPass GfxResources::getRenderPass()
     return m_renderPass;
 }
 
-VkPipeline GfxResources::getGraphicsPipeline()
+VkPipeline GfxResources::getGraphicsPipeline(const ShaderVariantKey& key)
 {
-    return m_graphicsPipeline;
+    auto iter = m_graphicsPipelines.find(key);
+    if (iter == m_graphicsPipelines.end())
+    {
+        iter = m_graphicsPipelines.emplace(key, createGraphicsPipelineVariant(key)).first;
+    }
+    return m_pipelinePool.get<PipelinePool::Pipeline>(iter->second);
+}
+
+bool GfxResources::ShaderVariantKey::operator<(const ShaderVariantKey& other) const
+{
+    return std::tie(resolution.width, resolution.height, gridSize, textured, copy)
+        < std::tie(other.resolution.width, other.resolution.height, other.gridSize, other.textured, other.copy);
+}
+
+uint32_t GfxResources::ShaderVariantKey::getGridSize(const uint32_t instanceCount)
+{
+    return (uint32_t)std::ceil(std::sqrt((double)std::max(instanceCount, 1u)));
+}
+
+VkPipelineLayout GfxResources::getPipelineLayout()
+{
+    return m_pipelineLayout;
+}
+
+BindlessTable& GfxResources::getBindlessTable()
+{
+    return *m_bindlessTable;
+}
+
+VkExtent2D GfxResources::getSwapchainExtent()
+{
+    return m_swapchainExtent;
+}
+
+QueueTimeline& GfxResources::getQueueTimeline()
+{
+    return *m_queueTimeline;
+}
+
+DeletionQueue& GfxResources::getDeletionQueue()
+{
+    return *m_deletionQueue;
+}
+
+ImagePool& GfxResources::getImagePool()
+{
+    return m_imagePool;
+}
+
+BufferPool& GfxResources::getBufferPool()
+{
+    return m_bufferPool;
+}
+
+PipelinePool& GfxResources::getPipelinePool()
+{
+    return m_pipelinePool;
+}
+
+SamplerPool& GfxResources::getSamplerPool()
+{
+    return m_samplerPool;
 }
 
 VkQueue GfxResources::getQueue()
@@ -855,6 +1856,61 @@ VkQueue GfxResources::getQueue()
     return m_queue;
 }
 
+VkSampleCountFlagBits GfxResources::getSampleCount() const
+{
+    return m_sampleCount;
+}
+
+const GfxResources::MainPassAttachments& GfxResources::getMainPassAttachments() const
+{
+    return m_mainPassAttachments;
+}
+
+VkFormat GfxResources::getSwapchainFormat() const
+{
+    return m_swapChainImageformat;
+}
+
+const VkPhysicalDeviceMemoryProperties& GfxResources::getMemoryProperties() const
+{
+    return m_memoryProperties;
+}
+
+MemoryBudget& GfxResources::getMemoryBudget()
+{
+    return *m_memoryBudget;
+}
+
+bool GfxResources::isDynamicResolutionEnabled() const
+{
+    return m_dynamicResolution;
+}
+
+bool GfxResources::isReadbackEnabled() const
+{
+    return m_readback;
+}
+
+bool GfxResources::isPipelineStatisticsEnabled() const
+{
+    return m_pipelineStatistics;
+}
+
+bool GfxResources::isOcclusionQueryPrecise() const
+{
+    return m_occlusionQueryPrecise;
+}
+
+float GfxResources::getTimestampPeriod() const
+{
+    return m_timestampPeriod;
+}
+
+uint64_t GfxResources::getTimestampMask() const
+{
+    return (m_timestampValidBits >= 64) ? ~0ull : ((1ull << m_timestampValidBits) - 1);
+}
+
 } // namespace
 
 ///////////////////////////////////////////////////////////////////////////////
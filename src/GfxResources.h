@@ -4,8 +4,17 @@
 // Copyright (c) 2017 Johannes Pystynen
 // This code is licensed under the MIT license (MIT)
 
+#include "BindlessTable.h"
+#include "DeletionQueue.h"
+#include "ErrorHandling.h"
+#include "GfxHandles.h"
+#include "LayoutCache.h"
+#include "MemoryBudget.h"
+#include "ShaderReflection.h"
+
 #include <assert.h>
 #include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 #include <memory>
@@ -19,15 +28,8 @@ static const uint32_t s_defaultTimeout = 1000000000; // 1 s
 namespace core
 {
 
-// Helper for checking the returned result from Vulkan functions
-#define CHECK_VK_RESULT_SUCCESS(check_vk_func) \
-{ \
-const VkResult result = (check_vk_func); \
-assert(result == VK_SUCCESS); \
-}
-
-///////////////////////////////////////////////////////////////////////////////
-
+class Config;
+class QueueTimeline;
 class Window;
 
 class GfxResources
@@ -40,14 +42,15 @@ public:
         // current index for buffered handles
         uint32_t bufferIndex = 0;
 
-        // Tries to create c_bufferingCount of vectors
+        // Tries to create Config::bufferingCount of vectors
         // and recycles them frame by frame
-        std::vector<VkImage> images;
-        std::vector<VkImageView> imageViews;
-        std::vector<VkFramebuffer> framebuffers;
+        // swapchain images in the image pool
+        std::vector<ImageHandle> images;
 
         std::vector<VkCommandBuffer> commandBuffers;
-        std::vector<VkFence> commandBufferFences;
+
+        // begin and end timestamp per buffered frame, nullptr if not supported
+        VkQueryPool timestampQueryPool = nullptr;
 
         // signaled when image is acquired
         VkSemaphore swapchainImageSemaphore;
@@ -55,25 +58,107 @@ public:
         VkSemaphore cmdBufferSubmitSemaphore;
     };
 
-    GfxResources(Window* const p_window);
+    // matches the push constant blocks in triangle.vert and triangle.frag
+    struct PushConstants
+    {
+        float angle = 0.0f;
+        // finest streamed in mip of the texture
+        float minLod = 0.0f;
+        // in the bindless texture array
+        uint32_t textureIndex = 0;
+        // rendered part of the variant's resolution, below 1 with
+        // dynamic resolution so the gradient still spans the image
+        float renderScaleX = 1.0f;
+        float renderScaleY = 1.0f;
+    };
+
+    // compile time parameters of the graphics pipeline, passed to the
+    // shaders as specialization constants so the driver can fold them
+    struct ShaderVariantKey
+    {
+        // gradient size in triangle.frag
+        VkExtent2D resolution   = { 1600, 900 };
+        // instances in a gridSize x gridSize grid in triangle.vert
+        uint32_t gridSize       = 1;
+        // without it triangle.frag does not sample the texture
+        bool textured           = true;
+        // separate pipeline objects with the same constants, for benchmarks
+        uint32_t copy           = 0;
+
+        bool operator<(const ShaderVariantKey& other) const;
+        // smallest grid that fits the instances
+        static uint32_t getGridSize(const uint32_t instanceCount);
+    };
+
+    GfxResources(Window* const p_window, const Config* const p_config);
     ~GfxResources();
 
     GfxResources(const GfxResources&) = delete;
     GfxResources& operator=(const GfxResources&) = delete;
 
     VkDevice getDevice();
+    VkPhysicalDevice getPhysicalDevice();
     VkSwapchainKHR getSwapchain();
+    VkExtent2D getSwapchainExtent();
+    VkFormat getSwapchainFormat() const;
+    // color samples of the render pass, resolved within the subpass
+    VkSampleCountFlagBits getSampleCount() const;
     VkRenderPass getRenderPass();
-    VkPipeline getGraphicsPipeline();
+    // framebuffer attachments of getRenderPass() in order: color,
+    // the resolve target with msaa, depth
+    struct MainPassAttachments
+    {
+        uint32_t count                  = 0;
+        VkFormat depthFormat            = VK_FORMAT_UNDEFINED;
+        // for the images the graph creates, transient ones
+        // are not loaded or stored by the render pass
+        VkImageUsageFlags msaaColorUsage = 0;
+        VkImageUsageFlags depthUsage    = 0;
+    };
+    const MainPassAttachments& getMainPassAttachments() const;
+    // specialized pipeline of the variant, created through the
+    // pipeline cache on first use
+    VkPipeline getGraphicsPipeline(const ShaderVariantKey& key);
+    VkPipelineLayout getPipelineLayout();
+    // set 0 of the pipeline layout
+    BindlessTable& getBindlessTable();
     VkQueue getQueue();
+    // completion of the submits to the queue
+    QueueTimeline& getQueueTimeline();
+    DeletionQueue& getDeletionQueue();
+
+    ImagePool& getImagePool();
+    BufferPool& getBufferPool();
+    PipelinePool& getPipelinePool();
+    SamplerPool& getSamplerPool();
+
+    // frees the pool slot now and the vulkan objects through the deletion queue
+    void releaseBuffer(const BufferHandle handle);
+    void releaseImage(const ImageHandle handle);
+    void releasePipeline(const PipelineHandle handle);
+    void releaseSampler(const SamplerHandle handle);
+    const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const;
+    // allocations are reported to it, released memory counts as freed
+    MemoryBudget& getMemoryBudget();
+
+    bool isDynamicResolutionEnabled() const;
+    // swapchain images can be copied from
+    bool isReadbackEnabled() const;
+    // pipeline statistics queries, if configured and supported
+    bool isPipelineStatisticsEnabled() const;
+    // occlusion queries can count samples instead of only zero or not
+    bool isOcclusionQueryPrecise() const;
+    // nanoseconds per timestamp tick
+    float getTimestampPeriod() const;
+    uint64_t getTimestampMask() const;
 
     BufferedFrameResource& getBufferedFrameResource();
 
-private:
+    // rebuilds the swapchain, its image views and command buffers,
+    // the old ones are released through the deletion queue
+    void recreateSwapchain();
 
-    const uint32_t c_bufferingCount = 3;
-    const char* c_vertexShader      = "shaders/triangle.vert.spv";
-    const char* c_fragmentShader    = "shaders/triangle.frag.spv";
+private:
 
     void create();
     void destroy();
@@ -83,31 +168,75 @@ private:
     void createSurface();
     void createSwapchain();
     void createRenderPass();
-    void createFramebuffer();
+    void createPipelineCache();
+    void createBindlessTable();
+    void reflectShader(const std::string& fileName, const std::vector<char>& code,
+        ShaderReflection& reflection);
     void createGraphicsPipeline();
+    PipelineHandle createGraphicsPipelineVariant(const ShaderVariantKey& key);
     void createQueueAndPool();
+    void createCommandBuffers();
     void createSemaphores();
 
-    Window* const mp_window = nullptr;
+    void savePipelineCache();
+    std::string getPipelineCacheFileName() const;
+
+    void destroySwapchainResources();
+    void releaseAll();
+    void destroyCommandBuffers();
+
+    Window* const mp_window         = nullptr;
+    const Config* const mp_config   = nullptr;
 
     BufferedFrameResource m_bufferedFrameResource;
 
     VkInstance m_instance               = nullptr;
     VkPhysicalDevice m_physicalDevice   = nullptr;
     VkDevice m_device                   = nullptr;
+    uint32_t m_instanceApiVersion       = VK_API_VERSION_1_0;
+
+    std::unique_ptr<QueueTimeline> m_queueTimeline;
+    std::unique_ptr<DeletionQueue> m_deletionQueue;
+
+    // decided in createPhysicalDevice() from device support
+    BindlessTable::Limits m_bindlessLimits;
+    std::unique_ptr<BindlessTable> m_bindlessTable;
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+    std::unique_ptr<MemoryBudget> m_memoryBudget;
+    float m_timestampPeriod             = 0.0f;
+    uint32_t m_timestampValidBits       = 0;
+    VkSampleCountFlagBits m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
+    bool m_pipelineStatistics           = false;
+    bool m_occlusionQueryPrecise        = false;
 
     VkSurfaceKHR m_surface      = nullptr;
     VkSwapchainKHR m_swapchain  = nullptr;
 
     VkFormat m_swapChainImageformat = VK_FORMAT_UNDEFINED;
+    VkColorSpaceKHR m_swapChainColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    VkExtent2D m_swapchainExtent = { 0, 0 };
+
+    BufferPool m_bufferPool;
+    ImagePool m_imagePool;
+    PipelinePool m_pipelinePool;
+    SamplerPool m_samplerPool;
+
+    // decided in createSurface() from config and format support
+    bool m_dynamicResolution = false;
+    bool m_readback          = false;
 
 #ifdef _DEBUG
     VkDebugReportCallbackEXT m_debugReportCallback = nullptr;
 #endif
 
     VkRenderPass m_renderPass           = nullptr;
-    VkPipeline m_graphicsPipeline       = nullptr;
+    MainPassAttachments m_mainPassAttachments;
+    std::map<ShaderVariantKey, PipelineHandle> m_graphicsPipelines;
+    std::unique_ptr<LayoutCache> m_layoutCache;
+    // owned by m_layoutCache
     VkPipelineLayout m_pipelineLayout   = nullptr;
+    VkPipelineCache m_pipelineCache     = nullptr;
 
     VkQueue m_queue             = nullptr;
     VkCommandPool m_commandPool = nullptr;
@@ -120,6 +249,25 @@ private:
     };
 
     Shader m_shader;
+
+    // file contents, released after use
+    struct ShaderCode
+    {
+        std::vector<char> vert;
+        std::vector<char> frag;
+    };
+
+    ShaderCode m_shaderCode;
+
+    // interface of the shader modules, from the code or the cache file
+    struct Reflection
+    {
+        ShaderReflection vert;
+        ShaderReflection frag;
+    };
+
+    Reflection m_reflection;
+    std::vector<char> m_pipelineCacheData;
 };
 
 } // namespace
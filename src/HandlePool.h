@@ -0,0 +1,205 @@
+#ifndef CORE_HANDLE_POOL_H
+#define CORE_HANDLE_POOL_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <assert.h>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// 32-bit typed handle, slot index in the low bits and the slot generation
+// in the high bits. A freed slot bumps its generation, so stale handles
+// are detected with one compare. Value 0 is never a valid handle.
+template <typename Tag>
+class Handle
+{
+public:
+    static const uint32_t c_indexBits       = 20;
+    static const uint32_t c_generationBits  = 32 - c_indexBits;
+    static const uint32_t c_indexMask       = (1u << c_indexBits) - 1;
+    static const uint32_t c_generationMask  = (1u << c_generationBits) - 1;
+
+    Handle() = default;
+
+    static Handle make(const uint32_t index, const uint32_t generation)
+    {
+        assert(index <= c_indexMask && generation <= c_generationMask && generation > 0);
+        Handle handle;
+        handle.m_value = (generation << c_indexBits) | index;
+        return handle;
+    }
+
+    uint32_t getIndex() const { return m_value & c_indexMask; }
+    uint32_t getGeneration() const { return m_value >> c_indexBits; }
+    uint32_t getValue() const { return m_value; }
+    bool isValid() const { return m_value != 0; }
+
+    bool operator==(const Handle& other) const { return m_value == other.m_value; }
+    bool operator!=(const Handle& other) const { return m_value != other.m_value; }
+
+private:
+    uint32_t m_value = 0;
+};
+
+// Pool of objects stored as one dense array per column (structure of
+// arrays). Live objects are packed at the front, destroy() moves the last
+// one into the hole, so iterating a column is a linear scan. Handles go
+// through a sparse slot table of generations and dense indices, freed
+// slots are recycled in FIFO order so generations wrap slowly.
+template <typename Tag, typename... Columns>
+class HandlePool
+{
+public:
+    typedef core::Handle<Tag> Handle;
+
+    HandlePool() = default;
+    ~HandlePool() = default;
+
+    HandlePool(const HandlePool&) = delete;
+    HandlePool& operator=(const HandlePool&) = delete;
+
+    Handle create(Columns... values)
+    {
+        uint32_t slotIndex = 0;
+        if (m_freeHead < m_freeSlots.size())
+        {
+            slotIndex = m_freeSlots[m_freeHead++];
+            // drop the consumed front once it is half of the queue, the
+            // copy is amortized and the queue does not grow under churn
+            if (m_freeHead * 2 >= m_freeSlots.size())
+            {
+                m_freeSlots.erase(m_freeSlots.begin(), m_freeSlots.begin() + m_freeHead);
+                m_freeHead = 0;
+            }
+        }
+        else
+        {
+            slotIndex = (uint32_t)m_slots.size();
+            assert(slotIndex <= Handle::c_indexMask);
+            m_slots.push_back(Slot());
+        }
+
+        Slot& slot = m_slots[slotIndex];
+        slot.denseIndex = (uint32_t)m_denseHandles.size();
+        const Handle handle = Handle::make(slotIndex, slot.generation);
+
+        m_denseHandles.push_back(handle);
+        pushColumns(std::index_sequence_for<Columns...>(), values...);
+
+        return handle;
+    }
+
+    void destroy(const Handle handle)
+    {
+        assert(isAlive(handle));
+
+        Slot& slot = m_slots[handle.getIndex()];
+        const uint32_t denseIndex = slot.denseIndex;
+        const uint32_t lastIndex = (uint32_t)m_denseHandles.size() - 1;
+
+        if (denseIndex != lastIndex)
+        {
+            const Handle moved = m_denseHandles[lastIndex];
+            m_denseHandles[denseIndex] = moved;
+            m_slots[moved.getIndex()].denseIndex = denseIndex;
+            moveColumns(std::index_sequence_for<Columns...>(), lastIndex, denseIndex);
+        }
+        m_denseHandles.pop_back();
+        popColumns(std::index_sequence_for<Columns...>());
+
+        // generation 0 is reserved for the invalid handle
+        slot.generation = (slot.generation == Handle::c_generationMask) ? 1 : slot.generation + 1;
+        slot.denseIndex = ~0u;
+        m_freeSlots.push_back(handle.getIndex());
+    }
+
+    bool isAlive(const Handle handle) const
+    {
+        return handle.isValid()
+            && handle.getIndex() < m_slots.size()
+            && m_slots[handle.getIndex()].generation == handle.getGeneration()
+            && m_slots[handle.getIndex()].denseIndex != ~0u;
+    }
+
+    template <size_t Column>
+    typename std::tuple_element<Column, std::tuple<Columns...>>::type& get(const Handle handle)
+    {
+        assert(isAlive(handle));
+        return std::get<Column>(m_columns)[m_slots[handle.getIndex()].denseIndex];
+    }
+
+    template <size_t Column>
+    const typename std::tuple_element<Column, std::tuple<Columns...>>::type& get(const Handle handle) const
+    {
+        assert(isAlive(handle));
+        return std::get<Column>(m_columns)[m_slots[handle.getIndex()].denseIndex];
+    }
+
+    // dense column for linear scans, index i belongs to getHandle(i)
+    template <size_t Column>
+    const std::vector<typename std::tuple_element<Column, std::tuple<Columns...>>::type>& getColumn() const
+    {
+        return std::get<Column>(m_columns);
+    }
+
+    Handle getHandle(const size_t denseIndex) const
+    {
+        assert(denseIndex < m_denseHandles.size());
+        return m_denseHandles[denseIndex];
+    }
+
+    size_t size() const
+    {
+        return m_denseHandles.size();
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t generation = 1;
+        uint32_t denseIndex = ~0u;
+    };
+
+    template <size_t... Is>
+    void pushColumns(std::index_sequence<Is...>, Columns... values)
+    {
+        const int expand[] = { 0, (std::get<Is>(m_columns).push_back(std::move(values)), 0)... };
+        (void)expand;
+    }
+
+    template <size_t... Is>
+    void moveColumns(std::index_sequence<Is...>, const uint32_t from, const uint32_t to)
+    {
+        const int expand[] = { 0, (std::get<Is>(m_columns)[to] = std::move(std::get<Is>(m_columns)[from]), 0)... };
+        (void)expand;
+    }
+
+    template <size_t... Is>
+    void popColumns(std::index_sequence<Is...>)
+    {
+        const int expand[] = { 0, (std::get<Is>(m_columns).pop_back(), 0)... };
+        (void)expand;
+    }
+
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    size_t m_freeHead = 0;
+
+    std::vector<Handle> m_denseHandles;
+    std::tuple<std::vector<Columns>...> m_columns;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_HANDLE_POOL_H
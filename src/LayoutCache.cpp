@@ -0,0 +1,143 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "LayoutCache.h"
+
+#include "ErrorHandling.h"
+
+#include <algorithm>
+#include <assert.h>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+LayoutCache::LayoutCache(VkDevice device)
+    : m_device(device)
+{
+    assert(m_device);
+}
+
+LayoutCache::~LayoutCache()
+{
+    for (const auto& ref : m_pipelineLayouts)
+    {
+        vkDestroyPipelineLayout(m_device, ref.second, nullptr);
+    }
+    for (const auto& ref : m_setLayouts)
+    {
+        vkDestroyDescriptorSetLayout(m_device, ref.second, nullptr);
+    }
+}
+
+VkDescriptorSetLayout LayoutCache::getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    // binding order does not change the layout
+    std::vector<VkDescriptorSetLayoutBinding> sorted = bindings;
+    std::sort(sorted.begin(), sorted.end(),
+        [](const VkDescriptorSetLayoutBinding& lhs, const VkDescriptorSetLayoutBinding& rhs)
+        { return lhs.binding < rhs.binding; });
+
+    std::vector<uint64_t> key;
+    key.reserve(sorted.size() * 4);
+    for (const VkDescriptorSetLayoutBinding& binding : sorted)
+    {
+        assert(!binding.pImmutableSamplers);
+        key.push_back(binding.binding);
+        key.push_back((uint64_t)binding.descriptorType);
+        key.push_back(binding.descriptorCount);
+        key.push_back(binding.stageFlags);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto iter = m_setLayouts.find(key);
+    if (iter != m_setLayouts.end())
+    {
+        return iter->second;
+    }
+
+    const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,    // sType
+        nullptr,                                                // pNext
+        0,                                                      // flags
+        (uint32_t)sorted.size(),                                // bindingCount
+        sorted.data()                                           // pBindings
+    };
+
+    VkDescriptorSetLayout setLayout = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkCreateDescriptorSetLayout(
+        m_device,                       // device
+        &descriptorSetLayoutCreateInfo, // pCreateInfo
+        nullptr,                        // pAllocator
+        &setLayout));                   // pSetLayout
+
+    m_setLayouts.emplace(key, setLayout);
+    return setLayout;
+}
+
+VkPipelineLayout LayoutCache::getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+    const std::vector<VkPushConstantRange>& pushConstantRanges)
+{
+    // set layouts are unique per content, so their handles identify them
+    std::vector<uint64_t> key;
+    key.reserve(1 + setLayouts.size() + pushConstantRanges.size() * 3);
+    key.push_back(setLayouts.size());
+    for (const VkDescriptorSetLayout setLayout : setLayouts)
+    {
+        key.push_back((uint64_t)setLayout);
+    }
+    for (const VkPushConstantRange& range : pushConstantRanges)
+    {
+        key.push_back(range.stageFlags);
+        key.push_back(range.offset);
+        key.push_back(range.size);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto iter = m_pipelineLayouts.find(key);
+    if (iter != m_pipelineLayouts.end())
+    {
+        return iter->second;
+    }
+
+    const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,  // sType
+        nullptr,                                        // pNext
+        0,                                              // flags
+        (uint32_t)setLayouts.size(),                    // setLayoutCount
+        setLayouts.data(),                              // pSetLayouts
+        (uint32_t)pushConstantRanges.size(),            // pushConstantRangeCount
+        pushConstantRanges.data()                       // pPushConstantRanges
+    };
+
+    VkPipelineLayout pipelineLayout = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkCreatePipelineLayout(
+        m_device,                       // device
+        &pipelineLayoutCreateInfo,      // pCreateInfo
+        nullptr,                        // pAllocator,
+        &pipelineLayout));              // pPipelineLayout
+
+    m_pipelineLayouts.emplace(key, pipelineLayout);
+    return pipelineLayout;
+}
+
+uint32_t LayoutCache::getSetLayoutCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_setLayouts.size();
+}
+
+uint32_t LayoutCache::getPipelineLayoutCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_pipelineLayouts.size();
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
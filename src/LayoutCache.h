@@ -0,0 +1,53 @@
+#ifndef CORE_LAYOUT_CACHE_H
+#define CORE_LAYOUT_CACHE_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Descriptor set and pipeline layouts keyed by content, so pipelines
+// whose shaders declare the same interface share the layout objects and
+// stay compatible for descriptor set binding. Layouts are owned by the
+// cache and live until it is destroyed.
+class LayoutCache
+{
+public:
+    explicit LayoutCache(VkDevice device);
+    // the device must be idle
+    ~LayoutCache();
+
+    LayoutCache(const LayoutCache&) = delete;
+    LayoutCache& operator=(const LayoutCache&) = delete;
+
+    // immutable samplers are not supported
+    VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+    VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+        const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+    uint32_t getSetLayoutCount() const;
+    uint32_t getPipelineLayoutCount() const;
+
+private:
+    VkDevice m_device = nullptr;
+
+    mutable std::mutex m_mutex;
+    std::map<std::vector<uint64_t>, VkDescriptorSetLayout> m_setLayouts;
+    std::map<std::vector<uint64_t>, VkPipelineLayout> m_pipelineLayouts;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_LAYOUT_CACHE_H
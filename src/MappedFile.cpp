@@ -0,0 +1,146 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& fileName)
+{
+    close();
+
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    mp_file = file;
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        close();
+        return false;
+    }
+    mp_mapping = mapping;
+
+    mp_data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mp_data)
+    {
+        close();
+        return false;
+    }
+    m_size = (size_t)size.QuadPart;
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mp_data)
+    {
+        UnmapViewOfFile(mp_data);
+    }
+    if (mp_mapping)
+    {
+        CloseHandle(mp_mapping);
+    }
+    if (mp_file)
+    {
+        CloseHandle(mp_file);
+    }
+    mp_file = nullptr;
+    mp_mapping = nullptr;
+    mp_data = nullptr;
+    m_size = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& fileName)
+{
+    close();
+
+    m_fd = ::open(fileName.c_str(), O_RDONLY);
+    if (m_fd < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat = {};
+    if (fstat(m_fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    mp_data = (const uint8_t*)data;
+    m_size = (size_t)fileStat.st_size;
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mp_data)
+    {
+        munmap((void*)mp_data, m_size);
+    }
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+    mp_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+const uint8_t* MappedFile::getData() const
+{
+    return mp_data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return m_size;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,49 @@
+#ifndef CORE_MAPPED_FILE_H
+#define CORE_MAPPED_FILE_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Read-only memory mapping of a whole file. Pages are read in by the
+// OS when first touched, so only the parts that are used cost IO.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // returns false if the file can't be opened or is empty
+    bool open(const std::string& fileName);
+    void close();
+
+    const uint8_t* getData() const;
+    size_t getSize() const;
+
+private:
+#ifdef _WIN32
+    void* mp_file       = nullptr;
+    void* mp_mapping    = nullptr;
+#else
+    int m_fd            = -1;
+#endif
+    const uint8_t* mp_data  = nullptr;
+    size_t m_size           = 0;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_MAPPED_FILE_H
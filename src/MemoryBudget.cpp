@@ -0,0 +1,313 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <iomanip>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// budget without VK_EXT_memory_budget, other processes need memory too
+static const uint32_t s_fallbackBudgetPercent = 80;
+// evicted resources come back only this far below the watermark,
+// so they are not evicted again right away
+static const uint32_t s_restoreMarginPercent = 5;
+
+static const char* const s_categoryNames[] =
+{
+    "geometry",
+    "textures",
+    "render targets",
+    "staging",
+};
+static_assert(sizeof(s_categoryNames) / sizeof(s_categoryNames[0]) == (size_t)MemoryBudget::Category::Count,
+    "category names");
+
+MemoryBudget::MemoryBudget(VkInstance instance, VkPhysicalDevice physicalDevice,
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    const bool budgetExtension, const uint32_t watermarkPercent)
+    : m_physicalDevice(physicalDevice),
+    m_watermarkPercent(std::min(std::max(watermarkPercent, 10u), 100u)),
+    m_memoryProperties(memoryProperties)
+{
+    if (budgetExtension)
+    {
+        mp_getMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2)
+            vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2");
+    }
+
+    m_heaps.resize(m_memoryProperties.memoryHeapCount);
+    for (uint32_t idx = 0; idx < m_memoryProperties.memoryHeapCount; ++idx)
+    {
+        m_heaps[idx].size = m_memoryProperties.memoryHeaps[idx].size;
+        m_heaps[idx].deviceLocal =
+            (m_memoryProperties.memoryHeaps[idx].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    queryHeaps();
+}
+
+void MemoryBudget::onAllocate(VkDeviceMemory memory, const uint32_t memoryTypeIndex,
+    const VkDeviceSize size, const Category category)
+{
+    assert(memory);
+    assert(memoryTypeIndex < m_memoryProperties.memoryTypeCount);
+
+    Allocation allocation;
+    allocation.heap = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    allocation.size = size;
+    allocation.category = category;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_allocations[memory] = allocation;
+    m_heaps[allocation.heap].allocated[(uint32_t)category] += size;
+}
+
+void MemoryBudget::onFree(VkDeviceMemory memory)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto iter = m_allocations.find(memory);
+    if (iter == m_allocations.end())
+    {
+        return;
+    }
+
+    const Allocation& allocation = iter->second;
+    VkDeviceSize& allocated = m_heaps[allocation.heap].allocated[(uint32_t)allocation.category];
+    allocated -= std::min(allocated, allocation.size);
+    m_allocations.erase(iter);
+}
+
+MemoryBudget::EvictableId MemoryBudget::addEvictable(VkDeviceMemory memory, std::function<void()> evict)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto iter = m_allocations.find(memory);
+    if (iter == m_allocations.end())
+    {
+        assert(false && "evictable memory is not tracked");
+        return c_invalidEvictable;
+    }
+
+    Evictable evictable;
+    evictable.memory = memory;
+    evictable.heap = iter->second.heap;
+    evictable.size = iter->second.size;
+    evictable.evict = std::move(evict);
+
+    if (!m_freeEvictables.empty())
+    {
+        const EvictableId id = m_freeEvictables.back();
+        m_freeEvictables.pop_back();
+        m_evictables[id] = std::move(evictable);
+        return id;
+    }
+    m_evictables.push_back(std::move(evictable));
+    return (EvictableId)(m_evictables.size() - 1);
+}
+
+void MemoryBudget::removeEvictable(const EvictableId id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id < m_evictables.size() && m_evictables[id].memory)
+    {
+        m_evictables[id] = Evictable();
+        m_freeEvictables.push_back(id);
+    }
+}
+
+void MemoryBudget::touch(const EvictableId id, const uint64_t frame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id < m_evictables.size())
+    {
+        m_evictables[id].lastUsedFrame = std::max(m_evictables[id].lastUsedFrame, frame);
+    }
+}
+
+void MemoryBudget::update(const uint64_t recordingFrame, const uint64_t completedFrame)
+{
+    // called without the lock, they release memory
+    std::vector<std::function<void()>> evictions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        queryHeaps();
+
+        m_pendingEvictions.erase(std::remove_if(m_pendingEvictions.begin(), m_pendingEvictions.end(),
+            [completedFrame](const PendingEviction& pending) { return pending.frame <= completedFrame; }),
+            m_pendingEvictions.end());
+
+        std::vector<EvictableId> candidates;
+        for (uint32_t heap = 0; heap < (uint32_t)m_heaps.size(); ++heap)
+        {
+            VkDeviceSize usage = getProjectedUsage(heap);
+            const VkDeviceSize watermark = getWatermark(heap);
+            if (usage <= watermark)
+            {
+                continue;
+            }
+
+            candidates.clear();
+            for (EvictableId id = 0; id < (EvictableId)m_evictables.size(); ++id)
+            {
+                const Evictable& evictable = m_evictables[id];
+                if (evictable.memory && evictable.heap == heap)
+                {
+                    candidates.push_back(id);
+                }
+            }
+            // least recently used first, larger first among equals
+            std::sort(candidates.begin(), candidates.end(), [this](const EvictableId lhs, const EvictableId rhs)
+            {
+                const Evictable& left = m_evictables[lhs];
+                const Evictable& right = m_evictables[rhs];
+                return (left.lastUsedFrame != right.lastUsedFrame)
+                    ? (left.lastUsedFrame < right.lastUsedFrame)
+                    : (left.size > right.size);
+            });
+
+            for (const EvictableId id : candidates)
+            {
+                if (usage <= watermark)
+                {
+                    break;
+                }
+                Evictable& evictable = m_evictables[id];
+                usage -= std::min(usage, evictable.size);
+
+                PendingEviction pending;
+                pending.heap = heap;
+                pending.size = evictable.size;
+                pending.frame = recordingFrame;
+                m_pendingEvictions.push_back(pending);
+
+                evictions.push_back(std::move(evictable.evict));
+                evictable = Evictable();
+                m_freeEvictables.push_back(id);
+                ++m_evictionCount;
+            }
+        }
+    }
+
+    for (const std::function<void()>& evict : evictions)
+    {
+        evict();
+    }
+}
+
+bool MemoryBudget::hasHeadroom(const uint32_t memoryTypeIndex, const VkDeviceSize size) const
+{
+    assert(memoryTypeIndex < m_memoryProperties.memoryTypeCount);
+    const uint32_t heap = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const VkDeviceSize margin = m_heaps[heap].budget / 100 * s_restoreMarginPercent;
+    const VkDeviceSize watermark = getWatermark(heap);
+    return getProjectedUsage(heap) + size + margin <= watermark;
+}
+
+bool MemoryBudget::isBudgetExtensionEnabled() const
+{
+    return mp_getMemoryProperties2 != nullptr;
+}
+
+std::vector<MemoryBudget::Heap> MemoryBudget::getHeaps() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_heaps;
+}
+
+uint64_t MemoryBudget::getEvictionCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_evictionCount;
+}
+
+void MemoryBudget::print(std::ostream& out) const
+{
+    const std::vector<Heap> heaps = getHeaps();
+    const double mb = 1.0 / (1024.0 * 1024.0);
+
+    out << std::fixed << std::setprecision(1);
+    for (uint32_t idx = 0; idx < (uint32_t)heaps.size(); ++idx)
+    {
+        const Heap& heap = heaps[idx];
+        out << "memory heap " << idx << (heap.deviceLocal ? " (device local)" : "")
+            << ": " << heap.usage * mb << " / " << heap.budget * mb << " MB";
+        for (uint32_t category = 0; category < (uint32_t)Category::Count; ++category)
+        {
+            if (heap.allocated[category] > 0)
+            {
+                out << ", " << s_categoryNames[category] << " " << heap.allocated[category] * mb << " MB";
+            }
+        }
+        out << std::endl;
+    }
+    out << "memory evictions: " << getEvictionCount()
+        << (isBudgetExtensionEnabled() ? "" : " (no VK_EXT_memory_budget)") << std::endl;
+    out << std::defaultfloat;
+}
+
+void MemoryBudget::queryHeaps()
+{
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+    if (mp_getMemoryProperties2)
+    {
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 memoryProperties = {};
+        memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memoryProperties.pNext = &budgetProperties;
+        mp_getMemoryProperties2(m_physicalDevice, &memoryProperties);
+    }
+
+    for (uint32_t idx = 0; idx < (uint32_t)m_heaps.size(); ++idx)
+    {
+        Heap& heap = m_heaps[idx];
+        if (mp_getMemoryProperties2)
+        {
+            heap.budget = budgetProperties.heapBudget[idx];
+            heap.usage = budgetProperties.heapUsage[idx];
+        }
+        else
+        {
+            heap.budget = heap.size / 100 * s_fallbackBudgetPercent;
+            heap.usage = 0;
+            for (const VkDeviceSize allocated : heap.allocated)
+            {
+                heap.usage += allocated;
+            }
+        }
+    }
+}
+
+VkDeviceSize MemoryBudget::getProjectedUsage(const uint32_t heap) const
+{
+    // tracked allocations drop when released, the driver's
+    // usage only when the deletion queue frees them
+    VkDeviceSize usage = m_heaps[heap].usage;
+    if (mp_getMemoryProperties2)
+    {
+        for (const PendingEviction& pending : m_pendingEvictions)
+        {
+            if (pending.heap == heap)
+            {
+                usage -= std::min(usage, pending.size);
+            }
+        }
+    }
+    return usage;
+}
+
+VkDeviceSize MemoryBudget::getWatermark(const uint32_t heap) const
+{
+    return m_heaps[heap].budget / 100 * m_watermarkPercent;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,144 @@
+#ifndef CORE_MEMORY_BUDGET_H
+#define CORE_MEMORY_BUDGET_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Device memory use per heap. Our allocations are tracked per category by
+// their VkDeviceMemory handle. Heap budget and the usage of the whole
+// process come from VK_EXT_memory_budget when the device has it,
+// otherwise the budget is a share of the heap size and the usage is what
+// we track. Resources that can be recreated later, like streamed
+// textures, register as evictable; past the watermark the least recently
+// used of them are evicted, so the heap stays below the budget instead
+// of allocations failing with VK_ERROR_OUT_OF_DEVICE_MEMORY.
+class MemoryBudget
+{
+public:
+    typedef uint32_t EvictableId;
+
+    static const EvictableId c_invalidEvictable = ~0u;
+
+    enum class Category : uint32_t
+    {
+        Geometry,
+        Textures,
+        RenderTargets,
+        Staging,
+        Count,
+    };
+
+    struct Heap
+    {
+        VkDeviceSize size   = 0;
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage  = 0;
+        // ours, per category
+        VkDeviceSize allocated[(uint32_t)Category::Count] = {};
+        bool deviceLocal    = false;
+    };
+
+    // budgetExtension: VK_EXT_memory_budget is enabled on the device,
+    // watermarkPercent: of the budget, eviction starts past it
+    MemoryBudget(VkInstance instance, VkPhysicalDevice physicalDevice,
+        const VkPhysicalDeviceMemoryProperties& memoryProperties,
+        const bool budgetExtension, const uint32_t watermarkPercent);
+    ~MemoryBudget() = default;
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    // thread safe, frees of unknown memory are ignored
+    void onAllocate(VkDeviceMemory memory, const uint32_t memoryTypeIndex,
+        const VkDeviceSize size, const Category category);
+    void onFree(VkDeviceMemory memory);
+
+    // the memory must be tracked. evict is called from update() after the
+    // id is removed, and releases the resource through the deletion queue
+    EvictableId addEvictable(VkDeviceMemory memory, std::function<void()> evict);
+    void removeEvictable(const EvictableId id);
+    // the resource is used by the frame being recorded
+    void touch(const EvictableId id, const uint64_t frame);
+
+    // once per frame before recording: reads the heap usage and evicts the
+    // least recently used resources while a heap is past the watermark.
+    // Plain LRU, resources drawn in recent frames sort last and are
+    // evicted only when nothing older is left
+    void update(const uint64_t recordingFrame, const uint64_t completedFrame);
+
+    // an allocation of size would leave the heap of the memory type
+    // with room below the watermark, for bringing evicted resources back
+    bool hasHeadroom(const uint32_t memoryTypeIndex, const VkDeviceSize size) const;
+
+    bool isBudgetExtensionEnabled() const;
+    // as of the last update()
+    std::vector<Heap> getHeaps() const;
+    uint64_t getEvictionCount() const;
+
+    void print(std::ostream& out) const;
+
+private:
+    struct Allocation
+    {
+        uint32_t heap       = 0;
+        VkDeviceSize size   = 0;
+        Category category   = Category::Geometry;
+    };
+
+    struct Evictable
+    {
+        VkDeviceMemory memory   = nullptr;
+        uint32_t heap           = 0;
+        VkDeviceSize size       = 0;
+        uint64_t lastUsedFrame  = 0;
+        std::function<void()> evict;
+    };
+
+    // evicted but not freed by the deletion queue yet
+    struct PendingEviction
+    {
+        uint32_t heap       = 0;
+        VkDeviceSize size   = 0;
+        uint64_t frame      = 0;
+    };
+
+    void queryHeaps();
+    // usage with pending evictions taken out
+    VkDeviceSize getProjectedUsage(const uint32_t heap) const;
+    VkDeviceSize getWatermark(const uint32_t heap) const;
+
+    VkPhysicalDevice m_physicalDevice = nullptr;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 mp_getMemoryProperties2 = nullptr;
+    const uint32_t m_watermarkPercent = 90;
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+    mutable std::mutex m_mutex;
+    std::vector<Heap> m_heaps;
+    std::unordered_map<VkDeviceMemory, Allocation> m_allocations;
+
+    std::vector<Evictable> m_evictables;
+    std::vector<EvictableId> m_freeEvictables;
+    std::vector<PendingEviction> m_pendingEvictions;
+    uint64_t m_evictionCount = 0;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_MEMORY_BUDGET_H
@@ -0,0 +1,592 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "MeshBatcher.h"
+
+#include "ErrorHandling.h"
+#include "GfxResources.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+static_assert(sizeof(MeshBatcher::PackedVertex) == 20, "vertex layout is tightly packed");
+
+// modeled post-transform cache, about what current gpus reuse
+static const uint32_t s_vertexCacheSize = 32;
+
+static uint32_t findMemoryTypeIndex(
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    const uint32_t memoryTypeBits,
+    const VkMemoryPropertyFlags propertyFlags)
+{
+    for (uint32_t idx = 0; idx < memoryProperties.memoryTypeCount; ++idx)
+    {
+        if ((memoryTypeBits & (1u << idx))
+            && (memoryProperties.memoryTypes[idx].propertyFlags & propertyFlags) == propertyFlags)
+        {
+            return idx;
+        }
+    }
+    return ~0u;
+}
+
+// round to nearest, overflow to infinity, small values to subnormals
+static uint16_t toHalf(const float value)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t floatExponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (floatExponent == 0xff)
+    {
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+
+    const int32_t exponent = (int32_t)floatExponent - 127 + 15;
+    if (exponent >= 31)
+    {
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000;
+        const uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+        {
+            ++half;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    // a rounding carry moves into the exponent, which is still correct
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000)
+    {
+        ++half;
+    }
+    return (uint16_t)half;
+}
+
+static int8_t toSnorm8(const float value)
+{
+    return (int8_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 127.0f);
+}
+
+// Forsyth's scoring: vertices recently in the cache and vertices with few
+// triangles left score high, the best triangle around the cache goes next
+static float getVertexScore(const int32_t cachePosition, const uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0)
+    {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // the last triangle's vertices get a fixed score so the
+        // next one does not simply reuse the same edge
+        if (cachePosition < 3)
+        {
+            score = 0.75f;
+        }
+        else
+        {
+            const float scale = 1.0f / (s_vertexCacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+        }
+    }
+    return score + 2.0f / std::sqrt((float)remainingTriangles);
+}
+
+static void optimizeVertexCache(std::vector<uint32_t>& indices, const uint32_t vertexCount)
+{
+    const uint32_t triangleCount = (uint32_t)indices.size() / 3;
+
+    // triangles of each vertex, the first remainingTriangles are not emitted yet
+    std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+    for (const uint32_t index : indices)
+    {
+        ++remainingTriangles[index];
+    }
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        firstTriangle[vertex + 1] = firstTriangle[vertex] + remainingTriangles[vertex];
+    }
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    {
+        std::vector<uint32_t> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (uint32_t idx = 0; idx < (uint32_t)indices.size(); ++idx)
+        {
+            vertexTriangles[cursor[indices[idx]]++] = idx / 3;
+        }
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        vertexScore[vertex] = getVertexScore(-1, remainingTriangles[vertex]);
+    }
+
+    std::vector<float> triangleScore(triangleCount, 0.0f);
+    std::vector<bool> emitted(triangleCount, false);
+    for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        for (uint32_t corner = 0; corner < 3; ++corner)
+        {
+            triangleScore[triangle] += vertexScore[indices[3 * triangle + corner]];
+        }
+    }
+
+    std::vector<uint32_t> cache;
+    cache.reserve(s_vertexCacheSize + 3);
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    uint32_t bestTriangle = (uint32_t)(std::max_element(triangleScore.begin(), triangleScore.end())
+        - triangleScore.begin());
+    uint32_t scanTriangle = 0;
+
+    while (result.size() < indices.size())
+    {
+        if (bestTriangle == ~0u)
+        {
+            // nothing around the cache, continue from the first triangle left
+            while (emitted[scanTriangle])
+            {
+                ++scanTriangle;
+            }
+            bestTriangle = scanTriangle;
+        }
+
+        emitted[bestTriangle] = true;
+        for (uint32_t corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t vertex = indices[3 * bestTriangle + corner];
+            result.push_back(vertex);
+
+            uint32_t* const p_triangles = &vertexTriangles[firstTriangle[vertex]];
+            uint32_t* const p_end = p_triangles + remainingTriangles[vertex];
+            std::iter_swap(std::find(p_triangles, p_end, bestTriangle), p_end - 1);
+            --remainingTriangles[vertex];
+
+            const auto iter = std::find(cache.begin(), cache.end(), vertex);
+            if (iter != cache.end())
+            {
+                cache.erase(iter);
+            }
+            cache.insert(cache.begin(), vertex);
+        }
+
+        // rescore the cache and the vertices that fell out of it
+        for (uint32_t position = 0; position < (uint32_t)cache.size(); ++position)
+        {
+            const uint32_t vertex = cache[position];
+            cachePosition[vertex] = (position < s_vertexCacheSize) ? (int32_t)position : -1;
+
+            const float score = getVertexScore(cachePosition[vertex], remainingTriangles[vertex]);
+            const float delta = score - vertexScore[vertex];
+            vertexScore[vertex] = score;
+            for (uint32_t idx = 0; idx < remainingTriangles[vertex]; ++idx)
+            {
+                triangleScore[vertexTriangles[firstTriangle[vertex] + idx]] += delta;
+            }
+        }
+        if (cache.size() > s_vertexCacheSize)
+        {
+            cache.resize(s_vertexCacheSize);
+        }
+
+        bestTriangle = ~0u;
+        float bestScore = -1.0f;
+        for (const uint32_t vertex : cache)
+        {
+            for (uint32_t idx = 0; idx < remainingTriangles[vertex]; ++idx)
+            {
+                const uint32_t triangle = vertexTriangles[firstTriangle[vertex] + idx];
+                if (triangleScore[triangle] > bestScore)
+                {
+                    bestScore = triangleScore[triangle];
+                    bestTriangle = triangle;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+// vertices in order of first use, unreferenced ones are dropped
+static void optimizeVertexFetch(std::vector<uint32_t>& indices,
+    std::vector<MeshBatcher::PackedVertex>& vertices)
+{
+    std::vector<uint32_t> remap(vertices.size(), ~0u);
+    std::vector<MeshBatcher::PackedVertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            remap[index] = (uint32_t)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+MeshBatcher::MeshBatcher(GfxResources* const p_gfxResources)
+    : mp_gfxResources(p_gfxResources)
+{
+    assert(mp_gfxResources);
+}
+
+MeshBatcher::~MeshBatcher()
+{
+    if (m_vertexBuffer.isValid())
+    {
+        mp_gfxResources->releaseBuffer(m_vertexBuffer);
+    }
+    if (m_indexBuffer.isValid())
+    {
+        mp_gfxResources->releaseBuffer(m_indexBuffer);
+    }
+}
+
+MeshBatcher::MeshId MeshBatcher::add(const MeshData& mesh, const uint64_t batchKey)
+{
+    assert(!m_uploaded);
+
+    const uint32_t vertexCount = (uint32_t)(mesh.positions.size() / 3);
+    if (mesh.positions.size() != 3 * vertexCount
+        || (!mesh.normals.empty() && mesh.normals.size() != 3 * vertexCount)
+        || (!mesh.uvs.empty() && mesh.uvs.size() != 2 * vertexCount)
+        || mesh.indices.empty() || (mesh.indices.size() % 3) != 0)
+    {
+        throw std::runtime_error("Invalid mesh data");
+    }
+    for (const uint32_t index : mesh.indices)
+    {
+        if (index >= vertexCount)
+        {
+            throw std::runtime_error("Mesh index out of range");
+        }
+    }
+
+    Mesh packed;
+    packed.vertices.resize(vertexCount);
+    for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        PackedVertex& dst = packed.vertices[vertex];
+        const float* const p_normal = mesh.normals.empty() ? nullptr : &mesh.normals[3 * vertex];
+        for (uint32_t idx = 0; idx < 3; ++idx)
+        {
+            dst.position[idx] = mesh.positions[3 * vertex + idx];
+            dst.normal[idx] = toSnorm8(p_normal ? p_normal[idx] : (idx == 2 ? 1.0f : 0.0f));
+        }
+        dst.normal[3] = 0;
+        dst.uv[0] = toHalf(mesh.uvs.empty() ? 0.0f : mesh.uvs[2 * vertex]);
+        dst.uv[1] = toHalf(mesh.uvs.empty() ? 0.0f : mesh.uvs[2 * vertex + 1]);
+    }
+
+    packed.indices = mesh.indices;
+    optimizeVertexCache(packed.indices, vertexCount);
+    optimizeVertexFetch(packed.indices, packed.vertices);
+
+    packed.range.indexCount = (uint32_t)packed.indices.size();
+    packed.range.batchKey = batchKey;
+
+    m_meshes.push_back(std::move(packed));
+    return (MeshId)(m_meshes.size() - 1);
+}
+
+BufferHandle MeshBatcher::createBuffer(const VkDeviceSize size, const VkBufferUsageFlags usage,
+    const VkMemoryPropertyFlags memoryFlags, void** const pp_data)
+{
+    VkDevice device = mp_gfxResources->getDevice();
+
+    const VkBufferCreateInfo bufferCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,   // sType
+        nullptr,                                // pNext
+        0,                                      // flags
+        size,                                   // size
+        usage,                                  // usage
+        VK_SHARING_MODE_EXCLUSIVE,              // sharingMode
+        0,                                      // queueFamilyIndexCount
+        nullptr                                 // pQueueFamilyIndices
+    };
+
+    VkBuffer buffer = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkCreateBuffer(
+        device,             // device
+        &bufferCreateInfo,  // pCreateInfo
+        nullptr,            // pAllocator
+        &buffer));          // pBuffer
+
+    VkMemoryRequirements memoryRequirements = {};
+    vkGetBufferMemoryRequirements(
+        device,                 // device
+        buffer,                 // buffer
+        &memoryRequirements);   // pMemoryRequirements
+
+    const uint32_t memoryTypeIndex = findMemoryTypeIndex(mp_gfxResources->getMemoryProperties(),
+        memoryRequirements.memoryTypeBits, memoryFlags);
+    if (memoryTypeIndex == ~0u)
+    {
+        vkDestroyBuffer(device, buffer, nullptr);
+        throw std::runtime_error("No memory type for mesh buffers");
+    }
+
+    const VkMemoryAllocateInfo memoryAllocateInfo =
+    {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, // sType
+        nullptr,                                // pNext
+        memoryRequirements.size,                // allocationSize
+        memoryTypeIndex                         // memoryTypeIndex
+    };
+
+    VkDeviceMemory memory = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkAllocateMemory(
+        device,                 // device
+        &memoryAllocateInfo,    // pAllocateInfo
+        nullptr,                // pAllocator
+        &memory));              // pMemory
+
+    // mapped buffers are only used for staging
+    mp_gfxResources->getMemoryBudget().onAllocate(memory, memoryTypeIndex, memoryRequirements.size,
+        pp_data ? MemoryBudget::Category::Staging : MemoryBudget::Category::Geometry);
+
+    CHECK_VK_RESULT_SUCCESS(vkBindBufferMemory(
+        device,     // device
+        buffer,     // buffer
+        memory,     // memory
+        0));        // memoryOffset
+
+    if (pp_data)
+    {
+        CHECK_VK_RESULT_SUCCESS(vkMapMemory(
+            device,         // device
+            memory,         // memory
+            0,              // offset
+            VK_WHOLE_SIZE,  // size
+            0,              // flags
+            pp_data));      // ppData
+    }
+
+    return mp_gfxResources->getBufferPool().create(buffer, memory, size, usage);
+}
+
+void MeshBatcher::upload(VkCommandBuffer cmdBuffer)
+{
+    assert(!m_uploaded);
+    m_uploaded = true;
+    if (m_meshes.empty())
+    {
+        return;
+    }
+
+    // stable, meshes of a key keep the order they were added in
+    std::vector<MeshId> order(m_meshes.size());
+    for (MeshId mesh = 0; mesh < (MeshId)order.size(); ++mesh)
+    {
+        order[mesh] = mesh;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](const MeshId lhs, const MeshId rhs)
+        { return m_meshes[lhs].range.batchKey < m_meshes[rhs].range.batchKey; });
+
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    for (const Mesh& mesh : m_meshes)
+    {
+        vertexCount += mesh.vertices.size();
+        indexCount += mesh.indices.size();
+    }
+    const VkDeviceSize vertexSize = vertexCount * sizeof(PackedVertex);
+    const VkDeviceSize indexSize = indexCount * sizeof(uint32_t);
+
+    // vertices first, indices are 4 byte aligned after them
+    void* p_data = nullptr;
+    const BufferHandle staging = createBuffer(vertexSize + indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &p_data);
+    PackedVertex* p_vertices = (PackedVertex*)p_data;
+    uint32_t* p_indices = (uint32_t*)((uint8_t*)p_data + vertexSize);
+
+    // indices are rebased to the shared buffer, so ranges of
+    // different meshes can be drawn together
+    uint32_t vertexBase = 0;
+    uint32_t indexBase = 0;
+    for (const MeshId id : order)
+    {
+        Mesh& mesh = m_meshes[id];
+        memcpy(p_vertices + vertexBase, mesh.vertices.data(), mesh.vertices.size() * sizeof(PackedVertex));
+        for (size_t idx = 0; idx < mesh.indices.size(); ++idx)
+        {
+            p_indices[indexBase + idx] = mesh.indices[idx] + vertexBase;
+        }
+        mesh.range.firstIndex = indexBase;
+
+        if (!m_batches.empty() && m_batches.back().batchKey == mesh.range.batchKey)
+        {
+            m_batches.back().indexCount += mesh.range.indexCount;
+        }
+        else
+        {
+            m_batches.push_back(mesh.range);
+        }
+
+        vertexBase += (uint32_t)mesh.vertices.size();
+        indexBase += (uint32_t)mesh.indices.size();
+
+        // the gpu copy is all that is needed from now on
+        mesh.vertices = std::vector<PackedVertex>();
+        mesh.indices = std::vector<uint32_t>();
+    }
+
+    m_vertexBuffer = createBuffer(vertexSize,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, nullptr);
+    m_indexBuffer = createBuffer(indexSize,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, nullptr);
+
+    const BufferPool& bufferPool = mp_gfxResources->getBufferPool();
+    const VkBuffer stagingBuffer = bufferPool.get<BufferPool::Buffer>(staging);
+    const VkBuffer vertexBuffer = bufferPool.get<BufferPool::Buffer>(m_vertexBuffer);
+    const VkBuffer indexBuffer = bufferPool.get<BufferPool::Buffer>(m_indexBuffer);
+
+    const VkBufferCopy vertexCopy =
+    {
+        0,              // srcOffset
+        0,              // dstOffset
+        vertexSize      // size
+    };
+    vkCmdCopyBuffer(
+        cmdBuffer,      // commandBuffer
+        stagingBuffer,  // srcBuffer
+        vertexBuffer,   // dstBuffer
+        1,              // regionCount
+        &vertexCopy);   // pRegions
+
+    const VkBufferCopy indexCopy =
+    {
+        vertexSize,     // srcOffset
+        0,              // dstOffset
+        indexSize       // size
+    };
+    vkCmdCopyBuffer(
+        cmdBuffer,      // commandBuffer
+        stagingBuffer,  // srcBuffer
+        indexBuffer,    // dstBuffer
+        1,              // regionCount
+        &indexCopy);    // pRegions
+
+    const VkBufferMemoryBarrier bufferMemoryBarriers[] =
+    {
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,    // sType
+            nullptr,                                    // pNext
+            VK_ACCESS_TRANSFER_WRITE_BIT,               // srcAccessMask
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,        // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                    // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                    // dstQueueFamilyIndex
+            vertexBuffer,                               // buffer
+            0,                                          // offset
+            VK_WHOLE_SIZE                               // size
+        },
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,    // sType
+            nullptr,                                    // pNext
+            VK_ACCESS_TRANSFER_WRITE_BIT,               // srcAccessMask
+            VK_ACCESS_INDEX_READ_BIT,                   // dstAccessMask
+            VK_QUEUE_FAMILY_IGNORED,                    // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                    // dstQueueFamilyIndex
+            indexBuffer,                                // buffer
+            0,                                          // offset
+            VK_WHOLE_SIZE                               // size
+        }
+    };
+
+    vkCmdPipelineBarrier(
+        cmdBuffer,                              // commandBuffer
+        VK_PIPELINE_STAGE_TRANSFER_BIT,         // srcStageMask
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,     // dstStageMask
+        0,                                      // dependencyFlags
+        0,                                      // memoryBarrierCount
+        nullptr,                                // pMemoryBarriers
+        2,                                      // bufferMemoryBarrierCount
+        bufferMemoryBarriers,                   // pBufferMemoryBarriers
+        0,                                      // imageMemoryBarrierCount
+        nullptr);                               // pImageMemoryBarriers
+
+    // freed once this frame has completed
+    mp_gfxResources->releaseBuffer(staging);
+}
+
+bool MeshBatcher::isUploaded() const
+{
+    return m_uploaded;
+}
+
+VkBuffer MeshBatcher::getVertexBuffer() const
+{
+    return m_vertexBuffer.isValid()
+        ? mp_gfxResources->getBufferPool().get<BufferPool::Buffer>(m_vertexBuffer) : nullptr;
+}
+
+VkBuffer MeshBatcher::getIndexBuffer() const
+{
+    return m_indexBuffer.isValid()
+        ? mp_gfxResources->getBufferPool().get<BufferPool::Buffer>(m_indexBuffer) : nullptr;
+}
+
+const MeshBatcher::DrawRange& MeshBatcher::getDrawRange(const MeshId mesh) const
+{
+    assert(mesh < m_meshes.size());
+    return m_meshes[mesh].range;
+}
+
+const std::vector<MeshBatcher::DrawRange>& MeshBatcher::getBatches() const
+{
+    return m_batches;
+}
+
+const std::vector<VkVertexInputAttributeDescription>& MeshBatcher::getVertexAttributes()
+{
+    // formats with mandatory vertex buffer support
+    static const std::vector<VkVertexInputAttributeDescription> s_attributes =
+    {
+        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PackedVertex, position) },
+        { 1, 0, VK_FORMAT_R8G8B8A8_SNORM, offsetof(PackedVertex, normal) },
+        { 2, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv) },
+    };
+    return s_attributes;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,115 @@
+#ifndef CORE_MESH_BATCHER_H
+#define CORE_MESH_BATCHER_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "GfxHandles.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+class GfxResources;
+
+// Static meshes packed into one shared vertex buffer and one shared index
+// buffer, so all of them draw with a single vertex and index buffer bind.
+// Meshes are optimized when added: triangles are reordered for the
+// post-transform vertex cache, then vertices by first use for fetch
+// locality. Vertices are quantized to 20 bytes: float position, 8-bit
+// snorm normal and half-float uv.
+// Meshes sharing a batch key, e.g. the same pipeline and material, are
+// placed next to each other in the index buffer, so a key draws as one
+// vkCmdDrawIndexed() over a contiguous range.
+class MeshBatcher
+{
+public:
+    typedef uint32_t MeshId;
+
+    static const MeshId c_invalidMesh = ~0u;
+
+    struct MeshData
+    {
+        // xyz per vertex
+        std::vector<float> positions;
+        // xyz per vertex, +z if empty
+        std::vector<float> normals;
+        // uv per vertex, zero if empty
+        std::vector<float> uvs;
+        // triangle list
+        std::vector<uint32_t> indices;
+    };
+
+    struct PackedVertex
+    {
+        float position[3];
+        int8_t normal[4];
+        uint16_t uv[2];
+    };
+
+    // vkCmdDrawIndexed() arguments, indices are absolute so vertexOffset is 0
+    struct DrawRange
+    {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        uint64_t batchKey   = 0;
+    };
+
+    explicit MeshBatcher(GfxResources* const p_gfxResources);
+    // buffers go through the deletion queue
+    ~MeshBatcher();
+
+    MeshBatcher(const MeshBatcher&) = delete;
+    MeshBatcher& operator=(const MeshBatcher&) = delete;
+
+    // before upload(), throws std::runtime_error for invalid data
+    MeshId add(const MeshData& mesh, const uint64_t batchKey);
+
+    // creates the shared buffers and records their upload,
+    // once, outside render passes and before the first draw
+    void upload(VkCommandBuffer cmdBuffer);
+    bool isUploaded() const;
+
+    // nullptr before upload() or without meshes
+    VkBuffer getVertexBuffer() const;
+    VkBuffer getIndexBuffer() const;
+    const DrawRange& getDrawRange(const MeshId mesh) const;
+    // meshes with the same key merged, in key order
+    const std::vector<DrawRange>& getBatches() const;
+
+    // layout of PackedVertex in binding 0, for the pipeline vertex input
+    static const std::vector<VkVertexInputAttributeDescription>& getVertexAttributes();
+
+private:
+    struct Mesh
+    {
+        std::vector<PackedVertex> vertices;
+        // relative to the mesh, rebased at upload
+        std::vector<uint32_t> indices;
+        DrawRange range;
+    };
+
+    BufferHandle createBuffer(const VkDeviceSize size, const VkBufferUsageFlags usage,
+        const VkMemoryPropertyFlags memoryFlags, void** const pp_data);
+
+    GfxResources* const mp_gfxResources = nullptr;
+
+    std::vector<Mesh> m_meshes;
+    std::vector<DrawRange> m_batches;
+
+    bool m_uploaded = false;
+    BufferHandle m_vertexBuffer;
+    BufferHandle m_indexBuffer;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_MESH_BATCHER_H
@@ -0,0 +1,189 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "OcclusionQueries.h"
+
+#include "DeletionQueue.h"
+#include "ErrorHandling.h"
+
+#include <algorithm>
+#include <assert.h>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+OcclusionQueries::OcclusionQueries(VkDevice device, DeletionQueue& deletionQueue,
+    const uint32_t bufferCount, const uint32_t capacity, const bool precise)
+    : m_device(device),
+    m_deletionQueue(deletionQueue),
+    m_capacity(capacity),
+    m_precise(precise)
+{
+    assert(m_device);
+    assert(m_capacity > 0);
+
+    m_queries.resize(m_capacity);
+    m_freeQueries.reserve(m_capacity);
+    for (uint32_t idx = m_capacity; idx > 0; --idx)
+    {
+        m_freeQueries.push_back(idx - 1);
+    }
+
+    setBufferCount(bufferCount);
+}
+
+OcclusionQueries::~OcclusionQueries()
+{
+    m_deletionQueue.destroy(m_queryPool);
+}
+
+void OcclusionQueries::setBufferCount(const uint32_t bufferCount)
+{
+    assert(bufferCount > 0);
+
+    // frames in flight may still write to the old pool
+    m_deletionQueue.destroy(m_queryPool);
+    m_queryPool = nullptr;
+
+    const VkQueryPoolCreateInfo queryPoolCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,   // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        VK_QUERY_TYPE_OCCLUSION,                    // queryType
+        bufferCount * m_capacity,                   // queryCount
+        0                                           // pipelineStatistics
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkCreateQueryPool(
+        m_device,               // device
+        &queryPoolCreateInfo,   // pCreateInfo
+        nullptr,                // pAllocator
+        &m_queryPool));         // pQueryPool
+
+    m_bufferCount = bufferCount;
+    m_bufferIndex = 0;
+    m_recorded.assign(bufferCount * m_capacity, false);
+}
+
+OcclusionQueries::QueryId OcclusionQueries::create()
+{
+    if (m_freeQueries.empty())
+    {
+        return c_invalidQuery;
+    }
+
+    const QueryId query = m_freeQueries.back();
+    m_freeQueries.pop_back();
+    m_queries[query].used = true;
+    m_queries[query].samples = c_noResult;
+    return query;
+}
+
+void OcclusionQueries::release(const QueryId query)
+{
+    assert(query < m_capacity && m_queries[query].used);
+
+    // results still in flight belong to the old user
+    for (uint32_t bufferIndex = 0; bufferIndex < m_bufferCount; ++bufferIndex)
+    {
+        m_recorded[bufferIndex * m_capacity + query] = false;
+    }
+    m_queries[query] = Query();
+    m_freeQueries.push_back(query);
+}
+
+void OcclusionQueries::beginFrame(VkCommandBuffer cmdBuffer, const uint32_t bufferIndex)
+{
+    assert(bufferIndex < m_bufferCount);
+    m_bufferIndex = bufferIndex;
+
+    const uint32_t firstQuery = bufferIndex * m_capacity;
+
+    // reset in the same frame they were written, so the whole range is readable
+    uint32_t queryCount = 0;
+    for (uint32_t query = 0; query < m_capacity; ++query)
+    {
+        if (m_recorded[firstQuery + query])
+        {
+            queryCount = query + 1;
+        }
+    }
+
+    if (queryCount > 0)
+    {
+        // samples and availability per query, zero = not available
+        std::vector<uint64_t> results(2 * queryCount, 0);
+
+        // VK_NOT_READY if some are not available yet, the rest are still written
+        CHECK_VK_RESULT_SUCCESS(vkGetQueryPoolResults(
+            m_device,                               // device
+            m_queryPool,                            // queryPool
+            firstQuery,                             // firstQuery
+            queryCount,                             // queryCount
+            results.size() * sizeof(uint64_t),      // dataSize
+            results.data(),                         // pData
+            2 * sizeof(uint64_t),                   // stride
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT)); // flags
+
+        for (uint32_t query = 0; query < queryCount; ++query)
+        {
+            if (m_recorded[firstQuery + query] && results[2 * query + 1] != 0)
+            {
+                m_queries[query].samples = results[2 * query];
+            }
+        }
+    }
+
+    std::fill(m_recorded.begin() + firstQuery, m_recorded.begin() + firstQuery + m_capacity, false);
+
+    vkCmdResetQueryPool(
+        cmdBuffer,      // commandBuffer
+        m_queryPool,    // queryPool
+        firstQuery,     // firstQuery
+        m_capacity);    // queryCount
+}
+
+void OcclusionQueries::begin(VkCommandBuffer cmdBuffer, const QueryId query)
+{
+    assert(query < m_capacity && m_queries[query].used);
+    assert(!m_recorded[m_bufferIndex * m_capacity + query]);
+
+    m_recorded[m_bufferIndex * m_capacity + query] = true;
+
+    vkCmdBeginQuery(
+        cmdBuffer,                                          // commandBuffer
+        m_queryPool,                                        // queryPool
+        m_bufferIndex * m_capacity + query,                 // query
+        m_precise ? VK_QUERY_CONTROL_PRECISE_BIT : 0);      // flags
+}
+
+void OcclusionQueries::end(VkCommandBuffer cmdBuffer, const QueryId query)
+{
+    assert(query < m_capacity && m_queries[query].used);
+
+    vkCmdEndQuery(
+        cmdBuffer,                              // commandBuffer
+        m_queryPool,                            // queryPool
+        m_bufferIndex * m_capacity + query);    // query
+}
+
+uint64_t OcclusionQueries::getSamples(const QueryId query) const
+{
+    assert(query < m_capacity);
+    return m_queries[query].samples;
+}
+
+bool OcclusionQueries::isVisible(const QueryId query) const
+{
+    assert(query < m_capacity);
+    return m_queries[query].samples != 0;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
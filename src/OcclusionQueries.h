@@ -0,0 +1,89 @@
+#ifndef CORE_OCCLUSION_QUERIES_H
+#define CORE_OCCLUSION_QUERIES_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+class DeletionQueue;
+
+// Occlusion queries for visibility tests, e.g. drawing the bounds of an
+// object with depth test on and color writes off, then skipping the
+// object while its bounds are not visible.
+// Each query has a slot per buffer index. Results of a frame are read when
+// its buffer index comes around again, after the frame has completed, and
+// a query that is not available yet keeps its previous result, so reading
+// never waits. Results are at least a frame old, a query without one
+// counts as visible so new objects are drawn until tested.
+class OcclusionQueries
+{
+public:
+    typedef uint32_t QueryId;
+
+    static const QueryId c_invalidQuery = ~0u;
+    static const uint64_t c_noResult = ~0ull;
+
+    // without precise queries samples is only zero or non-zero
+    OcclusionQueries(VkDevice device, DeletionQueue& deletionQueue,
+        const uint32_t bufferCount, const uint32_t capacity, const bool precise);
+    // the query pool goes through the deletion queue
+    ~OcclusionQueries();
+
+    OcclusionQueries(const OcclusionQueries&) = delete;
+    OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+
+    // recreates the query pool, ids and results are kept
+    void setBufferCount(const uint32_t bufferCount);
+
+    // returns c_invalidQuery if all are in use
+    QueryId create();
+    void release(const QueryId query);
+
+    // reads the results of the frame last recorded on bufferIndex and
+    // resets its queries, outside render passes after the frame completed
+    void beginFrame(VkCommandBuffer cmdBuffer, const uint32_t bufferIndex);
+
+    // inside a render pass, at most once per frame for each query
+    void begin(VkCommandBuffer cmdBuffer, const QueryId query);
+    void end(VkCommandBuffer cmdBuffer, const QueryId query);
+
+    // samples that passed the depth and stencil tests, c_noResult if none yet
+    uint64_t getSamples(const QueryId query) const;
+    bool isVisible(const QueryId query) const;
+
+private:
+    struct Query
+    {
+        bool used       = false;
+        uint64_t samples= c_noResult;
+    };
+
+    VkDevice m_device = nullptr;
+    DeletionQueue& m_deletionQueue;
+    const uint32_t m_capacity   = 0;
+    const bool m_precise        = false;
+
+    VkQueryPool m_queryPool = nullptr;
+    uint32_t m_bufferCount  = 0;
+    uint32_t m_bufferIndex  = 0;
+
+    std::vector<Query> m_queries;
+    std::vector<QueryId> m_freeQueries;
+    // per buffer index and query, begun in the frame last recorded
+    std::vector<bool> m_recorded;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_OCCLUSION_QUERIES_H
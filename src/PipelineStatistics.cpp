@@ -0,0 +1,195 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "PipelineStatistics.h"
+
+#include "DeletionQueue.h"
+#include "ErrorHandling.h"
+
+#include <algorithm>
+#include <assert.h>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// results come in bit order, matching PipelineStatistics::Counters
+static constexpr VkQueryPipelineStatisticFlags s_statisticFlags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+static constexpr uint32_t s_counterCount = 7;
+
+PipelineStatistics::PipelineStatistics(VkDevice device, DeletionQueue& deletionQueue,
+    const uint32_t bufferCount, const uint32_t maxPasses)
+    : m_device(device),
+    m_deletionQueue(deletionQueue),
+    m_bufferCount(bufferCount),
+    m_maxPasses(maxPasses)
+{
+    assert(m_device);
+    assert(m_bufferCount > 0 && m_maxPasses > 0);
+
+    const VkQueryPoolCreateInfo queryPoolCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,   // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        VK_QUERY_TYPE_PIPELINE_STATISTICS,          // queryType
+        m_bufferCount * m_maxPasses,                // queryCount
+        s_statisticFlags                            // pipelineStatistics
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkCreateQueryPool(
+        m_device,               // device
+        &queryPoolCreateInfo,   // pCreateInfo
+        nullptr,                // pAllocator
+        &m_queryPool));         // pQueryPool
+
+    m_recorded.resize(m_bufferCount * m_maxPasses);
+}
+
+PipelineStatistics::~PipelineStatistics()
+{
+    m_deletionQueue.destroy(m_queryPool);
+}
+
+void PipelineStatistics::beginFrame(VkCommandBuffer cmdBuffer, const uint32_t bufferIndex)
+{
+    assert(bufferIndex < m_bufferCount);
+    m_bufferIndex = bufferIndex;
+
+    const uint32_t firstQuery = bufferIndex * m_maxPasses;
+
+    // reset in the same frame they were written, so the whole range is readable
+    uint32_t queryCount = 0;
+    for (uint32_t pass = 0; pass < m_maxPasses; ++pass)
+    {
+        if (!m_recorded[firstQuery + pass].empty())
+        {
+            queryCount = pass + 1;
+        }
+    }
+
+    if (queryCount > 0)
+    {
+        // counters and availability per query, zero = not available
+        std::vector<uint64_t> results(queryCount * (s_counterCount + 1), 0);
+
+        // VK_NOT_READY if some are not available yet, the rest are still written
+        CHECK_VK_RESULT_SUCCESS(vkGetQueryPoolResults(
+            m_device,                                       // device
+            m_queryPool,                                    // queryPool
+            firstQuery,                                     // firstQuery
+            queryCount,                                     // queryCount
+            results.size() * sizeof(uint64_t),              // dataSize
+            results.data(),                                 // pData
+            (s_counterCount + 1) * sizeof(uint64_t),        // stride
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT)); // flags
+
+        for (uint32_t pass = 0; pass < queryCount; ++pass)
+        {
+            const std::string& name = m_recorded[firstQuery + pass];
+            const uint64_t* const values = &results[pass * (s_counterCount + 1)];
+            if (!name.empty() && values[s_counterCount] != 0)
+            {
+                accumulate(name, values);
+            }
+        }
+    }
+
+    std::fill(m_recorded.begin() + firstQuery, m_recorded.begin() + firstQuery + m_maxPasses, std::string());
+
+    vkCmdResetQueryPool(
+        cmdBuffer,      // commandBuffer
+        m_queryPool,    // queryPool
+        firstQuery,     // firstQuery
+        m_maxPasses);   // queryCount
+}
+
+void PipelineStatistics::beginPass(VkCommandBuffer cmdBuffer, const uint32_t pass, const std::string& name)
+{
+    if (pass >= m_maxPasses)
+    {
+        return;
+    }
+
+    const uint32_t query = m_bufferIndex * m_maxPasses + pass;
+    m_recorded[query] = name;
+
+    vkCmdBeginQuery(
+        cmdBuffer,      // commandBuffer
+        m_queryPool,    // queryPool
+        query,          // query
+        0);             // flags
+}
+
+void PipelineStatistics::endPass(VkCommandBuffer cmdBuffer, const uint32_t pass)
+{
+    if (pass >= m_maxPasses)
+    {
+        return;
+    }
+
+    vkCmdEndQuery(
+        cmdBuffer,                              // commandBuffer
+        m_queryPool,                            // queryPool
+        m_bufferIndex * m_maxPasses + pass);    // query
+}
+
+void PipelineStatistics::accumulate(const std::string& name, const uint64_t* const values)
+{
+    auto iter = std::find_if(m_totals.begin(), m_totals.end(),
+        [&name](const PassTotals& totals) { return totals.name == name; });
+    if (iter == m_totals.end())
+    {
+        m_totals.emplace_back();
+        m_totals.back().name = name;
+        iter = m_totals.end() - 1;
+    }
+
+    Counters& sum = iter->sum;
+    sum.inputVertices += values[0];
+    sum.inputPrimitives += values[1];
+    sum.vertexInvocations += values[2];
+    sum.clippingInvocations += values[3];
+    sum.clippingPrimitives += values[4];
+    sum.fragmentInvocations += values[5];
+    sum.computeInvocations += values[6];
+    iter->frameCount++;
+}
+
+void PipelineStatistics::print(std::ostream& out)
+{
+    for (const PassTotals& totals : m_totals)
+    {
+        if (totals.frameCount == 0)
+        {
+            continue;
+        }
+
+        const uint64_t frames = totals.frameCount;
+        const Counters& sum = totals.sum;
+        out << "pass " << totals.name << " per frame:"
+            << " vertices " << sum.inputVertices / frames
+            << ", primitives " << sum.inputPrimitives / frames
+            << ", vs invocations " << sum.vertexInvocations / frames
+            << ", clipping invocations " << sum.clippingInvocations / frames
+            << ", clipping primitives " << sum.clippingPrimitives / frames
+            << ", fs invocations " << sum.fragmentInvocations / frames
+            << ", cs invocations " << sum.computeInvocations / frames
+            << ", frames " << frames << std::endl;
+    }
+    m_totals.clear();
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
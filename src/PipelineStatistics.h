@@ -0,0 +1,91 @@
+#ifndef CORE_PIPELINE_STATISTICS_H
+#define CORE_PIPELINE_STATISTICS_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+class DeletionQueue;
+
+// Pipeline statistics queries around render graph passes, showing what
+// the gpu processed: a lot more fragment invocations than pixels is
+// overdraw, vertices clipped away are wasted vertex work.
+// Each buffer index has its own queries. Results of a frame are read when
+// its buffer index comes around again, after the frame has completed, and
+// queries that are still not available are skipped, so reading never
+// waits. Counters are summed per pass name until print().
+class PipelineStatistics
+{
+public:
+    // in the order the query returns them
+    struct Counters
+    {
+        uint64_t inputVertices          = 0;
+        uint64_t inputPrimitives        = 0;
+        uint64_t vertexInvocations      = 0;
+        uint64_t clippingInvocations    = 0;
+        uint64_t clippingPrimitives     = 0;
+        uint64_t fragmentInvocations    = 0;
+        uint64_t computeInvocations     = 0;
+    };
+
+    // the device must have the pipelineStatisticsQuery feature enabled
+    PipelineStatistics(VkDevice device, DeletionQueue& deletionQueue,
+        const uint32_t bufferCount, const uint32_t maxPasses);
+    // the query pool goes through the deletion queue
+    ~PipelineStatistics();
+
+    PipelineStatistics(const PipelineStatistics&) = delete;
+    PipelineStatistics& operator=(const PipelineStatistics&) = delete;
+
+    // reads the results of the frame last recorded on bufferIndex and
+    // resets its queries, outside render passes after the frame completed
+    void beginFrame(VkCommandBuffer cmdBuffer, const uint32_t bufferIndex);
+
+    // outside render passes, passes from maxPasses on are not measured
+    void beginPass(VkCommandBuffer cmdBuffer, const uint32_t pass, const std::string& name);
+    void endPass(VkCommandBuffer cmdBuffer, const uint32_t pass);
+
+    // averages per frame for each pass since the last print
+    void print(std::ostream& out);
+
+private:
+    struct PassTotals
+    {
+        std::string name;
+        Counters sum;
+        uint32_t frameCount = 0;
+    };
+
+    void accumulate(const std::string& name, const uint64_t* const values);
+
+    VkDevice m_device = nullptr;
+    DeletionQueue& m_deletionQueue;
+    const uint32_t m_bufferCount    = 0;
+    const uint32_t m_maxPasses      = 0;
+
+    VkQueryPool m_queryPool = nullptr;
+    uint32_t m_bufferIndex  = 0;
+
+    // per buffer index and pass, name of the pass recorded, empty = none
+    std::vector<std::string> m_recorded;
+    // in the order passes were first seen
+    std::vector<PassTotals> m_totals;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_PIPELINE_STATISTICS_H
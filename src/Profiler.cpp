@@ -0,0 +1,222 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+typedef std::chrono::steady_clock Clock;
+
+struct ProfileEvent
+{
+    const char* name    = nullptr;
+    uint64_t begin      = 0;
+    uint64_t end        = 0;
+};
+
+// written by its thread only, read by the trace writer
+struct ThreadRing
+{
+    uint32_t index = 0;
+    std::atomic<const char*> name{ nullptr };
+    // zones written so far, the slot is head % capacity
+    std::atomic<uint64_t> head{ 0 };
+    std::unique_ptr<ProfileEvent[]> events;
+};
+
+struct GpuZone
+{
+    const char* name    = nullptr;
+    uint64_t submitTicks = 0;
+    uint64_t beginNs    = 0;
+    uint64_t endNs      = 0;
+};
+
+// ticks are converted to time at the export with these as the origin
+static const uint64_t s_startTicks = Profiler::readTicks();
+static const Clock::time_point s_startTime = Clock::now();
+
+// rings stay alive after their thread exits, so the trace keeps its zones
+static std::mutex s_mutex;
+static std::vector<std::unique_ptr<ThreadRing>> s_rings;
+static thread_local ThreadRing* sp_threadRing = nullptr;
+
+static std::vector<GpuZone> s_gpuZones;
+static uint64_t s_gpuZoneCount = 0;
+
+static ThreadRing& getThreadRing()
+{
+    if (!sp_threadRing)
+    {
+        std::unique_ptr<ThreadRing> ring(new ThreadRing());
+        ring->events.reset(new ProfileEvent[Profiler::c_ringCapacity]);
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        ring->index = (uint32_t)s_rings.size();
+        sp_threadRing = ring.get();
+        s_rings.push_back(std::move(ring));
+    }
+    return *sp_threadRing;
+}
+
+static void writeString(std::ostream& out, const char* const p_str)
+{
+    out << '"';
+    for (const char* p_char = p_str; *p_char; ++p_char)
+    {
+        if (*p_char == '"' || *p_char == '\\')
+        {
+            out << '\\';
+        }
+        out << *p_char;
+    }
+    out << '"';
+}
+
+void Profiler::setThreadName(const char* const name)
+{
+    getThreadRing().name.store(name, std::memory_order_relaxed);
+}
+
+uint64_t Profiler::beginZone()
+{
+    return readTicks();
+}
+
+void Profiler::endZone(const char* const name, const uint64_t beginTicks)
+{
+    const uint64_t endTicks = readTicks();
+
+    ThreadRing& ring = getThreadRing();
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    ProfileEvent& event = ring.events[head % c_ringCapacity];
+    event.name = name;
+    event.begin = beginTicks;
+    event.end = endTicks;
+    // publishes the event to the trace writer
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::addGpuZone(const char* const name, const uint64_t submitTicks,
+    const uint64_t gpuBeginNs, const uint64_t gpuEndNs)
+{
+    GpuZone zone;
+    zone.name = name;
+    zone.submitTicks = submitTicks;
+    zone.beginNs = gpuBeginNs;
+    zone.endNs = gpuEndNs;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_gpuZones.size() < c_ringCapacity)
+    {
+        s_gpuZones.push_back(zone);
+    }
+    else
+    {
+        s_gpuZones[s_gpuZoneCount % c_ringCapacity] = zone;
+    }
+    ++s_gpuZoneCount;
+}
+
+void Profiler::writeChromeTrace(std::ostream& out)
+{
+    // tick rate measured over the whole run
+    const uint64_t nowTicks = readTicks();
+    const double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - s_startTime).count();
+    const double ticksPerNs = (elapsedNs > 0.0 && nowTicks > s_startTicks)
+        ? ((nowTicks - s_startTicks) / elapsedNs) : 1.0;
+    const auto toUs = [ticksPerNs](const uint64_t ticks)
+    {
+        return (ticks > s_startTicks) ? ((ticks - s_startTicks) / ticksPerNs * 1e-3) : 0.0;
+    };
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, \"args\": {\"name\": \"CPU\"}}";
+
+    std::vector<ProfileEvent> events;
+    for (const std::unique_ptr<ThreadRing>& ring : s_rings)
+    {
+        const char* const threadName = ring->name.load(std::memory_order_relaxed);
+        out << "," << std::endl << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": "
+            << ring->index << ", \"args\": {\"name\": ";
+        writeString(out, threadName ? threadName : ("thread " + std::to_string(ring->index)).c_str());
+        out << "}}";
+
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t first = (head > c_ringCapacity) ? (head - c_ringCapacity) : 0;
+        events.clear();
+        for (uint64_t idx = first; idx < head; ++idx)
+        {
+            events.push_back(ring->events[idx % c_ringCapacity]);
+        }
+        // copying the events is only safe once their thread stopped recording,
+        // if it did not, drop every slot it wrote or may still be writing
+        const uint64_t headAfter = ring->head.load(std::memory_order_acquire);
+        assert(headAfter == head);
+        const uint64_t overwritten = (headAfter + 1 > c_ringCapacity) ? (headAfter + 1 - c_ringCapacity) : 0;
+        if (overwritten > first)
+        {
+            events.erase(events.begin(),
+                events.begin() + (size_t)std::min<uint64_t>(overwritten - first, events.size()));
+        }
+
+        // zones end child first, the viewer wants parents first
+        std::sort(events.begin(), events.end(), [](const ProfileEvent& lhs, const ProfileEvent& rhs)
+        {
+            return (lhs.begin != rhs.begin) ? (lhs.begin < rhs.begin) : (lhs.end > rhs.end);
+        });
+
+        for (const ProfileEvent& event : events)
+        {
+            out << "," << std::endl << "{\"name\": ";
+            writeString(out, event.name);
+            out << ", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << ring->index
+                << ", \"ts\": " << toUs(event.begin)
+                << ", \"dur\": " << (toUs(event.end) - toUs(event.begin)) << "}";
+        }
+    }
+
+    if (!s_gpuZones.empty())
+    {
+        // smallest offset that puts no GPU zone before its submit
+        int64_t offsetNs = std::numeric_limits<int64_t>::min();
+        for (const GpuZone& zone : s_gpuZones)
+        {
+            const int64_t submitNs = (int64_t)(toUs(zone.submitTicks) * 1e3);
+            offsetNs = std::max(offsetNs, submitNs - (int64_t)zone.beginNs);
+        }
+
+        out << "," << std::endl << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"GPU\"}}";
+        for (const GpuZone& zone : s_gpuZones)
+        {
+            out << "," << std::endl << "{\"name\": ";
+            writeString(out, zone.name);
+            out << ", \"cat\": \"gpu\", \"ph\": \"X\", \"pid\": 1, \"tid\": 0"
+                << ", \"ts\": " << ((int64_t)zone.beginNs + offsetNs) * 1e-3
+                << ", \"dur\": " << (zone.endNs - zone.beginNs) * 1e-3 << "}";
+        }
+    }
+
+    out << std::endl << "]}" << std::endl;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,102 @@
+#ifndef CORE_PROFILER_H
+#define CORE_PROFILER_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#if defined(CORE_PROFILER)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// CPU profiler for nested zones, built in with CORE_PROFILER defined.
+// Each thread writes finished zones to its own ring buffer without
+// locking, old zones are overwritten when a ring is full. Timestamps are
+// TSC ticks on x86 and steady clock nanoseconds elsewhere.
+// The trace is written in the Chrome trace event format, which Perfetto
+// and chrome://tracing open. GPU zones are placed on their own track;
+// Vulkan 1.0 has no calibrated timestamps, so GPU time is aligned to CPU
+// time assuming no GPU work starts before its submit.
+class Profiler
+{
+public:
+#if defined(CORE_PROFILER)
+    static constexpr bool c_enabled = true;
+#else
+    static constexpr bool c_enabled = false;
+#endif
+    // zones kept per thread
+    static const uint32_t c_ringCapacity = 1 << 16;
+
+    static inline uint64_t readTicks()
+    {
+#if defined(CORE_PROFILER) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+        return __rdtsc();
+#else
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // names are not copied, string literals or static storage only
+    static void setThreadName(const char* const name);
+
+    // begin returns the start ticks of the zone for end
+    static uint64_t beginZone();
+    static void endZone(const char* const name, const uint64_t beginTicks);
+
+    // GPU zone in nanoseconds of the device timestamp clock,
+    // submitTicks from readTicks() at the submit that ran it
+    static void addGpuZone(const char* const name, const uint64_t submitTicks,
+        const uint64_t gpuBeginNs, const uint64_t gpuEndNs);
+
+    // zones of all threads still in the rings,
+    // only once every other thread that records zones has stopped or is idle
+    static void writeChromeTrace(std::ostream& out);
+};
+
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char* const name)
+        : mp_name(name), m_beginTicks(Profiler::beginZone()) {}
+    ~ProfileZone() { Profiler::endZone(mp_name, m_beginTicks); }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* const mp_name;
+    const uint64_t m_beginTicks;
+};
+
+} // namespace
+
+// Zone from here to the end of the enclosing scope,
+// expands to nothing without CORE_PROFILER
+#if defined(CORE_PROFILER)
+#define CORE_PROFILE_CONCAT_INNER(a, b) a##b
+#define CORE_PROFILE_CONCAT(a, b) CORE_PROFILE_CONCAT_INNER(a, b)
+#define CORE_PROFILE_ZONE(name) \
+    ::core::ProfileZone CORE_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define CORE_PROFILE_THREAD(name) ::core::Profiler::setThreadName(name)
+#else
+#define CORE_PROFILE_ZONE(name)
+#define CORE_PROFILE_THREAD(name)
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_PROFILER_H
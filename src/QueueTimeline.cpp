@@ -0,0 +1,268 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "QueueTimeline.h"
+
+#include "ErrorHandling.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+QueueTimeline::QueueTimeline(VkDevice device, const bool timelineSemaphore, const bool coreEntryPoints)
+    : m_device(device)
+{
+    assert(device);
+
+    if (!timelineSemaphore)
+    {
+        return;
+    }
+
+    mp_waitSemaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(
+        m_device, coreEntryPoints ? "vkWaitSemaphores" : "vkWaitSemaphoresKHR");
+    mp_getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(
+        m_device, coreEntryPoints ? "vkGetSemaphoreCounterValue" : "vkGetSemaphoreCounterValueKHR");
+    if (!mp_waitSemaphores || !mp_getSemaphoreCounterValue)
+    {
+        throw std::runtime_error("Timeline semaphore entry points not found");
+    }
+
+    const VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,   // sType
+        nullptr,                                        // pNext
+        VK_SEMAPHORE_TYPE_TIMELINE,                     // semaphoreType
+        0                                               // initialValue
+    };
+
+    const VkSemaphoreCreateInfo semaphoreCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,    // sType
+        &semaphoreTypeCreateInfo,                   // pNext
+        0                                           // flags
+    };
+
+    CHECK_VK_RESULT_SUCCESS(vkCreateSemaphore(
+        m_device,               // device
+        &semaphoreCreateInfo,   // pCreateInfo
+        nullptr,                // pAllocator
+        &m_semaphore));         // pSemaphore
+}
+
+QueueTimeline::~QueueTimeline()
+{
+    // owner waits for the device to go idle first
+    vkDestroySemaphore(m_device, m_semaphore, nullptr);
+    for (const PendingFence& pending : m_pendingFences)
+    {
+        vkDestroyFence(m_device, pending.fence, nullptr);
+    }
+    for (VkFence fence : m_signaledFences)
+    {
+        vkDestroyFence(m_device, fence, nullptr);
+    }
+    for (VkFence fence : m_freeFences)
+    {
+        vkDestroyFence(m_device, fence, nullptr);
+    }
+}
+
+uint64_t QueueTimeline::submit(VkQueue queue, const VkSubmitInfo& submitInfo)
+{
+    const uint64_t value = m_submittedValue + 1;
+
+    if (!m_semaphore)
+    {
+        VkFence fence = acquireFence();
+        CHECK_VK_RESULT_SUCCESS(vkQueueSubmit(
+            queue,          // queue
+            1,              // submitCount
+            &submitInfo,    // pSubmits
+            fence));        // fence
+
+        m_pendingFences.push_back({ fence, value });
+        m_submittedValue = value;
+        return value;
+    }
+
+    // binary semaphores ignore their values, but every signal needs one
+    std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores,
+        submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+    signalSemaphores.push_back(m_semaphore);
+    std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+    signalValues.back() = value;
+
+    const VkTimelineSemaphoreSubmitInfo timelineSubmitInfo =
+    {
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,   // sType
+        submitInfo.pNext,                                   // pNext
+        0,                                                  // waitSemaphoreValueCount
+        nullptr,                                            // pWaitSemaphoreValues
+        (uint32_t)signalValues.size(),                      // signalSemaphoreValueCount
+        signalValues.data()                                 // pSignalSemaphoreValues
+    };
+
+    VkSubmitInfo timelineInfo = submitInfo;
+    timelineInfo.pNext = &timelineSubmitInfo;
+    timelineInfo.signalSemaphoreCount = (uint32_t)signalSemaphores.size();
+    timelineInfo.pSignalSemaphores = signalSemaphores.data();
+
+    CHECK_VK_RESULT_SUCCESS(vkQueueSubmit(
+        queue,          // queue
+        1,              // submitCount
+        &timelineInfo,  // pSubmits
+        nullptr));      // fence
+
+    m_submittedValue = value;
+    return value;
+}
+
+uint64_t QueueTimeline::getNextValue() const
+{
+    return m_submittedValue + 1;
+}
+
+uint64_t QueueTimeline::getLastSubmittedValue() const
+{
+    return m_submittedValue;
+}
+
+uint64_t QueueTimeline::getCompletedValue()
+{
+    if (!m_semaphore)
+    {
+        pollFences();
+        return m_completedValue;
+    }
+
+    uint64_t value = 0;
+    if (CHECK_VK_RESULT_SUCCESS(mp_getSemaphoreCounterValue(
+        m_device,       // device
+        m_semaphore,    // semaphore
+        &value)))       // pValue
+    {
+        m_completedValue = std::max(m_completedValue, value);
+    }
+    return m_completedValue;
+}
+
+bool QueueTimeline::wait(const uint64_t value, const uint64_t timeout)
+{
+    assert(value <= m_submittedValue);
+    if (value <= m_completedValue)
+    {
+        return true;
+    }
+
+    if (!m_semaphore)
+    {
+        // fences signal in submission order, the first one at
+        // or past the value is enough
+        const auto iter = std::find_if(m_pendingFences.begin(), m_pendingFences.end(),
+            [value](const PendingFence& pending) { return pending.value >= value; });
+        assert(iter != m_pendingFences.end());
+
+        if (!CHECK_VK_RESULT_SUCCESS(vkWaitForFences(
+            m_device,       // device
+            1,              // fenceCount
+            &iter->fence,   // pFences
+            VK_TRUE,        // waitAll
+            timeout)))      // timeout
+        {
+            return false;
+        }
+        pollFences();
+        return true;
+    }
+
+    const VkSemaphoreWaitInfo semaphoreWaitInfo =
+    {
+        VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,  // sType
+        nullptr,                                // pNext
+        0,                                      // flags
+        1,                                      // semaphoreCount
+        &m_semaphore,                           // pSemaphores
+        &value                                  // pValues
+    };
+
+    if (!CHECK_VK_RESULT_SUCCESS(mp_waitSemaphores(
+        m_device,               // device
+        &semaphoreWaitInfo,     // pWaitInfo
+        timeout)))              // timeout
+    {
+        return false;
+    }
+    m_completedValue = std::max(m_completedValue, value);
+    return true;
+}
+
+bool QueueTimeline::isTimelineSemaphore() const
+{
+    return m_semaphore != nullptr;
+}
+
+VkSemaphore QueueTimeline::getSemaphore() const
+{
+    return m_semaphore;
+}
+
+VkFence QueueTimeline::acquireFence()
+{
+    if (m_freeFences.empty() && !m_signaledFences.empty())
+    {
+        CHECK_VK_RESULT_SUCCESS(vkResetFences(
+            m_device,                               // device
+            (uint32_t)m_signaledFences.size(),      // fenceCount
+            m_signaledFences.data()));              // pFences
+        m_freeFences.swap(m_signaledFences);
+    }
+
+    if (!m_freeFences.empty())
+    {
+        VkFence fence = m_freeFences.back();
+        m_freeFences.pop_back();
+        return fence;
+    }
+
+    constexpr VkFenceCreateInfo fenceCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,    // sType
+        nullptr,                                // pNext
+        0                                       // flags
+    };
+
+    VkFence fence = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkCreateFence(
+        m_device,           // device
+        &fenceCreateInfo,   // pCreateInfo
+        nullptr,            // pAllocator
+        &fence));           // pFence
+    return fence;
+}
+
+void QueueTimeline::pollFences()
+{
+    while (!m_pendingFences.empty())
+    {
+        const PendingFence& pending = m_pendingFences.front();
+        if (!CHECK_VK_RESULT_SUCCESS(vkGetFenceStatus(
+            m_device,           // device
+            pending.fence)))    // fence
+        {
+            break;
+        }
+        m_completedValue = std::max(m_completedValue, pending.value);
+        m_signaledFences.push_back(pending.fence);
+        m_pendingFences.pop_front();
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
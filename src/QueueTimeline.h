@@ -0,0 +1,83 @@
+#ifndef CORE_QUEUE_TIMELINE_H
+#define CORE_QUEUE_TIMELINE_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Completion of the work submitted to a queue as one increasing value.
+// Every submit gets the next value, waiting for work is waiting for its
+// value and everything with a smaller value is done too. With timeline
+// semaphores the queue signals its semaphore to the value, which other
+// queues can also wait for. Without them each submit signals a fence
+// from a pool, fences are reset in batches when they are recycled.
+class QueueTimeline
+{
+public:
+    // timelineSemaphore: the feature is enabled on the device,
+    // core from 1.2 and VK_KHR_timeline_semaphore before
+    QueueTimeline(VkDevice device, const bool timelineSemaphore, const bool coreEntryPoints);
+    ~QueueTimeline();
+
+    QueueTimeline(const QueueTimeline&) = delete;
+    QueueTimeline& operator=(const QueueTimeline&) = delete;
+
+    // submits with the signal of the returned value added,
+    // pNext of submitInfo must not have timeline values already
+    uint64_t submit(VkQueue queue, const VkSubmitInfo& submitInfo);
+
+    // value of the next submit, values start from 1
+    uint64_t getNextValue() const;
+    uint64_t getLastSubmittedValue() const;
+    // largest value the gpu has completed, polls without blocking
+    uint64_t getCompletedValue();
+
+    // false if the timeout elapsed first, values not submitted yet are an error
+    bool wait(const uint64_t value, const uint64_t timeout);
+
+    bool isTimelineSemaphore() const;
+    // nullptr without timeline semaphores
+    VkSemaphore getSemaphore() const;
+
+private:
+    struct PendingFence
+    {
+        VkFence fence   = nullptr;
+        uint64_t value  = 0;
+    };
+
+    VkFence acquireFence();
+    // moves signaled fences to the free list
+    void pollFences();
+
+    VkDevice m_device = nullptr;
+
+    VkSemaphore m_semaphore = nullptr;
+    PFN_vkWaitSemaphores mp_waitSemaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValue mp_getSemaphoreCounterValue = nullptr;
+
+    uint64_t m_submittedValue = 0;
+    uint64_t m_completedValue = 0;
+
+    // fallback, in submission order
+    std::deque<PendingFence> m_pendingFences;
+    // signaled, reset together before reuse
+    std::vector<VkFence> m_signaledFences;
+    std::vector<VkFence> m_freeFences;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_QUEUE_TIMELINE_H
@@ -0,0 +1,713 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "RenderGraph.h"
+
+#include "ErrorHandling.h"
+#include "MemoryBudget.h"
+#include "RenderPassBuilder.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <iomanip>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+struct AccessInfo
+{
+    VkImageLayout layout;
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+};
+
+static AccessInfo getAccessInfo(const RenderGraph::Access access)
+{
+    switch (access)
+    {
+    case RenderGraph::Access::ColorAttachmentWrite:
+        return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+    case RenderGraph::Access::DepthAttachmentWrite:
+        return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+    case RenderGraph::Access::TransferRead:
+        return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT };
+    case RenderGraph::Access::TransferWrite:
+        return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT };
+    case RenderGraph::Access::FragmentShaderRead:
+        return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT };
+    }
+    assert(false);
+    return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0 };
+}
+
+static uint32_t findMemoryTypeIndex(
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    const uint32_t memoryTypeBits,
+    const VkMemoryPropertyFlags propertyFlags)
+{
+    for (uint32_t idx = 0; idx < memoryProperties.memoryTypeCount; ++idx)
+    {
+        if ((memoryTypeBits & (1u << idx))
+            && (memoryProperties.memoryTypes[idx].propertyFlags & propertyFlags) == propertyFlags)
+        {
+            return idx;
+        }
+    }
+    return ~0u;
+}
+
+static void recordBarriers(VkCommandBuffer cmdBuffer,
+    const std::vector<VkImageMemoryBarrier>& imageBarriers,
+    const VkPipelineStageFlags srcStageMask,
+    const VkPipelineStageFlags dstStageMask)
+{
+    if (imageBarriers.empty())
+    {
+        return;
+    }
+
+    vkCmdPipelineBarrier(
+        cmdBuffer,                                                      // commandBuffer
+        srcStageMask ? srcStageMask
+            : (VkPipelineStageFlags)VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  // srcStageMask
+        dstStageMask,                                                   // dstStageMask
+        0,                                                              // dependencyFlags
+        0,                                                              // memoryBarrierCount
+        nullptr,                                                        // pMemoryBarriers
+        0,                                                              // bufferMemoryBarrierCount
+        nullptr,                                                        // pBufferMemoryBarriers
+        (uint32_t)imageBarriers.size(),                                 // imageMemoryBarrierCount
+        imageBarriers.data());                                          // pImageMemoryBarriers
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::~RenderGraph()
+{
+    destroy();
+}
+
+RenderGraph::ResourceId RenderGraph::importImage(const std::string& name,
+    VkImage image, VkImageView imageView, const ImageDesc& desc,
+    const VkImageLayout initialLayout, const VkPipelineStageFlags srcStage,
+    const VkImageLayout finalLayout)
+{
+    assert(!m_compiled);
+    assert(image);
+
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = true;
+    resource.image = image;
+    resource.imageView = imageView;
+    resource.initialLayout = initialLayout;
+    resource.initialStage = srcStage;
+    resource.finalLayout = finalLayout;
+    m_resources.push_back(resource);
+
+    return (ResourceId)(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::createImage(const std::string& name, const ImageDesc& desc)
+{
+    assert(!m_compiled);
+    assert(desc.extent.width > 0 && desc.extent.height > 0);
+
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    m_resources.push_back(resource);
+
+    return (ResourceId)(m_resources.size() - 1);
+}
+
+RenderGraph::PassId RenderGraph::addPass(const std::string& name, ExecuteFunc func)
+{
+    assert(!m_compiled);
+
+    Pass pass;
+    pass.name = name;
+    pass.func = std::move(func);
+    m_passes.push_back(std::move(pass));
+
+    return (PassId)(m_passes.size() - 1);
+}
+
+void RenderGraph::read(const PassId pass, const ResourceId resource, const Access access)
+{
+    assert(pass < m_passes.size() && resource < m_resources.size());
+    m_passes[pass].uses.push_back({ resource, access, false });
+}
+
+void RenderGraph::write(const PassId pass, const ResourceId resource, const Access access)
+{
+    assert(pass < m_passes.size() && resource < m_resources.size());
+    m_passes[pass].uses.push_back({ resource, access, true });
+}
+
+void RenderGraph::setSideEffects(const PassId pass)
+{
+    assert(pass < m_passes.size());
+    m_passes[pass].sideEffects = true;
+}
+
+void RenderGraph::setRenderPass(const PassId pass, VkRenderPass renderPass,
+    std::initializer_list<ResourceId> attachments)
+{
+    assert(pass < m_passes.size());
+    m_passes[pass].renderPass = renderPass;
+    m_passes[pass].attachments = attachments;
+}
+
+void RenderGraph::compile(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    MemoryBudget* const p_memoryBudget)
+{
+    assert(!m_compiled);
+    m_device = device;
+    mp_memoryBudget = p_memoryBudget;
+
+    cullPasses();
+    allocateTransients(memoryProperties);
+    createFramebuffers();
+    computeBarriers();
+
+    m_compiled = true;
+}
+
+void RenderGraph::cullPasses()
+{
+    // walk backwards from the outputs, a pass is needed
+    // if it writes something a later needed pass or an output uses
+    std::vector<bool> needed(m_resources.size(), false);
+    for (size_t idx = 0; idx < m_resources.size(); ++idx)
+    {
+        needed[idx] = m_resources[idx].imported
+            && (m_resources[idx].finalLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+    }
+
+    for (size_t passIdx = m_passes.size(); passIdx-- > 0;)
+    {
+        Pass& pass = m_passes[passIdx];
+
+        pass.culled = !pass.sideEffects;
+        for (const ResourceUse& use : pass.uses)
+        {
+            if (use.write && needed[use.resource])
+            {
+                pass.culled = false;
+            }
+        }
+
+        if (!pass.culled)
+        {
+            for (const ResourceUse& use : pass.uses)
+            {
+                if (!use.write)
+                {
+                    needed[use.resource] = true;
+                }
+            }
+        }
+    }
+
+    for (PassId passIdx = 0; passIdx < m_passes.size(); ++passIdx)
+    {
+        if (m_passes[passIdx].culled)
+        {
+            continue;
+        }
+        for (const ResourceUse& use : m_passes[passIdx].uses)
+        {
+            Resource& resource = m_resources[use.resource];
+            resource.firstPass = std::min(resource.firstPass, passIdx);
+            resource.lastPass = std::max(resource.lastPass, passIdx);
+        }
+    }
+}
+
+void RenderGraph::allocateTransients(const VkPhysicalDeviceMemoryProperties& memoryProperties)
+{
+    std::vector<ResourceId> transients;
+    for (ResourceId idx = 0; idx < m_resources.size(); ++idx)
+    {
+        Resource& resource = m_resources[idx];
+        if (resource.imported || resource.firstPass > resource.lastPass)
+        {
+            continue;
+        }
+
+        const VkImageCreateInfo imageCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,    // sType
+            nullptr,                                // pNext
+            0,                                      // flags
+            VK_IMAGE_TYPE_2D,                       // imageType
+            resource.desc.format,                   // format
+            { resource.desc.extent.width, resource.desc.extent.height, 1 }, // extent
+            1,                                      // mipLevels
+            1,                                      // arrayLayers
+            resource.desc.samples,                  // samples
+            VK_IMAGE_TILING_OPTIMAL,                // tiling
+            resource.desc.usage,                    // usage
+            VK_SHARING_MODE_EXCLUSIVE,              // sharingMode
+            0,                                      // queueFamilyIndexCount
+            nullptr,                                // pQueueFamilyIndices
+            VK_IMAGE_LAYOUT_UNDEFINED               // initialLayout
+        };
+
+        CHECK_VK_RESULT_SUCCESS(vkCreateImage(
+            m_device,           // device
+            &imageCreateInfo,   // pCreateInfo
+            nullptr,            // pAllocator
+            &resource.image));  // pImage
+
+        transients.push_back(idx);
+    }
+
+    // largest first, each image goes to the first compatible block
+    // where no other image is alive during its passes
+    std::vector<VkMemoryRequirements> requirements(m_resources.size());
+    for (const ResourceId idx : transients)
+    {
+        vkGetImageMemoryRequirements(m_device, m_resources[idx].image, &requirements[idx]);
+    }
+    std::stable_sort(transients.begin(), transients.end(),
+        [&requirements](const ResourceId lhs, const ResourceId rhs)
+    {
+        return requirements[lhs].size > requirements[rhs].size;
+    });
+
+    std::vector<bool> lazyBlocks;
+    for (const ResourceId idx : transients)
+    {
+        Resource& resource = m_resources[idx];
+        const VkMemoryRequirements& req = requirements[idx];
+
+        // transient attachments take lazily allocated memory when there is
+        // such, it may never be backed so it is not shared
+        uint32_t memoryTypeIndex = ~0u;
+        bool lazy = false;
+        if (resource.desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+        {
+            memoryTypeIndex = findMemoryTypeIndex(memoryProperties, req.memoryTypeBits,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+            lazy = (memoryTypeIndex != ~0u);
+        }
+        if (memoryTypeIndex == ~0u)
+        {
+            memoryTypeIndex = findMemoryTypeIndex(memoryProperties, req.memoryTypeBits,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+        if (memoryTypeIndex == ~0u)
+        {
+            throw std::runtime_error("No memory type for render graph image " + resource.name);
+        }
+
+        for (uint32_t blockIdx = 0; !lazy && blockIdx < m_memoryBlocks.size(); ++blockIdx)
+        {
+            const MemoryBlock& block = m_memoryBlocks[blockIdx];
+            if (lazyBlocks[blockIdx] || block.memoryTypeIndex != memoryTypeIndex)
+            {
+                continue;
+            }
+
+            bool overlaps = false;
+            for (const ResourceId other : block.resources)
+            {
+                overlaps |= (resource.firstPass <= m_resources[other].lastPass)
+                    && (m_resources[other].firstPass <= resource.lastPass);
+            }
+            if (!overlaps)
+            {
+                resource.memoryBlock = blockIdx;
+                break;
+            }
+        }
+
+        if (resource.memoryBlock == ~0u)
+        {
+            resource.memoryBlock = (uint32_t)m_memoryBlocks.size();
+            MemoryBlock block;
+            block.memoryTypeIndex = memoryTypeIndex;
+            m_memoryBlocks.push_back(block);
+            lazyBlocks.push_back(lazy);
+        }
+
+        MemoryBlock& block = m_memoryBlocks[resource.memoryBlock];
+        block.size = std::max(block.size, req.size);
+        block.resources.push_back(idx);
+    }
+
+    for (MemoryBlock& block : m_memoryBlocks)
+    {
+        const VkMemoryAllocateInfo memoryAllocateInfo =
+        {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, // sType
+            nullptr,                                // pNext
+            block.size,                             // allocationSize
+            block.memoryTypeIndex                   // memoryTypeIndex
+        };
+
+        CHECK_VK_RESULT_SUCCESS(vkAllocateMemory(
+            m_device,               // device
+            &memoryAllocateInfo,    // pAllocateInfo
+            nullptr,                // pAllocator
+            &block.memory));        // pMemory
+
+        if (mp_memoryBudget)
+        {
+            mp_memoryBudget->onAllocate(block.memory, block.memoryTypeIndex,
+                block.size, MemoryBudget::Category::RenderTargets);
+        }
+
+        std::sort(block.resources.begin(), block.resources.end(),
+            [this](const ResourceId lhs, const ResourceId rhs)
+        {
+            return m_resources[lhs].firstPass < m_resources[rhs].firstPass;
+        });
+
+        for (size_t idx = 0; idx < block.resources.size(); ++idx)
+        {
+            Resource& resource = m_resources[block.resources[idx]];
+            if (idx > 0)
+            {
+                resource.aliasedAfter = block.resources[idx - 1];
+            }
+
+            CHECK_VK_RESULT_SUCCESS(vkBindImageMemory(
+                m_device,       // device
+                resource.image, // image
+                block.memory,   // memory
+                0));            // memoryOffset
+
+            const VkImageViewCreateInfo imageViewCreateInfo =
+            {
+                VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,   // sType
+                nullptr,                                    // pNext
+                0,                                          // flags
+                resource.image,                             // image
+                VK_IMAGE_VIEW_TYPE_2D,                      // viewType
+                resource.desc.format,                       // format
+                {
+                    VK_COMPONENT_SWIZZLE_IDENTITY,
+                    VK_COMPONENT_SWIZZLE_IDENTITY,
+                    VK_COMPONENT_SWIZZLE_IDENTITY,
+                    VK_COMPONENT_SWIZZLE_IDENTITY
+                },                                          // components
+                {
+                    RenderPassBuilder::getAspectMask(resource.desc.format),
+                    0, 1, 0, 1
+                }                                           // subresourceRange
+            };
+
+            CHECK_VK_RESULT_SUCCESS(vkCreateImageView(
+                m_device,               // device
+                &imageViewCreateInfo,   // pCreateInfo
+                nullptr,                // pAllocator
+                &resource.imageView));  // pView
+        }
+    }
+}
+
+void RenderGraph::createFramebuffers()
+{
+    for (Pass& pass : m_passes)
+    {
+        if (pass.culled || !pass.renderPass)
+        {
+            continue;
+        }
+        assert(!pass.attachments.empty());
+
+        std::vector<VkImageView> imageViews;
+        for (const ResourceId resource : pass.attachments)
+        {
+            imageViews.push_back(m_resources[resource].imageView);
+        }
+        const VkExtent2D extent = m_resources[pass.attachments[0]].desc.extent;
+
+        const VkFramebufferCreateInfo framebufferCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+            nullptr,                                    // pNext
+            0,                                          // flags
+            pass.renderPass,                            // renderPass
+            (uint32_t)imageViews.size(),                // attachmentCount
+            imageViews.data(),                          // pAttachments
+            extent.width,                               // width
+            extent.height,                              // height
+            1,                                          // layers
+        };
+
+        CHECK_VK_RESULT_SUCCESS(vkCreateFramebuffer(
+            m_device,                   // device
+            &framebufferCreateInfo,     // pCreateInfo
+            nullptr,                    // pAllocator
+            &pass.framebuffer));        // pFramebuffer
+    }
+}
+
+void RenderGraph::computeBarriers()
+{
+    struct State
+    {
+        VkImageLayout layout;
+        VkPipelineStageFlags stage;
+        VkAccessFlags access;
+        bool written;
+    };
+
+    std::vector<State> states(m_resources.size());
+    for (size_t idx = 0; idx < m_resources.size(); ++idx)
+    {
+        states[idx] = { m_resources[idx].initialLayout, m_resources[idx].initialStage, 0, false };
+    }
+
+    for (PassId passIdx = 0; passIdx < m_passes.size(); ++passIdx)
+    {
+        Pass& pass = m_passes[passIdx];
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        for (const ResourceUse& use : pass.uses)
+        {
+            const Resource& resource = m_resources[use.resource];
+            const AccessInfo info = getAccessInfo(use.access);
+            State& state = states[use.resource];
+
+            // first use of aliased memory waits for the previous image
+            // and discards the contents
+            if (passIdx == resource.firstPass && resource.aliasedAfter != ~0u)
+            {
+                const State& previous = states[resource.aliasedAfter];
+                state = { VK_IMAGE_LAYOUT_UNDEFINED, previous.stage,
+                    previous.written ? previous.access : 0, previous.written };
+            }
+
+            // read after read in the same layout needs nothing
+            if (state.layout == info.layout && !state.written && !use.write)
+            {
+                state.stage |= info.stage;
+                continue;
+            }
+
+            const VkImageMemoryBarrier imageBarrier =
+            {
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,     // sType
+                nullptr,                                    // pNext
+                state.written ? state.access : 0u,          // srcAccessMask
+                info.access,                                // dstAccessMask
+                state.layout,                               // oldLayout
+                info.layout,                                // newLayout
+                VK_QUEUE_FAMILY_IGNORED,                    // srcQueueFamilyIndex
+                VK_QUEUE_FAMILY_IGNORED,                    // dstQueueFamilyIndex
+                resource.image,                             // image
+                {
+                    RenderPassBuilder::getAspectMask(resource.desc.format),
+                    0, 1, 0, 1
+                }                                           // subresourceRange
+            };
+
+            pass.barriers.imageBarriers.push_back(imageBarrier);
+            pass.barriers.srcStageMask |= state.stage;
+            pass.barriers.dstStageMask |= info.stage;
+
+            state = { info.layout, info.stage, info.access, use.write };
+        }
+    }
+
+    for (size_t idx = 0; idx < m_resources.size(); ++idx)
+    {
+        const Resource& resource = m_resources[idx];
+        const State& state = states[idx];
+        if (!resource.imported
+            || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED
+            || resource.finalLayout == state.layout)
+        {
+            continue;
+        }
+
+        const VkImageMemoryBarrier imageBarrier =
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,     // sType
+            nullptr,                                    // pNext
+            state.written ? state.access : 0u,          // srcAccessMask
+            0,                                          // dstAccessMask
+            state.layout,                               // oldLayout
+            resource.finalLayout,                       // newLayout
+            VK_QUEUE_FAMILY_IGNORED,                    // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                    // dstQueueFamilyIndex
+            resource.image,                             // image
+            {
+                RenderPassBuilder::getAspectMask(resource.desc.format),
+                0, 1, 0, 1
+            }                                           // subresourceRange
+        };
+
+        m_finalBarriers.imageBarriers.push_back(imageBarrier);
+        m_finalBarriers.srcStageMask |= state.stage;
+        m_finalBarriers.dstStageMask |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+}
+
+void RenderGraph::execute(VkCommandBuffer cmdBuffer, const PassHook& passHook) const
+{
+    assert(m_compiled);
+
+    for (PassId passId = 0; passId < (PassId)m_passes.size(); ++passId)
+    {
+        const Pass& pass = m_passes[passId];
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        recordBarriers(cmdBuffer, pass.barriers.imageBarriers,
+            pass.barriers.srcStageMask, pass.barriers.dstStageMask);
+
+        if (passHook)
+        {
+            passHook(cmdBuffer, passId, true);
+        }
+
+        PassContext context;
+        context.cmdBuffer = cmdBuffer;
+        context.framebuffer = pass.framebuffer;
+        context.graph = this;
+        pass.func(context);
+
+        if (passHook)
+        {
+            passHook(cmdBuffer, passId, false);
+        }
+    }
+
+    recordBarriers(cmdBuffer, m_finalBarriers.imageBarriers,
+        m_finalBarriers.srcStageMask, m_finalBarriers.dstStageMask);
+}
+
+VkImage RenderGraph::getImage(const ResourceId resource) const
+{
+    assert(resource < m_resources.size());
+    return m_resources[resource].image;
+}
+
+VkImageView RenderGraph::getImageView(const ResourceId resource) const
+{
+    assert(resource < m_resources.size());
+    return m_resources[resource].imageView;
+}
+
+const RenderGraph::ImageDesc& RenderGraph::getImageDesc(const ResourceId resource) const
+{
+    assert(resource < m_resources.size());
+    return m_resources[resource].desc;
+}
+
+const std::string& RenderGraph::getPassName(const PassId pass) const
+{
+    assert(pass < m_passes.size());
+    return m_passes[pass].name;
+}
+
+void RenderGraph::destroy()
+{
+    if (!m_device)
+    {
+        return;
+    }
+
+    for (Pass& pass : m_passes)
+    {
+        vkDestroyFramebuffer(m_device, pass.framebuffer, nullptr);
+        pass.framebuffer = nullptr;
+    }
+
+    for (Resource& resource : m_resources)
+    {
+        if (!resource.imported)
+        {
+            vkDestroyImageView(m_device, resource.imageView, nullptr);
+            vkDestroyImage(m_device, resource.image, nullptr);
+            resource.imageView = nullptr;
+            resource.image = nullptr;
+        }
+    }
+
+    for (MemoryBlock& block : m_memoryBlocks)
+    {
+        if (mp_memoryBudget)
+        {
+            mp_memoryBudget->onFree(block.memory);
+        }
+        vkFreeMemory(m_device, block.memory, nullptr);
+    }
+    m_memoryBlocks.clear();
+
+    m_device = nullptr;
+}
+
+void RenderGraph::printReport(std::ostream& out) const
+{
+    size_t nameWidth = 4;
+    for (const auto& ref : m_passes)
+    {
+        nameWidth = std::max(nameWidth, ref.name.size());
+    }
+    for (const auto& ref : m_resources)
+    {
+        nameWidth = std::max(nameWidth, ref.name.size());
+    }
+
+    out << std::left << std::setw(nameWidth) << "pass" << std::right
+        << std::setw(10) << "barriers" << "  state" << std::endl;
+    for (const auto& ref : m_passes)
+    {
+        out << std::left << std::setw(nameWidth) << ref.name << std::right
+            << std::setw(10) << ref.barriers.imageBarriers.size()
+            << "  " << (ref.culled ? "culled" : "live") << std::endl;
+    }
+    out << std::left << std::setw(nameWidth) << "final" << std::right
+        << std::setw(10) << m_finalBarriers.imageBarriers.size() << std::endl;
+
+    VkDeviceSize aliasedSize = 0;
+    VkDeviceSize unaliasedSize = 0;
+    for (uint32_t blockIdx = 0; blockIdx < m_memoryBlocks.size(); ++blockIdx)
+    {
+        const MemoryBlock& block = m_memoryBlocks[blockIdx];
+        aliasedSize += block.size;
+        for (const ResourceId idx : block.resources)
+        {
+            const Resource& resource = m_resources[idx];
+            VkMemoryRequirements req;
+            vkGetImageMemoryRequirements(m_device, resource.image, &req);
+            unaliasedSize += req.size;
+
+            out << std::left << std::setw(nameWidth) << resource.name << std::right
+                << "  block " << blockIdx << ", passes " << resource.firstPass
+                << "-" << resource.lastPass << ", " << (req.size >> 10) << " KiB" << std::endl;
+        }
+    }
+    out << "transient memory " << (aliasedSize >> 10) << " KiB, without aliasing "
+        << (unaliasedSize >> 10) << " KiB" << std::endl;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
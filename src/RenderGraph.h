@@ -0,0 +1,197 @@
+#ifndef CORE_RENDER_GRAPH_H
+#define CORE_RENDER_GRAPH_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+class MemoryBudget;
+
+// Frame as a list of passes that declare how they use images.
+// compile() culls passes that do not contribute to an output,
+// creates transient images with memory aliased between images whose
+// lifetimes do not overlap, creates framebuffers and precomputes the
+// barriers and layout transitions between passes. execute() then only
+// records barriers and calls the pass functions, so a compiled graph
+// is meant to be reused frame after frame.
+//
+// Render passes used with the graph must keep their attachments in
+// the access layout, i.e. finalLayout COLOR_ATTACHMENT_OPTIMAL for
+// color and DEPTH_STENCIL_ATTACHMENT_OPTIMAL for depth attachments.
+// Transitions around the pass are done by the graph. Passes merged as
+// subpasses of one render pass (see RenderPassBuilder) are a single
+// graph pass whose function steps through them with vkCmdNextSubpass.
+class RenderGraph
+{
+public:
+    typedef uint32_t ResourceId;
+    typedef uint32_t PassId;
+
+    enum class Access
+    {
+        ColorAttachmentWrite,
+        DepthAttachmentWrite,
+        TransferRead,
+        TransferWrite,
+        FragmentShaderRead,
+    };
+
+    struct ImageDesc
+    {
+        VkFormat format             = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent           = { 0, 0 };
+        VkImageUsageFlags usage     = 0;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    };
+
+    struct PassContext
+    {
+        VkCommandBuffer cmdBuffer   = nullptr;
+        // created by compile() for passes with a render pass
+        VkFramebuffer framebuffer   = nullptr;
+        const RenderGraph* graph    = nullptr;
+    };
+
+    typedef std::function<void(const PassContext&)> ExecuteFunc;
+    // called before and after each pass that is not culled,
+    // outside render passes, e.g. for queries
+    typedef std::function<void(VkCommandBuffer cmdBuffer, const PassId pass, const bool begin)> PassHook;
+
+    RenderGraph() = default;
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // external image, e.g. a swapchain image. srcStage is the stage the
+    // image becomes available at, like the acquire semaphore wait stage.
+    // finalLayout other than UNDEFINED makes the image a graph output.
+    ResourceId importImage(const std::string& name, VkImage image, VkImageView imageView,
+        const ImageDesc& desc, const VkImageLayout initialLayout,
+        const VkPipelineStageFlags srcStage, const VkImageLayout finalLayout);
+
+    // created and owned by the graph, contents live only within the frame
+    ResourceId createImage(const std::string& name, const ImageDesc& desc);
+
+    PassId addPass(const std::string& name, ExecuteFunc func);
+    void read(const PassId pass, const ResourceId resource, const Access access);
+    void write(const PassId pass, const ResourceId resource, const Access access);
+
+    // pass has effects outside the graph, e.g. copies to a readback
+    // buffer, and is never culled
+    void setSideEffects(const PassId pass);
+
+    // framebuffer of attachments is created for the pass
+    void setRenderPass(const PassId pass, VkRenderPass renderPass,
+        std::initializer_list<ResourceId> attachments);
+
+    // transient memory is reported to the budget, if one is given
+    void compile(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+        MemoryBudget* const p_memoryBudget = nullptr);
+    void execute(VkCommandBuffer cmdBuffer, const PassHook& passHook = nullptr) const;
+
+    VkImage getImage(const ResourceId resource) const;
+    VkImageView getImageView(const ResourceId resource) const;
+    const ImageDesc& getImageDesc(const ResourceId resource) const;
+    const std::string& getPassName(const PassId pass) const;
+
+    // passes, culling, barriers and transient memory with aliasing
+    void printReport(std::ostream& out) const;
+
+private:
+    struct ResourceUse
+    {
+        ResourceId resource = 0;
+        Access access       = Access::TransferRead;
+        bool write          = false;
+    };
+
+    struct Barriers
+    {
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        VkPipelineStageFlags srcStageMask = 0;
+        VkPipelineStageFlags dstStageMask = 0;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        ExecuteFunc func;
+        std::vector<ResourceUse> uses;
+
+        VkRenderPass renderPass = nullptr;
+        std::vector<ResourceId> attachments;
+        VkFramebuffer framebuffer = nullptr;
+
+        bool sideEffects = false;
+        bool culled = false;
+        Barriers barriers;
+    };
+
+    struct Resource
+    {
+        std::string name;
+        ImageDesc desc;
+        bool imported = false;
+
+        VkImage image = nullptr;
+        VkImageView imageView = nullptr;
+
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags initialStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        // live pass range, firstPass > lastPass if unused
+        PassId firstPass = ~0u;
+        PassId lastPass = 0;
+
+        // transient memory block and the previous image aliasing it
+        uint32_t memoryBlock = ~0u;
+        ResourceId aliasedAfter = ~0u;
+    };
+
+    struct MemoryBlock
+    {
+        VkDeviceMemory memory = nullptr;
+        VkDeviceSize size = 0;
+        uint32_t memoryTypeIndex = 0;
+        // resources in lifetime order
+        std::vector<ResourceId> resources;
+    };
+
+    void cullPasses();
+    void allocateTransients(const VkPhysicalDeviceMemoryProperties& memoryProperties);
+    void createFramebuffers();
+    void computeBarriers();
+    void destroy();
+
+    VkDevice m_device = nullptr;
+    MemoryBudget* mp_memoryBudget = nullptr;
+    bool m_compiled = false;
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<MemoryBlock> m_memoryBlocks;
+
+    // transitions of imported images to their final layout
+    Barriers m_finalBarriers;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_RENDER_GRAPH_H
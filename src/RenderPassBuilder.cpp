@@ -0,0 +1,460 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "RenderPassBuilder.h"
+
+#include "ErrorHandling.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// most precise first, 24-bit depth is packed with
+// stencil or padding so 32-bit float costs no more
+static const VkFormat s_depthFormats[] =
+{
+    VK_FORMAT_D32_SFLOAT,
+    VK_FORMAT_X8_D24_UNORM_PACK32,
+    VK_FORMAT_D16_UNORM,
+};
+
+static const VkFormat s_depthStencilFormats[] =
+{
+    VK_FORMAT_D32_SFLOAT_S8_UINT,
+    VK_FORMAT_D24_UNORM_S8_UINT,
+    VK_FORMAT_D16_UNORM_S8_UINT,
+};
+
+VkFormat RenderPassBuilder::findDepthFormat(VkPhysicalDevice physicalDevice, const bool stencil)
+{
+    const VkFormat* const p_begin = stencil ? std::begin(s_depthStencilFormats) : std::begin(s_depthFormats);
+    const VkFormat* const p_end = stencil ? std::end(s_depthStencilFormats) : std::end(s_depthFormats);
+    for (const VkFormat* p_format = p_begin; p_format != p_end; ++p_format)
+    {
+        VkFormatProperties formatProperties = {};
+        vkGetPhysicalDeviceFormatProperties(
+            physicalDevice,     // physicalDevice
+            *p_format,          // format
+            &formatProperties); // pFormatProperties
+
+        if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        {
+            return *p_format;
+        }
+    }
+    throw std::runtime_error(stencil ? "No depth stencil format" : "No depth format");
+}
+
+VkImageAspectFlags RenderPassBuilder::getAspectMask(const VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+RenderPassBuilder::AttachmentId RenderPassBuilder::addAttachment(const AttachmentDesc& desc)
+{
+    assert(desc.format != VK_FORMAT_UNDEFINED);
+    m_attachments.push_back(desc);
+    return (AttachmentId)(m_attachments.size() - 1);
+}
+
+RenderPassBuilder::SubpassId RenderPassBuilder::addSubpass()
+{
+    m_subpasses.push_back(Subpass());
+    return (SubpassId)(m_subpasses.size() - 1);
+}
+
+void RenderPassBuilder::addColor(const SubpassId subpass, const AttachmentId attachment,
+    const AttachmentId resolve)
+{
+    assert(subpass < m_subpasses.size() && attachment < m_attachments.size());
+    assert(resolve == c_noAttachment
+        || (resolve < m_attachments.size() && m_attachments[resolve].samples == VK_SAMPLE_COUNT_1_BIT));
+    m_subpasses[subpass].colors.push_back(attachment);
+    m_subpasses[subpass].resolves.push_back(resolve);
+}
+
+void RenderPassBuilder::setDepth(const SubpassId subpass, const AttachmentId attachment, const bool write)
+{
+    assert(subpass < m_subpasses.size() && attachment < m_attachments.size());
+    assert(getAspectMask(m_attachments[attachment].format) & VK_IMAGE_ASPECT_DEPTH_BIT);
+    m_subpasses[subpass].depth = attachment;
+    m_subpasses[subpass].depthWrite = write;
+}
+
+void RenderPassBuilder::addInput(const SubpassId subpass, const AttachmentId attachment)
+{
+    assert(subpass < m_subpasses.size() && attachment < m_attachments.size());
+    assert(subpass > 0 && "input attachments are written by an earlier subpass");
+    m_subpasses[subpass].inputs.push_back(attachment);
+}
+
+std::vector<RenderPassBuilder::AttachmentUse> RenderPassBuilder::getUses(const Subpass& subpass) const
+{
+    std::vector<AttachmentUse> uses;
+    for (const AttachmentId attachment : subpass.inputs)
+    {
+        uses.push_back({ attachment, Use::Input });
+    }
+    if (subpass.depth != c_noAttachment)
+    {
+        uses.push_back({ subpass.depth, subpass.depthWrite ? Use::DepthWrite : Use::DepthRead });
+    }
+    for (const AttachmentId attachment : subpass.colors)
+    {
+        uses.push_back({ attachment, Use::Color });
+    }
+    for (const AttachmentId attachment : subpass.resolves)
+    {
+        if (attachment != c_noAttachment)
+        {
+            uses.push_back({ attachment, Use::Resolve });
+        }
+    }
+    return uses;
+}
+
+VkImageLayout RenderPassBuilder::getLayout(const AttachmentUse& use) const
+{
+    switch (use.use)
+    {
+    case Use::Color:
+    case Use::Resolve:
+        return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    case Use::DepthWrite:
+        return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    case Use::DepthRead:
+        return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    case Use::Input:
+        return (getAspectMask(m_attachments[use.attachment].format) & VK_IMAGE_ASPECT_COLOR_BIT)
+            ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+    assert(false);
+    return VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+RenderPassBuilder::UseInfo RenderPassBuilder::getUseInfo(const Use use)
+{
+    UseInfo info;
+    switch (use)
+    {
+    case Use::Color:
+    case Use::Resolve:
+        info.stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        info.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        info.write = true;
+        break;
+    case Use::DepthWrite:
+    case Use::DepthRead:
+        info.stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        info.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        if (use == Use::DepthWrite)
+        {
+            info.access |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            info.write = true;
+        }
+        break;
+    case Use::Input:
+        info.stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        info.access = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        break;
+    }
+    return info;
+}
+
+VkRenderPass RenderPassBuilder::build(VkDevice device) const
+{
+    assert(!m_subpasses.empty());
+
+    // first and last subpass using each attachment, in their layouts
+    std::vector<SubpassId> firstSubpass(m_attachments.size(), ~0u);
+    std::vector<SubpassId> lastSubpass(m_attachments.size(), 0);
+    std::vector<VkImageLayout> firstLayout(m_attachments.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+    std::vector<VkImageLayout> lastLayout(m_attachments.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+
+    // last subpass writing each attachment and the ones reading it since
+    struct Access
+    {
+        SubpassId subpass = ~0u;
+        UseInfo info;
+    };
+    std::vector<Access> lastWrites(m_attachments.size());
+    std::vector<std::vector<Access>> reads(m_attachments.size());
+
+    std::vector<VkSubpassDependency> dependencies;
+    const auto addDependency = [&dependencies](const Access& src, const SubpassId dst, const UseInfo& dstInfo)
+    {
+        if (src.subpass == ~0u || src.subpass == dst)
+        {
+            return;
+        }
+        // write after read only waits for the reads to execute
+        const UseInfo& srcInfo = src.info;
+        const VkAccessFlags srcAccess = srcInfo.write ? srcInfo.access : 0u;
+        for (VkSubpassDependency& dependency : dependencies)
+        {
+            if (dependency.srcSubpass == src.subpass && dependency.dstSubpass == dst)
+            {
+                dependency.srcStageMask |= srcInfo.stage;
+                dependency.dstStageMask |= dstInfo.stage;
+                dependency.srcAccessMask |= srcAccess;
+                dependency.dstAccessMask |= dstInfo.access;
+                return;
+            }
+        }
+        const VkSubpassDependency dependency =
+        {
+            src.subpass,                    // srcSubpass
+            dst,                            // dstSubpass
+            srcInfo.stage,                  // srcStageMask
+            dstInfo.stage,                  // dstStageMask
+            srcAccess,                      // srcAccessMask
+            dstInfo.access,                 // dstAccessMask
+            VK_DEPENDENCY_BY_REGION_BIT     // dependencyFlags
+        };
+        dependencies.push_back(dependency);
+    };
+
+    for (SubpassId subpassIdx = 0; subpassIdx < (SubpassId)m_subpasses.size(); ++subpassIdx)
+    {
+        for (const AttachmentUse& use : getUses(m_subpasses[subpassIdx]))
+        {
+            const AttachmentId attachment = use.attachment;
+            const VkImageLayout layout = getLayout(use);
+            const UseInfo info = getUseInfo(use.use);
+
+            if (firstSubpass[attachment] == ~0u)
+            {
+                firstSubpass[attachment] = subpassIdx;
+                firstLayout[attachment] = layout;
+            }
+            else if (lastSubpass[attachment] == subpassIdx && lastLayout[attachment] != layout)
+            {
+                throw std::runtime_error("Attachment used in two layouts by one subpass");
+            }
+            lastSubpass[attachment] = subpassIdx;
+            lastLayout[attachment] = layout;
+
+            // reads wait for the last write, writes also for the reads since
+            addDependency(lastWrites[attachment], subpassIdx, info);
+            if (!info.write)
+            {
+                reads[attachment].push_back({ subpassIdx, info });
+                continue;
+            }
+            for (const Access& read : reads[attachment])
+            {
+                addDependency(read, subpassIdx, info);
+            }
+            reads[attachment].clear();
+            lastWrites[attachment] = { subpassIdx, info };
+        }
+    }
+
+    std::vector<VkAttachmentDescription> attachmentDescriptions;
+    for (AttachmentId idx = 0; idx < (AttachmentId)m_attachments.size(); ++idx)
+    {
+        const AttachmentDesc& desc = m_attachments[idx];
+        assert(firstSubpass[idx] != ~0u && "attachment is not used");
+
+        const bool hasStencil = (getAspectMask(desc.format) & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+        const VkAttachmentDescription attachmentDescription =
+        {
+            0,                                              // flags
+            desc.format,                                    // format
+            desc.samples,                                   // samples
+            getLoadOp(idx),                                 // loadOp
+            getStoreOp(idx),                                // storeOp
+            hasStencil
+                ? getLoadOp(idx)
+                : VK_ATTACHMENT_LOAD_OP_DONT_CARE,          // stencilLoadOp
+            hasStencil
+                ? getStoreOp(idx)
+                : VK_ATTACHMENT_STORE_OP_DONT_CARE,         // stencilStoreOp
+            desc.loadContents
+                ? firstLayout[idx]
+                : VK_IMAGE_LAYOUT_UNDEFINED,                // initialLayout
+            (desc.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+                ? desc.finalLayout
+                : lastLayout[idx]                           // finalLayout
+        };
+        attachmentDescriptions.push_back(attachmentDescription);
+    }
+
+    // references of all subpasses, the descriptions point into these
+    std::vector<std::vector<VkAttachmentReference>> colorReferences(m_subpasses.size());
+    std::vector<std::vector<VkAttachmentReference>> resolveReferences(m_subpasses.size());
+    std::vector<std::vector<VkAttachmentReference>> inputReferences(m_subpasses.size());
+    std::vector<VkAttachmentReference> depthReferences(m_subpasses.size());
+    std::vector<std::vector<uint32_t>> preserveAttachments(m_subpasses.size());
+
+    std::vector<VkSubpassDescription> subpassDescriptions;
+    for (SubpassId subpassIdx = 0; subpassIdx < (SubpassId)m_subpasses.size(); ++subpassIdx)
+    {
+        const Subpass& subpass = m_subpasses[subpassIdx];
+
+        bool resolved = false;
+        for (size_t idx = 0; idx < subpass.colors.size(); ++idx)
+        {
+            colorReferences[subpassIdx].push_back(
+                { subpass.colors[idx], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+            resolveReferences[subpassIdx].push_back(
+                { (subpass.resolves[idx] != c_noAttachment) ? subpass.resolves[idx] : VK_ATTACHMENT_UNUSED,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+            resolved |= (subpass.resolves[idx] != c_noAttachment);
+        }
+        for (const AttachmentId attachment : subpass.inputs)
+        {
+            inputReferences[subpassIdx].push_back(
+                { attachment, getLayout({ attachment, Use::Input }) });
+        }
+        if (subpass.depth != c_noAttachment)
+        {
+            depthReferences[subpassIdx] = { subpass.depth,
+                getLayout({ subpass.depth, subpass.depthWrite ? Use::DepthWrite : Use::DepthRead }) };
+        }
+
+        // contents a later subpass uses stay through the ones in between
+        for (AttachmentId attachment = 0; attachment < (AttachmentId)m_attachments.size(); ++attachment)
+        {
+            if (firstSubpass[attachment] < subpassIdx && subpassIdx < lastSubpass[attachment])
+            {
+                std::vector<AttachmentUse> uses = getUses(subpass);
+                if (std::none_of(uses.begin(), uses.end(),
+                    [attachment](const AttachmentUse& use) { return use.attachment == attachment; }))
+                {
+                    preserveAttachments[subpassIdx].push_back(attachment);
+                }
+            }
+        }
+
+        const VkSubpassDescription subpassDescription =
+        {
+            0,                                                  // flags
+            VK_PIPELINE_BIND_POINT_GRAPHICS,                    // pipelineBindPoint
+            (uint32_t)inputReferences[subpassIdx].size(),       // inputAttachmentCount
+            inputReferences[subpassIdx].data(),                 // pInputAttachments
+            (uint32_t)colorReferences[subpassIdx].size(),       // colorAttachmentCount
+            colorReferences[subpassIdx].data(),                 // pColorAttachments
+            resolved
+                ? resolveReferences[subpassIdx].data()
+                : nullptr,                                      // pResolveAttachments
+            (subpass.depth != c_noAttachment)
+                ? &depthReferences[subpassIdx]
+                : nullptr,                                      // pDepthStencilAttachment
+            (uint32_t)preserveAttachments[subpassIdx].size(),   // preserveAttachmentCount
+            preserveAttachments[subpassIdx].data()              // pPreserveAttachments
+        };
+        subpassDescriptions.push_back(subpassDescription);
+    }
+
+    const VkRenderPassCreateInfo createInfo =
+    {
+        VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        (uint32_t)attachmentDescriptions.size(),    // attachmentCount
+        attachmentDescriptions.data(),              // pAttachments
+        (uint32_t)subpassDescriptions.size(),       // subpassCount
+        subpassDescriptions.data(),                 // pSubpasses
+        (uint32_t)dependencies.size(),              // dependencyCount
+        dependencies.data(),                        // pDependencies
+    };
+
+    VkRenderPass renderPass = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkCreateRenderPass(
+        device,             // device
+        &createInfo,        // pCreateInfo
+        nullptr,            // pAllocator
+        &renderPass));      // pRenderPass
+    return renderPass;
+}
+
+VkImageUsageFlags RenderPassBuilder::getImageUsage(const AttachmentId attachment) const
+{
+    assert(attachment < m_attachments.size());
+
+    VkImageUsageFlags usage = 0;
+    for (const Subpass& subpass : m_subpasses)
+    {
+        for (const AttachmentUse& use : getUses(subpass))
+        {
+            if (use.attachment != attachment)
+            {
+                continue;
+            }
+            switch (use.use)
+            {
+            case Use::Color:
+            case Use::Resolve:
+                usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                break;
+            case Use::DepthWrite:
+            case Use::DepthRead:
+                usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                break;
+            case Use::Input:
+                usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+                break;
+            }
+        }
+    }
+    if (isTransient(attachment))
+    {
+        usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+    return usage;
+}
+
+bool RenderPassBuilder::isTransient(const AttachmentId attachment) const
+{
+    assert(attachment < m_attachments.size());
+    return !m_attachments[attachment].loadContents && !m_attachments[attachment].storeContents;
+}
+
+VkAttachmentLoadOp RenderPassBuilder::getLoadOp(const AttachmentId attachment) const
+{
+    assert(attachment < m_attachments.size());
+    const AttachmentDesc& desc = m_attachments[attachment];
+    if (desc.loadContents)
+    {
+        return VK_ATTACHMENT_LOAD_OP_LOAD;
+    }
+    return desc.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+}
+
+VkAttachmentStoreOp RenderPassBuilder::getStoreOp(const AttachmentId attachment) const
+{
+    assert(attachment < m_attachments.size());
+    return m_attachments[attachment].storeContents
+        ? VK_ATTACHMENT_STORE_OP_STORE
+        : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+}
+
+uint32_t RenderPassBuilder::getAttachmentCount() const
+{
+    return (uint32_t)m_attachments.size();
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,125 @@
+#ifndef CORE_RENDER_PASS_BUILDER_H
+#define CORE_RENDER_PASS_BUILDER_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Render pass from attachments and the subpasses that use them.
+// Load and store ops follow from how each attachment is used: loaded if
+// its earlier contents are needed, cleared or left undefined if not, and
+// stored only if the contents are used after the render pass.
+// An attachment that is neither loaded nor stored lives only within the
+// render pass, getImageUsage() then adds TRANSIENT_ATTACHMENT, so tiled
+// gpus keep it in tile memory and lazily allocated memory is never
+// backed. Passes that read earlier results only at the same pixel can be
+// merged as subpasses of one render pass, reading them as input
+// attachments; dependencies between subpasses are by region and the
+// attachments in between do not leave tile memory either.
+class RenderPassBuilder
+{
+public:
+    typedef uint32_t AttachmentId;
+    typedef uint32_t SubpassId;
+
+    static const AttachmentId c_noAttachment = ~0u;
+
+    struct AttachmentDesc
+    {
+        VkFormat format                 = VK_FORMAT_UNDEFINED;
+        VkSampleCountFlagBits samples   = VK_SAMPLE_COUNT_1_BIT;
+        // the first use clears it, otherwise the contents start undefined
+        bool clear                      = false;
+        // contents from before the render pass are used, overrides clear
+        bool loadContents               = false;
+        // contents are used after the render pass
+        bool storeContents              = false;
+        // layout after the render pass, UNDEFINED = layout of the last use
+        VkImageLayout finalLayout       = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    // most precise depth format usable as an optimal tiling depth
+    // attachment, with a stencil component if stencil is set
+    static VkFormat findDepthFormat(VkPhysicalDevice physicalDevice, const bool stencil);
+    static VkImageAspectFlags getAspectMask(const VkFormat format);
+
+    AttachmentId addAttachment(const AttachmentDesc& desc);
+
+    // subpasses run in the order they are added
+    SubpassId addSubpass();
+    // resolve is a single sampled attachment the color
+    // attachment is resolved to at the end of the subpass
+    void addColor(const SubpassId subpass, const AttachmentId attachment,
+        const AttachmentId resolve = c_noAttachment);
+    void setDepth(const SubpassId subpass, const AttachmentId attachment, const bool write);
+    // read at the same pixel it was written by an earlier subpass
+    void addInput(const SubpassId subpass, const AttachmentId attachment);
+
+    VkRenderPass build(VkDevice device) const;
+
+    // attachment usages of the image, TRANSIENT_ATTACHMENT if
+    // the contents are not loaded or stored
+    VkImageUsageFlags getImageUsage(const AttachmentId attachment) const;
+    bool isTransient(const AttachmentId attachment) const;
+    VkAttachmentLoadOp getLoadOp(const AttachmentId attachment) const;
+    VkAttachmentStoreOp getStoreOp(const AttachmentId attachment) const;
+
+    uint32_t getAttachmentCount() const;
+
+private:
+    enum class Use
+    {
+        Color,
+        Resolve,
+        DepthWrite,
+        DepthRead,
+        Input,
+    };
+
+    struct AttachmentUse
+    {
+        AttachmentId attachment = 0;
+        Use use                 = Use::Color;
+    };
+
+    // stages and accesses of a use, for the dependencies
+    struct UseInfo
+    {
+        VkPipelineStageFlags stage  = 0;
+        VkAccessFlags access        = 0;
+        bool write                  = false;
+    };
+
+    struct Subpass
+    {
+        std::vector<AttachmentId> colors;
+        // c_noAttachment for colors without a resolve
+        std::vector<AttachmentId> resolves;
+        AttachmentId depth  = c_noAttachment;
+        bool depthWrite     = false;
+        std::vector<AttachmentId> inputs;
+    };
+
+    // in the order the subpass accesses them
+    std::vector<AttachmentUse> getUses(const Subpass& subpass) const;
+    VkImageLayout getLayout(const AttachmentUse& use) const;
+    static UseInfo getUseInfo(const Use use);
+
+    std::vector<AttachmentDesc> m_attachments;
+    std::vector<Subpass> m_subpasses;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_RENDER_PASS_BUILDER_H
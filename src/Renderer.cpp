@@ -3,10 +3,21 @@
 
 #include "Renderer.h"
 
+#include "Config.h"
+#include "DrawList.h"
+#include "DynamicResolution.h"
 #include "GfxResources.h"
+#include "PipelineStatistics.h"
+#include "Profiler.h"
+#include "QueueTimeline.h"
+#include "RenderGraph.h"
+#include "Simulation.h"
 #include "Window.h"
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <assert.h>
 #include <iostream>
@@ -18,25 +29,559 @@
 namespace core
 {
 
-Renderer::Renderer(GfxResources* const p_gfxResources, Window* const p_window)
+// graph passes measured with pipeline statistics
+static const uint32_t s_maxStatisticsPasses = 8;
+static const uint32_t s_maxOcclusionQueries = 256;
+// swapchain formats are 32 bits per pixel
+static const VkDeviceSize s_readbackPixelSize = 4;
+
+static uint32_t findMemoryTypeIndex(
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    const uint32_t memoryTypeBits,
+    const VkMemoryPropertyFlags propertyFlags)
+{
+    for (uint32_t idx = 0; idx < memoryProperties.memoryTypeCount; ++idx)
+    {
+        if ((memoryTypeBits & (1u << idx))
+            && (memoryProperties.memoryTypes[idx].propertyFlags & propertyFlags) == propertyFlags)
+        {
+            return idx;
+        }
+    }
+    return ~0u;
+}
+
+Renderer::Renderer(
+    GfxResources* const p_gfxResources,
+    Window* const p_window,
+    const Config* const p_config)
     : mp_gfxResources(p_gfxResources),
-    mp_window(p_window)
+    mp_window(p_window),
+    m_printRenderGraph(p_config->printRenderGraph),
+    m_printDrawStatistics(p_config->printDrawStatistics),
+    m_printMemoryBudget(p_config->printMemoryBudget),
+    m_drawCount(std::max(p_config->drawCount, 1u)),
+    m_instanceCount(std::max(p_config->instanceCount, 1u)),
+    m_pipelineCount(std::max(p_config->pipelineCount, 1u))
 {
     assert(mp_gfxResources);
     assert(mp_window);
+    assert(p_config);
+
+    if (mp_gfxResources->isDynamicResolutionEnabled())
+    {
+        // out of range values are clamped, a zero budget would be divided by
+        const float minScale = std::min(std::max(p_config->minResolutionScale, 1u), 100u) / 100.0f;
+        const double budgetMs = std::max(p_config->gpuTimeBudgetUs, 1u) / 1000.0;
+        m_dynamicResolution = std::unique_ptr<DynamicResolution>(new DynamicResolution(
+            budgetMs, minScale));
+    }
+    m_submittedFrames.assign(mp_gfxResources->getBufferedFrameResource().bufferCount, 0);
+    m_submitTicks.assign(mp_gfxResources->getBufferedFrameResource().bufferCount, 0);
+    m_timestampsWritten.assign(mp_gfxResources->getBufferedFrameResource().bufferCount, false);
+    buildFrameGraphs();
+
+    const uint32_t bufferCount = mp_gfxResources->getBufferedFrameResource().bufferCount;
+    m_occlusionQueries = std::unique_ptr<OcclusionQueries>(new OcclusionQueries(
+        mp_gfxResources->getDevice(), mp_gfxResources->getDeletionQueue(),
+        bufferCount, s_maxOcclusionQueries, mp_gfxResources->isOcclusionQueryPrecise()));
+    m_triangleQuery = m_occlusionQueries->create();
+    if (mp_gfxResources->isPipelineStatisticsEnabled())
+    {
+        m_pipelineStatistics = std::unique_ptr<PipelineStatistics>(new PipelineStatistics(
+            mp_gfxResources->getDevice(), mp_gfxResources->getDeletionQueue(),
+            bufferCount, s_maxStatisticsPasses));
+    }
+
+    // uv spans the texture over the triangle's bounds
+    MeshBatcher::MeshData triangle;
+    triangle.positions = { -0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 0.0f, 0.0f };
+    triangle.uvs = { 0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 0.0f };
+    triangle.indices = { 0, 1, 2 };
+    m_meshBatcher = std::unique_ptr<MeshBatcher>(new MeshBatcher(mp_gfxResources));
+    m_triangleMesh = m_meshBatcher->add(triangle, 0);
+    m_drawList = std::unique_ptr<DrawList>(new DrawList(p_config->workerThreadCount));
+
+    // loads in the background, the placeholder is drawn meanwhile
+    m_textureStreamer = std::unique_ptr<TextureStreamer>(new TextureStreamer(mp_gfxResources, p_config));
+    if (!p_config->texture.empty())
+    {
+        m_texture = m_textureStreamer->load(p_config->texture);
+    }
+
+    // out of date swapchain skips the frame and rebuilds,
+    // suboptimal one still presents and then rebuilds
+    setVkResultHandler(VkResultCategory::OutOfDate,
+        [this](VkResult, const VkCallSite&)
+    {
+        m_swapchainDirty = true;
+        return false;
+    });
+    setVkResultHandler(VkResultCategory::Suboptimal,
+        [this](VkResult, const VkCallSite&)
+    {
+        m_swapchainDirty = true;
+        return true;
+    });
+}
+
+Renderer::~Renderer()
+{
+    m_meshBatcher.reset();
+    m_textureStreamer.reset();
+    m_pipelineStatistics.reset();
+    m_occlusionQueries.reset();
+    releaseFrameGraphs();
+    setVkResultHandler(VkResultCategory::OutOfDate, nullptr);
+    setVkResultHandler(VkResultCategory::Suboptimal, nullptr);
 }
 
-void Renderer::render()
+void Renderer::recordUpscale(const RenderGraph::PassContext& context,
+    const RenderGraph::ResourceId src, const RenderGraph::ResourceId dst)
 {
+    const VkImageBlit imageBlit =
+    {
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },     // srcSubresource
+        {
+            { 0, 0, 0 },
+            { (int32_t)m_frame.renderExtent.width, (int32_t)m_frame.renderExtent.height, 1 }
+        },                                          // srcOffsets
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },     // dstSubresource
+        {
+            { 0, 0, 0 },
+            { (int32_t)m_frame.swapchainExtent.width, (int32_t)m_frame.swapchainExtent.height, 1 }
+        }                                           // dstOffsets
+    };
+
+    vkCmdBlitImage(
+        context.cmdBuffer,                      // commandBuffer
+        context.graph->getImage(src),           // srcImage
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,   // srcImageLayout
+        context.graph->getImage(dst),           // dstImage
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,   // dstImageLayout
+        1,                                      // regionCount
+        &imageBlit,                             // pRegions
+        VK_FILTER_LINEAR);                      // filter
+}
+
+void Renderer::recordReadback(const RenderGraph::PassContext& context,
+    const RenderGraph::ResourceId src, const uint32_t bufferIndex)
+{
+    const VkExtent2D extent = context.graph->getImageDesc(src).extent;
+    const VkBuffer buffer = mp_gfxResources->getBufferPool().get<BufferPool::Buffer>(
+        m_readbackBuffers[bufferIndex].buffer);
+
+    const VkBufferImageCopy region =
+    {
+        0,                                      // bufferOffset
+        0,                                      // bufferRowLength
+        0,                                      // bufferImageHeight
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }, // imageSubresource
+        { 0, 0, 0 },                            // imageOffset
+        { extent.width, extent.height, 1 }      // imageExtent
+    };
+
+    vkCmdCopyImageToBuffer(
+        context.cmdBuffer,                      // commandBuffer
+        context.graph->getImage(src),           // srcImage
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,   // srcImageLayout
+        buffer,                                 // dstBuffer
+        1,                                      // regionCount
+        &region);                               // pRegions
+
+    // host reads it after the frame has completed
+    const VkBufferMemoryBarrier bufferMemoryBarrier =
+    {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,    // sType
+        nullptr,                                    // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,               // srcAccessMask
+        VK_ACCESS_HOST_READ_BIT,                    // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                    // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                    // dstQueueFamilyIndex
+        buffer,                                     // buffer
+        0,                                          // offset
+        VK_WHOLE_SIZE                               // size
+    };
+
+    vkCmdPipelineBarrier(
+        context.cmdBuffer,                  // commandBuffer
+        VK_PIPELINE_STAGE_TRANSFER_BIT,     // srcStageMask
+        VK_PIPELINE_STAGE_HOST_BIT,         // dstStageMask
+        0,                                  // dependencyFlags
+        0,                                  // memoryBarrierCount
+        nullptr,                            // pMemoryBarriers
+        1,                                  // bufferMemoryBarrierCount
+        &bufferMemoryBarrier,               // pBufferMemoryBarriers
+        0,                                  // imageMemoryBarrierCount
+        nullptr);                           // pImageMemoryBarriers
+
+    m_readbackBuffers[bufferIndex].written = true;
+}
+
+void Renderer::createReadbackBuffers()
+{
+    VkDevice device = mp_gfxResources->getDevice();
+    const VkExtent2D extent = mp_gfxResources->getSwapchainExtent();
+    const VkDeviceSize size = s_readbackPixelSize * extent.width * extent.height;
+
+    for (uint32_t idx = 0; idx < mp_gfxResources->getBufferedFrameResource().bufferCount; ++idx)
+    {
+        const VkBufferCreateInfo bufferCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,   // sType
+            nullptr,                                // pNext
+            0,                                      // flags
+            size,                                   // size
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,       // usage
+            VK_SHARING_MODE_EXCLUSIVE,              // sharingMode
+            0,                                      // queueFamilyIndexCount
+            nullptr                                 // pQueueFamilyIndices
+        };
+
+        VkBuffer buffer = nullptr;
+        CHECK_VK_RESULT_SUCCESS(vkCreateBuffer(
+            device,             // device
+            &bufferCreateInfo,  // pCreateInfo
+            nullptr,            // pAllocator
+            &buffer));          // pBuffer
+
+        VkMemoryRequirements memoryRequirements = {};
+        vkGetBufferMemoryRequirements(
+            device,                 // device
+            buffer,                 // buffer
+            &memoryRequirements);   // pMemoryRequirements
+
+        // cached memory is a lot faster to read from the host
+        const VkMemoryPropertyFlags hostFlags =
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        uint32_t memoryTypeIndex = findMemoryTypeIndex(mp_gfxResources->getMemoryProperties(),
+            memoryRequirements.memoryTypeBits, hostFlags | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        if (memoryTypeIndex == ~0u)
+        {
+            memoryTypeIndex = findMemoryTypeIndex(mp_gfxResources->getMemoryProperties(),
+                memoryRequirements.memoryTypeBits, hostFlags);
+        }
+        if (memoryTypeIndex == ~0u)
+        {
+            vkDestroyBuffer(device, buffer, nullptr);
+            throw std::runtime_error("No host visible memory type for readback");
+        }
+
+        const VkMemoryAllocateInfo memoryAllocateInfo =
+        {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, // sType
+            nullptr,                                // pNext
+            memoryRequirements.size,                // allocationSize
+            memoryTypeIndex                         // memoryTypeIndex
+        };
+
+        VkDeviceMemory memory = nullptr;
+        CHECK_VK_RESULT_SUCCESS(vkAllocateMemory(
+            device,                 // device
+            &memoryAllocateInfo,    // pAllocateInfo
+            nullptr,                // pAllocator
+            &memory));              // pMemory
+
+        mp_gfxResources->getMemoryBudget().onAllocate(memory, memoryTypeIndex,
+            memoryRequirements.size, MemoryBudget::Category::Staging);
+
+        CHECK_VK_RESULT_SUCCESS(vkBindBufferMemory(
+            device,     // device
+            buffer,     // buffer
+            memory,     // memory
+            0));        // memoryOffset
+
+        void* p_data = nullptr;
+        CHECK_VK_RESULT_SUCCESS(vkMapMemory(
+            device,         // device
+            memory,         // memory
+            0,              // offset
+            VK_WHOLE_SIZE,  // size
+            0,              // flags
+            &p_data));      // ppData
+
+        ReadbackBuffer readbackBuffer;
+        readbackBuffer.buffer = mp_gfxResources->getBufferPool().create(
+            buffer, memory, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        readbackBuffer.p_data = (const uint8_t*)p_data;
+        m_readbackBuffers.push_back(readbackBuffer);
+    }
+}
+
+void Renderer::recordMainPass(const RenderGraph::PassContext& context)
+{
+    VkCommandBuffer cmdBuffer = context.cmdBuffer;
+
+    const VkRect2D renderArea =
+    {
+        { 0, 0 },               // offset
+        m_frame.renderExtent    // extent
+    };
+    // color, the resolve target that is not cleared, depth last
+    const uint32_t attachmentCount = mp_gfxResources->getMainPassAttachments().count;
+    assert(attachmentCount >= 2 && attachmentCount <= 3);
+    VkClearValue clearValues[3] = {};
+    clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+    clearValues[attachmentCount - 1].depthStencil = { 1.0f, 0 };
+
+    const VkRenderPassBeginInfo renderPassBeginInfo =
+    {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,   // sType
+        nullptr,                                    // pNext
+        mp_gfxResources->getRenderPass(),           // renderPass
+        context.framebuffer,                        // framebuffer
+        renderArea,                                 // renderArea
+        attachmentCount,                            // clearValueCount
+        clearValues                                 // pClearValues;
+    };
+
+    vkCmdBeginRenderPass(
+        cmdBuffer,                      // commandBuffer
+        &renderPassBeginInfo,           // pRenderPassBegin
+        VK_SUBPASS_CONTENTS_INLINE);    // contents
+
+    const VkViewport viewport =
+    {
+        0.0f,                               // x
+        0.0f,                               // y
+        (float)m_frame.renderExtent.width,  // width
+        (float)m_frame.renderExtent.height, // height
+        0.0f,                               // minDepth
+        1.0f,                               // maxDepth
+    };
+
+    vkCmdSetViewport(
+        cmdBuffer,  // commandBuffer
+        0,          // firstViewport
+        1,          // viewportCount
+        &viewport); // pViewports
+
+    vkCmdSetScissor(
+        cmdBuffer,      // commandBuffer
+        0,              // firstScissor
+        1,              // scissorCount
+        &renderArea);   // pScissors
+
+    const MeshBatcher::DrawRange& triangle = m_meshBatcher->getDrawRange(m_triangleMesh);
+
+    DrawList::Draw draw;
+    draw.layout = mp_gfxResources->getPipelineLayout();
+    draw.descriptorSet = m_frame.bindlessSet;
+    draw.vertexBuffer = m_meshBatcher->getVertexBuffer();
+    draw.indexBuffer = m_meshBatcher->getIndexBuffer();
+    draw.pushConstants.angle = m_frame.angle;
+    draw.pushConstants.minLod = m_frame.textureMinLod;
+    draw.pushConstants.textureIndex = m_frame.textureIndex;
+    draw.pushConstants.renderScaleX = (float)m_frame.renderExtent.width / (float)m_frame.swapchainExtent.width;
+    draw.pushConstants.renderScaleY = (float)m_frame.renderExtent.height / (float)m_frame.swapchainExtent.height;
+    draw.indexCount = triangle.indexCount;
+    draw.instanceCount = m_instanceCount;
+    draw.firstIndex = triangle.firstIndex;
+
+    // more than one draw only as synthetic load, draws of
+    // the same pipeline copy end up next to each other
+    m_drawList->clear();
+    GfxResources::ShaderVariantKey shaderVariant = m_frame.shaderVariant;
+    uint32_t triangleDraw = ~0u;
+    for (uint32_t drawIndex = 0; drawIndex < m_drawCount; ++drawIndex)
+    {
+        shaderVariant.copy = drawIndex % m_pipelineCount;
+        draw.pipeline = mp_gfxResources->getGraphicsPipeline(shaderVariant);
+        const uint32_t added = m_drawList->add(
+            DrawList::makeKey(0, shaderVariant.copy, m_frame.textureIndex, 0.0f, m_triangleMesh), draw);
+        if (drawIndex == 0)
+        {
+            triangleDraw = added;
+        }
+    }
+
+    // the query counts the triangle itself, not the synthetic copies
+    if (m_triangleQuery == OcclusionQueries::c_invalidQuery)
+    {
+        triangleDraw = ~0u;
+    }
+    m_drawList->record(cmdBuffer, triangleDraw,
+        [this](VkCommandBuffer queryCmdBuffer, const bool begin)
+    {
+        if (begin)
+        {
+            m_occlusionQueries->begin(queryCmdBuffer, m_triangleQuery);
+        }
+        else
+        {
+            m_occlusionQueries->end(queryCmdBuffer, m_triangleQuery);
+        }
+    });
+
+    vkCmdEndRenderPass(cmdBuffer);
+}
+
+void Renderer::buildFrameGraphs()
+{
+    // one graph per swapchain image, compiled once and executed every frame
+    releaseFrameGraphs();
+
+    if (mp_gfxResources->isReadbackEnabled())
+    {
+        createReadbackBuffers();
+    }
+
+    const GfxResources::BufferedFrameResource& frameResource =
+        mp_gfxResources->getBufferedFrameResource();
+
+    RenderGraph::ImageDesc backbufferDesc;
+    backbufferDesc.format = mp_gfxResources->getSwapchainFormat();
+    backbufferDesc.extent = mp_gfxResources->getSwapchainExtent();
+
+    const ImagePool& imagePool = mp_gfxResources->getImagePool();
+
+    for (uint32_t idx = 0; idx < frameResource.bufferCount; ++idx)
+    {
+        std::unique_ptr<RenderGraph> graph(new RenderGraph());
+
+        // available after the acquire semaphore wait at color attachment output
+        const ImageHandle image = frameResource.images[idx];
+        const RenderGraph::ResourceId backbuffer = graph->importImage("backbuffer",
+            imagePool.get<ImagePool::Image>(image), imagePool.get<ImagePool::View>(image), backbufferDesc,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+        // with dynamic resolution the scene is rendered into the top left part
+        // of a swapchain sized target, so the size can change every frame
+        RenderGraph::ResourceId sceneColor = backbuffer;
+        if (m_dynamicResolution)
+        {
+            RenderGraph::ImageDesc sceneColorDesc = backbufferDesc;
+            sceneColorDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            sceneColor = graph->createImage("sceneColor", sceneColorDesc);
+        }
+
+        const RenderGraph::PassId mainPass = graph->addPass("main",
+            [this](const RenderGraph::PassContext& context) { recordMainPass(context); });
+
+        // depth and the multisampled target live only inside the pass, on
+        // tiled gpus they get lazily allocated memory that is never backed
+        const GfxResources::MainPassAttachments& attachments = mp_gfxResources->getMainPassAttachments();
+        const VkSampleCountFlagBits sampleCount = mp_gfxResources->getSampleCount();
+
+        RenderGraph::ImageDesc depthDesc = backbufferDesc;
+        depthDesc.format = attachments.depthFormat;
+        depthDesc.usage = attachments.depthUsage;
+        depthDesc.samples = sampleCount;
+        const RenderGraph::ResourceId depth = graph->createImage("depth", depthDesc);
+
+        if (sampleCount != VK_SAMPLE_COUNT_1_BIT)
+        {
+            RenderGraph::ImageDesc msaaColorDesc = backbufferDesc;
+            msaaColorDesc.usage = attachments.msaaColorUsage;
+            msaaColorDesc.samples = sampleCount;
+            const RenderGraph::ResourceId msaaColor = graph->createImage("msaaColor", msaaColorDesc);
+
+            graph->write(mainPass, msaaColor, RenderGraph::Access::ColorAttachmentWrite);
+            graph->write(mainPass, sceneColor, RenderGraph::Access::ColorAttachmentWrite);
+            graph->write(mainPass, depth, RenderGraph::Access::DepthAttachmentWrite);
+            graph->setRenderPass(mainPass, mp_gfxResources->getRenderPass(), { msaaColor, sceneColor, depth });
+        }
+        else
+        {
+            graph->write(mainPass, sceneColor, RenderGraph::Access::ColorAttachmentWrite);
+            graph->write(mainPass, depth, RenderGraph::Access::DepthAttachmentWrite);
+            graph->setRenderPass(mainPass, mp_gfxResources->getRenderPass(), { sceneColor, depth });
+        }
+
+        if (m_dynamicResolution)
+        {
+            const RenderGraph::PassId upscalePass = graph->addPass("upscale",
+                [this, sceneColor, backbuffer](const RenderGraph::PassContext& context)
+            {
+                recordUpscale(context, sceneColor, backbuffer);
+            });
+            graph->read(upscalePass, sceneColor, RenderGraph::Access::TransferRead);
+            graph->write(upscalePass, backbuffer, RenderGraph::Access::TransferWrite);
+        }
+
+        if (!m_readbackBuffers.empty())
+        {
+            const RenderGraph::PassId readbackPass = graph->addPass("readback",
+                [this, backbuffer, idx](const RenderGraph::PassContext& context)
+            {
+                recordReadback(context, backbuffer, idx);
+            });
+            graph->read(readbackPass, backbuffer, RenderGraph::Access::TransferRead);
+            graph->setSideEffects(readbackPass);
+        }
+
+        graph->compile(mp_gfxResources->getDevice(), mp_gfxResources->getMemoryProperties(),
+            &mp_gfxResources->getMemoryBudget());
+        m_frameGraphs.push_back(std::move(graph));
+    }
+
+    if (m_printRenderGraph && !m_frameGraphs.empty())
+    {
+        m_frameGraphs[0]->printReport(std::cout);
+    }
+}
+
+void Renderer::releaseFrameGraphs()
+{
+    // frames in flight may still use the graph images and framebuffers
+    for (std::unique_ptr<RenderGraph>& graph : m_frameGraphs)
+    {
+        std::shared_ptr<RenderGraph> oldGraph(std::move(graph));
+        mp_gfxResources->getDeletionQueue().destroy([oldGraph]() {});
+    }
+    m_frameGraphs.clear();
+
+    for (const ReadbackBuffer& readbackBuffer : m_readbackBuffers)
+    {
+        mp_gfxResources->releaseBuffer(readbackBuffer.buffer);
+    }
+    m_readbackBuffers.clear();
+}
+
+void Renderer::onResize()
+{
+    m_swapchainDirty = true;
+}
+
+bool Renderer::render(const SimulationState& state)
+{
+    CORE_PROFILE_ZONE("Renderer::render");
+
     // not using pre-recorded command buffers
     // does the same setup every frame
     // for buffered resources
 
+    // minimized window has nothing to present to
+    if (mp_window->getWidth() == 0 || mp_window->getHeight() == 0)
+    {
+        return false;
+    }
+
+    if (m_swapchainDirty)
+    {
+        // old command buffers go to the deletion queue, forget their frames here
+        mp_gfxResources->recreateSwapchain();
+        m_submittedFrames.assign(mp_gfxResources->getBufferedFrameResource().bufferCount, 0);
+        m_submitTicks.assign(mp_gfxResources->getBufferedFrameResource().bufferCount, 0);
+        m_timestampsWritten.assign(mp_gfxResources->getBufferedFrameResource().bufferCount, false);
+        buildFrameGraphs();
+
+        const uint32_t bufferCount = mp_gfxResources->getBufferedFrameResource().bufferCount;
+        m_occlusionQueries->setBufferCount(bufferCount);
+        if (m_pipelineStatistics)
+        {
+            m_pipelineStatistics = std::unique_ptr<PipelineStatistics>(new PipelineStatistics(
+                mp_gfxResources->getDevice(), mp_gfxResources->getDeletionQueue(),
+                bufferCount, s_maxStatisticsPasses));
+        }
+        m_swapchainDirty = false;
+    }
+
     VkDevice device = mp_gfxResources->getDevice();
     VkSwapchainKHR swapchain = mp_gfxResources->getSwapchain();
-    VkRenderPass renderPass = mp_gfxResources->getRenderPass();
-    VkPipeline graphicsPipeline = mp_gfxResources->getGraphicsPipeline();
     VkQueue queue = mp_gfxResources->getQueue();
+    QueueTimeline& queueTimeline = mp_gfxResources->getQueueTimeline();
 
     GfxResources::BufferedFrameResource& frameResource =
         mp_gfxResources->getBufferedFrameResource();
@@ -45,32 +590,65 @@ void Renderer::render()
 
     // get index for buffered resources
     {
-        CHECK_VK_RESULT_SUCCESS(vkAcquireNextImageKHR(
+        // false for timeout or out of date swapchain, try again next frame
+        if (!CHECK_VK_RESULT_SUCCESS(vkAcquireNextImageKHR(
             device,                         // device
             swapchain,                      // swapchin
-            0,                              // timeout
+            s_defaultTimeout,               // timeout
             swapchainImageSemaphore,        // semaphore
             nullptr,                        // fence
-            &frameResource.bufferIndex));   //  pImageIndex
+            &frameResource.bufferIndex)))   //  pImageIndex
+        {
+            return false;
+        }
         assert(frameResource.bufferIndex < (uint32_t)frameResource.images.size());
     }
 
     const uint32_t currIndex = frameResource.bufferIndex;
 
-    VkFramebuffer framebuffer = frameResource.framebuffers[currIndex];
     VkCommandBuffer cmdBuffer = frameResource.commandBuffers[currIndex];
-    VkFence cmdBufferFence = frameResource.commandBufferFences[currIndex];
     VkSemaphore cmdBufferSubmitSemaphore = frameResource.cmdBufferSubmitSemaphore;
 
     // setup command buffer
     {
-        const uint32_t timeout = s_defaultTimeout;
-        CHECK_VK_RESULT_SUCCESS(vkWaitForFences(
-            device,             // device
-            1,                  // fenceCount
-            &cmdBufferFence,    // pFences
-            VK_TRUE,            // waitAll
-            timeout));          // timeout
+        // last frame recorded to this command buffer
+        while (!queueTimeline.wait(m_submittedFrames[currIndex], s_defaultTimeout))
+        {
+            // timed out, the image is already acquired so keep waiting
+        }
+
+        DeletionQueue& deletionQueue = mp_gfxResources->getDeletionQueue();
+        deletionQueue.markCompleted(queueTimeline.getCompletedValue());
+        deletionQueue.collect();
+
+        // evictions before recording, so freed memory is reused this frame
+        mp_gfxResources->getMemoryBudget().update(deletionQueue.getRecordingFrame(),
+            deletionQueue.getCompletedFrame());
+
+        // previous frame on this index is done, its timestamps are available
+        uint64_t gpuBeginNs = 0;
+        uint64_t gpuEndNs = 0;
+        if ((m_dynamicResolution || Profiler::c_enabled) && m_timestampsWritten[currIndex]
+            && readGpuTimestamps(currIndex, gpuBeginNs, gpuEndNs))
+        {
+            if (m_dynamicResolution)
+            {
+                m_dynamicResolution->update((gpuEndNs - gpuBeginNs) * 1e-6);
+            }
+            if (Profiler::c_enabled)
+            {
+                Profiler::addGpuZone("gpu frame", m_submitTicks[currIndex], gpuBeginNs, gpuEndNs);
+            }
+        }
+
+        if (!m_readbackBuffers.empty() && m_readbackBuffers[currIndex].written)
+        {
+            const BufferPool& bufferPool = mp_gfxResources->getBufferPool();
+            const ReadbackBuffer& readbackBuffer = m_readbackBuffers[currIndex];
+            m_readbackPixels.resize((size_t)bufferPool.get<BufferPool::Size>(readbackBuffer.buffer));
+            memcpy(m_readbackPixels.data(), readbackBuffer.p_data, m_readbackPixels.size());
+            m_readbackBuffers[currIndex].written = false;
+        }
 
         CHECK_VK_RESULT_SUCCESS(vkResetCommandBuffer(
             cmdBuffer,  // commandBuffer
@@ -89,58 +667,94 @@ void Renderer::render()
             &commandBufferBeginInfo));  // pBeginInfo
     }
 
-    const uint32_t width = mp_window->getWidth();
-    const uint32_t height = mp_window->getHeight();
+    VkQueryPool timestampQueryPool = frameResource.timestampQueryPool;
+    const VkExtent2D swapchainExtent = mp_gfxResources->getSwapchainExtent();
 
-    const VkRect2D renderArea =
-    {
-        { 0, 0 },           // offset
-        { width, height}    // extent
-    };
-    constexpr VkClearValue clearValue =
-    {
-        { 0.0f, 0.0f, 0.0f, 0.0f }, // color
-    };
+    // with dynamic resolution only the top left part of the target is rendered
+    const VkExtent2D extent = m_dynamicResolution
+        ? VkExtent2D{
+            m_dynamicResolution->getScaledSize(swapchainExtent.width),
+            m_dynamicResolution->getScaledSize(swapchainExtent.height) }
+        : swapchainExtent;
 
-    const VkRenderPassBeginInfo renderPassBeginInfo =
+    if (timestampQueryPool)
     {
-        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,   // sType
-        nullptr,                                    // pNext
-        renderPass,                                 // renderPass
-        framebuffer,                                // framebuffer
-        renderArea,                                 // renderArea
-        1,                                          // clearValueCount
-        &clearValue                                 // pClearValues;
-    };
-
-    vkCmdBeginRenderPass(
-        cmdBuffer,                      // commandBuffer
-        &renderPassBeginInfo,           // pRenderPassBegin
-        VK_SUBPASS_CONTENTS_INLINE);    // contents
+        vkCmdResetQueryPool(
+            cmdBuffer,          // commandBuffer
+            timestampQueryPool, // queryPool
+            2 * currIndex,      // firstQuery
+            2);                 // queryCount
+
+        vkCmdWriteTimestamp(
+            cmdBuffer,                          // commandBuffer
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  // pipelineStage
+            timestampQueryPool,                 // queryPool
+            2 * currIndex);                     // query
+    }
 
-    vkCmdBindPipeline(
-        cmdBuffer,                          // commandBuffer
-        VK_PIPELINE_BIND_POINT_GRAPHICS,    // pipelineBindPoint
-        graphicsPipeline);                  // pipeline
+    // previous frame on this index is done, read its queries and reset them
+    m_occlusionQueries->beginFrame(cmdBuffer, currIndex);
+    if (m_pipelineStatistics)
+    {
+        m_pipelineStatistics->beginFrame(cmdBuffer, currIndex);
+    }
 
-    vkCmdDraw(
-        cmdBuffer,  // commandBuffer
-        3,          // vertexCount
-        1,          // instanceCount
-        0,          // firstVertex
-        0);         // firstInstance
+    // uploads go before the passes that read them
+    if (!m_meshBatcher->isUploaded())
+    {
+        m_meshBatcher->upload(cmdBuffer);
+    }
+    m_textureStreamer->update(cmdBuffer);
+
+    m_frame.renderExtent = extent;
+    m_frame.swapchainExtent = swapchainExtent;
+    m_frame.angle = state.angle;
+    m_frame.bindlessSet = mp_gfxResources->getBindlessTable().acquireSet(
+        mp_gfxResources->getDeletionQueue());
+    m_frame.textureIndex = m_textureStreamer->getTextureIndex(m_texture);
+    m_frame.textureMinLod = m_textureStreamer->getMinLod(m_texture);
+
+    // swapchain extent, not the dynamic render extent, to keep the variants few
+    m_frame.shaderVariant.resolution = swapchainExtent;
+    m_frame.shaderVariant.gridSize = GfxResources::ShaderVariantKey::getGridSize(m_instanceCount);
+    m_frame.shaderVariant.textured = (m_texture != TextureStreamer::c_invalidTexture);
+    m_frame.shaderVariant.copy = 0;
+
+    if (m_pipelineStatistics)
+    {
+        const RenderGraph& graph = *m_frameGraphs[currIndex];
+        graph.execute(cmdBuffer,
+            [this, &graph](VkCommandBuffer passCmdBuffer, const RenderGraph::PassId pass, const bool begin)
+        {
+            if (begin)
+            {
+                m_pipelineStatistics->beginPass(passCmdBuffer, pass, graph.getPassName(pass));
+            }
+            else
+            {
+                m_pipelineStatistics->endPass(passCmdBuffer, pass);
+            }
+        });
+    }
+    else
+    {
+        m_frameGraphs[currIndex]->execute(cmdBuffer);
+    }
 
-    vkCmdEndRenderPass(cmdBuffer);
+    if (timestampQueryPool)
+    {
+        vkCmdWriteTimestamp(
+            cmdBuffer,                              // commandBuffer
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,   // pipelineStage
+            timestampQueryPool,                     // queryPool
+            2 * currIndex + 1);                     // query
+        m_timestampsWritten[currIndex] = true;
+    }
 
     CHECK_VK_RESULT_SUCCESS(vkEndCommandBuffer(cmdBuffer));
 
     // submit
     {
-        vkResetFences(
-            device,             // device
-            1,                  // fenceCount
-            &cmdBufferFence);   // pFences
-
         constexpr VkPipelineStageFlags waitStageFlags =
         {
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
@@ -159,11 +773,17 @@ void Renderer::render()
             &cmdBufferSubmitSemaphore       // pSignalSemaphores
         };
 
-        CHECK_VK_RESULT_SUCCESS(vkQueueSubmit(
-            queue,              // queue
-            1,                  // submitCount
-            &submitInfo,        // pSubmits
-            cmdBufferFence));   // fence
+        if (Profiler::c_enabled)
+        {
+            m_submitTicks[currIndex] = Profiler::readTicks();
+        }
+        const uint64_t value = queueTimeline.submit(queue, submitInfo);
+
+        // one submit per frame, the timeline values are the frames
+        DeletionQueue& deletionQueue = mp_gfxResources->getDeletionQueue();
+        assert(value == deletionQueue.getRecordingFrame());
+        m_submittedFrames[currIndex] = value;
+        deletionQueue.endFrame();
     }
 
     // present
@@ -180,12 +800,98 @@ void Renderer::render()
             nullptr                             // pResults
         };
 
-        CHECK_VK_RESULT_SUCCESS(vkQueuePresentKHR(
+        // a suboptimal present still shows the frame, an out of date one does not
+        return CHECK_VK_RESULT_SUCCESS(vkQueuePresentKHR(
             queue,          // queue
             &presentInfo)); // pPresentInfo
     }
 }
 
+bool Renderer::readGpuTimestamps(const uint32_t bufferIndex, uint64_t& beginNs, uint64_t& endNs)
+{
+    // frame has completed, so the results are there without waiting
+    uint64_t timestamps[2] = {};
+    if (!CHECK_VK_RESULT_SUCCESS(vkGetQueryPoolResults(
+        mp_gfxResources->getDevice(),                                   // device
+        mp_gfxResources->getBufferedFrameResource().timestampQueryPool, // queryPool
+        2 * bufferIndex,                                                // firstQuery
+        2,                                                              // queryCount
+        sizeof(timestamps),                                             // dataSize
+        timestamps,                                                     // pData
+        sizeof(uint64_t),                                               // stride
+        VK_QUERY_RESULT_64_BIT)))                                       // flags
+    {
+        return false;
+    }
+
+    const uint64_t mask = mp_gfxResources->getTimestampMask();
+    const double period = mp_gfxResources->getTimestampPeriod();
+    const uint64_t ticks = ((timestamps[1] & mask) - (timestamps[0] & mask)) & mask;
+    beginNs = (uint64_t)((timestamps[0] & mask) * period);
+    endNs = beginNs + (uint64_t)(ticks * period);
+    return true;
+}
+
+const std::vector<uint8_t>& Renderer::getReadbackPixels() const
+{
+    return m_readbackPixels;
+}
+
+OcclusionQueries& Renderer::getOcclusionQueries()
+{
+    return *m_occlusionQueries;
+}
+
+void Renderer::printStatistics(std::ostream& out)
+{
+    if (m_printDrawStatistics)
+    {
+        m_drawList->print(out);
+    }
+
+    if (m_printMemoryBudget)
+    {
+        mp_gfxResources->getMemoryBudget().print(out);
+    }
+
+    if (m_pipelineStatistics)
+    {
+        m_pipelineStatistics->print(out);
+    }
+
+    if (m_triangleQuery == OcclusionQueries::c_invalidQuery)
+    {
+        return;
+    }
+
+    const uint64_t samples = m_occlusionQueries->getSamples(m_triangleQuery);
+    if (samples != OcclusionQueries::c_noResult)
+    {
+        out << "triangle samples: " << samples
+            << (mp_gfxResources->isOcclusionQueryPrecise() ? "" : " (not precise)") << std::endl;
+    }
+}
+
+void Renderer::waitForFramesInFlight(const uint32_t maxFramesAhead)
+{
+    QueueTimeline& queueTimeline = mp_gfxResources->getQueueTimeline();
+    const uint64_t submitted = queueTimeline.getLastSubmittedValue();
+    if (maxFramesAhead == 0 || submitted < maxFramesAhead)
+    {
+        return;
+    }
+
+    // leaves maxFramesAhead - 1 frames queued
+    if (!queueTimeline.wait(submitted - maxFramesAhead + 1, s_defaultTimeout))
+    {
+        return; // timed out, don't block input handling any longer
+    }
+
+    DeletionQueue& deletionQueue = mp_gfxResources->getDeletionQueue();
+    deletionQueue.markCompleted(queueTimeline.getCompletedValue());
+    deletionQueue.collect();
+}
+
 } // namespace
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -4,7 +4,16 @@
 // Copyright (c) 2017 Johannes Pystynen
 // This code is licensed under the MIT license (MIT)
 
+#include "GfxHandles.h"
+#include "GfxResources.h"
+#include "MeshBatcher.h"
+#include "OcclusionQueries.h"
+#include "RenderGraph.h"
+#include "TextureStreamer.h"
+
 #include <memory>
+#include <ostream>
+#include <vector>
 
 #include <vulkan/vulkan.h>
 
@@ -13,24 +22,127 @@
 namespace core
 {
 
+class Config;
+class DrawList;
+class DynamicResolution;
 class GfxDevice;
-class GfxResources;
+class PipelineStatistics;
 class Window;
+struct SimulationState;
 
 class Renderer
 {
 public:
-    Renderer(GfxResources* const p_gfxResources, Window* const p_window);
-    ~Renderer() = default;
+    Renderer(
+        GfxResources* const p_gfxResources,
+        Window* const p_window,
+        const Config* const p_config);
+    ~Renderer();
 
     Renderer(const Renderer&) = delete;
     Renderer& operator=(const Renderer&) = delete;
 
-    void render();
+    // returns false if the frame was skipped
+    bool render(const SimulationState& state);
+
+    // swapchain is rebuilt before the next frame
+    void onResize();
+
+    // blocks until at most maxFramesAhead frames are queued on the gpu,
+    // 0 means no limit
+    void waitForFramesInFlight(const uint32_t maxFramesAhead);
+
+    // for visibility tests of object bounds
+    OcclusionQueries& getOcclusionQueries();
+
+    // last frame copied back with readback enabled, tightly packed
+    // rows of 4 byte pixels in the swapchain format
+    const std::vector<uint8_t>& getReadbackPixels() const;
+
+    // per pass pipeline statistics and triangle coverage since the last
+    // call with gpu statistics, draw list binds with draw statistics
+    void printStatistics(std::ostream& out);
 
 private:
+    // values the pass functions read when the frame graph is executed
+    struct FrameParams
+    {
+        VkExtent2D renderExtent     = { 0, 0 };
+        VkExtent2D swapchainExtent  = { 0, 0 };
+        float angle                 = 0.0f;
+        // bound once, draws index it with push constants
+        VkDescriptorSet bindlessSet = nullptr;
+        uint32_t textureIndex       = 0;
+        float textureMinLod         = 0.0f;
+        GfxResources::ShaderVariantKey shaderVariant;
+    };
+
+    void buildFrameGraphs();
+    void releaseFrameGraphs();
+    void recordMainPass(const RenderGraph::PassContext& context);
+    void recordUpscale(const RenderGraph::PassContext& context,
+        const RenderGraph::ResourceId src, const RenderGraph::ResourceId dst);
+    void recordReadback(const RenderGraph::PassContext& context,
+        const RenderGraph::ResourceId src, const uint32_t bufferIndex);
+    void createReadbackBuffers();
+
+    // gpu begin and end of the frame last recorded on bufferIndex,
+    // nanoseconds of the device timestamp clock, false if not available
+    bool readGpuTimestamps(const uint32_t bufferIndex, uint64_t& beginNs, uint64_t& endNs);
+
     GfxResources* const mp_gfxResources = nullptr;
     Window* const mp_window             = nullptr;
+    const bool m_printRenderGraph       = false;
+    const bool m_printDrawStatistics    = false;
+    const bool m_printMemoryBudget      = false;
+    const uint32_t m_drawCount          = 1;
+    const uint32_t m_instanceCount      = 1;
+    const uint32_t m_pipelineCount      = 1;
+
+    // queue timeline value last submitted per buffer index, 0 = none
+    std::vector<uint64_t> m_submittedFrames;
+    // Profiler::readTicks() at the last submit per buffer index
+    std::vector<uint64_t> m_submitTicks;
+
+    // set by the result handlers and resizes, swapchain is rebuilt before next frame
+    bool m_swapchainDirty = false;
+
+    // nullptr when rendering at full resolution
+    std::unique_ptr<DynamicResolution> m_dynamicResolution;
+    // per buffer index, timestamps were recorded and can be read back
+    std::vector<bool> m_timestampsWritten;
+
+    // nullptr unless gpu statistics are enabled
+    std::unique_ptr<PipelineStatistics> m_pipelineStatistics;
+
+    std::unique_ptr<OcclusionQueries> m_occlusionQueries;
+    // samples the triangle covers, read back each frame
+    OcclusionQueries::QueryId m_triangleQuery = OcclusionQueries::c_invalidQuery;
+
+    struct ReadbackBuffer
+    {
+        BufferHandle buffer;
+        // persistently mapped
+        const uint8_t* p_data   = nullptr;
+        bool written            = false;
+    };
+
+    // per swapchain image, with readback enabled
+    std::vector<ReadbackBuffer> m_readbackBuffers;
+    std::vector<uint8_t> m_readbackPixels;
+
+    // static geometry, uploaded with the first frame
+    std::unique_ptr<MeshBatcher> m_meshBatcher;
+    MeshBatcher::MeshId m_triangleMesh = MeshBatcher::c_invalidMesh;
+    // rebuilt every frame
+    std::unique_ptr<DrawList> m_drawList;
+
+    std::unique_ptr<TextureStreamer> m_textureStreamer;
+    TextureStreamer::TextureId m_texture = TextureStreamer::c_invalidTexture;
+
+    // per swapchain image
+    std::vector<std::unique_ptr<RenderGraph>> m_frameGraphs;
+    FrameParams m_frame;
 };
 
 } // namespace
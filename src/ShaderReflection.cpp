@@ -0,0 +1,935 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "ShaderReflection.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// SPIR-V specification values of the instructions and operands parsed
+static constexpr uint32_t s_spirvMagic = 0x07230203;
+static constexpr uint32_t s_spirvHeaderWords = 5;
+
+enum Op : uint32_t
+{
+    OpEntryPoint            = 15,
+    OpTypeBool              = 20,
+    OpTypeInt               = 21,
+    OpTypeFloat             = 22,
+    OpTypeVector            = 23,
+    OpTypeMatrix            = 24,
+    OpTypeImage             = 25,
+    OpTypeSampler           = 26,
+    OpTypeSampledImage      = 27,
+    OpTypeArray             = 28,
+    OpTypeRuntimeArray      = 29,
+    OpTypeStruct            = 30,
+    OpTypePointer           = 32,
+    OpConstant              = 43,
+    OpSpecConstantTrue      = 48,
+    OpSpecConstantFalse     = 49,
+    OpSpecConstant          = 50,
+    OpVariable              = 59,
+    OpDecorate              = 71,
+    OpMemberDecorate        = 72,
+};
+
+enum Decoration : uint32_t
+{
+    DecorationSpecId        = 1,
+    DecorationBlock         = 2,
+    DecorationBufferBlock   = 3,
+    DecorationArrayStride   = 6,
+    DecorationMatrixStride  = 7,
+    DecorationBuiltIn       = 11,
+    DecorationLocation      = 30,
+    DecorationBinding       = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset        = 35,
+};
+
+enum StorageClass : uint32_t
+{
+    StorageClassUniformConstant = 0,
+    StorageClassInput           = 1,
+    StorageClassUniform         = 2,
+    StorageClassPushConstant    = 9,
+    StorageClassStorageBuffer   = 12,
+};
+
+enum Dim : uint32_t
+{
+    DimBuffer       = 5,
+    DimSubpassData  = 6,
+};
+
+static constexpr uint32_t s_noValue = ~0u;
+
+// well above real shaders, malformed headers don't allocate without bound
+static constexpr uint32_t s_maxIdBound = 1 << 18;
+// SPIR-V universal limit on struct members
+static constexpr uint32_t s_maxStructMembers = 16383;
+// types nest this deep at most, also stops cycles between ids
+static constexpr uint32_t s_maxTypeDepth = 64;
+// type lookups per module, wide nested structs can't blow up the size walk
+static constexpr uint32_t s_maxTypeVisits = 1 << 20;
+
+// reflection data format version, bump when ShaderReflection changes
+static constexpr uint32_t s_cacheMagic = 0x4c464552; // "REFL"
+static constexpr uint32_t s_cacheVersion = 1;
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+struct Id
+{
+    uint32_t opcode     = 0;
+    // operands after the result id
+    std::vector<uint32_t> operands;
+
+    // decorations
+    uint32_t set        = s_noValue;
+    uint32_t binding    = s_noValue;
+    uint32_t location   = s_noValue;
+    uint32_t specId     = s_noValue;
+    uint32_t arrayStride= 0;
+    bool builtIn        = false;
+    bool block          = false;
+    bool bufferBlock    = false;
+
+    // struct members
+    std::vector<uint32_t> memberOffsets;
+    std::vector<uint32_t> memberMatrixStrides;
+};
+
+class Parser
+{
+public:
+    Parser(const uint32_t* const p_words, const size_t wordCount)
+        : mp_words(p_words),
+        m_wordCount(wordCount)
+    { }
+
+    std::string parse(ShaderReflection& reflection);
+
+private:
+    Id& getId(const uint32_t id);
+    std::string readInstructions();
+
+    // nullptr and m_error set if id is out of range or
+    // defined with fewer than operandCount operands
+    const Id* findId(const uint32_t id, const size_t operandCount) const;
+
+    uint32_t getConstant(const uint32_t id) const;
+    uint32_t getTypeSize(const uint32_t type, const uint32_t matrixStride, const uint32_t depth = 0) const;
+    VkFormat getInputFormat(const uint32_t type) const;
+    VkDescriptorType getDescriptorType(const uint32_t type) const;
+
+    std::string addInput(const Id& variable, const uint32_t type, ShaderReflection& reflection) const;
+    std::string addBinding(const Id& variable, const uint32_t storageClass, uint32_t type,
+        ShaderReflection& reflection) const;
+    void addPushConstants(const uint32_t type, ShaderReflection& reflection) const;
+
+    const uint32_t* const mp_words = nullptr;
+    const size_t m_wordCount = 0;
+
+    std::vector<Id> m_ids;
+    Id m_scratch;
+    std::vector<uint32_t> m_variables;
+    uint32_t m_executionModel = s_noValue;
+
+    // first error found while resolving ids after reading
+    mutable std::string m_error;
+    mutable uint32_t m_typeVisits = 0;
+};
+
+std::string Parser::parse(ShaderReflection& reflection)
+{
+    if (m_wordCount < s_spirvHeaderWords || mp_words[0] != s_spirvMagic)
+    {
+        return "not a SPIR-V module";
+    }
+    const uint32_t bound = mp_words[3];
+    if (bound > s_maxIdBound)
+    {
+        return "id bound " + std::to_string(bound) + " is too large";
+    }
+    m_ids.resize(bound);
+
+    const std::string error = readInstructions();
+    if (!error.empty())
+    {
+        return error;
+    }
+
+    switch (m_executionModel)
+    {
+    case 0: reflection.stage = VK_SHADER_STAGE_VERTEX_BIT; break;
+    case 1: reflection.stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; break;
+    case 2: reflection.stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; break;
+    case 3: reflection.stage = VK_SHADER_STAGE_GEOMETRY_BIT; break;
+    case 4: reflection.stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
+    case 5: reflection.stage = VK_SHADER_STAGE_COMPUTE_BIT; break;
+    default: return "no supported entry point";
+    }
+
+    for (uint32_t idx = 0; idx < (uint32_t)m_ids.size(); ++idx)
+    {
+        const Id& id = m_ids[idx];
+        if (id.specId != s_noValue)
+        {
+            reflection.specConstantIds.push_back(id.specId);
+        }
+    }
+
+    for (const uint32_t variableId : m_variables)
+    {
+        const Id* const p_variable = findId(variableId, 1);
+        const Id* const p_pointer = p_variable ? findId(p_variable->operands[0], 2) : nullptr;
+        if (!p_pointer)
+        {
+            return m_error;
+        }
+        const Id& variable = *p_variable;
+        const Id& pointer = *p_pointer;
+        if (pointer.opcode != OpTypePointer)
+        {
+            return "variable without a pointer type";
+        }
+        const uint32_t storageClass = pointer.operands[0];
+        const uint32_t type = pointer.operands[1];
+
+        std::string variableError;
+        switch (storageClass)
+        {
+        case StorageClassInput:
+            if (reflection.stage == VK_SHADER_STAGE_VERTEX_BIT && !variable.builtIn)
+            {
+                variableError = addInput(variable, type, reflection);
+            }
+            break;
+        case StorageClassUniformConstant:
+        case StorageClassUniform:
+        case StorageClassStorageBuffer:
+            variableError = addBinding(variable, storageClass, type, reflection);
+            break;
+        case StorageClassPushConstant:
+            addPushConstants(type, reflection);
+            break;
+        default:
+            break;
+        }
+        if (!m_error.empty())
+        {
+            return m_error;
+        }
+        if (!variableError.empty())
+        {
+            return variableError;
+        }
+    }
+
+    std::sort(reflection.inputs.begin(), reflection.inputs.end(),
+        [](const ShaderReflection::Input& lhs, const ShaderReflection::Input& rhs)
+        { return lhs.location < rhs.location; });
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+        [](const ShaderReflection::Binding& lhs, const ShaderReflection::Binding& rhs)
+        { return std::tie(lhs.set, lhs.binding) < std::tie(rhs.set, rhs.binding); });
+    std::sort(reflection.specConstantIds.begin(), reflection.specConstantIds.end());
+
+    return std::string();
+}
+
+Id& Parser::getId(const uint32_t id)
+{
+    // out of range ids land on a scratch entry, instructions are not validated
+    if (id >= m_ids.size())
+    {
+        m_scratch = Id();
+        return m_scratch;
+    }
+    return m_ids[id];
+}
+
+std::string Parser::readInstructions()
+{
+    size_t pos = s_spirvHeaderWords;
+    while (pos < m_wordCount)
+    {
+        const uint32_t opcode = mp_words[pos] & 0xffff;
+        const uint32_t wordCount = mp_words[pos] >> 16;
+        if (wordCount == 0 || pos + wordCount > m_wordCount)
+        {
+            return "truncated instruction";
+        }
+        const uint32_t* const p_operands = mp_words + pos + 1;
+        const uint32_t operandCount = wordCount - 1;
+
+        switch (opcode)
+        {
+        case OpEntryPoint:
+            if (m_executionModel == s_noValue && operandCount >= 1)
+            {
+                m_executionModel = p_operands[0];
+            }
+            break;
+
+        case OpDecorate:
+            if (operandCount >= 2)
+            {
+                Id& id = getId(p_operands[0]);
+                const uint32_t value = (operandCount >= 3) ? p_operands[2] : 0;
+                switch (p_operands[1])
+                {
+                case DecorationSpecId:          id.specId = value; break;
+                case DecorationBlock:           id.block = true; break;
+                case DecorationBufferBlock:     id.bufferBlock = true; break;
+                case DecorationArrayStride:     id.arrayStride = value; break;
+                case DecorationBuiltIn:         id.builtIn = true; break;
+                case DecorationLocation:        id.location = value; break;
+                case DecorationBinding:         id.binding = value; break;
+                case DecorationDescriptorSet:   id.set = value; break;
+                default: break;
+                }
+            }
+            break;
+
+        case OpMemberDecorate:
+            if (operandCount >= 4)
+            {
+                Id& id = getId(p_operands[0]);
+                const uint32_t member = p_operands[1];
+                if (member >= s_maxStructMembers)
+                {
+                    return "struct member " + std::to_string(member) + " is out of range";
+                }
+                if (member >= id.memberOffsets.size())
+                {
+                    id.memberOffsets.resize(member + 1, s_noValue);
+                    id.memberMatrixStrides.resize(member + 1, 0);
+                }
+                if (p_operands[2] == DecorationOffset)
+                {
+                    id.memberOffsets[member] = p_operands[3];
+                }
+                else if (p_operands[2] == DecorationMatrixStride)
+                {
+                    id.memberMatrixStrides[member] = p_operands[3];
+                }
+            }
+            break;
+
+        case OpTypeBool:
+        case OpTypeInt:
+        case OpTypeFloat:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeImage:
+        case OpTypeSampler:
+        case OpTypeSampledImage:
+        case OpTypeArray:
+        case OpTypeRuntimeArray:
+        case OpTypeStruct:
+        case OpTypePointer:
+            if (operandCount >= 1)
+            {
+                Id& id = getId(p_operands[0]);
+                id.opcode = opcode;
+                id.operands.assign(p_operands + 1, p_operands + operandCount);
+            }
+            break;
+
+        // result type first
+        case OpConstant:
+        case OpSpecConstantTrue:
+        case OpSpecConstantFalse:
+        case OpSpecConstant:
+            if (operandCount >= 2)
+            {
+                Id& id = getId(p_operands[1]);
+                id.opcode = opcode;
+                id.operands.assign(p_operands + 2, p_operands + operandCount);
+            }
+            break;
+
+        case OpVariable:
+            if (operandCount >= 3)
+            {
+                Id& id = getId(p_operands[1]);
+                id.opcode = opcode;
+                id.operands.assign(p_operands, p_operands + 1); // pointer type
+                if (p_operands[1] < m_ids.size())
+                {
+                    m_variables.push_back(p_operands[1]);
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        pos += wordCount;
+    }
+    return std::string();
+}
+
+const Id* Parser::findId(const uint32_t id, const size_t operandCount) const
+{
+    // ids from operands are not checked while reading
+    if (id >= m_ids.size() || m_ids[id].operands.size() < operandCount)
+    {
+        if (m_error.empty())
+        {
+            m_error = "undefined or malformed id " + std::to_string(id);
+        }
+        return nullptr;
+    }
+    return &m_ids[id];
+}
+
+uint32_t Parser::getConstant(const uint32_t id) const
+{
+    // the low word is enough for array sizes
+    const Id* const p_constant = findId(id, 1);
+    return p_constant ? p_constant->operands[0] : 0;
+}
+
+uint32_t Parser::getTypeSize(const uint32_t type, const uint32_t matrixStride, const uint32_t depth) const
+{
+    if (depth > s_maxTypeDepth || ++m_typeVisits > s_maxTypeVisits)
+    {
+        if (m_error.empty())
+        {
+            m_error = "type " + std::to_string(type) + " nests too deep";
+        }
+        return 0;
+    }
+    if (type >= m_ids.size())
+    {
+        findId(type, 0);
+        return 0;
+    }
+
+    const Id& id = m_ids[type];
+    switch (id.opcode)
+    {
+    case OpTypeBool:
+        return 4;
+    case OpTypeInt:
+    case OpTypeFloat:
+        return findId(type, 1) ? id.operands[0] / 8 : 0; // width
+    case OpTypeVector:
+        return findId(type, 2) ? id.operands[1] * getTypeSize(id.operands[0], 0, depth + 1) : 0;
+    case OpTypeMatrix:
+        // column major, the stride is padded per layout rules
+        if (!findId(type, 2))
+        {
+            return 0;
+        }
+        return id.operands[1]
+            * ((matrixStride > 0) ? matrixStride : getTypeSize(id.operands[0], 0, depth + 1));
+    case OpTypeArray:
+        if (!findId(type, 2))
+        {
+            return 0;
+        }
+        return getConstant(id.operands[1])
+            * ((id.arrayStride > 0) ? id.arrayStride : getTypeSize(id.operands[0], 0, depth + 1));
+    case OpTypeStruct:
+    {
+        uint32_t size = 0;
+        for (uint32_t member = 0; member < (uint32_t)id.operands.size(); ++member)
+        {
+            const uint32_t offset = (member < id.memberOffsets.size()) ? id.memberOffsets[member] : s_noValue;
+            const uint32_t stride = (member < id.memberMatrixStrides.size()) ? id.memberMatrixStrides[member] : 0;
+            if (offset != s_noValue)
+            {
+                size = std::max(size, offset + getTypeSize(id.operands[member], stride, depth + 1));
+            }
+        }
+        return size;
+    }
+    default:
+        return 0;
+    }
+}
+
+VkFormat Parser::getInputFormat(const uint32_t type) const
+{
+    const Id* const p_id = findId(type, 0);
+    if (!p_id)
+    {
+        return VK_FORMAT_UNDEFINED;
+    }
+    uint32_t componentCount = 1;
+    const Id* p_component = p_id;
+    if (p_id->opcode == OpTypeVector)
+    {
+        p_component = findId(type, 2) ? findId(p_id->operands[0], 0) : nullptr;
+        if (!p_component)
+        {
+            return VK_FORMAT_UNDEFINED;
+        }
+        componentCount = p_id->operands[1];
+    }
+    if (p_component->operands.empty() || p_component->operands[0] != 32
+        || componentCount == 0 || componentCount > 4)
+    {
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    static const VkFormat s_floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+        VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+    static const VkFormat s_sintFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+        VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+    static const VkFormat s_uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+        VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+    if (p_component->opcode == OpTypeFloat)
+    {
+        return s_floatFormats[componentCount - 1];
+    }
+    else if (p_component->opcode == OpTypeInt)
+    {
+        const bool isSigned = (p_component->operands.size() >= 2) && (p_component->operands[1] != 0);
+        return isSigned ? s_sintFormats[componentCount - 1] : s_uintFormats[componentCount - 1];
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+VkDescriptorType Parser::getDescriptorType(const uint32_t type) const
+{
+    const Id* const p_id = findId(type, 0);
+    if (!p_id)
+    {
+        return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    }
+    const Id& id = *p_id;
+    switch (id.opcode)
+    {
+    case OpTypeSampler:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case OpTypeSampledImage:
+        return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    case OpTypeImage:
+    {
+        // sampled type, dim, depth, arrayed, multisampled, sampled, format
+        if (id.operands.size() < 6)
+        {
+            return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+        }
+        const uint32_t dim = id.operands[1];
+        const bool storage = (id.operands[5] == 2);
+        if (dim == DimSubpassData)
+        {
+            return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+        else if (dim == DimBuffer)
+        {
+            return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+        return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+    case OpTypeStruct:
+        if (id.block)
+        {
+            return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        }
+        else if (id.bufferBlock)
+        {
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        }
+        return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    default:
+        return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    }
+}
+
+std::string Parser::addInput(const Id& variable, const uint32_t type, ShaderReflection& reflection) const
+{
+    if (variable.location == s_noValue)
+    {
+        return "vertex input without a location";
+    }
+
+    // a matrix takes a location per column
+    const Id* const p_id = findId(type, 0);
+    if (!p_id)
+    {
+        return m_error;
+    }
+    const bool matrix = (p_id->opcode == OpTypeMatrix);
+    if (matrix && !findId(type, 2))
+    {
+        return m_error;
+    }
+    const uint32_t columnType = matrix ? p_id->operands[0] : type;
+    const uint32_t columnCount = matrix ? p_id->operands[1] : 1;
+
+    const VkFormat format = getInputFormat(columnType);
+    if (format == VK_FORMAT_UNDEFINED)
+    {
+        return "unsupported vertex input type at location " + std::to_string(variable.location);
+    }
+    for (uint32_t column = 0; column < columnCount; ++column)
+    {
+        reflection.inputs.push_back({ variable.location + column, format });
+    }
+    return std::string();
+}
+
+std::string Parser::addBinding(const Id& variable, const uint32_t storageClass, uint32_t type,
+    ShaderReflection& reflection) const
+{
+    ShaderReflection::Binding binding;
+    binding.set = (variable.set != s_noValue) ? variable.set : 0;
+    binding.binding = (variable.binding != s_noValue) ? variable.binding : 0;
+
+    // arrays of resources
+    const Id* const p_id = findId(type, 0);
+    if (!p_id)
+    {
+        return m_error;
+    }
+    if (p_id->opcode == OpTypeArray)
+    {
+        const Id* const p_length = findId(type, 2) ? findId(p_id->operands[1], 1) : nullptr;
+        if (!p_length)
+        {
+            return m_error;
+        }
+        binding.count = p_length->operands[0];
+        binding.countSpecId = p_length->specId;
+        type = p_id->operands[0];
+    }
+    else if (p_id->opcode == OpTypeRuntimeArray)
+    {
+        if (!findId(type, 1))
+        {
+            return m_error;
+        }
+        binding.count = 0;
+        type = p_id->operands[0];
+    }
+
+    binding.type = (storageClass == StorageClassStorageBuffer)
+        ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : getDescriptorType(type);
+    if (binding.type == VK_DESCRIPTOR_TYPE_MAX_ENUM)
+    {
+        return "unsupported descriptor type at set " + std::to_string(binding.set)
+            + " binding " + std::to_string(binding.binding);
+    }
+    reflection.bindings.push_back(binding);
+    return std::string();
+}
+
+void Parser::addPushConstants(const uint32_t type, ShaderReflection& reflection) const
+{
+    // only members the shader declares, not the whole block size
+    const Id* const p_id = findId(type, 0);
+    if (!p_id)
+    {
+        return;
+    }
+    uint32_t begin = s_noValue;
+    for (uint32_t offset : p_id->memberOffsets)
+    {
+        begin = std::min(begin, offset);
+    }
+    const uint32_t end = getTypeSize(type, 0);
+    if (begin == s_noValue || end <= begin)
+    {
+        return;
+    }
+    reflection.pushConstantOffset = begin;
+    reflection.pushConstantSize = end - begin;
+}
+
+template <typename T>
+void write(std::vector<char>& data, const T value)
+{
+    const size_t pos = data.size();
+    data.resize(pos + sizeof(T));
+    memcpy(&data[pos], &value, sizeof(T));
+}
+
+template <typename T>
+bool read(const std::vector<char>& data, size_t& pos, T& value)
+{
+    if (pos + sizeof(T) > data.size())
+    {
+        return false;
+    }
+    memcpy(&value, &data[pos], sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::string ShaderReflection::parse(const std::vector<char>& code, ShaderReflection& reflection)
+{
+    if (code.size() % sizeof(uint32_t) != 0)
+    {
+        return "code size is not a multiple of 4";
+    }
+
+    std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+    memcpy(words.data(), code.data(), code.size());
+
+    reflection = ShaderReflection();
+    Parser parser(words.data(), words.size());
+    return parser.parse(reflection);
+}
+
+uint64_t ShaderReflection::hashCode(const std::vector<char>& code)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const char byte : code)
+    {
+        hash ^= (uint8_t)byte;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::vector<char> ShaderReflection::serialize(const uint64_t codeHash) const
+{
+    std::vector<char> data;
+    write(data, s_cacheMagic);
+    write(data, s_cacheVersion);
+    write(data, codeHash);
+    write(data, (uint32_t)stage);
+
+    write(data, (uint32_t)inputs.size());
+    for (const Input& input : inputs)
+    {
+        write(data, input.location);
+        write(data, (uint32_t)input.format);
+    }
+
+    write(data, (uint32_t)bindings.size());
+    for (const Binding& binding : bindings)
+    {
+        write(data, binding.set);
+        write(data, binding.binding);
+        write(data, (uint32_t)binding.type);
+        write(data, binding.count);
+        write(data, binding.countSpecId);
+    }
+
+    write(data, pushConstantOffset);
+    write(data, pushConstantSize);
+
+    write(data, (uint32_t)specConstantIds.size());
+    for (const uint32_t id : specConstantIds)
+    {
+        write(data, id);
+    }
+    return data;
+}
+
+bool ShaderReflection::deserialize(const std::vector<char>& data, const uint64_t codeHash,
+    ShaderReflection& reflection)
+{
+    size_t pos = 0;
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t hash = 0;
+    uint32_t value = 0;
+    if (!read(data, pos, magic) || !read(data, pos, version) || !read(data, pos, hash)
+        || magic != s_cacheMagic || version != s_cacheVersion || hash != codeHash)
+    {
+        return false;
+    }
+
+    ShaderReflection result;
+    if (!read(data, pos, value))
+    {
+        return false;
+    }
+    result.stage = (VkShaderStageFlagBits)value;
+
+    uint32_t count = 0;
+    if (!read(data, pos, count) || count > data.size())
+    {
+        return false;
+    }
+    result.inputs.resize(count);
+    for (Input& input : result.inputs)
+    {
+        if (!read(data, pos, input.location) || !read(data, pos, value))
+        {
+            return false;
+        }
+        input.format = (VkFormat)value;
+    }
+
+    if (!read(data, pos, count) || count > data.size())
+    {
+        return false;
+    }
+    result.bindings.resize(count);
+    for (Binding& binding : result.bindings)
+    {
+        if (!read(data, pos, binding.set) || !read(data, pos, binding.binding) || !read(data, pos, value)
+            || !read(data, pos, binding.count) || !read(data, pos, binding.countSpecId))
+        {
+            return false;
+        }
+        binding.type = (VkDescriptorType)value;
+    }
+
+    if (!read(data, pos, result.pushConstantOffset) || !read(data, pos, result.pushConstantSize))
+    {
+        return false;
+    }
+
+    if (!read(data, pos, count) || count > data.size())
+    {
+        return false;
+    }
+    result.specConstantIds.resize(count);
+    for (uint32_t& id : result.specConstantIds)
+    {
+        if (!read(data, pos, id))
+        {
+            return false;
+        }
+    }
+
+    reflection = result;
+    return pos == data.size();
+}
+
+bool ShaderReflection::hasSpecConstant(const uint32_t id) const
+{
+    return std::binary_search(specConstantIds.begin(), specConstantIds.end(), id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PipelineInterface PipelineInterface::merge(std::initializer_list<const ShaderReflection*> stages)
+{
+    PipelineInterface result;
+    uint32_t pushBegin = s_noValue;
+    uint32_t pushEnd = 0;
+
+    for (const ShaderReflection* const p_stage : stages)
+    {
+        assert(p_stage);
+        for (const ShaderReflection::Binding& binding : p_stage->bindings)
+        {
+            if (binding.set >= result.sets.size())
+            {
+                result.sets.resize(binding.set + 1);
+            }
+            std::vector<VkDescriptorSetLayoutBinding>& set = result.sets[binding.set];
+
+            const auto iter = std::find_if(set.begin(), set.end(),
+                [&binding](const VkDescriptorSetLayoutBinding& layoutBinding)
+                { return layoutBinding.binding == binding.binding; });
+            if (iter == set.end())
+            {
+                const VkDescriptorSetLayoutBinding layoutBinding =
+                {
+                    binding.binding,    // binding
+                    binding.type,       // descriptorType
+                    binding.count,      // descriptorCount
+                    p_stage->stage,     // stageFlags
+                    nullptr             // pImmutableSamplers
+                };
+                set.push_back(layoutBinding);
+            }
+            else if (iter->descriptorType != binding.type)
+            {
+                throw std::runtime_error("Shader stages disagree on the type of set "
+                    + std::to_string(binding.set) + " binding " + std::to_string(binding.binding));
+            }
+            else
+            {
+                iter->descriptorCount = std::max(iter->descriptorCount, binding.count);
+                iter->stageFlags |= p_stage->stage;
+            }
+        }
+
+        if (p_stage->pushConstantSize > 0)
+        {
+            pushBegin = std::min(pushBegin, p_stage->pushConstantOffset);
+            pushEnd = std::max(pushEnd, p_stage->pushConstantOffset + p_stage->pushConstantSize);
+            result.pushConstantRange.stageFlags |= p_stage->stage;
+        }
+    }
+
+    for (std::vector<VkDescriptorSetLayoutBinding>& set : result.sets)
+    {
+        std::sort(set.begin(), set.end(),
+            [](const VkDescriptorSetLayoutBinding& lhs, const VkDescriptorSetLayoutBinding& rhs)
+            { return lhs.binding < rhs.binding; });
+    }
+    if (pushEnd > 0)
+    {
+        result.pushConstantRange.offset = pushBegin;
+        result.pushConstantRange.size = pushEnd - pushBegin;
+    }
+    return result;
+}
+
+void PipelineInterface::getVertexInput(const ShaderReflection& vertexStage,
+    const std::vector<VkVertexInputAttributeDescription>& available,
+    const std::vector<uint32_t>& strides,
+    std::vector<VkVertexInputBindingDescription>& bindings,
+    std::vector<VkVertexInputAttributeDescription>& attributes)
+{
+    assert(vertexStage.stage == VK_SHADER_STAGE_VERTEX_BIT);
+    bindings.clear();
+    attributes.clear();
+
+    // unused attributes are left out, so are bindings nothing reads
+    for (const ShaderReflection::Input& input : vertexStage.inputs)
+    {
+        const auto iter = std::find_if(available.begin(), available.end(),
+            [&input](const VkVertexInputAttributeDescription& attribute)
+            { return attribute.location == input.location; });
+        if (iter == available.end() || iter->binding >= strides.size())
+        {
+            throw std::runtime_error("No vertex attribute for shader input at location "
+                + std::to_string(input.location));
+        }
+        attributes.push_back(*iter);
+
+        const uint32_t binding = iter->binding;
+        if (std::none_of(bindings.begin(), bindings.end(),
+            [binding](const VkVertexInputBindingDescription& description)
+            { return description.binding == binding; }))
+        {
+            const VkVertexInputBindingDescription description =
+            {
+                binding,                        // binding
+                strides[binding],               // stride
+                VK_VERTEX_INPUT_RATE_VERTEX     // inputRate
+            };
+            bindings.push_back(description);
+        }
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
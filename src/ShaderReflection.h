@@ -0,0 +1,93 @@
+#ifndef CORE_SHADER_REFLECTION_H
+#define CORE_SHADER_REFLECTION_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Interface of a SPIR-V module, read straight from the binary:
+// stage, vertex inputs, descriptor bindings, push constant range and
+// specialization constant ids. Only what pipeline creation needs is
+// parsed, the first entry point is the one reflected.
+struct ShaderReflection
+{
+    struct Input
+    {
+        uint32_t location   = 0;
+        VkFormat format     = VK_FORMAT_UNDEFINED;
+    };
+
+    struct Binding
+    {
+        uint32_t set            = 0;
+        uint32_t binding        = 0;
+        VkDescriptorType type   = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+        // array size, 0 for runtime arrays, the default
+        // value if sized by a specialization constant
+        uint32_t count          = 1;
+        // specialization constant sizing the array, ~0u if none
+        uint32_t countSpecId    = ~0u;
+    };
+
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+    // sorted by location, built-ins are not included
+    std::vector<Input> inputs;
+    // sorted by set and binding
+    std::vector<Binding> bindings;
+    // bytes the push constant block uses, size 0 = none
+    uint32_t pushConstantOffset = 0;
+    uint32_t pushConstantSize   = 0;
+    // sorted
+    std::vector<uint32_t> specConstantIds;
+
+    // returns an error message, empty on success
+    static std::string parse(const std::vector<char>& code, ShaderReflection& reflection);
+
+    // for caching, stale data is detected with the hash of the code
+    static uint64_t hashCode(const std::vector<char>& code);
+    std::vector<char> serialize(const uint64_t codeHash) const;
+    // returns false if the data is invalid or for other code
+    static bool deserialize(const std::vector<char>& data, const uint64_t codeHash,
+        ShaderReflection& reflection);
+
+    bool hasSpecConstant(const uint32_t id) const;
+};
+
+// Stages of a pipeline combined
+struct PipelineInterface
+{
+    // per set index, stage flags of a binding are those of every stage using it
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+    // one range over the push constants of all stages, so one
+    // vkCmdPushConstants() with the combined stages covers them
+    VkPushConstantRange pushConstantRange = { 0, 0, 0 };
+
+    // throws std::runtime_error if the stages disagree on a binding
+    static PipelineInterface merge(std::initializer_list<const ShaderReflection*> stages);
+
+    // the shader's inputs picked from the attributes vertex buffers provide,
+    // with one per vertex binding of the given stride per binding index,
+    // throws std::runtime_error if an input has no attribute
+    static void getVertexInput(const ShaderReflection& vertexStage,
+        const std::vector<VkVertexInputAttributeDescription>& available,
+        const std::vector<uint32_t>& strides,
+        std::vector<VkVertexInputBindingDescription>& bindings,
+        std::vector<VkVertexInputAttributeDescription>& attributes);
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_SHADER_REFLECTION_H
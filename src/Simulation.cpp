@@ -0,0 +1,115 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "Simulation.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+static const float s_twoPi = 6.28318530718f;
+static const float s_angularVelocity = 1.0f; // radians per second
+
+// do not try to catch up more than this after a long stall
+static const uint32_t s_maxCatchUpSteps = 5;
+
+Simulation::Simulation(const uint32_t tickRate)
+    : m_timestep(std::chrono::nanoseconds(1000000000 / tickRate))
+{
+    assert(tickRate > 0);
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+void Simulation::start()
+{
+    assert(!m_running);
+
+    m_running = true;
+    m_thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop()
+{
+    m_running = false;
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+SimulationState Simulation::sample()
+{
+    m_snapshots.update();
+    const SimulationSnapshot& snapshot = m_snapshots.getReadBuffer();
+
+    const auto sinceTick = std::chrono::steady_clock::now() - snapshot.tickTime;
+    const float alpha = std::min(std::max(
+        std::chrono::duration<float>(sinceTick).count()
+        / std::chrono::duration<float>(m_timestep).count(), 0.0f), 1.0f);
+
+    float deltaAngle = snapshot.current.angle - snapshot.previous.angle;
+    if (deltaAngle < -0.5f * s_twoPi)
+    {
+        deltaAngle += s_twoPi; // wrapped around
+    }
+
+    SimulationState state = snapshot.current;
+    state.angle = std::fmod(snapshot.previous.angle + alpha * deltaAngle, s_twoPi);
+    return state;
+}
+
+void Simulation::run()
+{
+    CORE_PROFILE_THREAD("simulation");
+
+    auto nextTick = std::chrono::steady_clock::now();
+
+    while (m_running)
+    {
+        const SimulationState previous = m_state;
+        step();
+
+        SimulationSnapshot& snapshot = m_snapshots.getWriteBuffer();
+        snapshot.previous = previous;
+        snapshot.current = m_state;
+        snapshot.tickTime = nextTick;
+        m_snapshots.publish();
+
+        nextTick += m_timestep;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now > nextTick + s_maxCatchUpSteps * m_timestep)
+        {
+            // fell too far behind, drop the missed steps
+            nextTick = now;
+        }
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+void Simulation::step()
+{
+    CORE_PROFILE_ZONE("Simulation::step");
+
+    const float dt = std::chrono::duration<float>(m_timestep).count();
+
+    m_state.tick++;
+    m_state.angle = std::fmod(m_state.angle + s_angularVelocity * dt, s_twoPi);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
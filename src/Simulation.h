@@ -0,0 +1,71 @@
+#ifndef CORE_SIMULATION_H
+#define CORE_SIMULATION_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+struct SimulationState
+{
+    uint64_t tick   = 0;
+    float angle     = 0.0f; // triangle rotation in radians [0, 2pi)
+};
+
+// Immutable result of one simulation step, handed to the render thread.
+struct SimulationSnapshot
+{
+    SimulationState previous;
+    SimulationState current;
+    // time point which current state corresponds to
+    std::chrono::steady_clock::time_point tickTime;
+};
+
+// Runs the simulation with a fixed timestep in its own thread.
+// The render thread samples the latest snapshot and interpolates
+// between the last two states, so neither thread stalls the other.
+class Simulation
+{
+public:
+    Simulation(const uint32_t tickRate);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    void start();
+    void stop();
+
+    // render thread only
+    SimulationState sample();
+
+private:
+    void run();
+    void step();
+
+    const std::chrono::nanoseconds m_timestep;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running { false };
+
+    TripleBuffer<SimulationSnapshot> m_snapshots;
+
+    // owned by the simulation thread
+    SimulationState m_state;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_SIMULATION_H
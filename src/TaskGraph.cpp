@@ -0,0 +1,311 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "TaskGraph.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <iomanip>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// workers of TaskGraph::parallelFor(), started on first use
+// and kept for the lifetime of the process
+class ParallelForPool
+{
+public:
+    ParallelForPool()
+    {
+        const uint32_t workerCount = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+        for (uint32_t idx = 0; idx < workerCount; ++idx)
+        {
+            m_threads.emplace_back(&ParallelForPool::work, this);
+        }
+    }
+
+    ~ParallelForPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        for (std::thread& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    ParallelForPool(const ParallelForPool&) = delete;
+    ParallelForPool& operator=(const ParallelForPool&) = delete;
+
+    void run(const uint32_t count, const std::function<void(const uint32_t)>& func)
+    {
+        std::lock_guard<std::mutex> dispatchLock(m_dispatchMutex);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        mp_func = &func;
+        m_count = count;
+        m_next = 0;
+        m_done = 0;
+        m_exception = nullptr;
+        for (uint32_t idx = 1; idx < count; ++idx)
+        {
+            m_condition.notify_one();
+        }
+
+        runIndices(lock);
+        m_doneCondition.wait(lock, [this]() { return m_done == m_count; });
+
+        const std::exception_ptr exception = m_exception;
+        mp_func = nullptr;
+        m_count = 0;
+        m_next = 0;
+        m_exception = nullptr;
+        lock.unlock();
+
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+private:
+    void work()
+    {
+        CORE_PROFILE_THREAD("parallel for worker");
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_condition.wait(lock, [this]() { return m_stop || m_next < m_count; });
+            if (m_stop)
+            {
+                return;
+            }
+            runIndices(lock);
+        }
+    }
+
+    // takes indices until none are left, lock is held between them
+    void runIndices(std::unique_lock<std::mutex>& lock)
+    {
+        while (m_next < m_count)
+        {
+            const uint32_t idx = m_next++;
+            const bool skip = (m_exception != nullptr);
+
+            lock.unlock();
+            std::exception_ptr exception;
+            if (!skip)
+            {
+                try
+                {
+                    (*mp_func)(idx);
+                }
+                catch (...)
+                {
+                    exception = std::current_exception();
+                }
+            }
+            lock.lock();
+
+            if (exception && !m_exception)
+            {
+                m_exception = exception;
+            }
+            if (++m_done == m_count)
+            {
+                m_doneCondition.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+
+    // one parallelFor() at a time
+    std::mutex m_dispatchMutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::condition_variable m_doneCondition;
+    const std::function<void(const uint32_t)>* mp_func = nullptr;
+    uint32_t m_count = 0;
+    uint32_t m_next = 0;
+    uint32_t m_done = 0;
+    std::exception_ptr m_exception;
+    bool m_stop = false;
+};
+
+TaskGraph::TaskId TaskGraph::addTask(const std::string& name, std::function<void()> func,
+    std::initializer_list<TaskId> dependencies)
+{
+    const TaskId id = (TaskId)m_tasks.size();
+
+    Task task;
+    task.name = name;
+    task.func = std::move(func);
+    task.dependencyCount = (uint32_t)dependencies.size();
+    m_tasks.push_back(std::move(task));
+
+    for (const TaskId dependency : dependencies)
+    {
+        // dependencies must be added first, so the graph has no cycles
+        assert(dependency < id);
+        m_tasks[dependency].dependents.push_back(id);
+    }
+
+    return id;
+}
+
+void TaskGraph::run(const uint32_t threadCount)
+{
+    const uint32_t workerCount = std::max(1u,
+        (threadCount > 0) ? threadCount : std::thread::hardware_concurrency());
+
+    m_startTime = Clock::now();
+    m_finishedCount = 0;
+    m_runningCount = 0;
+    m_exception = nullptr;
+    m_readyTasks.clear();
+    for (TaskId id = 0; id < m_tasks.size(); ++id)
+    {
+        m_tasks[id].pendingCount = m_tasks[id].dependencyCount;
+        if (m_tasks[id].pendingCount == 0)
+        {
+            m_readyTasks.push_back(id);
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (uint32_t idx = 1; idx < workerCount; ++idx)
+    {
+        threads.emplace_back(&TaskGraph::work, this, idx);
+    }
+    work(0);
+
+    for (auto& ref : threads)
+    {
+        ref.join();
+    }
+    m_endTime = Clock::now();
+
+    if (m_exception)
+    {
+        std::rethrow_exception(m_exception);
+    }
+}
+
+void TaskGraph::parallelFor(const uint32_t count, const std::function<void(const uint32_t)>& func)
+{
+    if (count <= 1)
+    {
+        if (count == 1)
+        {
+            func(0);
+        }
+        return;
+    }
+
+    static ParallelForPool s_pool;
+    s_pool.run(count, func);
+}
+
+void TaskGraph::work(const uint32_t threadIndex)
+{
+    // index 0 is the thread that called run()
+    if (threadIndex > 0)
+    {
+        CORE_PROFILE_THREAD("task worker");
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_condition.wait(lock, [this]()
+        {
+            return !m_readyTasks.empty()
+                || m_finishedCount == m_tasks.size()
+                || (m_exception && m_runningCount == 0);
+        });
+
+        if (m_finishedCount == m_tasks.size() || m_exception)
+        {
+            break;
+        }
+
+        const TaskId id = m_readyTasks.back();
+        m_readyTasks.pop_back();
+        m_runningCount++;
+
+        Task& task = m_tasks[id];
+        task.threadIndex = threadIndex;
+        task.startTime = Clock::now();
+
+        lock.unlock();
+        std::exception_ptr exception;
+        try
+        {
+            task.func();
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        lock.lock();
+
+        task.endTime = Clock::now();
+        m_runningCount--;
+        m_finishedCount++;
+
+        if (exception && !m_exception)
+        {
+            m_exception = exception;
+        }
+        for (const TaskId dependent : task.dependents)
+        {
+            if (--m_tasks[dependent].pendingCount == 0)
+            {
+                m_readyTasks.push_back(dependent);
+            }
+        }
+        m_condition.notify_all();
+    }
+}
+
+void TaskGraph::printReport(std::ostream& out) const
+{
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+    size_t nameWidth = 4;
+    for (const auto& ref : m_tasks)
+    {
+        nameWidth = std::max(nameWidth, ref.name.size());
+    }
+
+    out << std::fixed << std::setprecision(2);
+    out << std::left << std::setw(nameWidth) << "task" << std::right
+        << std::setw(10) << "start ms" << std::setw(10) << "time ms" << "  thread" << std::endl;
+
+    for (const auto& ref : m_tasks)
+    {
+        out << std::left << std::setw(nameWidth) << ref.name << std::right
+            << std::setw(10) << Milliseconds(ref.startTime - m_startTime).count()
+            << std::setw(10) << Milliseconds(ref.endTime - ref.startTime).count()
+            << "  " << ref.threadIndex << std::endl;
+    }
+    out << std::left << std::setw(nameWidth) << "total" << std::right
+        << std::setw(10) << 0.0
+        << std::setw(10) << Milliseconds(m_endTime - m_startTime).count() << std::endl;
+    out.unsetf(std::ios_base::floatfield);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
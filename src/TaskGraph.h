@@ -0,0 +1,94 @@
+#ifndef CORE_TASK_GRAPH_H
+#define CORE_TASK_GRAPH_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Runs a set of tasks with dependencies on a pool of threads.
+// Meant for one-shot work like startup, tasks are not re-run.
+class TaskGraph
+{
+public:
+    typedef uint32_t TaskId;
+    typedef std::chrono::steady_clock Clock;
+
+    TaskGraph() = default;
+    ~TaskGraph() = default;
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    TaskId addTask(const std::string& name, std::function<void()> func,
+        std::initializer_list<TaskId> dependencies = {});
+
+    // blocks until all tasks are done, the calling thread works too.
+    // 0 threads = hardware concurrency.
+    // The first exception thrown by a task is rethrown here,
+    // tasks not yet started are skipped after that.
+    void run(const uint32_t threadCount);
+
+    // per task start and duration relative to run() start
+    void printReport(std::ostream& out) const;
+
+    // below this many items of per frame work, e.g. draws to sort or
+    // objects to cull, waking the workers costs more than it saves
+    static const uint32_t c_parallelThreshold = 1 << 16;
+
+    // func(idx) for idx in [0, count) on persistent worker threads,
+    // hardware concurrency - 1 of them, and the calling thread.
+    // Blocks until all are done. The first exception thrown by func is
+    // rethrown here, indices not yet started are skipped after that.
+    // Calls from different threads run one at a time, func must not
+    // call parallelFor().
+    static void parallelFor(const uint32_t count, const std::function<void(const uint32_t)>& func);
+
+private:
+    struct Task
+    {
+        std::string name;
+        std::function<void()> func;
+        std::vector<TaskId> dependents;
+        uint32_t dependencyCount    = 0;
+        uint32_t pendingCount       = 0;
+
+        uint32_t threadIndex        = 0;
+        Clock::time_point startTime;
+        Clock::time_point endTime;
+    };
+
+    void work(const uint32_t threadIndex);
+
+    std::vector<Task> m_tasks;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::vector<TaskId> m_readyTasks;
+    uint32_t m_finishedCount = 0;
+    uint32_t m_runningCount = 0;
+    std::exception_ptr m_exception;
+
+    Clock::time_point m_startTime;
+    Clock::time_point m_endTime;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_TASK_GRAPH_H
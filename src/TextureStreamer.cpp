@@ -0,0 +1,974 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "TextureStreamer.h"
+
+#include "BindlessTable.h"
+#include "Config.h"
+#include "DeletionQueue.h"
+#include "ErrorHandling.h"
+#include "GfxResources.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+static const uint8_t s_ktx2Identifier[12] =
+{
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+static const size_t s_ktx2HeaderSize = 80;
+static const size_t s_ktx2LevelIndexSize = 24;
+
+// levels that fit in this together are uploaded first as one batch
+static const VkDeviceSize s_mipTailSize = 64 * 1024;
+// multiple of 4 and of the texel block size of every supported format
+static const VkDeviceSize s_stagingAlignment = 16;
+
+// formats whose texel blocks fit s_stagingAlignment
+struct FormatInfo
+{
+    VkFormat format;
+    uint32_t blockWidth;
+    uint32_t blockHeight;
+    uint32_t blockSize;
+};
+
+static const FormatInfo s_supportedFormats[] =
+{
+    { VK_FORMAT_R8_UNORM,                   1, 1, 1 },
+    { VK_FORMAT_R8G8_UNORM,                 1, 1, 2 },
+    { VK_FORMAT_R8G8B8A8_UNORM,             1, 1, 4 },
+    { VK_FORMAT_R8G8B8A8_SRGB,              1, 1, 4 },
+    { VK_FORMAT_B8G8R8A8_UNORM,             1, 1, 4 },
+    { VK_FORMAT_B8G8R8A8_SRGB,              1, 1, 4 },
+    { VK_FORMAT_R16G16B16A16_SFLOAT,        1, 1, 8 },
+    { VK_FORMAT_R32G32B32A32_SFLOAT,        1, 1, 16 },
+    { VK_FORMAT_BC1_RGBA_UNORM_BLOCK,       4, 4, 8 },
+    { VK_FORMAT_BC1_RGBA_SRGB_BLOCK,        4, 4, 8 },
+    { VK_FORMAT_BC3_UNORM_BLOCK,            4, 4, 16 },
+    { VK_FORMAT_BC3_SRGB_BLOCK,             4, 4, 16 },
+    { VK_FORMAT_BC4_UNORM_BLOCK,            4, 4, 8 },
+    { VK_FORMAT_BC5_UNORM_BLOCK,            4, 4, 16 },
+    { VK_FORMAT_BC7_UNORM_BLOCK,            4, 4, 16 },
+    { VK_FORMAT_BC7_SRGB_BLOCK,             4, 4, 16 },
+    { VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK,  4, 4, 16 },
+    { VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK,   4, 4, 16 },
+    { VK_FORMAT_ASTC_4x4_UNORM_BLOCK,       4, 4, 16 },
+    { VK_FORMAT_ASTC_4x4_SRGB_BLOCK,        4, 4, 16 },
+};
+
+static const FormatInfo* findFormatInfo(const VkFormat format)
+{
+    for (const FormatInfo& info : s_supportedFormats)
+    {
+        if (info.format == format)
+        {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+template <typename T>
+static T readValue(const uint8_t* const p_data, const size_t offset)
+{
+    T value;
+    std::memcpy(&value, p_data + offset, sizeof(value));
+    return value;
+}
+
+static VkDeviceSize alignStaging(const VkDeviceSize size)
+{
+    return (size + s_stagingAlignment - 1) & ~(s_stagingAlignment - 1);
+}
+
+static uint32_t findMemoryTypeIndex(
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    const uint32_t memoryTypeBits,
+    const VkMemoryPropertyFlags propertyFlags)
+{
+    for (uint32_t idx = 0; idx < memoryProperties.memoryTypeCount; ++idx)
+    {
+        if ((memoryTypeBits & (1u << idx))
+            && (memoryProperties.memoryTypes[idx].propertyFlags & propertyFlags) == propertyFlags)
+        {
+            return idx;
+        }
+    }
+    return ~0u;
+}
+
+static ImageHandle createSampledImage(GfxResources& gfxResources,
+    const VkFormat format, const VkExtent2D extent, const uint32_t levelCount,
+    uint32_t* const p_memoryTypeIndex = nullptr, VkDeviceSize* const p_memorySize = nullptr)
+{
+    VkDevice device = gfxResources.getDevice();
+
+    const VkImageCreateInfo imageCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,                            // sType
+        nullptr,                                                        // pNext
+        0,                                                              // flags
+        VK_IMAGE_TYPE_2D,                                               // imageType
+        format,                                                         // format
+        { extent.width, extent.height, 1 },                             // extent
+        levelCount,                                                     // mipLevels
+        1,                                                              // arrayLayers
+        VK_SAMPLE_COUNT_1_BIT,                                          // samples
+        VK_IMAGE_TILING_OPTIMAL,                                        // tiling
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,   // usage
+        VK_SHARING_MODE_EXCLUSIVE,                                      // sharingMode
+        0,                                                              // queueFamilyIndexCount
+        nullptr,                                                        // pQueueFamilyIndices
+        VK_IMAGE_LAYOUT_UNDEFINED                                       // initialLayout
+    };
+
+    VkImage image = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkCreateImage(
+        device,             // device
+        &imageCreateInfo,   // pCreateInfo
+        nullptr,            // pAllocator
+        &image));           // pImage
+
+    VkMemoryRequirements memoryRequirements = {};
+    vkGetImageMemoryRequirements(
+        device,                 // device
+        image,                  // image
+        &memoryRequirements);   // pMemoryRequirements
+
+    const uint32_t memoryTypeIndex = findMemoryTypeIndex(gfxResources.getMemoryProperties(),
+        memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memoryTypeIndex == ~0u)
+    {
+        vkDestroyImage(device, image, nullptr);
+        throw std::runtime_error("No device local memory type for texture");
+    }
+
+    const VkMemoryAllocateInfo memoryAllocateInfo =
+    {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, // sType
+        nullptr,                                // pNext
+        memoryRequirements.size,                // allocationSize
+        memoryTypeIndex                         // memoryTypeIndex
+    };
+
+    VkDeviceMemory memory = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkAllocateMemory(
+        device,                 // device
+        &memoryAllocateInfo,    // pAllocateInfo
+        nullptr,                // pAllocator
+        &memory));              // pMemory
+
+    gfxResources.getMemoryBudget().onAllocate(memory, memoryTypeIndex,
+        memoryRequirements.size, MemoryBudget::Category::Textures);
+    if (p_memoryTypeIndex)
+    {
+        *p_memoryTypeIndex = memoryTypeIndex;
+    }
+    if (p_memorySize)
+    {
+        *p_memorySize = memoryRequirements.size;
+    }
+
+    CHECK_VK_RESULT_SUCCESS(vkBindImageMemory(
+        device, // device
+        image,  // image
+        memory, // memory
+        0));    // memoryOffset
+
+    const VkImageViewCreateInfo imageViewCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,   // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        image,                                      // image
+        VK_IMAGE_VIEW_TYPE_2D,                      // viewType
+        format,                                     // format
+        {
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY
+        },                                          // components
+        {
+            VK_IMAGE_ASPECT_COLOR_BIT,              // aspectMask
+            0,                                      // baseMipLevel
+            levelCount,                             // levelCount
+            0,                                      // baseArrayLayer
+            1                                       // layerCount
+        }                                           // subresourceRange
+    };
+
+    VkImageView imageView = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkCreateImageView(
+        device,                 // device
+        &imageViewCreateInfo,   // pCreateInfo
+        nullptr,                // pAllocator
+        &imageView));           // pView
+
+    return gfxResources.getImagePool().create(image, imageView, memory, format, extent);
+}
+
+static void recordImageBarrier(VkCommandBuffer cmdBuffer, VkImage image,
+    const uint32_t baseLevel, const uint32_t levelCount,
+    const VkAccessFlags srcAccessMask, const VkAccessFlags dstAccessMask,
+    const VkImageLayout oldLayout, const VkImageLayout newLayout,
+    const VkPipelineStageFlags srcStageMask, const VkPipelineStageFlags dstStageMask)
+{
+    const VkImageMemoryBarrier imageMemoryBarrier =
+    {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, // sType
+        nullptr,                                // pNext
+        srcAccessMask,                          // srcAccessMask
+        dstAccessMask,                          // dstAccessMask
+        oldLayout,                              // oldLayout
+        newLayout,                              // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                // dstQueueFamilyIndex
+        image,                                  // image
+        {
+            VK_IMAGE_ASPECT_COLOR_BIT,          // aspectMask
+            baseLevel,                          // baseMipLevel
+            levelCount,                         // levelCount
+            0,                                  // baseArrayLayer
+            1                                   // layerCount
+        }                                       // subresourceRange
+    };
+
+    vkCmdPipelineBarrier(
+        cmdBuffer,              // commandBuffer
+        srcStageMask,           // srcStageMask
+        dstStageMask,           // dstStageMask
+        0,                      // dependencyFlags
+        0,                      // memoryBarrierCount
+        nullptr,                // pMemoryBarriers
+        0,                      // bufferMemoryBarrierCount
+        nullptr,                // pBufferMemoryBarriers
+        1,                      // imageMemoryBarrierCount
+        &imageMemoryBarrier);   // pImageMemoryBarriers
+}
+
+TextureStreamer::TextureStreamer(GfxResources* const p_gfxResources, const Config* const p_config)
+    : mp_gfxResources(p_gfxResources),
+    m_device(p_gfxResources->getDevice()),
+    m_uploadBudget((VkDeviceSize)p_config->textureUploadBudgetKb * 1024)
+{
+    assert(mp_gfxResources);
+    assert(p_config);
+
+    m_ringSize = std::max(alignStaging((VkDeviceSize)p_config->textureStagingKb * 1024), s_stagingAlignment);
+
+    // lod is clamped in the shader to the resident mips
+    const VkSamplerCreateInfo samplerCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,      // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        VK_FILTER_LINEAR,                           // magFilter
+        VK_FILTER_LINEAR,                           // minFilter
+        VK_SAMPLER_MIPMAP_MODE_LINEAR,              // mipmapMode
+        VK_SAMPLER_ADDRESS_MODE_REPEAT,             // addressModeU
+        VK_SAMPLER_ADDRESS_MODE_REPEAT,             // addressModeV
+        VK_SAMPLER_ADDRESS_MODE_REPEAT,             // addressModeW
+        0.0f,                                       // mipLodBias
+        VK_FALSE,                                   // anisotropyEnable
+        1.0f,                                       // maxAnisotropy
+        VK_FALSE,                                   // compareEnable
+        VK_COMPARE_OP_NEVER,                        // compareOp
+        0.0f,                                       // minLod
+        VK_LOD_CLAMP_NONE,                          // maxLod
+        VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,    // borderColor
+        VK_FALSE                                    // unnormalizedCoordinates
+    };
+
+    VkSampler sampler = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkCreateSampler(
+        m_device,           // device
+        &samplerCreateInfo, // pCreateInfo
+        nullptr,            // pAllocator
+        &sampler));         // pSampler
+    m_sampler = mp_gfxResources->getSamplerPool().create(sampler);
+
+    // staging ring stays mapped, the loader thread writes straight into it
+    const VkBufferCreateInfo bufferCreateInfo =
+    {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,   // sType
+        nullptr,                                // pNext
+        0,                                      // flags
+        m_ringSize,                             // size
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,       // usage
+        VK_SHARING_MODE_EXCLUSIVE,              // sharingMode
+        0,                                      // queueFamilyIndexCount
+        nullptr                                 // pQueueFamilyIndices
+    };
+
+    VkBuffer buffer = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkCreateBuffer(
+        m_device,           // device
+        &bufferCreateInfo,  // pCreateInfo
+        nullptr,            // pAllocator
+        &buffer));          // pBuffer
+
+    VkMemoryRequirements memoryRequirements = {};
+    vkGetBufferMemoryRequirements(
+        m_device,               // device
+        buffer,                 // buffer
+        &memoryRequirements);   // pMemoryRequirements
+
+    const uint32_t memoryTypeIndex = findMemoryTypeIndex(mp_gfxResources->getMemoryProperties(),
+        memoryRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (memoryTypeIndex == ~0u)
+    {
+        vkDestroyBuffer(m_device, buffer, nullptr);
+        throw std::runtime_error("No host visible memory type for texture staging");
+    }
+
+    const VkMemoryAllocateInfo memoryAllocateInfo =
+    {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, // sType
+        nullptr,                                // pNext
+        memoryRequirements.size,                // allocationSize
+        memoryTypeIndex                         // memoryTypeIndex
+    };
+
+    VkDeviceMemory memory = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkAllocateMemory(
+        m_device,               // device
+        &memoryAllocateInfo,    // pAllocateInfo
+        nullptr,                // pAllocator
+        &memory));              // pMemory
+
+    mp_gfxResources->getMemoryBudget().onAllocate(memory, memoryTypeIndex,
+        memoryRequirements.size, MemoryBudget::Category::Staging);
+
+    CHECK_VK_RESULT_SUCCESS(vkBindBufferMemory(
+        m_device,   // device
+        buffer,     // buffer
+        memory,     // memory
+        0));        // memoryOffset
+
+    void* p_data = nullptr;
+    CHECK_VK_RESULT_SUCCESS(vkMapMemory(
+        m_device,       // device
+        memory,         // memory
+        0,              // offset
+        VK_WHOLE_SIZE,  // size
+        0,              // flags
+        &p_data));      // ppData
+    mp_ringData = (uint8_t*)p_data;
+
+    m_ring = mp_gfxResources->getBufferPool().create(
+        buffer, memory, m_ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+    createPlaceholder();
+
+    m_loader = std::thread(&TextureStreamer::loaderMain, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_jobAdded.notify_one();
+    m_loader.join();
+
+    // frames in flight may still sample the textures and read the ring
+    BindlessTable& bindlessTable = mp_gfxResources->getBindlessTable();
+    DeletionQueue& deletionQueue = mp_gfxResources->getDeletionQueue();
+    MemoryBudget& memoryBudget = mp_gfxResources->getMemoryBudget();
+    for (const Texture& texture : m_textures)
+    {
+        memoryBudget.removeEvictable(texture.evictable);
+        if (texture.image.isValid())
+        {
+            bindlessTable.removeTexture(texture.bindlessIndex, deletionQueue);
+            mp_gfxResources->releaseImage(texture.image);
+        }
+    }
+    bindlessTable.removeTexture(m_placeholderIndex, deletionQueue);
+    bindlessTable.setDefaultTexture(nullptr, nullptr);
+    mp_gfxResources->releaseImage(m_placeholder);
+    mp_gfxResources->releaseSampler(m_sampler);
+    mp_gfxResources->releaseBuffer(m_ring);
+}
+
+void TextureStreamer::createPlaceholder()
+{
+    // cleared to white by the first update()
+    m_placeholder = createSampledImage(*mp_gfxResources,
+        VK_FORMAT_R8G8B8A8_UNORM, { 1, 1 }, 1);
+
+    // also fills the unused slots of a table without descriptor indexing
+    BindlessTable& bindlessTable = mp_gfxResources->getBindlessTable();
+    VkImageView imageView = mp_gfxResources->getImagePool().get<ImagePool::View>(m_placeholder);
+    VkSampler sampler = mp_gfxResources->getSamplerPool().get<SamplerPool::Sampler>(m_sampler);
+    bindlessTable.setDefaultTexture(imageView, sampler);
+    m_placeholderIndex = bindlessTable.addTexture(imageView, sampler);
+    if (m_placeholderIndex == BindlessTable::c_invalidIndex)
+    {
+        throw std::runtime_error("No bindless slot for the placeholder texture");
+    }
+}
+
+TextureStreamer::TextureId TextureStreamer::load(const std::string& fileName)
+{
+    const TextureId textureId = (TextureId)m_textures.size();
+    m_textures.push_back(Texture());
+    m_textures.back().fileName = fileName;
+
+    Job job;
+    job.texture = textureId;
+    job.fileName = fileName;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_jobAdded.notify_one();
+
+    return textureId;
+}
+
+std::string TextureStreamer::readHeader(const MappedFile& file, Header& header)
+{
+    const uint8_t* const p_data = file.getData();
+    const size_t fileSize = file.getSize();
+
+    if (fileSize < s_ktx2HeaderSize
+        || std::memcmp(p_data, s_ktx2Identifier, sizeof(s_ktx2Identifier)) != 0)
+    {
+        return "not a KTX2 file";
+    }
+
+    const uint32_t format           = readValue<uint32_t>(p_data, 12);
+    const uint32_t width            = readValue<uint32_t>(p_data, 20);
+    const uint32_t height           = readValue<uint32_t>(p_data, 24);
+    const uint32_t depth            = readValue<uint32_t>(p_data, 28);
+    const uint32_t layerCount       = readValue<uint32_t>(p_data, 32);
+    const uint32_t faceCount        = readValue<uint32_t>(p_data, 36);
+    const uint32_t levelCount       = std::max(readValue<uint32_t>(p_data, 40), 1u);
+    const uint32_t supercompression = readValue<uint32_t>(p_data, 44);
+
+    if (format == VK_FORMAT_UNDEFINED || supercompression != 0)
+    {
+        return "supercompressed textures are not supported";
+    }
+    if (width == 0 || height == 0 || depth > 0 || layerCount > 1 || faceCount != 1)
+    {
+        return "only 2D textures are supported";
+    }
+
+    const FormatInfo* const p_formatInfo = findFormatInfo((VkFormat)format);
+    if (!p_formatInfo)
+    {
+        return "unsupported format " + std::to_string(format);
+    }
+
+    uint32_t maxLevelCount = 1;
+    while ((std::max(width, height) >> maxLevelCount) > 0)
+    {
+        ++maxLevelCount;
+    }
+    if (levelCount > maxLevelCount
+        || s_ktx2HeaderSize + levelCount * s_ktx2LevelIndexSize > fileSize)
+    {
+        return "invalid level index";
+    }
+
+    header.format = (VkFormat)format;
+    header.levels.resize(levelCount);
+    for (uint32_t idx = 0; idx < levelCount; ++idx)
+    {
+        Level& level = header.levels[idx];
+        const size_t indexOffset = s_ktx2HeaderSize + idx * s_ktx2LevelIndexSize;
+        level.offset = readValue<uint64_t>(p_data, indexOffset);
+        level.size = readValue<uint64_t>(p_data, indexOffset + 8);
+        level.extent = { std::max(width >> idx, 1u), std::max(height >> idx, 1u) };
+
+        if (level.size == 0 || level.offset > fileSize || level.size > fileSize - level.offset)
+        {
+            return "level " + std::to_string(idx) + " is outside the file";
+        }
+
+        // what the copy reads from the staging ring, tightly packed
+        const uint64_t blockCount =
+            (uint64_t)((level.extent.width + p_formatInfo->blockWidth - 1) / p_formatInfo->blockWidth)
+            * ((level.extent.height + p_formatInfo->blockHeight - 1) / p_formatInfo->blockHeight);
+        if (level.size < blockCount * p_formatInfo->blockSize)
+        {
+            return "level " + std::to_string(idx) + " is smaller than its extent";
+        }
+    }
+
+    return std::string();
+}
+
+void TextureStreamer::loaderMain()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobAdded.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+            if (m_stop)
+            {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        Result result;
+        runJob(job, result);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_results.push_back(std::move(result));
+        }
+    }
+}
+
+void TextureStreamer::runJob(Job& job, Result& result)
+{
+    result.texture = job.texture;
+
+    if (!job.fileName.empty())
+    {
+        result.opened = true;
+        result.file = std::unique_ptr<MappedFile>(new MappedFile());
+        if (!result.file->open(job.fileName))
+        {
+            result.error = "can't open file";
+            return;
+        }
+        result.error = readHeader(*result.file, result.header);
+        return;
+    }
+
+    // first touch of the mapped pages, the file io happens here
+    const uint8_t* const p_fileData = job.p_file->getData();
+    for (uint32_t idx = 0; idx < job.batch.levelCount; ++idx)
+    {
+        const Level& level = job.p_header->levels[job.batch.firstLevel + idx];
+        std::memcpy(mp_ringData + job.batch.regions[idx].bufferOffset,
+            p_fileData + level.offset, (size_t)level.size);
+    }
+    result.batch = std::move(job.batch);
+}
+
+void TextureStreamer::fail(Texture& texture, const std::string& error)
+{
+    // resident levels, if any, stay usable
+    std::cerr << "texture " << texture.fileName << ": " << error << std::endl;
+    texture.state = State::Failed;
+    texture.file.reset();
+}
+
+void TextureStreamer::evict(const TextureId textureId)
+{
+    Texture& texture = m_textures[textureId];
+    assert(texture.state == State::Resident);
+
+    // frames in flight may still sample it
+    mp_gfxResources->getBindlessTable().removeTexture(texture.bindlessIndex,
+        mp_gfxResources->getDeletionQueue());
+    mp_gfxResources->releaseImage(texture.image);
+
+    texture.image = ImageHandle();
+    texture.bindlessIndex = ~0u;
+    texture.evictable = MemoryBudget::c_invalidEvictable;
+    texture.requested = false;
+    texture.state = State::Evicted;
+}
+
+void TextureStreamer::restoreEvicted()
+{
+    MemoryBudget& memoryBudget = mp_gfxResources->getMemoryBudget();
+    for (TextureId textureId = 0; textureId < (TextureId)m_textures.size(); ++textureId)
+    {
+        Texture& texture = m_textures[textureId];
+        if (texture.state != State::Evicted || !texture.requested
+            || !memoryBudget.hasHeadroom(texture.memoryTypeIndex, texture.memorySize))
+        {
+            continue;
+        }
+
+        // streamed again from the file like a new load
+        texture.state = State::Opening;
+        texture.header = Header();
+
+        Job job;
+        job.texture = textureId;
+        job.fileName = texture.fileName;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_jobAdded.notify_one();
+    }
+}
+
+bool TextureStreamer::createImage(Texture& texture, VkCommandBuffer cmdBuffer)
+{
+    const Header& header = texture.header;
+
+    VkFormatProperties formatProperties = {};
+    vkGetPhysicalDeviceFormatProperties(
+        mp_gfxResources->getPhysicalDevice(),   // physicalDevice
+        header.format,                          // format
+        &formatProperties);                     // pFormatProperties
+
+    constexpr VkFormatFeatureFlags requiredFeatures =
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+    {
+        fail(texture, "format " + std::to_string(header.format) + " is not supported by the device");
+        return false;
+    }
+
+    const uint32_t levelCount = (uint32_t)header.levels.size();
+    const ImageHandle image = createSampledImage(*mp_gfxResources,
+        header.format, header.levels[0].extent, levelCount,
+        &texture.memoryTypeIndex, &texture.memorySize);
+
+    texture.bindlessIndex = mp_gfxResources->getBindlessTable().addTexture(
+        mp_gfxResources->getImagePool().get<ImagePool::View>(image),
+        mp_gfxResources->getSamplerPool().get<SamplerPool::Sampler>(m_sampler));
+    if (texture.bindlessIndex == BindlessTable::c_invalidIndex)
+    {
+        mp_gfxResources->releaseImage(image);
+        fail(texture, "bindless texture table is full");
+        return false;
+    }
+    texture.image = image;
+
+    // all levels in the layout of the descriptor, levels below
+    // the min lod are never sampled so their contents don't matter
+    recordImageBarrier(cmdBuffer,
+        mp_gfxResources->getImagePool().get<ImagePool::Image>(texture.image),
+        0, levelCount,
+        0, 0,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    texture.residentLevel = levelCount;
+    return true;
+}
+
+void TextureStreamer::recordUpload(const Batch& batch, VkCommandBuffer cmdBuffer)
+{
+    const Texture& texture = m_textures[batch.texture];
+    VkImage image = mp_gfxResources->getImagePool().get<ImagePool::Image>(texture.image);
+
+    // the levels have not been sampled, their contents can be discarded
+    recordImageBarrier(cmdBuffer, image,
+        batch.firstLevel, batch.levelCount,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    vkCmdCopyBufferToImage(
+        cmdBuffer,                                                          // commandBuffer
+        mp_gfxResources->getBufferPool().get<BufferPool::Buffer>(m_ring),   // srcBuffer
+        image,                                                              // dstImage
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,                               // dstImageLayout
+        (uint32_t)batch.regions.size(),                                     // regionCount
+        batch.regions.data());                                              // pRegions
+
+    recordImageBarrier(cmdBuffer, image,
+        batch.firstLevel, batch.levelCount,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    // the staged data is needed until this frame is done
+    const uint64_t frame = mp_gfxResources->getDeletionQueue().getRecordingFrame();
+    for (RingAllocation& allocation : m_ringAllocations)
+    {
+        if (allocation.begin == batch.ringBegin)
+        {
+            allocation.frame = frame;
+            break;
+        }
+    }
+}
+
+bool TextureStreamer::allocateRing(const VkDeviceSize size, uint64_t& begin)
+{
+    assert(size <= m_ringSize && size % s_stagingAlignment == 0);
+
+    // allocations don't wrap around the end of the buffer
+    begin = m_ringHead;
+    const uint64_t offset = begin % m_ringSize;
+    if (offset + size > m_ringSize)
+    {
+        begin += m_ringSize - offset;
+    }
+    if (begin + size - m_ringTail > m_ringSize)
+    {
+        return false;
+    }
+
+    m_ringHead = begin + size;
+
+    RingAllocation allocation;
+    allocation.begin = begin;
+    allocation.end = m_ringHead;
+    m_ringAllocations.push_back(allocation);
+
+    return true;
+}
+
+void TextureStreamer::releaseRing(const uint64_t completedFrame)
+{
+    // uploads are recorded in allocation order, so frames are increasing
+    while (!m_ringAllocations.empty() && m_ringAllocations.front().frame <= completedFrame)
+    {
+        m_ringTail = m_ringAllocations.front().end;
+        m_ringAllocations.pop_front();
+    }
+    // restart an empty ring from the start of the buffer, otherwise
+    // batches larger than the space on either side of the head never fit
+    if (m_ringAllocations.empty())
+    {
+        m_ringHead = (m_ringHead + m_ringSize - 1) / m_ringSize * m_ringSize;
+        m_ringTail = m_ringHead;
+    }
+}
+
+bool TextureStreamer::stageNextBatch(const TextureId textureId, VkDeviceSize& budget, bool& staged)
+{
+    Texture& texture = m_textures[textureId];
+    if (texture.state != State::Streaming || texture.batchInFlight)
+    {
+        return true;
+    }
+
+    // mip tail first, then one finer level at a time
+    const std::vector<Level>& levels = texture.header.levels;
+    uint32_t firstLevel = texture.residentLevel - 1;
+    VkDeviceSize size = alignStaging(levels[firstLevel].size);
+    if (texture.residentLevel == levels.size())
+    {
+        while (firstLevel > 0 && size + alignStaging(levels[firstLevel - 1].size) <= s_mipTailSize)
+        {
+            --firstLevel;
+            size += alignStaging(levels[firstLevel].size);
+        }
+    }
+
+    if (size > m_ringSize)
+    {
+        fail(texture, "level " + std::to_string(firstLevel) + " does not fit the staging ring");
+        return true;
+    }
+
+    // a batch larger than the whole budget goes alone,
+    // so big levels still make progress
+    if (staged && size > budget)
+    {
+        return false;
+    }
+
+    // retried once earlier batches are released, smaller
+    // batches of other textures may still fit meanwhile
+    uint64_t ringBegin = 0;
+    if (!allocateRing(size, ringBegin))
+    {
+        return true;
+    }
+
+    Job job;
+    job.texture = textureId;
+    job.p_file = texture.file.get();
+    job.p_header = &texture.header;
+    job.batch.texture = textureId;
+    job.batch.firstLevel = firstLevel;
+    job.batch.levelCount = texture.residentLevel - firstLevel;
+    job.batch.ringBegin = ringBegin;
+
+    VkDeviceSize bufferOffset = ringBegin % m_ringSize;
+    for (uint32_t level = firstLevel; level < texture.residentLevel; ++level)
+    {
+        const VkBufferImageCopy bufferImageCopy =
+        {
+            bufferOffset,                   // bufferOffset
+            0,                              // bufferRowLength
+            0,                              // bufferImageHeight
+            {
+                VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
+                level,                      // mipLevel
+                0,                          // baseArrayLayer
+                1                           // layerCount
+            },                              // imageSubresource
+            { 0, 0, 0 },                    // imageOffset
+            {
+                levels[level].extent.width,
+                levels[level].extent.height,
+                1
+            }                               // imageExtent
+        };
+        job.batch.regions.push_back(bufferImageCopy);
+        bufferOffset += alignStaging(levels[level].size);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_jobAdded.notify_one();
+
+    texture.batchInFlight = true;
+    budget -= std::min(size, budget);
+    staged = true;
+
+    return true;
+}
+
+void TextureStreamer::update(VkCommandBuffer cmdBuffer)
+{
+    releaseRing(mp_gfxResources->getDeletionQueue().getCompletedFrame());
+
+    if (!m_placeholderCleared)
+    {
+        VkImage image = mp_gfxResources->getImagePool().get<ImagePool::Image>(m_placeholder);
+
+        recordImageBarrier(cmdBuffer, image, 0, 1,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        constexpr VkClearColorValue white = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+        constexpr VkImageSubresourceRange imageSubresourceRange =
+        {
+            VK_IMAGE_ASPECT_COLOR_BIT,  // aspectMask
+            0,                          // baseMipLevel
+            1,                          // levelCount
+            0,                          // baseArrayLayer
+            1                           // layerCount
+        };
+
+        vkCmdClearColorImage(
+            cmdBuffer,                              // commandBuffer
+            image,                                  // image
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,   // imageLayout
+            &white,                                 // pColor
+            1,                                      // rangeCount
+            &imageSubresourceRange);                // pRanges
+
+        recordImageBarrier(cmdBuffer, image, 0, 1,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        m_placeholderCleared = true;
+    }
+
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        results.swap(m_results);
+    }
+
+    for (Result& result : results)
+    {
+        Texture& texture = m_textures[result.texture];
+
+        if (result.opened)
+        {
+            if (!result.error.empty())
+            {
+                fail(texture, result.error);
+                continue;
+            }
+            texture.file = std::move(result.file);
+            texture.header = std::move(result.header);
+            if (createImage(texture, cmdBuffer))
+            {
+                texture.state = State::Streaming;
+            }
+            continue;
+        }
+
+        recordUpload(result.batch, cmdBuffer);
+        texture.batchInFlight = false;
+        texture.residentLevel = result.batch.firstLevel;
+        if (texture.residentLevel == 0)
+        {
+            texture.state = State::Resident;
+            texture.file.reset();
+
+            const TextureId textureId = result.texture;
+            texture.evictable = mp_gfxResources->getMemoryBudget().addEvictable(
+                mp_gfxResources->getImagePool().get<ImagePool::Memory>(texture.image),
+                [this, textureId]() { evict(textureId); });
+        }
+    }
+
+    restoreEvicted();
+
+    VkDeviceSize budget = m_uploadBudget;
+    bool staged = false;
+    for (TextureId textureId = 0; textureId < (TextureId)m_textures.size(); ++textureId)
+    {
+        if (!stageNextBatch(textureId, budget, staged))
+        {
+            break;
+        }
+    }
+}
+
+uint32_t TextureStreamer::getTextureIndex(const TextureId texture) const
+{
+    if (texture == c_invalidTexture)
+    {
+        return m_placeholderIndex;
+    }
+    assert(texture < m_textures.size());
+
+    const Texture& entry = m_textures[texture];
+    if (entry.state == State::Evicted)
+    {
+        entry.requested = true;
+    }
+    else if (entry.evictable != MemoryBudget::c_invalidEvictable)
+    {
+        mp_gfxResources->getMemoryBudget().touch(entry.evictable,
+            mp_gfxResources->getDeletionQueue().getRecordingFrame());
+    }
+
+    return (entry.image.isValid() && entry.residentLevel < entry.header.levels.size())
+        ? entry.bindlessIndex
+        : m_placeholderIndex;
+}
+
+float TextureStreamer::getMinLod(const TextureId texture) const
+{
+    if (texture == c_invalidTexture)
+    {
+        return 0.0f;
+    }
+    assert(texture < m_textures.size());
+
+    const Texture& entry = m_textures[texture];
+    return (entry.image.isValid() && entry.residentLevel < entry.header.levels.size())
+        ? (float)entry.residentLevel
+        : 0.0f;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,207 @@
+#ifndef CORE_TEXTURE_STREAMER_H
+#define CORE_TEXTURE_STREAMER_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "GfxHandles.h"
+#include "MemoryBudget.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+class Config;
+class GfxResources;
+class MappedFile;
+
+// Streams KTX2 textures in without blocking the frame.
+// A loader thread maps the file and parses the header, the image is then
+// created with its full mip chain and filled from the coarsest mips up:
+// first the mip tail as one upload, then one finer level at a time.
+// Mip data is copied by the loader thread into a persistently mapped
+// staging ring and uploaded by update(), at most the configured amount
+// per frame. Shaders clamp their lod to getMinLod(), so mips that are
+// not resident yet are never sampled.
+// Resident textures are evictable by the memory budget. An evicted
+// texture shows the placeholder and is streamed in again once it is
+// used and its heap has room for it.
+class TextureStreamer
+{
+public:
+    typedef uint32_t TextureId;
+
+    static const TextureId c_invalidTexture = ~0u;
+
+    TextureStreamer(GfxResources* const p_gfxResources, const Config* const p_config);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // returns right away, the file is read on the loader thread
+    TextureId load(const std::string& fileName);
+
+    // records uploads of staged mips and stages the next ones,
+    // call once per frame outside render passes
+    void update(VkCommandBuffer cmdBuffer);
+
+    // slot in the bindless texture array, a 1x1 white placeholder
+    // until the texture has resident mips and for c_invalidTexture.
+    // marks the texture used by the frame being recorded
+    uint32_t getTextureIndex(const TextureId texture) const;
+    // finest resident mip level
+    float getMinLod(const TextureId texture) const;
+
+private:
+    struct Level
+    {
+        // in the file
+        uint64_t offset     = 0;
+        uint64_t size       = 0;
+        VkExtent2D extent   = { 0, 0 };
+    };
+
+    struct Header
+    {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        // level 0 is the largest
+        std::vector<Level> levels;
+    };
+
+    // contiguous range of levels staged with one ring allocation
+    struct Batch
+    {
+        TextureId texture       = 0;
+        uint32_t firstLevel     = 0;
+        uint32_t levelCount     = 0;
+        uint64_t ringBegin      = 0;
+        std::vector<VkBufferImageCopy> regions;
+    };
+
+    enum class State
+    {
+        Opening,
+        Streaming,
+        Resident,
+        Evicted,
+        Failed,
+    };
+
+    struct Texture
+    {
+        std::string fileName;
+        State state = State::Opening;
+
+        // owned by the loader thread while a batch is being staged
+        std::unique_ptr<MappedFile> file;
+        Header header;
+
+        ImageHandle image;
+        uint32_t bindlessIndex = ~0u;
+        uint32_t memoryTypeIndex = ~0u;
+        VkDeviceSize memorySize = 0;
+
+        MemoryBudget::EvictableId evictable = MemoryBudget::c_invalidEvictable;
+        // used while evicted, set by the const getTextureIndex()
+        mutable bool requested = false;
+
+        // levels from here to the smallest are resident
+        uint32_t residentLevel  = 0;
+        bool batchInFlight      = false;
+    };
+
+    struct Job
+    {
+        TextureId texture = 0;
+        // empty for staging jobs
+        std::string fileName;
+        const MappedFile* p_file = nullptr;
+        const Header* p_header = nullptr;
+        Batch batch;
+    };
+
+    struct Result
+    {
+        TextureId texture = 0;
+        bool opened = false;
+        std::string error;
+        std::unique_ptr<MappedFile> file;
+        Header header;
+        Batch batch;
+    };
+
+    struct RingAllocation
+    {
+        uint64_t begin = 0;
+        uint64_t end   = 0;
+        // frame that reads it, ~0 until the upload is recorded
+        uint64_t frame = ~0ull;
+    };
+
+    // returns an error message, empty on success
+    static std::string readHeader(const MappedFile& file, Header& header);
+
+    void loaderMain();
+    void runJob(Job& job, Result& result);
+
+    void createPlaceholder();
+    bool createImage(Texture& texture, VkCommandBuffer cmdBuffer);
+    void recordUpload(const Batch& batch, VkCommandBuffer cmdBuffer);
+    void fail(Texture& texture, const std::string& error);
+    // called by the memory budget
+    void evict(const TextureId textureId);
+    void restoreEvicted();
+
+    // false once the upload budget is used up
+    bool stageNextBatch(const TextureId textureId, VkDeviceSize& budget, bool& staged);
+
+    // ring offsets grow forever, the buffer offset is offset % size
+    bool allocateRing(const VkDeviceSize size, uint64_t& begin);
+    void releaseRing(const uint64_t completedFrame);
+
+    GfxResources* const mp_gfxResources = nullptr;
+    VkDevice m_device = nullptr;
+    const VkDeviceSize m_uploadBudget = 0;
+
+    // deque keeps the headers in place for the loader thread
+    std::deque<Texture> m_textures;
+
+    ImageHandle m_placeholder;
+    uint32_t m_placeholderIndex = ~0u;
+    bool m_placeholderCleared = false;
+
+    SamplerHandle m_sampler;
+
+    BufferHandle m_ring;
+    uint8_t* mp_ringData    = nullptr;
+    VkDeviceSize m_ringSize = 0;
+    uint64_t m_ringHead     = 0;
+    uint64_t m_ringTail     = 0;
+    std::deque<RingAllocation> m_ringAllocations;
+
+    std::thread m_loader;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAdded;
+    std::deque<Job> m_jobs;
+    std::vector<Result> m_results;
+    bool m_stop = false;
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_TEXTURE_STREAMER_H
@@ -0,0 +1,77 @@
+#ifndef CORE_TRIPLE_BUFFER_H
+#define CORE_TRIPLE_BUFFER_H
+
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include <atomic>
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+// Lock-free single producer / single consumer triple buffer.
+// The writer fills the back buffer and publishes it by swapping it with the
+// middle buffer. The reader takes the middle buffer only when it is fresh.
+// Neither side ever waits for the other.
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    ~TripleBuffer() = default;
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // writer thread only
+    T& getWriteBuffer()
+    {
+        return m_buffers[m_writeIndex];
+    }
+
+    // writer thread only
+    void publish()
+    {
+        const uint8_t prev = m_middle.exchange(
+            uint8_t(m_writeIndex | c_freshBit), std::memory_order_acq_rel);
+        m_writeIndex = prev & c_indexMask;
+    }
+
+    // reader thread only, returns true if a new buffer was taken
+    bool update()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & c_freshBit) == 0)
+        {
+            return false;
+        }
+
+        const uint8_t prev = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+        m_readIndex = prev & c_indexMask;
+        return true;
+    }
+
+    // reader thread only
+    const T& getReadBuffer() const
+    {
+        return m_buffers[m_readIndex];
+    }
+
+private:
+    static const uint8_t c_freshBit     = 0x4;
+    static const uint8_t c_indexMask    = 0x3;
+
+    T m_buffers[3] = {};
+
+    uint8_t m_writeIndex = 0;                   // writer owned
+    std::atomic<uint8_t> m_middle { uint8_t(1) };// shared, index | fresh bit
+    uint8_t m_readIndex = 2;                    // reader owned
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CORE_TRIPLE_BUFFER_H
@@ -4,15 +4,44 @@
 // Copyright (c) 2017 Johannes Pystynen
 // This code is licensed under the MIT license (MIT)
 
+#include "EventQueue.h"
+
+#include <cstdint>
 #include <string>
 
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
 #include <windows.h>
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+#include <xcb/xcb.h>
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 
 namespace core
 {
 
+struct WindowEvent
+{
+    enum class Type : uint32_t
+    {
+        Close,
+        Resize,
+        KeyDown,
+        KeyUp,
+        MouseMove,
+        MouseButtonDown,
+        MouseButtonUp,
+    };
+
+    Type type       = Type::Close;
+    uint32_t key    = 0;    // platform key code or mouse button
+    int32_t x       = 0;    // mouse position
+    int32_t y       = 0;
+    uint32_t width  = 0;    // new size for Resize
+    uint32_t height = 0;
+};
+
+// Platform window. The implementation is in WindowWin32.cpp or WindowXcb.cpp
 class Window
 {
 public:
@@ -22,25 +51,52 @@ public:
     Window(const Window&) = delete;
     Window& operator=(const Window&) = delete;
 
+    // drains all pending platform events into the event queue
     void update();
     bool shouldClose() const;
 
+    // returns false when the queue is empty
+    bool pollEvent(WindowEvent& event);
+
     uint32_t getWidth() const;
     uint32_t getHeight() const;
+    // client area size, the Resize event follows from the platform
+    void setSize(const uint32_t width, const uint32_t height);
 
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
     HWND getHwnd() const;
     HINSTANCE getHinstance() const;
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    xcb_connection_t* getConnection() const;
+    xcb_window_t getXcbWindow() const;
+    xcb_visualid_t getVisualId() const;
+#endif
 
 private:
+    // updates window state and queues the event
+    void pushEvent(const WindowEvent& event);
+
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+    static LRESULT CALLBACK windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
     HWND m_hwnd;
     HINSTANCE m_hinstance;
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    void handleEvent(const xcb_generic_event_t* const p_event);
+
+    xcb_connection_t* mp_connection = nullptr;
+    xcb_window_t m_xcbWindow        = 0;
+    xcb_visualid_t m_visualId       = 0;
+    xcb_atom_t m_deleteWindowAtom   = 0;
+#endif
 
     uint32_t m_width    = 0;
     uint32_t m_height   = 0;
 
     std::string m_name;
     bool m_closeWindow = false;
+
+    EventQueue<WindowEvent, 256> m_events;
 };
 
 } // namespace
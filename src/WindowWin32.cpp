@@ -0,0 +1,179 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "Window.h"
+
+#include "Profiler.h"
+
+#include <string>
+#include <assert.h>
+
+#include <windows.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+    LRESULT CALLBACK Window::windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        Window* const p_window = (Window*)GetWindowLongPtr(hWnd, GWLP_USERDATA);
+        if (!p_window)
+        {
+            // messages sent during CreateWindowEx()
+            return DefWindowProc(hWnd, uMsg, wParam, lParam);
+        }
+
+        WindowEvent event;
+        switch (uMsg)
+        {
+        case WM_CLOSE:
+        case WM_DESTROY:
+        {
+            event.type = WindowEvent::Type::Close;
+            p_window->pushEvent(event);
+            PostQuitMessage(0);
+            return 0;
+        } break;
+        case WM_SIZE:
+        {
+            event.type = WindowEvent::Type::Resize;
+            event.width = LOWORD(lParam);
+            event.height = HIWORD(lParam);
+            p_window->pushEvent(event);
+        } break;
+        case WM_KEYDOWN:
+        case WM_KEYUP:
+        {
+            event.type = (uMsg == WM_KEYDOWN) ? WindowEvent::Type::KeyDown : WindowEvent::Type::KeyUp;
+            event.key = (uint32_t)wParam;
+            p_window->pushEvent(event);
+        } break;
+        case WM_MOUSEMOVE:
+        case WM_LBUTTONDOWN:
+        case WM_LBUTTONUP:
+        case WM_RBUTTONDOWN:
+        case WM_RBUTTONUP:
+        {
+            event.type = (uMsg == WM_MOUSEMOVE) ? WindowEvent::Type::MouseMove
+                : (uMsg == WM_LBUTTONDOWN || uMsg == WM_RBUTTONDOWN) ? WindowEvent::Type::MouseButtonDown
+                : WindowEvent::Type::MouseButtonUp;
+            event.key = (uMsg == WM_RBUTTONDOWN || uMsg == WM_RBUTTONUP) ? 2 : 1;
+            event.x = (int16_t)LOWORD(lParam);
+            event.y = (int16_t)HIWORD(lParam);
+            p_window->pushEvent(event);
+        } break;
+        default:break;
+        }
+        return DefWindowProc(hWnd, uMsg, wParam, lParam);
+    }
+
+    Window::Window(const uint32_t width, const uint32_t height, const std::string& name)
+        : m_width(width), m_height(height), m_name(name)
+    {
+        m_hinstance = GetModuleHandle(nullptr);
+
+        WNDCLASSEX wcex;
+        ZeroMemory(&wcex, sizeof(WNDCLASSEX));
+
+        wcex.cbSize = sizeof(WNDCLASSEX);
+        wcex.style = CS_HREDRAW | CS_VREDRAW;
+        wcex.lpfnWndProc = windowProc;
+        wcex.cbClsExtra = 0;
+        wcex.cbWndExtra = 0;
+        wcex.hInstance = m_hinstance;
+        wcex.hCursor = LoadCursor(NULL, IDC_ARROW);
+        wcex.hbrBackground = (HBRUSH)(COLOR_WINDOW + 1);
+        wcex.lpszMenuName = nullptr;
+        wcex.lpszClassName = m_name.c_str();
+        //wcex.hIconSm = LoadIcon(wcex.hInstance, MAKEINTRESOURCE(IDI_APPLICATION));
+        const auto res = RegisterClassEx(&wcex);
+        assert(res > 0);
+
+        DWORD dwStyle = WS_CAPTION | WS_SYSMENU | WS_THICKFRAME | WS_MINIMIZEBOX | WS_MAXIMIZEBOX;
+        DWORD dwExStyle = WS_EX_APPWINDOW | WS_EX_WINDOWEDGE;
+        RECT winRect = { 0, 0, LONG(width), LONG(height) };
+
+        const BOOL success = AdjustWindowRectEx(&winRect, dwStyle, FALSE, dwExStyle);
+        assert(success);
+
+        m_hwnd = CreateWindowEx(
+            0,
+            m_name.c_str(),
+            m_name.c_str(),
+            dwStyle,
+            CW_USEDEFAULT,
+            CW_USEDEFAULT,
+            winRect.right - winRect.left,
+            winRect.bottom - winRect.top,
+            nullptr,
+            nullptr,
+            m_hinstance,
+            nullptr);
+        assert(m_hwnd);
+
+        SetWindowLongPtr(m_hwnd, GWLP_USERDATA, (intptr_t)this);
+
+        ShowWindow(m_hwnd, SW_SHOWDEFAULT);
+    }
+
+Window::~Window()
+{
+    SetWindowLongPtr(m_hwnd, GWLP_USERDATA, 0);
+    DestroyWindow(m_hwnd);
+    UnregisterClass(m_name.c_str(), m_hinstance);
+}
+
+void Window::update()
+{
+    CORE_PROFILE_ZONE("Window::update");
+
+    // handle everything pending, not just one message per frame
+    MSG msg;
+    while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+    {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+
+        if (msg.message == WM_QUIT && !m_closeWindow)
+        {
+            WindowEvent event;
+            event.type = WindowEvent::Type::Close;
+            pushEvent(event);
+        }
+    }
+}
+
+void Window::setSize(const uint32_t width, const uint32_t height)
+{
+    const DWORD dwStyle = (DWORD)GetWindowLongPtr(m_hwnd, GWL_STYLE);
+    const DWORD dwExStyle = (DWORD)GetWindowLongPtr(m_hwnd, GWL_EXSTYLE);
+    RECT winRect = { 0, 0, LONG(width), LONG(height) };
+
+    const BOOL success = AdjustWindowRectEx(&winRect, dwStyle, FALSE, dwExStyle);
+    assert(success);
+
+    // sends WM_SIZE before returning
+    SetWindowPos(
+        m_hwnd,
+        nullptr,
+        0,
+        0,
+        winRect.right - winRect.left,
+        winRect.bottom - winRect.top,
+        SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+}
+
+HWND Window::getHwnd() const
+{
+    return m_hwnd;
+}
+
+HINSTANCE Window::getHinstance() const
+{
+    return m_hinstance;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,222 @@
+// Copyright (c) 2017 Johannes Pystynen
+// This code is licensed under the MIT license (MIT)
+
+#include "Window.h"
+
+#include "Profiler.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <assert.h>
+
+#include <xcb/xcb.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace core
+{
+
+static xcb_atom_t internAtom(xcb_connection_t* const p_connection, const char* const name)
+{
+    const xcb_intern_atom_cookie_t cookie =
+        xcb_intern_atom(p_connection, 0, (uint16_t)strlen(name), name);
+    xcb_intern_atom_reply_t* const p_reply =
+        xcb_intern_atom_reply(p_connection, cookie, nullptr);
+    const xcb_atom_t atom = p_reply ? p_reply->atom : (xcb_atom_t)XCB_ATOM_NONE;
+    free(p_reply);
+    return atom;
+}
+
+Window::Window(const uint32_t width, const uint32_t height, const std::string& name)
+    : m_width(width), m_height(height), m_name(name)
+{
+    int screenIndex = 0;
+    mp_connection = xcb_connect(nullptr, &screenIndex);
+    if (xcb_connection_has_error(mp_connection))
+    {
+        xcb_disconnect(mp_connection);
+        throw std::runtime_error("Cannot connect to X server, is DISPLAY set?");
+    }
+
+    xcb_screen_iterator_t screenIter = xcb_setup_roots_iterator(xcb_get_setup(mp_connection));
+    for (int idx = 0; idx < screenIndex; ++idx)
+    {
+        xcb_screen_next(&screenIter);
+    }
+    const xcb_screen_t* const p_screen = screenIter.data;
+    assert(p_screen);
+
+    m_visualId = p_screen->root_visual;
+    m_xcbWindow = xcb_generate_id(mp_connection);
+
+    const uint32_t valueMask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
+    const uint32_t values[] =
+    {
+        p_screen->black_pixel,
+        XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE
+            | XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE
+            | XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_STRUCTURE_NOTIFY
+    };
+
+    xcb_create_window(
+        mp_connection,
+        XCB_COPY_FROM_PARENT,
+        m_xcbWindow,
+        p_screen->root,
+        0,
+        0,
+        (uint16_t)width,
+        (uint16_t)height,
+        0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT,
+        m_visualId,
+        valueMask,
+        values);
+
+    xcb_change_property(
+        mp_connection,
+        XCB_PROP_MODE_REPLACE,
+        m_xcbWindow,
+        XCB_ATOM_WM_NAME,
+        XCB_ATOM_STRING,
+        8,
+        (uint32_t)m_name.size(),
+        m_name.c_str());
+
+    // ask the window manager to send a message instead of killing the connection
+    const xcb_atom_t protocolsAtom = internAtom(mp_connection, "WM_PROTOCOLS");
+    m_deleteWindowAtom = internAtom(mp_connection, "WM_DELETE_WINDOW");
+    xcb_change_property(
+        mp_connection,
+        XCB_PROP_MODE_REPLACE,
+        m_xcbWindow,
+        protocolsAtom,
+        XCB_ATOM_ATOM,
+        32,
+        1,
+        &m_deleteWindowAtom);
+
+    xcb_map_window(mp_connection, m_xcbWindow);
+    xcb_flush(mp_connection);
+}
+
+Window::~Window()
+{
+    xcb_destroy_window(mp_connection, m_xcbWindow);
+    xcb_disconnect(mp_connection);
+}
+
+void Window::update()
+{
+    CORE_PROFILE_ZONE("Window::update");
+
+    // handle everything pending, not just one event per frame
+    xcb_generic_event_t* p_event = nullptr;
+    while ((p_event = xcb_poll_for_event(mp_connection)) != nullptr)
+    {
+        handleEvent(p_event);
+        free(p_event);
+    }
+
+    if (xcb_connection_has_error(mp_connection) && !m_closeWindow)
+    {
+        WindowEvent event;
+        event.type = WindowEvent::Type::Close;
+        pushEvent(event);
+    }
+}
+
+void Window::handleEvent(const xcb_generic_event_t* const p_event)
+{
+    WindowEvent event;
+    switch (p_event->response_type & ~0x80)
+    {
+    case XCB_CLIENT_MESSAGE:
+    {
+        const auto* const p_message = (const xcb_client_message_event_t*)p_event;
+        if (p_message->data.data32[0] == m_deleteWindowAtom)
+        {
+            event.type = WindowEvent::Type::Close;
+            pushEvent(event);
+        }
+    } break;
+    case XCB_DESTROY_NOTIFY:
+    {
+        event.type = WindowEvent::Type::Close;
+        pushEvent(event);
+    } break;
+    case XCB_CONFIGURE_NOTIFY:
+    {
+        const auto* const p_configure = (const xcb_configure_notify_event_t*)p_event;
+        event.type = WindowEvent::Type::Resize;
+        event.width = p_configure->width;
+        event.height = p_configure->height;
+        pushEvent(event);
+    } break;
+    case XCB_KEY_PRESS:
+    case XCB_KEY_RELEASE:
+    {
+        const auto* const p_key = (const xcb_key_press_event_t*)p_event;
+        event.type = ((p_event->response_type & ~0x80) == XCB_KEY_PRESS)
+            ? WindowEvent::Type::KeyDown : WindowEvent::Type::KeyUp;
+        event.key = p_key->detail;
+        event.x = p_key->event_x;
+        event.y = p_key->event_y;
+        pushEvent(event);
+    } break;
+    case XCB_BUTTON_PRESS:
+    case XCB_BUTTON_RELEASE:
+    {
+        const auto* const p_button = (const xcb_button_press_event_t*)p_event;
+        event.type = ((p_event->response_type & ~0x80) == XCB_BUTTON_PRESS)
+            ? WindowEvent::Type::MouseButtonDown : WindowEvent::Type::MouseButtonUp;
+        event.key = p_button->detail;
+        event.x = p_button->event_x;
+        event.y = p_button->event_y;
+        pushEvent(event);
+    } break;
+    case XCB_MOTION_NOTIFY:
+    {
+        const auto* const p_motion = (const xcb_motion_notify_event_t*)p_event;
+        event.type = WindowEvent::Type::MouseMove;
+        event.x = p_motion->event_x;
+        event.y = p_motion->event_y;
+        pushEvent(event);
+    } break;
+    default:break;
+    }
+}
+
+void Window::setSize(const uint32_t width, const uint32_t height)
+{
+    const uint32_t values[] = { width, height };
+    xcb_configure_window(
+        mp_connection,
+        m_xcbWindow,
+        XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+        values);
+
+    // round trip, so the configure notify is queued for the next update()
+    free(xcb_get_input_focus_reply(mp_connection, xcb_get_input_focus(mp_connection), nullptr));
+}
+
+xcb_connection_t* Window::getConnection() const
+{
+    return mp_connection;
+}
+
+xcb_window_t Window::getXcbWindow() const
+{
+    return m_xcbWindow;
+}
+
+xcb_visualid_t Window::getVisualId() const
+{
+    return m_visualId;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
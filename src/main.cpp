@@ -8,13 +8,13 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
-int main()
+int main(int argc, char* argv[])
 {
     try
     {
         core::Engine app;
 
-        app.init();
+        app.init(argc, argv);
         app.run();
     }
     catch (const std::runtime_error& err)